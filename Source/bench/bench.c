@@ -0,0 +1,616 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+
+#include "../compiler/compiler.h"
+#include "../virtual_machine/vm.h"
+#include "../method/method.h"
+#include "../virtual_machine/opcodes.h"
+#include "../statistics/statistics.h"
+
+/** @file bench.c
+ *
+ *  Benchmark of every stage of the program.
+ *
+ *  For every expression of a corpus, from shallow polynomials to deeply nested
+ *  functions, the benchmark measures the frontend, the derivation, the
+ *  simplification, the backend, a single evaluation by the virtual machine and
+ *  an entire solve by `method_iterate`. Every stage is repeated until it has
+ *  run for a while, so short stages are measured as accurately as long ones.
+ *
+ *  The results are printed as a table. If a file name is passed as the only
+ *  argument the results are also written to that file as tab-separated values
+ *  with a header line, one line per expression, for tracking regressions.
+ *
+ *  After the table follows the throughput of the frontend in megabytes of
+ *  formula text per second, once for the corpus parsed formula by formula into
+ *  an arena which is reset in between, the way an ingest path would use it,
+ *  and once for one large formula made of many copies of the corpus.
+ *
+ *  Then comes the time of the gradient of an expression in many variables,
+ *  once evaluating the compiled partial derivatives by every variable and once
+ *  by a single reverse sweep over a tape.
+ *
+ *  Then the polynomials of the corpus are evaluated and solved twice, once on
+ *  the dual-number machine and once by Horner's scheme on their coefficients.
+ *
+ *  Last every expression of the corpus is searched for roots by
+ *  `method_search` on one thread, which includes pruning the seeds by
+ *  interval arithmetic.
+ *
+ *  Built with `NEWTON_STATISTICS` the benchmark also prints a profile of every
+ *  expression: the allocations of compiling it, the iterations of solving it,
+ *  the share of cycles spent in the function and the opcodes which took the
+ *  most cycles. The timings of the table include the instrumentation then.
+ */
+
+/** Minimum time in nanoseconds to repeat every measurement for. */
+#define MIN_TIME  50e6
+
+/** Expression of the corpus along with a guess which converges. */
+struct benchmark {
+	const char *expression; /**< Function string.           */
+	double      guess;      /**< Starting value of solving. */
+};
+
+/** Corpus of expressions to benchmark. */
+static const struct benchmark corpus[] = {
+	{"x^2 - 2"                                                 , 1.0},
+	{"3x^5 - 2x^2 + 7x - 1"                                    , 0.0},
+	{"x^9 - 4x^7 + 2x^5 - x^3 + 5x - 1"                        , 0.0},
+	{"(x+1)*(x-2)*(x+3)*(x-4)*(x+5)*(x-6)"                     , 1.5},
+	{"((((x+1)*x+2)*x+3)*x+4)*x+5 - (x-1)/(x+2) + (x-3)/(x+4)" , -1.0},
+	{"sin(x) * cos(x) + tan(x/7)"                              , 3.0},
+	{"exp(sin(x)) / (1 + x*x) - ln(2 + cos(x))"                , 1.0},
+	{"sin(cos(sin(cos(sin(cos(sin(cos(x)))))))) - 0.7"         , 1.0},
+	{"sin(3cos(sin(3cos(sin(x))))) - 0.5"                      , 1.0},
+	{"exp(sin(exp(cos(x)))) - 2"                               , 1.0},
+	{"x^x^0.5 - 2/x + ln(x^2 + 1) * e^(-x) - pi"               , 2.0},
+};
+
+/** Results of one expression. */
+struct result {
+	size_t characters;       /**< Length of the expression.                */
+	size_t nodes;            /**< Nodes of the simplified function.        */
+	size_t derived_nodes;    /**< Nodes of the raw derivative.             */
+	size_t simplified_nodes; /**< Nodes of the simplified derivative.      */
+	size_t bytes;            /**< Bytecode of function plus derivative.    */
+	double frontend;         /**< Time of the frontend per character.      */
+	double derive;           /**< Time of deriving the function.           */
+	double simplify;         /**< Time of simplifying the derivative.      */
+	double backend;          /**< Time of compiling function and derivative. */
+	double evaluate;         /**< Time of one evaluation of the function.  */
+	double solves;           /**< Solves per second.                       */
+};
+
+/** Repeats a statement until it has run for `MIN_TIME`.
+ *
+ *  @param time       Variable to store the time of a single run in.
+ *  @param statement  The statement to repeat, may use the counter `rep`.
+ */
+#define MEASURE(time, statement) { \
+	size_t repetitions = 1; \
+	double elapsed; \
+	for (;;) { \
+		double start = now(); \
+		for (size_t rep = 0; rep < repetitions; ++rep) {statement} \
+		elapsed = now() - start; \
+		if (elapsed >= MIN_TIME) {break;} \
+		repetitions *= 2; \
+	} \
+	time = elapsed / repetitions; \
+}
+
+/** Benchmarks one expression.
+ *
+ *  @param benchmark  The expression to benchmark.
+ *  @param result     Results to fill in.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int run(const struct benchmark *benchmark, struct result *result);
+
+/** Number of copies of the corpus in the large formula. */
+#define LARGE_COPIES  1000
+
+/** Measures and prints the throughput of the frontend.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int throughput(void);
+
+/** Number of variables of the expression to take the gradient of. */
+#define GRADIENT_VARIABLES  50
+
+/** Measures and prints the cost of a gradient, symbolic versus taped.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int gradients(void);
+
+/** Measures and prints the polynomials of the corpus, VM versus Horner.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int polynomials(void);
+
+/** Number of seeds and bounds of the interval of the search benchmark. */
+#define SEARCH_SEEDS  10000
+#define SEARCH_LOWER  -100.0
+#define SEARCH_UPPER  100.0
+
+/** Measures and prints searches of the corpus.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int searches(void);
+
+#ifdef NEWTON_STATISTICS
+/** Number of solves of the profile. */
+#define PROFILE_SOLVES  1000
+
+/** Prints the profile of one expression.
+ *
+ *  @param benchmark  The expression to profile.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int profile(const struct benchmark *benchmark);
+#endif
+
+/** Number of nodes of a tree. */
+static size_t count_nodes(const SyntaxNode *node);
+
+/** Current time in nanoseconds. */
+static double now(void);
+
+int main(int argc, const char *argv[]) {
+	FILE *output = NULL; /* File of machine-readable results. */
+
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench [output.tsv]\n");
+		return 1;
+	}
+	if (argc == 2 && !(output = fopen(argv[1], "w"))) {
+		fprintf(stderr, "Error: could not open '%s'.\n", argv[1]);
+		return 1;
+	}
+
+	printf("%-58s %9s %6s %9s %6s %9s %6s %9s %6s %8s %9s\n",
+	       "expression", "front ns/c", "nodes", "derive ns", "nodes", "simpl ns", "nodes",
+	       "back ns", "bytes", "eval ns", "solves/s");
+	if (output) {
+		fprintf(output, "expression\tcharacters\tfrontend_ns_per_char\tnodes\tderive_ns\tderived_nodes"
+		                "\tsimplify_ns\tsimplified_nodes\tbackend_ns\tbytes\tevaluate_ns\tsolves_per_s\n");
+	}
+
+	for (size_t i = 0; i < sizeof corpus / sizeof corpus[0]; ++i) {
+		struct result r = {0};
+		if (run(&corpus[i], &r) != 0) {
+			fprintf(stderr, "Error: could not benchmark '%s'.\n", corpus[i].expression);
+			if (output) {fclose(output);}
+			return 1;
+		}
+
+		printf("%-58s %9.2f %6zu %9.0f %6zu %9.0f %6zu %9.0f %6zu %8.2f %9.0f\n",
+		       corpus[i].expression, r.frontend, r.nodes, r.derive, r.derived_nodes,
+		       r.simplify, r.simplified_nodes, r.backend, r.bytes, r.evaluate, r.solves);
+		if (output) {
+			fprintf(output, "%s\t%zu\t%.3f\t%zu\t%.1f\t%zu\t%.1f\t%zu\t%.1f\t%zu\t%.3f\t%.1f\n",
+			        corpus[i].expression, r.characters, r.frontend, r.nodes, r.derive, r.derived_nodes,
+			        r.simplify, r.simplified_nodes, r.backend, r.bytes, r.evaluate, r.solves);
+		}
+	}
+
+	if (throughput() != 0) {
+		fprintf(stderr, "Error: could not benchmark the frontend.\n");
+		if (output) {fclose(output);}
+		return 1;
+	}
+
+	if (gradients() != 0) {
+		fprintf(stderr, "Error: could not benchmark the gradient.\n");
+		if (output) {fclose(output);}
+		return 1;
+	}
+
+	if (polynomials() != 0) {
+		fprintf(stderr, "Error: could not benchmark the polynomials.\n");
+		if (output) {fclose(output);}
+		return 1;
+	}
+
+	if (searches() != 0) {
+		fprintf(stderr, "Error: could not benchmark the search.\n");
+		if (output) {fclose(output);}
+		return 1;
+	}
+
+	#ifdef NEWTON_STATISTICS
+	printf("\n%-58s %8s %8s %10s  %s\n", "expression", "allocs", "iter", "function", "opcodes by cycles");
+	for (size_t i = 0; i < sizeof corpus / sizeof corpus[0]; ++i) {
+		if (profile(&corpus[i]) != 0) {
+			fprintf(stderr, "Error: could not profile '%s'.\n", corpus[i].expression);
+			if (output) {fclose(output);}
+			return 1;
+		}
+	}
+	#endif
+
+	if (output && fclose(output) != 0) {
+		fprintf(stderr, "Error: could not write '%s'.\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}
+
+static int run(const struct benchmark *benchmark, struct result *result) {
+	int error = 0;
+	SyntaxNodeArena arena; /* Arena of the function and derivative.   */
+	SyntaxNodeArena work;  /* Arena of the trees thrown away at once.  */
+	SyntaxNode *function = NULL, *derivative, *scratch;
+	VMCode     *function_code = NULL, *derivative_code = NULL, *code;
+	volatile double sink = 0.0; /* Keeps the results alive. */
+	double time, value;
+
+	syntax_node_arena_init(&arena, 0);
+	syntax_node_arena_init(&work , 0);
+
+	result->characters = strlen(benchmark->expression);
+	MEASURE(time, {
+		syntax_node_arena_reset(&work);
+		scratch = NULL;
+		if (compiler_frontend_arena(benchmark->expression, &work, &scratch) != 0) {error = 1; goto end;}
+	})
+	result->frontend = time / result->characters;
+
+	if (compiler_frontend_arena(benchmark->expression, &arena, &function) != 0) {error = 1; goto end;}
+	syntax_node_arena_simplify(&arena, function);
+	result->nodes = count_nodes(function);
+
+	MEASURE(time, {
+		syntax_node_arena_reset(&work);
+		if (!(scratch = syntax_node_arena_derive(&work, function))) {error = 1; goto end;}
+	})
+	result->derive        = time;
+	result->derived_nodes = count_nodes(scratch);
+
+	/* Simplifying changes the tree, so every run simplifies a new derivative. */
+	MEASURE(time, {
+		syntax_node_arena_reset(&work);
+		if (!(scratch = syntax_node_arena_derive(&work, function))) {error = 1; goto end;}
+		syntax_node_arena_simplify(&work, scratch);
+	})
+	result->simplify = time - result->derive;
+
+	if (!(derivative = syntax_node_arena_derive(&arena, function))) {error = 1; goto end;}
+	syntax_node_arena_simplify(&arena, derivative);
+	result->simplified_nodes = count_nodes(derivative);
+
+	MEASURE(time, {
+		code = NULL;
+		if (compiler_backend(function  , &code) != 0) {error = 1; goto end;}
+		vm_code_clear(code);
+		free(code);
+		code = NULL;
+		if (compiler_backend(derivative, &code) != 0) {error = 1; goto end;}
+		vm_code_clear(code);
+		free(code);
+	})
+	result->backend = time;
+
+	if (compiler_backend(function  , &function_code  ) != 0) {error = 1; goto end;}
+	if (compiler_backend(derivative, &derivative_code) != 0) {error = 1; goto end;}
+	result->bytes = function_code->length + derivative_code->length;
+
+	VirtualMachine machine = {.code = *function_code};
+	MEASURE(time, {
+		machine.reg_x = benchmark->guess + rep * 1e-9;
+		machine_execute(&machine, &value);
+		sink += value;
+	})
+	result->evaluate = time;
+
+	MEASURE(time, {
+		sink += method_iterate(*function_code, *derivative_code, benchmark->guess, &error, 0);
+		if (error != 0) {goto end;}
+	})
+	result->solves = 1e9 / time;
+
+end:
+	if (function_code  ) {vm_code_clear(function_code  ); free(function_code  );}
+	if (derivative_code) {vm_code_clear(derivative_code); free(derivative_code);}
+	syntax_node_arena_release(&work);
+	syntax_node_arena_release(&arena);
+	return error;
+}
+
+static int throughput(void) {
+	const size_t formulas = sizeof corpus / sizeof corpus[0];
+	int    error = 0;
+	size_t characters = 0; /* Length of the entire corpus. */
+	SyntaxNodeArena arena;
+	SyntaxNode *tree;
+	double time;
+
+	for (size_t i = 0; i < formulas; ++i) {characters += strlen(corpus[i].expression);}
+
+	/* The corpus as one sum, "(f1) + (f2) + ...", many times over. */
+	char *large = malloc(LARGE_COPIES * (characters + 5 * formulas) + 1);
+	if (!large) {return 1;}
+	char *end = large;
+	for (size_t copy = 0; copy < LARGE_COPIES; ++copy) {
+		for (size_t i = 0; i < formulas; ++i) {
+			end += sprintf(end, "%s(%s)", end == large ? "" : " + ", corpus[i].expression);
+		}
+	}
+	size_t large_characters = (size_t)(end - large);
+
+	syntax_node_arena_init(&arena, 0);
+	STATISTICS(NewtonStatistics statistics; statistics_reset(&statistics);)
+	MEASURE(time, {
+		for (size_t i = 0; i < formulas; ++i) {
+			syntax_node_arena_reset(&arena);
+			tree = NULL;
+			/* Only count the allocations of the last round, when the arena has warmed up. */
+			STATISTICS(statistics_reset(&statistics); statistics_attach(&statistics);)
+			if (compiler_frontend_arena(corpus[i].expression, &arena, &tree) != 0) {error = 1; goto end;}
+			STATISTICS(statistics_attach(NULL);)
+		}
+	})
+	printf("\nfrontend: %8.2f MB/s over the corpus", characters / time * 1e3);
+	STATISTICS(printf(" (%llu allocations for the last formula)", (unsigned long long)statistics.allocations);)
+	printf("\n");
+
+	MEASURE(time, {
+		syntax_node_arena_reset(&arena);
+		tree = NULL;
+		if (compiler_frontend_arena(large, &arena, &tree) != 0) {error = 1; goto end;}
+	})
+	printf("frontend: %8.2f MB/s over one formula of %zu characters\n", large_characters / time * 1e3, large_characters);
+
+end:
+	STATISTICS(statistics_attach(NULL);)
+	syntax_node_arena_release(&arena);
+	free(large);
+	return error;
+}
+
+static int gradients(void) {
+	const size_t n = GRADIENT_VARIABLES;
+	int    error = 0;
+	size_t bytes = 0; /* Bytecode of all the partial derivatives. */
+	char   source[GRADIENT_VARIABLES * 24 + 32];
+	double symbolic[GRADIENT_VARIABLES]; /* Gradient by the partials. */
+	double deviation = 0;                /* Largest difference.       */
+	double x[GRADIENT_VARIABLES], gradient[GRADIENT_VARIABLES], value, time;
+	volatile double sink = 0.0;
+	SyntaxNodeArena arena;
+	SyntaxNode *function = NULL;
+	VMCode     *function_code = NULL;
+	VMCode     *partials[GRADIENT_VARIABLES] = {NULL};
+	VMTape      tape = {.entries = NULL, .capacity = 0, .length = 0};
+
+	/* (x1 + x2^2 + ... + xn^n) * sin(x1*x2 + x2*x3 + ... + xn*x1), every
+	 * variable affects every term of every partial derivative. */
+	char *end = source + sprintf(source, "(");
+	for (size_t i = 0; i < n; ++i) {
+		end += sprintf(end, "%sx%zu^%zu", i == 0 ? "" : " + ", i + 1, i % 3 + 1);
+		x[i] = 0.5 + 0.01 * i;
+	}
+	end += sprintf(end, ") * sin(");
+	for (size_t i = 0; i < n; ++i) {
+		end += sprintf(end, "%sx%zu*x%zu", i == 0 ? "" : " + ", i + 1, (i + 1) % n + 1);
+	}
+	sprintf(end, ")");
+
+	syntax_node_arena_init(&arena, 0);
+	if (compiler_frontend_arena(source, &arena, &function) != 0) {error = 1; goto end;}
+	syntax_node_arena_simplify(&arena, function);
+	if (compiler_backend(function, &function_code) != 0) {error = 1; goto end;}
+	for (size_t i = 0; i < n; ++i) {
+		SyntaxNode *partial = syntax_node_arena_derive_partial(&arena, function, (unsigned int)(i + 1));
+		if (!partial) {error = 1; goto end;}
+		syntax_node_arena_simplify(&arena, partial);
+		if (compiler_backend(partial, &partials[i]) != 0) {error = 1; goto end;}
+		bytes += partials[i]->length;
+	}
+	if (vm_tape_reserve(&tape, *function_code) != 0) {error = 1; goto end;}
+
+	VirtualMachine machine = {.code = *function_code, .reg_vars = x, .reg_count = n};
+	MEASURE(time, {
+		for (size_t i = 0; i < n; ++i) {
+			machine_load_code(&machine, *partials[i]);
+			if (machine_execute(&machine, &gradient[i]) != 0) {error = 1; goto end;}
+		}
+		sink += gradient[0];
+	})
+	for (size_t i = 0; i < n; ++i) {symbolic[i] = gradient[i];}
+	printf("\ngradient: %8.0f ns symbolic, %zu bytes of partials for %zu variables\n", time, bytes, n);
+
+	machine_load_code(&machine, *function_code);
+	MEASURE(time, {
+		if (machine_execute_gradient(&machine, &tape, &value, gradient) != 0) {error = 1; goto end;}
+		sink += gradient[0];
+	})
+	for (size_t i = 0; i < n; ++i) {
+		double d = fabs(gradient[i] - symbolic[i]) / (1 + fabs(symbolic[i]));
+		if (d > deviation) {deviation = d;}
+	}
+	printf("gradient: %8.0f ns taped, %zu bytes of function, %zu tape entries, deviation %.1e\n",
+	       time, function_code->length, tape.length, deviation);
+
+end:
+	(void)sink;
+	vm_tape_clear(&tape);
+	if (function_code) {vm_code_clear(function_code); free(function_code);}
+	for (size_t i = 0; i < n; ++i) {
+		if (partials[i]) {vm_code_clear(partials[i]); free(partials[i]);}
+	}
+	syntax_node_arena_release(&arena);
+	return error;
+}
+
+static int polynomials(void) {
+	int error = 0;
+	double coefficients[POLYNOMIAL_MAX_DEGREE + 1];
+	size_t degree;
+	double vm, horner, vm_solves, horner_solves, value, derivative;
+	volatile double sink = 0.0;
+	SyntaxNodeArena arena;
+
+	syntax_node_arena_init(&arena, 0);
+	printf("\n%-58s %9s %9s %11s %15s\n", "polynomial", "vm ns", "horner ns", "vm solves/s", "horner solves/s");
+	for (size_t i = 0; i < sizeof corpus / sizeof corpus[0]; ++i) {
+		const struct benchmark *b = &corpus[i];
+		SyntaxNode *function = NULL;
+		VMCode     *code     = NULL;
+
+		syntax_node_arena_reset(&arena);
+		if (compiler_frontend_arena(b->expression, &arena, &function) != 0) {error = 1; goto end;}
+		syntax_node_arena_simplify(&arena, function);
+		if (syntax_node_polynomial(function, coefficients, &degree) != 0) {continue;}
+		if (compiler_backend(function, &code) != 0) {error = 1; goto end;}
+
+		VirtualMachine machine = {.code = *code};
+		MEASURE(vm, {
+			machine.reg_x = b->guess + rep * 1e-9;
+			machine_execute_dual(&machine, &value, &derivative);
+			sink += value + derivative;
+		})
+		MEASURE(horner, {
+			method_polynomial_evaluate(coefficients, degree, b->guess + rep * 1e-9, &value, &derivative);
+			sink += value + derivative;
+		})
+		MEASURE(vm_solves, {
+			sink += method_iterate_fused(*code, b->guess, &error, 0);
+			if (error != 0) {break;}
+		})
+		MEASURE(horner_solves, {
+			sink += method_iterate_polynomial(coefficients, degree, b->guess, &error, 0);
+			if (error != 0) {break;}
+		})
+		vm_code_clear(code);
+		free(code);
+		if (error != 0) {goto end;}
+
+		printf("%-58s %9.2f %9.2f %11.0f %15.0f\n", b->expression, vm, horner, 1e9 / vm_solves, 1e9 / horner_solves);
+	}
+
+end:
+	(void)sink;
+	syntax_node_arena_release(&arena);
+	return error;
+}
+
+static int searches(void) {
+	int error = 0;
+	double time;
+	size_t count;
+	SyntaxNodeArena arena;
+
+	syntax_node_arena_init(&arena, 0);
+	printf("\nsearch of [%g, %g] from %d seeds on one thread\n", SEARCH_LOWER, SEARCH_UPPER, SEARCH_SEEDS);
+	printf("%-58s %9s %7s\n", "expression", "search ms", "roots");
+	for (size_t i = 0; i < sizeof corpus / sizeof corpus[0]; ++i) {
+		SyntaxNode *function = NULL;
+		VMCode     *code     = NULL;
+
+		syntax_node_arena_reset(&arena);
+		if (compiler_frontend_arena(corpus[i].expression, &arena, &function) != 0) {error = 1; goto end;}
+		syntax_node_arena_simplify(&arena, function);
+		if (compiler_backend(function, &code) != 0) {error = 1; goto end;}
+
+		MEASURE(time, {
+			double *roots = method_search(*code, SEARCH_LOWER, SEARCH_UPPER, SEARCH_SEEDS, 1, 0.0001, &count, &error);
+			free(roots);
+			if (error != 0) {break;}
+		})
+		vm_code_clear(code);
+		free(code);
+		if (error != 0) {goto end;}
+
+		printf("%-58s %9.2f %7zu\n", corpus[i].expression, time / 1e6, count);
+	}
+
+end:
+	syntax_node_arena_release(&arena);
+	return error;
+}
+
+#ifdef NEWTON_STATISTICS
+static int profile(const struct benchmark *benchmark) {
+	static const char *names[] = {
+		[OPC_NUM ] = "num", [OPC_NEG ] = "neg", [OPC_ADD  ] = "add", [OPC_SUB] = "sub",
+		[OPC_MULT] = "mul", [OPC_DIV ] = "div", [OPC_POW  ] = "pow", [OPC_EXP] = "exp",
+		[OPC_LN  ] = "ln" , [OPC_SIN ] = "sin", [OPC_COS  ] = "cos", [OPC_TAN] = "tan",
+		[OPC_PI  ] = "pi" , [OPC_E   ] = "e"  , [OPC_VAR_X] = "x"  ,
+		[OPC_VAR ] = "var", [OPC_ADDC] = "addc", [OPC_MULC ] = "mulc",
+		[OPC_MADDC] = "maddc", [OPC_POWI] = "powi",
+	};
+	int error = 0;
+	SyntaxNodeArena arena;
+	SyntaxNode *function = NULL, *derivative;
+	VMCode     *function_code = NULL, *derivative_code = NULL;
+	NewtonStatistics statistics;
+	volatile double sink = 0.0;
+
+	statistics_reset(&statistics);
+	statistics_attach(&statistics);
+	syntax_node_arena_init(&arena, 0);
+
+	if (compiler_frontend_arena(benchmark->expression, &arena, &function) != 0) {error = 1; goto end;}
+	syntax_node_arena_simplify(&arena, function);
+	if (!(derivative = syntax_node_arena_derive(&arena, function))) {error = 1; goto end;}
+	syntax_node_arena_simplify(&arena, derivative);
+	if (compiler_backend(function  , &function_code  ) != 0) {error = 1; goto end;}
+	if (compiler_backend(derivative, &derivative_code) != 0) {error = 1; goto end;}
+	uint64_t allocations = statistics.allocations;
+
+	for (int i = 0; i < PROFILE_SOLVES && error == 0; ++i) {
+		sink += method_iterate(*function_code, *derivative_code, benchmark->guess, &error, 0);
+	}
+	if (error != 0) {goto end;}
+
+	printf("%-58s %8llu %8.2f %9.1f%% ", benchmark->expression, (unsigned long long)allocations,
+	       (double)statistics.iterations / statistics.solves,
+	       100.0 * statistics.function_cycles / (statistics.function_cycles + statistics.derivative_cycles));
+
+	/* The three opcodes which took the most cycles, with their share. */
+	uint64_t total = 0;
+	for (int o = 0; o < STATISTICS_OPCODES; ++o) {total += statistics.opcode_cycles[o];}
+	for (int rank = 0; rank < 3; ++rank) {
+		int top = -1;
+		for (int o = 0; o < STATISTICS_OPCODES; ++o) {
+			if (statistics.opcode_cycles[o] > 0 && (top < 0 || statistics.opcode_cycles[o] > statistics.opcode_cycles[top])) {top = o;}
+		}
+		if (top < 0) {break;}
+		printf(" %s %.0f%%", names[top], 100.0 * statistics.opcode_cycles[top] / total);
+		statistics.opcode_cycles[top] = 0;
+	}
+	printf("\n");
+
+end:
+	statistics_attach(NULL);
+	if (function_code  ) {vm_code_clear(function_code  ); free(function_code  );}
+	if (derivative_code) {vm_code_clear(derivative_code); free(derivative_code);}
+	syntax_node_arena_release(&arena);
+	return error;
+}
+#endif
+
+static size_t count_nodes(const SyntaxNode *node) {
+	size_t count = 1;
+	for (unsigned int i = 0; i < node->arity; ++i) {count += count_nodes(node->operand[i]);}
+	return count;
+}
+
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
@@ -0,0 +1,142 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../compiler/compiler.h"
+#include "../virtual_machine/vm.h"
+
+/** @file dispatch.c
+ *
+ *  Benchmark of the dispatch engines of the virtual machine.
+ *
+ *  Every expression is evaluated many times by the switch loop of
+ *  `machine_execute` on the raw bytecode tape and by `machine_execute_threaded`
+ *  on the decoded threaded code. The result is the time per executed
+ *  instruction for both engines. For comparison the expression is also run as
+ *  register code, which executes fewer instructions for the same work, and as
+ *  native code if available; both are only compared by their speedup over the
+ *  switch loop.
+ *
+ *  Before timing, all engines are checked to compute the same results as the
+ *  switch loop bit for bit, the exit status is 1 if any of them differs.
+ */
+
+/** Number of evaluations per expression and engine. */
+#define EVALUATIONS  2000000
+
+/** Number of values of X at which the engines are compared. */
+#define CHECKS  10000
+
+/** Expressions to benchmark. */
+static const char *expressions[] = {
+	"x^2 - 2",
+	"3x^5 - 2x^2 + 7x - 1",
+	"sin(x) * cos(x) + tan(x/7)",
+	"(x+1)*(x-2)*(x+3)*(x-4)*(x+5)*(x-6)",
+	"exp(sin(x)) / (1 + x*x) - ln(2 + cos(x))",
+	"((((x+1)*x+2)*x+3)*x+4)*x+5 - (x-1)/(x+2) + (x-3)/(x+4)",
+};
+
+/** Whether two doubles are the same bits, so NaN equals NaN. */
+static int same(double a, double b);
+
+/** Current time in nanoseconds. */
+static double now(void);
+
+int main(void) {
+	size_t mismatches = 0; /* Results of any engine which differ. */
+
+	printf("%-60s %6s %12s %12s %8s %8s %8s\n", "expression", "instr", "switch ns/i", "thread ns/i", "speedup", "register", "native");
+
+	for (size_t e = 0; e < sizeof expressions / sizeof expressions[0]; ++e) {
+		SyntaxNode    *tree = NULL;
+		VMCode        *code = NULL;
+		VMRegisterCode *registers = NULL;
+		VMThreadedCode  threaded;
+		VMNativeCode    native;
+
+		volatile double sink = 0.0; /* Keeps the results alive. */
+		double          result, start, time_switch, time_threaded, time_register, time_native = 0.0;
+
+		if (compiler_frontend(expressions[e], &tree) != 0) {return 1;}
+		syntax_node_condense(tree);
+		if (compiler_backend(tree, &code) != 0) {return 1;}
+		if (vm_threaded_code_decode(*code, &threaded) != 0) {return 1;}
+		if (compiler_backend_register(tree, &registers) != 0) {return 1;}
+		compiler_backend_native(*code, &native); /* Optional. */
+
+		VirtualMachine machine = {.code = *code};
+		for (int i = 0; i < CHECKS; ++i) {
+			double x = -8.0 + i * (16.0 / CHECKS), expected;
+			machine.reg_x = x;
+			machine_execute(&machine, &expected);
+			machine_execute_threaded(&threaded, x, &result);
+			if (!same(result, expected)) {++mismatches;}
+			machine_execute_register(registers, x, &result);
+			if (!same(result, expected)) {++mismatches;}
+			if (native.function && !same(native.function(x), expected)) {++mismatches;}
+		}
+
+		start = now();
+		for (int i = 0; i < EVALUATIONS; ++i) {
+			machine.reg_x = 0.5 + i * 1e-7;
+			machine_execute(&machine, &result);
+			sink += result;
+		}
+		time_switch = now() - start;
+
+		start = now();
+		for (int i = 0; i < EVALUATIONS; ++i) {
+			machine_execute_threaded(&threaded, 0.5 + i * 1e-7, &result);
+			sink += result;
+		}
+		time_threaded = now() - start;
+
+		start = now();
+		for (int i = 0; i < EVALUATIONS; ++i) {
+			machine_execute_register(registers, 0.5 + i * 1e-7, &result);
+			sink += result;
+		}
+		time_register = now() - start;
+
+		if (native.function) {
+			start = now();
+			for (int i = 0; i < EVALUATIONS; ++i) {
+				sink += native.function(0.5 + i * 1e-7);
+			}
+			time_native = now() - start;
+		}
+
+		/* The threaded code has one extra instruction to end it. */
+		double instructions = (double)(threaded.length - 1) * EVALUATIONS;
+		printf("%-60s %6zu %12.3f %12.3f %7.2fx %7.2fx ",
+		       expressions[e], threaded.length - 1,
+		       time_switch / instructions, time_threaded / instructions,
+		       time_switch / time_threaded, time_switch / time_register);
+		if (native.function) {printf("%7.2fx\n", time_switch / time_native);}
+		else                 {printf("%8s\n", "n/a");}
+
+		vm_threaded_code_clear(&threaded);
+		vm_native_code_clear(&native);
+		vm_register_code_clear(registers);
+		free(registers);
+		vm_code_clear(code);
+		free(code);
+		syntax_node_destroy(tree);
+	}
+
+	printf("%zu mismatches between the engines\n", mismatches);
+	return mismatches == 0 ? 0 : 1;
+}
+
+static int same(double a, double b) {
+	return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
@@ -0,0 +1,238 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, nanosleep, sysconf */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../library/library.h"
+#include "../status/status.h"
+
+/** @file pool.c
+ *
+ *  Benchmark of the pool under bursty load.
+ *
+ *  A number of client threads submit bursts of jobs to one pool: every burst
+ *  is a run of guesses for one function, followed by a pause. The latency of
+ *  every job, from submission to its callback, is measured and the
+ *  percentiles printed. Every root and error code has to match
+ *  `newton_function_solve` bit for bit.
+ *
+ *  The load runs twice. The first time clients wait for room when the queue
+ *  is full, the second time they do not wait and count the jobs the pool has
+ *  pushed back instead. For that the queue has to fill up: by default the
+ *  second run has a queue of half a burst, and it fails if no job is pushed
+ *  back.
+ *
+ *  Usage: `bench_pool [threads [capacity [bursts]]]`, by default one worker per
+ *  processor, a queue of 256 jobs and 200 bursts per client. A capacity given
+ *  on the command line is used for both runs. The exit status is 1 if any
+ *  result differs.
+ */
+
+/** Number of client threads. */
+#define CLIENTS  4
+
+/** Jobs per burst. */
+#define BURST  48
+
+/** Capacity of the queue when clients do not wait, unless one is given. */
+#define NO_WAIT_CAPACITY  (BURST / 2)
+
+/** Pause after a burst in microseconds. */
+#define PAUSE  200
+
+/** Expressions to solve. */
+static const char *expressions[] = {
+	"x^2 - 2",
+	"sin(x) - x/3",
+	"exp(x) - 3x",
+	"(x+1)*(x-2)*(x+3)*(x-4)*(x+5)*(x-6)",
+	"ln(x^2 + 1) - cos(x)",
+	"x^x - 5",
+};
+
+/** Number of expressions. */
+#define EXPRESSIONS  (sizeof expressions / sizeof expressions[0])
+
+/** A job along with what to expect of it. */
+struct job {
+	double submitted; /**< Time of submission in nanoseconds.   */
+	double latency;   /**< Time until the callback.             */
+	double expected;  /**< Root by `newton_function_solve`.     */
+	int    error;     /**< Its error code.                      */
+	int    mismatch;  /**< Whether the result differed.         */
+	int    done;      /**< Whether the callback has been called. */
+};
+
+/** Work of one client thread. */
+struct client {
+	pthread_t   thread;   /**< The thread.                          */
+	NewtonPool *pool;     /**< Pool to submit to.                   */
+	size_t      bursts;   /**< Number of bursts to submit.          */
+	size_t      index;    /**< Number of the client.                */
+	int         wait;     /**< Whether to wait for room.            */
+	struct job *jobs;     /**< One per job, BURST per burst.        */
+	size_t      rejected; /**< Jobs pushed back by the pool.        */
+};
+
+/** Handles of the expressions. */
+static NewtonFunction *functions[EXPRESSIONS];
+
+/** Roots of every job of a burst of every expression, and their errors. */
+static double roots [EXPRESSIONS][BURST];
+static int    errors[EXPRESSIONS][BURST];
+
+/** The guess of a given job of a burst. */
+static double guess(size_t i);
+
+/** Receives the result of a job. */
+static void receive(void *context, double root, int error);
+
+/** Body of a client thread. */
+static void *submit(void *argument);
+
+/** Runs the load once and prints the results.
+ *
+ *  @param threads   Number of workers.
+ *  @param capacity  Capacity of the queue.
+ *  @param bursts    Bursts per client.
+ *  @param wait      Whether clients wait for room in the queue.
+ *  @param full      Whether the pool has to push back at least one job.
+ *
+ *  @return  Number of mismatches, counting a missing push back as one.
+ */
+static size_t run(size_t threads, size_t capacity, size_t bursts, int wait, int full);
+
+/** Compare function for sorting numbers in ascending order. */
+static int compare_doubles(const void *a, const void *b);
+
+/** Current time in nanoseconds. */
+static double now(void);
+
+
+int main(int argc, char *argv[]) {
+	long threads  = argc > 1 ? strtol(argv[1], NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+	long capacity = argc > 2 ? strtol(argv[2], NULL, 10) : 256;
+	long no_wait  = argc > 2 ? capacity : NO_WAIT_CAPACITY;
+	long bursts   = argc > 3 ? strtol(argv[3], NULL, 10) : 200;
+	if (threads  < 1) {threads  = 1;}
+	if (capacity < 1) {capacity = 1;}
+	if (no_wait  < 1) {no_wait  = 1;}
+	if (bursts   < 1) {bursts   = 1;}
+
+	/* Failed solves report their failure, the status keeps this quiet. */
+	NewtonStatus status = {.errors = 0};
+	status_attach(&status);
+
+	for (size_t e = 0; e < EXPRESSIONS; ++e) {
+		int error;
+		if (!(functions[e] = newton_function_compile(expressions[e], &error))) {return 1;}
+		for (size_t i = 0; i < BURST; ++i) {
+			roots[e][i] = newton_function_solve(functions[e], guess(i), &errors[e][i]);
+		}
+	}
+	status_attach(NULL);
+
+	printf("%ld workers, queue of %ld (%ld without waiting), %d clients, %ld bursts of %d jobs each\n",
+	       threads, capacity, no_wait, CLIENTS, bursts, BURST);
+	size_t mismatches = run((size_t)threads, (size_t)capacity, (size_t)bursts, 1, 0)
+	                  + run((size_t)threads, (size_t)no_wait , (size_t)bursts, 0, argc <= 2);
+
+	for (size_t e = 0; e < EXPRESSIONS; ++e) {newton_function_destroy(functions[e]);}
+	return mismatches == 0 ? 0 : 1;
+}
+
+static size_t run(size_t threads, size_t capacity, size_t bursts, int wait, int full) {
+	NewtonPool *pool = newton_pool_create(threads, capacity);
+	struct client clients[CLIENTS];
+	if (!pool) {return 1;}
+
+	double start = now();
+	for (size_t c = 0; c < CLIENTS; ++c) {
+		clients[c] = (struct client){
+			.pool     = pool,
+			.bursts   = bursts,
+			.index    = c,
+			.wait     = wait,
+			.jobs     = calloc(bursts * BURST, sizeof(struct job)),
+			.rejected = 0,
+		};
+		if (!clients[c].jobs || pthread_create(&clients[c].thread, NULL, submit, &clients[c]) != 0) {return 1;}
+	}
+	for (size_t c = 0; c < CLIENTS; ++c) {pthread_join(clients[c].thread, NULL);}
+	newton_pool_wait(pool);
+	double elapsed = now() - start;
+	newton_pool_destroy(pool);
+
+	size_t total = CLIENTS * bursts * BURST, count = 0, rejected = 0, mismatches = 0;
+	double *latencies = malloc(total * sizeof(double));
+	if (!latencies) {return 1;}
+	for (size_t c = 0; c < CLIENTS; ++c) {
+		for (size_t j = 0; j < bursts * BURST; ++j) {
+			const struct job *job = &clients[c].jobs[j];
+			if (!job->done) {continue;}
+			latencies[count++] = job->latency;
+			mismatches += (size_t)job->mismatch;
+		}
+		rejected += clients[c].rejected;
+		free(clients[c].jobs);
+	}
+	if (count + rejected != total) {++mismatches;}
+	if (full && rejected == 0) {++mismatches;}
+	qsort(latencies, count, sizeof(double), compare_doubles);
+
+	#define PERCENTILE(p)  (count ? latencies[(size_t)((count - 1) * (p))] / 1e3 : 0)
+	printf("%-7s %7zu jobs in %7.1f ms, %8.0f per second, %6zu rejected, %zu mismatches\n",
+	       wait ? "wait" : "no wait", count, elapsed / 1e6, count / (elapsed / 1e9), rejected, mismatches);
+	printf("        latency in µs: p50 %8.1f  p90 %8.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f\n",
+	       PERCENTILE(0.5), PERCENTILE(0.9), PERCENTILE(0.99), PERCENTILE(0.999), PERCENTILE(1.0));
+	#undef PERCENTILE
+
+	free(latencies);
+	return mismatches;
+}
+
+static void *submit(void *argument) {
+	struct client *client = argument;
+	struct timespec pause = {.tv_sec = 0, .tv_nsec = PAUSE * 1000};
+
+	for (size_t b = 0; b < client->bursts; ++b) {
+		size_t e = (client->index + b) % EXPRESSIONS;
+		for (size_t i = 0; i < BURST; ++i) {
+			struct job *job = &client->jobs[b * BURST + i];
+			job->expected  = roots[e][i];
+			job->error     = errors[e][i];
+			job->submitted = now();
+			if (newton_pool_submit(client->pool, functions[e], guess(i), receive, job, client->wait) != 0) {
+				++client->rejected;
+			}
+		}
+		nanosleep(&pause, NULL);
+	}
+	return NULL;
+}
+
+static void receive(void *context, double root, int error) {
+	struct job *job = context;
+	job->latency  = now() - job->submitted;
+	job->mismatch = memcmp(&root, &job->expected, sizeof(double)) != 0 || error != job->error;
+	job->done     = 1;
+}
+
+static double guess(size_t i) {
+	return -6.0 + 0.25 * (double)i;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
@@ -0,0 +1,254 @@
+#define _POSIX_C_SOURCE 200809L /* clock_gettime, sysconf */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../compiler/compiler.h"
+#include "../library/library.h"
+#include "../method/method.h"
+#include "../status/status.h"
+
+/** @file stress.c
+ *
+ *  Stress test of the core running on many threads at once.
+ *
+ *  All expressions are compiled once into handles which every thread shares.
+ *  Each thread then goes over the expressions again and again: it evaluates
+ *  and solves the shared handles, runs `method_iterate` on shared bytecode,
+ *  compiles the expression anew through the frontend, derivation and backend,
+ *  and compiles a broken expression. Every result has to match the
+ *  result of the main thread exactly, bit for bit, and the error of the broken
+ *  expression has to end up in the status of the thread which caused it.
+ *
+ *  Usage: `bench_stress [threads [rounds]]`, by default one thread per
+ *  processor. The exit status is 1 if any result differs.
+ */
+
+/** Rounds over all expressions per thread by default. */
+#define ROUNDS  200
+
+/** Guesses per expression. */
+#define GUESSES  8
+
+/** Expressions to run, every one of them has a root. */
+static const char *expressions[] = {
+	"x^2 - 2",
+	"3x^5 - 2x^2 + 7x - 1",
+	"sin(x) - x/3",
+	"exp(x) - 3x",
+	"(x+1)*(x-2)*(x+3)*(x-4)*(x+5)*(x-6)",
+	"ln(x^2 + 1) - cos(x)",
+	"x^x - 5",
+	"tan(x/4) - 1/(1 + x^2)",
+};
+
+/** Number of expressions. */
+#define EXPRESSIONS  (sizeof expressions / sizeof expressions[0])
+
+/** Expressions which do not compile, one per expression. */
+static const char *broken[EXPRESSIONS] = {
+	"((x", "x +", "sin", "3 $ x", "x)", "ln()", "x^^2", "2 x",
+};
+
+/** Results of one expression as computed by the main thread. */
+struct reference {
+	NewtonFunction *function;          /**< Handle shared by all threads. */
+	VMCode          function_code;     /**< Bytecode of the function.     */
+	VMCode          derivative_code;   /**< Bytecode of the derivative.   */
+	double value     [GUESSES];        /**< f at every guess.             */
+	double derivative[GUESSES];        /**< f' at every guess.            */
+	double root      [GUESSES];        /**< Root from every guess.        */
+	double iterated  [GUESSES];        /**< Root by `method_iterate`.     */
+	int    error     [GUESSES];        /**< Error code of every solve.    */
+	char   message[STATUS_MESSAGE];    /**< Error of the broken version.  */
+};
+
+/** Work of one thread. */
+struct worker {
+	pthread_t thread;     /**< The thread.                     */
+	size_t    rounds;     /**< Rounds over all expressions.    */
+	size_t    mismatches; /**< Results which differ.           */
+	size_t    operations; /**< Evaluations, solves and compiles. */
+};
+
+/** Results of the main thread, read by all workers. */
+static struct reference references[EXPRESSIONS];
+
+/** The guess of a given number. */
+static double guess(size_t i);
+
+/** Compiles an expression with the compiler only, the way the library does.
+ *
+ *  @param source      The expression.
+ *  @param function    Pointer to store the bytecode of the function in.
+ *  @param derivative  Pointer to store the bytecode of the derivative in.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int compile(const char *source, VMCode *function, VMCode *derivative);
+
+/** Whether two pieces of bytecode are the same. */
+static int same_code(VMCode a, VMCode b);
+
+/** Whether two doubles are the same bits, so NaN equals NaN. */
+static int same(double a, double b);
+
+/** Body of a worker thread. */
+static void *work(void *argument);
+
+/** Current time in nanoseconds. */
+static double now(void);
+
+
+int main(int argc, char *argv[]) {
+	long threads = argc > 1 ? strtol(argv[1], NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+	long rounds  = argc > 2 ? strtol(argv[2], NULL, 10) : ROUNDS;
+	if (threads < 1) {threads = 1;}
+	if (rounds  < 1) {rounds  = 1;}
+
+	/* Failed solves report their failure, the status keeps this quiet. */
+	NewtonStatus status = {.errors = 0};
+	status_attach(&status);
+
+	for (size_t e = 0; e < EXPRESSIONS; ++e) {
+		struct reference *r = &references[e];
+		int error;
+		r->function = newton_function_compile(expressions[e], &error);
+		if (!r->function || compile(expressions[e], &r->function_code, &r->derivative_code) != 0) {
+			fprintf(stderr, "Could not compile '%s': %s\n", expressions[e], status.message);
+			return 1;
+		}
+		for (size_t i = 0; i < GUESSES; ++i) {
+			newton_function_evaluate(r->function, guess(i), &r->value[i], &r->derivative[i]);
+			r->root[i] = newton_function_solve(r->function, guess(i), &r->error[i]);
+			r->iterated[i] = method_iterate(r->function_code, r->derivative_code, guess(i), NULL, 0);
+		}
+
+		status_reset(&status);
+		VMCode f, d;
+		if (compile(broken[e], &f, &d) == 0 || status.errors == 0) {
+			fprintf(stderr, "'%s' should not compile.\n", broken[e]);
+			return 1;
+		}
+		memcpy(r->message, status.message, STATUS_MESSAGE);
+	}
+	status_attach(NULL);
+
+	struct worker *workers = calloc((size_t)threads, sizeof(struct worker));
+	if (!workers) {return 1;}
+
+	double start = now();
+	for (long t = 0; t < threads; ++t) {
+		workers[t].rounds = (size_t)rounds;
+		if (pthread_create(&workers[t].thread, NULL, work, &workers[t]) != 0) {
+			fprintf(stderr, "Could not start thread %ld.\n", t);
+			return 1;
+		}
+	}
+	size_t mismatches = 0, operations = 0;
+	for (long t = 0; t < threads; ++t) {
+		pthread_join(workers[t].thread, NULL);
+		mismatches += workers[t].mismatches;
+		operations += workers[t].operations;
+	}
+	double elapsed = now() - start;
+
+	printf("%ld threads, %ld rounds: %zu operations in %.1f ms, %.0f per second, %zu mismatches\n",
+	       threads, rounds, operations, elapsed / 1e6, operations / (elapsed / 1e9), mismatches);
+
+	for (size_t e = 0; e < EXPRESSIONS; ++e) {
+		newton_function_destroy(references[e].function);
+		vm_code_clear(&references[e].function_code);
+		vm_code_clear(&references[e].derivative_code);
+	}
+	free(workers);
+	return mismatches == 0 ? 0 : 1;
+}
+
+static void *work(void *argument) {
+	struct worker *worker = argument;
+	NewtonStatus status = {.errors = 0};
+	status_attach(&status);
+
+	for (size_t round = 0; round < worker->rounds; ++round) {
+		for (size_t e = 0; e < EXPRESSIONS; ++e) {
+			const struct reference *r = &references[e];
+
+			for (size_t i = 0; i < GUESSES; ++i) {
+				double value, derivative;
+				int    error;
+				newton_function_evaluate(r->function, guess(i), &value, &derivative);
+				double root = newton_function_solve(r->function, guess(i), &error);
+				double iterated = method_iterate(r->function_code, r->derivative_code, guess(i), NULL, 0);
+				if (!same(value, r->value[i]) || !same(derivative, r->derivative[i])) {++worker->mismatches;}
+				if (!same(root, r->root[i]) || error != r->error[i] || !same(iterated, r->iterated[i])) {++worker->mismatches;}
+				worker->operations += 3;
+			}
+
+			VMCode f, d;
+			if (compile(expressions[e], &f, &d) != 0) {
+				++worker->mismatches;
+			} else {
+				if (!same_code(f, r->function_code) || !same_code(d, r->derivative_code)) {++worker->mismatches;}
+				vm_code_clear(&f);
+				vm_code_clear(&d);
+			}
+
+			/* Only the error of this thread may show up in its status. */
+			status_reset(&status);
+			if (compile(broken[e], &f, &d) == 0 || strcmp(status.message, r->message) != 0) {++worker->mismatches;}
+			status_reset(&status);
+			worker->operations += 2;
+		}
+	}
+
+	status_attach(NULL);
+	return NULL;
+}
+
+static int compile(const char *source, VMCode *function, VMCode *derivative) {
+	int error = 1;
+	SyntaxNodeArena arena;
+	SyntaxNode *tree = NULL, *derived = NULL;
+	VMCode *f = NULL, *d = NULL;
+
+	syntax_node_arena_init(&arena, 0);
+	if (compiler_frontend_arena(source, &arena, &tree) != 0) {goto end;}
+	syntax_node_arena_simplify(&arena, tree);
+	if (!(derived = syntax_node_arena_derive(&arena, tree))) {goto end;}
+	syntax_node_arena_simplify(&arena, derived);
+
+	if (compiler_backend(tree, &f) != 0) {goto end;}
+	if (compiler_backend(derived, &d) != 0) {vm_code_clear(f); free(f); goto end;}
+	*function   = *f;
+	*derivative = *d;
+	free(f);
+	free(d);
+	error = 0;
+
+end:
+	syntax_node_arena_release(&arena);
+	return error;
+}
+
+static double guess(size_t i) {
+	return -2.5 + 0.75 * (double)i;
+}
+
+static int same_code(VMCode a, VMCode b) {
+	return a.length == b.length && a.depth == b.depth && memcmp(a.code, b.code, a.length) == 0;
+}
+
+static int same(double a, double b) {
+	return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static double now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec * 1e9 + t.tv_nsec;
+}
@@ -1,8 +1,12 @@
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "backend.h"
 #include "../../virtual_machine/opcodes.h"
+#include "../../statistics/statistics.h"
+#include "../../status/status.h"
 
 /* Compilation:
  *
@@ -15,14 +19,53 @@
  *
  * Number literals are written in front of their opcode because the bytecode
  * will be read in reverse order.
+ *
+ * While compiling we also keep track of how deep the stack of the VM will
+ * grow. Since the code is read backwards the last operand is evaluated first
+ * and stays on the stack while the remaining operands get evaluated. The depth
+ * of a node is thus the maximum over all operands of the operand's own depth
+ * plus the number of results already waiting on the stack.
+ *
+ * Before a node is compiled the peephole pass looks at it and its children
+ * for a few patterns which one fused opcode can compute on the top of the
+ * stack: multiplying by or adding a constant, both at once, and integer
+ * powers, including products of the same variable like `x * x`. The operand
+ * which does not take part in the pattern is compiled as usual after the
+ * opcode, the node then needs the same depth as a unary operator.
+ *
+ * The bytecode of a node is written in one go: first its own opcode, then the
+ * bytecode of its operands. A memo of the backend records where that run of
+ * bytes begins and ends, and the depth of the node. When a node of the memo
+ * comes up again its bytes are copied and the node is done.
  */
 
+/** Bytecode of a node in a memo. */
+struct compiler_backend_fragment {
+	const SyntaxNode *node; /**< The node, `NULL` if the entry is empty. */
+	size_t generation;      /**< Buffer holding the bytecode.           */
+	size_t offset;          /**< Position of the bytecode in the buffer. */
+	size_t length;          /**< Number of bytes of the bytecode.       */
+	size_t depth;           /**< Stack depth needed by the node.        */
+};
+
+/** Largest exponent of `OPC_POWI`, it has to fit into a byte. */
+#define MAX_POWI  255
+
+/** Fused instruction selected for a node by the peephole pass. */
+struct fused {
+	uint8_t opcode;           /**< Fused opcode, 0 if there is none.     */
+	double  factor;           /**< Constant of ADDC, MULC or MADDC.      */
+	double  term;             /**< Constant added by MADDC.              */
+	unsigned int exponent;    /**< Exponent of POWI.                     */
+	const SyntaxNode *operand; /**< Sub-tree the opcode is applied to.   */
+};
+
 /** Maps a syntax node operator to a VM bytecode.
  *
  *  Some operators are not mapped to opcodes because they don't have any. In
- *  particular those operators are the constants and braces.
+ *  particular those operators are the braces.
  */
-static uint8_t operator_to_opcode[NUMBER_OF_OPERATORS] = {
+static const uint8_t operator_to_opcode[NUMBER_OF_OPERATORS] = {
 	[ OP_NUMBER ] = OPC_NUM   ,
 	[ OP_NEGATE ] = OPC_NEG   ,
 	[ OP_PLUS   ] = OPC_ADD   ,
@@ -36,17 +79,145 @@ static uint8_t operator_to_opcode[NUMBER_OF_OPERATORS] = {
 	[ OP_COS    ] = OPC_COS   ,
 	[ OP_TAN    ] = OPC_TAN   ,
 	[ OP_X_VAR  ] = OPC_VAR_X ,
+	[ OP_PI     ] = OPC_PI    ,
+	[ OP_E      ] = OPC_E     ,
+};
+
+/* Register code:
+ *
+ * Register code is compiled in two passes. The first pass collects all the
+ * constants of the tree into the constant pool, this fixes the number of
+ * constant registers and thereby where the temporary registers begin. The
+ * second pass walks the tree depth-first and emits one instruction per
+ * operator. Variables and constants don't need instructions, they already sit
+ * in their registers.
+ *
+ * Temporaries are allocated like a stack: the result of a node goes into the
+ * temporary register one above those still in use by its ancestors. An
+ * operator can overwrite the register of its first operand with its result,
+ * because the operands are read before the result is written.
+ *
+ * The tree can also be a graph where nodes are shared by several parents, like
+ * the graphs of a syntax node table. The first pass counts the parents of
+ * every node and visits shared nodes only once. Each shared operator gets a
+ * register of its own between the constants and the temporaries; the first
+ * time it is reached its instruction is emitted, afterwards its register is
+ * simply used again. This way every shared node is computed only once.
+ */
+
+/** Node of the syntax graph and the number of its parents. */
+struct node_use {
+	const SyntaxNode *node; /**< The node, `NULL` if the entry is empty. */
+	size_t   parents;       /**< Number of parents of the node.          */
+	uint16_t reg;           /**< Register of a shared node, or X if none. */
+};
+
+/** Hash map from syntax nodes to their uses. */
+struct node_uses {
+	struct node_use *entries;  /**< Open addressed hash table.         */
+	size_t           capacity; /**< Number of entries, a power of two. */
+	size_t           count;    /**< Number of nodes in the map.        */
+	size_t           shared;   /**< Number of shared operator nodes.   */
+	size_t           assigned; /**< Number of shared registers in use. */
 };
 
 /** Compile an individual syntax node to bytecode.
  *
- *  @param node  The node to compile.
- *  @param code  The code object to compile to.
- *  @param tail  Index into the bytecode sequence.
+ *  @param node   The node to compile.
+ *  @param code   The code object to compile to.
+ *  @param depth  Pointer to store the stack depth needed by the node in.
+ *  @param memo   Memo of the bytecode of nodes, or `NULL`. If given `code`
+ *                must be its newest buffer.
+ *
+ *  @return 0 on success, non-0 on error.
+ */
+static int compile_syntax_node(const SyntaxNode *const node, VMCode *code, size_t *depth, CompilerBackendMemo *memo);
+
+/** Finds the bytecode of a node in a memo.
+ *
+ *  @param memo  The memo to search.
+ *  @param node  The node to search for.
+ *
+ *  @return  Pointer to the entry of the node, or to the empty entry where it
+ *           would go.
+ */
+static struct compiler_backend_fragment *find_fragment(const CompilerBackendMemo *memo, const SyntaxNode *node);
+
+/** Adds the bytecode of a node to a memo, growing it if necessary.
+ *
+ *  @param memo      The memo to add to.
+ *  @param fragment  The bytecode of the node.
+ *
+ *  @return 0 on success, non-0 on error.
+ */
+static int add_fragment(CompilerBackendMemo *memo, struct compiler_backend_fragment fragment);
+
+/** Selects a fused opcode for a node.
+ *
+ *  @param node  The node to look at.
+ *
+ *  @return  The fused instruction, with an opcode of 0 if no pattern matches.
+ */
+static struct fused fuse(const SyntaxNode *const node);
+
+/** Counts the factors of a product of one and the same variable.
+ *
+ *  @param node      Root of the product.
+ *  @param variable  Pointer to the variable found so far, `NULL` at first.
+ *
+ *  @return  The number of factors, or 0 if the node is not such a product.
+ */
+static unsigned int variable_factors(const SyntaxNode *const node, const SyntaxNode **variable);
+
+/** Adds all the constants of a tree to the constant pool.
+ *
+ *  @param node  Root of the (sub-)tree.
+ *  @param code  The register code to add the constants to.
+ *  @param uses  Map to count the parents of every node in.
+ *
+ *  @return 0 on success, non-0 on error.
+ */
+static int pool_constants(const SyntaxNode *const node, VMRegisterCode *code, struct node_uses *uses);
+
+/** Looks up the uses of a node, adding it to the map if necessary.
+ *
+ *  @param node  The node to look up.
+ *  @param uses  The map to look in.
+ *
+ *  @return  Pointer to the uses of the node, `NULL` on failure.
+ */
+static struct node_use *node_use(const SyntaxNode *const node, struct node_uses *uses);
+
+/** Looks up the register of a constant.
+ *
+ *  @param number  The constant to look up.
+ *  @param code    The register code holding the constant pool.
+ *
+ *  @return  Number of the register holding the constant, or 0 (the register
+ *           of X) if the constant is not in the pool.
+ */
+static uint16_t constant_register(double number, const VMRegisterCode *code);
+
+/** Compile an individual syntax node to register code.
+ *
+ *  @param node   The node to compile.
+ *  @param code   The register code to compile to.
+ *  @param uses   The uses of all the nodes.
+ *  @param level  Number of temporary registers in use by the ancestors.
+ *  @param reg    Pointer to store the register holding the result in.
+ *
+ *  @return 0 on success, non-0 on error.
+ */
+static int compile_register_node(const SyntaxNode *const node, VMRegisterCode *code, struct node_uses *uses, size_t level, uint16_t *reg);
+
+/** Appends an instruction to register code, growing it if necessary.
+ *
+ *  @param instruction  The instruction to append.
+ *  @param code         The register code to append to.
  *
  *  @return 0 on success, non-0 on error.
  */
-static int compile_syntax_node(const SyntaxNode *const node, VMCode *code);
+static int write_instruction(VMRegisterInstruction instruction, VMRegisterCode *code);
 
 /** Writes an opcode byte to the bytecode.
  *
@@ -71,7 +242,7 @@ static int write_opcode(uint8_t opcode, VMCode *code);
  *
  *  The exact format of the number is specific to the machine the program has
  *  been compiled for (the physical machine the user is running this on, not
- *  the VM).
+ *  the VM). Code of float precision gets the number rounded to a `float`.
  */
 static int write_number(double number, VMCode *code);
 
@@ -87,6 +258,10 @@ static int grow_bytecode(VMCode *code, size_t by);
 
 
 int compiler_backend(const SyntaxNode *const tree, VMCode **code) {
+	return compiler_backend_precision(tree, VM_DOUBLE, code);
+}
+
+int compiler_backend_precision(const SyntaxNode *const tree, VMPrecision precision, VMCode **code) {
 	assert(*code == NULL); /* The code object must be NULL */
 
 	int error = 0; /* No error */
@@ -94,13 +269,16 @@ int compiler_backend(const SyntaxNode *const tree, VMCode **code) {
 	#define CODE_LENGTH  64 /**< Default size of the code array. */
 	*code = malloc(sizeof(VMCode));
 	if (!*code) {error = 1; goto end;}
-	(*code)->length   = 0;
-	(*code)->capacity = CODE_LENGTH;
-	(*code)->code     = malloc(CODE_LENGTH * sizeof(uint8_t));
+	(*code)->length    = 0;
+	(*code)->capacity  = CODE_LENGTH;
+	(*code)->depth     = 0;
+	(*code)->precision = precision;
+	(*code)->code      = malloc(CODE_LENGTH * sizeof(uint8_t));
+	STATISTICS(statistics_count_allocation();)
 	if (!(*code)->code) {free(*code); *code = NULL; error = 1; goto end;}
 
 	// If compilation fails at any point the bytecode is invalid, so delete it.
-	if (compile_syntax_node(tree, *code) != 0) {
+	if (compile_syntax_node(tree, *code, &(*code)->depth, NULL) != 0) {
 		error = 1;
 		free((*code)->code);
 		free(*code);
@@ -113,10 +291,172 @@ end:
 	#undef CODE_LENGTH
 }
 
-static int compile_syntax_node(const SyntaxNode *const node, VMCode *code) {
+void compiler_backend_memo_init(CompilerBackendMemo *memo) {
+	*memo = (CompilerBackendMemo){
+		.entries     = NULL,
+		.capacity    = 0,
+		.count       = 0,
+		.buffers     = NULL,
+		.generations = 0,
+		.size        = 0,
+		.compiled    = 0,
+	};
+}
+
+void compiler_backend_memo_clear(CompilerBackendMemo *memo) {
+	for (size_t i = 0; i < memo->generations; ++i) {
+		vm_code_clear(&memo->buffers[i]);
+	}
+	free(memo->buffers);
+	free(memo->entries);
+	compiler_backend_memo_init(memo);
+}
+
+int compiler_backend_memoised(const SyntaxNode *const graph, CompilerBackendMemo *memo, VMCode **code) {
+	assert(*code == NULL); /* The code object must be NULL */
+
+	#define CODE_LENGTH  64 /**< Default size of the code array. */
+	int error = 0; /* No error */
+
+	memo->compiled = 0;
+	const uint8_t *source; /* The bytecode to copy for the caller. */
+	size_t length, depth;
+
+	/* An edit which was undone hits the whole graph, no new buffer is needed. */
+	const struct compiler_backend_fragment *fragment = find_fragment(memo, graph);
+	if (fragment && fragment->node) {
+		source = memo->buffers[fragment->generation].code + fragment->offset;
+		length = fragment->length;
+		depth  = fragment->depth;
+	} else {
+		/* Edits hardly change the size, start out as large as the last buffer. */
+		size_t capacity = CODE_LENGTH;
+		if (memo->generations > 0) {capacity += memo->buffers[memo->generations - 1].length;}
+
+		VMCode *buffers = realloc(memo->buffers, (memo->generations + 1) * sizeof(VMCode));
+		if (!buffers) {
+			status_report("Memory error: could not grow the buffers of the bytecode memo.\n");
+			error = 1;
+			goto end;
+		}
+		memo->buffers = buffers;
+
+		VMCode *buffer = &memo->buffers[memo->generations];
+		*buffer = (VMCode){
+			.length   = 0,
+			.capacity = capacity,
+			.depth    = 0,
+			.code     = malloc(capacity * sizeof(uint8_t)),
+		};
+		STATISTICS(statistics_count_allocation();)
+		if (!buffer->code) {error = 1; goto end;}
+		++memo->generations;
+
+		error = compile_syntax_node(graph, buffer, &buffer->depth, memo);
+		/* Even after an error the fragments in the buffer are complete. */
+		memo->size += buffer->capacity;
+		if (error != 0) {goto end;}
+		source = buffer->code;
+		length = buffer->length;
+		depth  = buffer->depth;
+	}
+
+	/* The buffers stay with the memo, the caller gets a copy. */
+	*code = malloc(sizeof(VMCode));
+	if (!*code) {error = 1; goto end;}
+	**code = (VMCode){
+		.length   = length,
+		.capacity = length,
+		.depth    = depth,
+		.code     = malloc(length * sizeof(uint8_t)),
+	};
+	STATISTICS(statistics_count_allocation();)
+	if (!(*code)->code) {free(*code); *code = NULL; error = 1; goto end;}
+	memcpy((*code)->code, source, length);
+
+end:
+	return error;
+	#undef CODE_LENGTH
+}
+
+int compiler_backend_register(const SyntaxNode *const tree, VMRegisterCode **code) {
+	assert(*code == NULL); /* The code object must be NULL */
+
+	#define USES_CAPACITY  64 /**< Default size of the map of uses. */
+	int error = 0; /* No error */
+	struct node_uses uses = {
+		.entries  = calloc(USES_CAPACITY, sizeof(struct node_use)),
+		.capacity = USES_CAPACITY,
+	};
+	if (!uses.entries) {error = 1; goto end;}
+
+	*code = malloc(sizeof(VMRegisterCode));
+	if (!*code) {error = 1; goto end;}
+	**code = (VMRegisterCode){
+		.length    = 0,
+		.capacity  = 0,
+		.code      = NULL,
+		.constants = 0,
+		.pool      = NULL,
+		.registers = 0,
+		.result    = VM_REGISTER_X,
+	};
+
+	if (pool_constants(tree, *code, &uses) != 0) {error = 1; goto end;}
+	(*code)->registers = 1 + (*code)->constants + uses.shared;
+	if (compile_register_node(tree, *code, &uses, 0, &(*code)->result) != 0) {error = 1; goto end;}
+
+end:
+	// If compilation fails at any point the code is invalid, so delete it.
+	if (error && *code) {
+		vm_register_code_clear(*code);
+		free(*code);
+		*code = NULL;
+	}
+	free(uses.entries);
+	return error;
+	#undef USES_CAPACITY
+}
+
+static int compile_syntax_node(const SyntaxNode *const node, VMCode *code, size_t *depth, CompilerBackendMemo *memo) {
 	#define CHECK_EXIT_STATUS  if (error != 0) {goto end;}
-	int     error = 0; /**< Indicate success or failure.     */
-	uint8_t opcode;    /**< Opcode to write to the bytecode. */
+	int     error = 0;            /**< Indicate success or failure.     */
+	uint8_t opcode;               /**< Opcode to write to the bytecode. */
+	size_t  start = code->length; /**< Where the node's bytecode begins. */
+
+	/* A node compiled before is copied. */
+	const struct compiler_backend_fragment *fragment = memo ? find_fragment(memo, node) : NULL;
+	if (fragment && fragment->node) {
+		if (grow_bytecode(code, fragment->length) != 0) {return 1;}
+		/* The source might be this very buffer, so only look it up now. */
+		memcpy(code->code + code->length, memo->buffers[fragment->generation].code + fragment->offset, fragment->length);
+		code->length += fragment->length;
+		*depth = fragment->depth;
+		return 0;
+	}
+
+	/* Every node leaves exactly one number on the stack. */
+	*depth = 1;
+
+	struct fused fused = fuse(node);
+	if (fused.opcode != 0) {
+		/* Constants are in front of the opcode, the term before the factor. */
+		if (fused.opcode == OPC_MADDC) {
+			error = write_number(fused.term, code);
+			CHECK_EXIT_STATUS
+		}
+		if (fused.opcode == OPC_POWI) {
+			error = write_opcode((uint8_t)fused.exponent, code);
+		} else {
+			error = write_number(fused.factor, code);
+		}
+		CHECK_EXIT_STATUS
+		error = write_opcode(fused.opcode, code);
+		CHECK_EXIT_STATUS
+		error = compile_syntax_node(fused.operand, code, depth, memo);
+		CHECK_EXIT_STATUS
+		goto record;
+	}
 
 	/* Opcode of this node, get it, don't write it yet */
 	opcode = operator_to_opcode[node->operator_value];
@@ -126,12 +466,34 @@ static int compile_syntax_node(const SyntaxNode *const node, VMCode *code) {
 		error = write_number(node->numeric_value, code);
 		CHECK_EXIT_STATUS
 	}
+	/* An indexed variable is its index followed by its own opcode. */
+	if (opcode == OPC_VAR_X && node->numeric_value != 0) {
+		error = write_opcode((uint8_t)node->numeric_value, code);
+		CHECK_EXIT_STATUS
+		opcode = OPC_VAR;
+	}
 
 	error = write_opcode(opcode, code);
 	CHECK_EXIT_STATUS
 	for (int i = 0; i < node->arity; ++i) {
-		error = compile_syntax_node(node->operand[i], code);
+		size_t operand_depth; /* Depth of the operand's sub-tree. */
+		error = compile_syntax_node(node->operand[i], code, &operand_depth, memo);
 		CHECK_EXIT_STATUS
+		/* Operands after this one are evaluated first and wait on the stack. */
+		operand_depth += node->arity - 1 - i;
+		if (operand_depth > *depth) {*depth = operand_depth;}
+	}
+
+record:
+	if (memo) {
+		error = add_fragment(memo, (struct compiler_backend_fragment){
+			.node       = node,
+			.generation = memo->generations - 1,
+			.offset     = start,
+			.length     = code->length - start,
+			.depth      = *depth,
+		});
+		++memo->compiled;
 	}
 
 end:
@@ -139,6 +501,105 @@ end:
 	#undef CHECK_EXIT_STATUS
 }
 
+static struct compiler_backend_fragment *find_fragment(const CompilerBackendMemo *memo, const SyntaxNode *node) {
+	if (memo->capacity == 0) {return NULL;}
+	/* The memo outlives many versions of the graph, nodes from all over the
+	 * arena of the table would pile up on the same slots, so the address is
+	 * scrambled. The high bits of the product depend on all bits of it. */
+	uint64_t hash = (uint64_t)((uintptr_t)node / sizeof(SyntaxNode)) * 11400714819323198485u;
+	size_t mask  = memo->capacity - 1;
+	size_t index = (size_t)(hash ^ (hash >> 32)) & mask;
+	while (memo->entries[index].node && memo->entries[index].node != node) {
+		index = (index + 1) & mask;
+	}
+	return &memo->entries[index];
+}
+
+static int add_fragment(CompilerBackendMemo *memo, struct compiler_backend_fragment fragment) {
+	#define INITIAL_CAPACITY  64 /**< Number of entries of a new memo. */
+
+	/* Keep the load factor at one half at most. */
+	if (2 * (memo->count + 1) > memo->capacity) {
+		CompilerBackendMemo grown = *memo;
+		grown.capacity = memo->capacity > 0 ? 2 * memo->capacity : INITIAL_CAPACITY;
+		grown.entries  = calloc(grown.capacity, sizeof(struct compiler_backend_fragment));
+		if (!grown.entries) {
+			status_report("Memory error: could not grow the bytecode memo.\n");
+			return 1;
+		}
+		for (size_t i = 0; i < memo->capacity; ++i) {
+			if (memo->entries[i].node) {*find_fragment(&grown, memo->entries[i].node) = memo->entries[i];}
+		}
+		free(memo->entries);
+		*memo = grown;
+	}
+
+	*find_fragment(memo, fragment.node) = fragment;
+	++memo->count;
+	return 0;
+	#undef INITIAL_CAPACITY
+}
+
+static struct fused fuse(const SyntaxNode *const node) {
+	struct fused fused = {.opcode = 0};
+	const SyntaxNode *a = node->arity > 0 ? node->operand[0] : NULL;
+	const SyntaxNode *b = node->arity > 1 ? node->operand[1] : NULL;
+	const SyntaxNode *variable = NULL;
+
+	/* The simplifier puts constants first into sums and products. */
+	switch (node->operator_value) {
+	case OP_PLUS:
+		if (a->operator_value != OP_NUMBER) {break;}
+		if (b->operator_value == OP_TIMES && b->operand[0]->operator_value == OP_NUMBER) {
+			fused = (struct fused){
+				.opcode = OPC_MADDC, .factor = b->operand[0]->numeric_value,
+				.term = a->numeric_value, .operand = b->operand[1],
+			};
+		} else {
+			fused = (struct fused){.opcode = OPC_ADDC, .factor = a->numeric_value, .operand = b};
+		}
+		break;
+	case OP_MINUS:
+		/* c - f is -1 * f + c, negating is exact and so is the result. */
+		if (a->operator_value != OP_NUMBER) {break;}
+		fused = (struct fused){.opcode = OPC_MADDC, .factor = -1, .term = a->numeric_value, .operand = b};
+		break;
+	case OP_TIMES: {
+		unsigned int n = variable_factors(node, &variable);
+		if (n >= 2 && n <= MAX_POWI) {
+			fused = (struct fused){.opcode = OPC_POWI, .exponent = n, .operand = variable};
+		} else if (a->operator_value == OP_NUMBER) {
+			fused = (struct fused){.opcode = OPC_MULC, .factor = a->numeric_value, .operand = b};
+		}
+		break;
+	}
+	case OP_POWER: {
+		double n = b->operator_value == OP_NUMBER ? b->numeric_value : 0;
+		if (n >= 2 && n <= MAX_POWI && n == (unsigned int)n) {
+			fused = (struct fused){.opcode = OPC_POWI, .exponent = (unsigned int)n, .operand = a};
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	return fused;
+}
+
+static unsigned int variable_factors(const SyntaxNode *const node, const SyntaxNode **variable) {
+	if (node->operator_value == OP_X_VAR) {
+		if (*variable && (*variable)->numeric_value != node->numeric_value) {return 0;}
+		*variable = node;
+		return 1;
+	}
+	if (node->operator_value != OP_TIMES) {return 0;}
+
+	unsigned int a = variable_factors(node->operand[0], variable);
+	if (a == 0 || a > MAX_POWI) {return 0;}
+	unsigned int b = variable_factors(node->operand[1], variable);
+	return b == 0 ? 0 : a + b;
+}
+
 static int write_opcode(uint8_t opcode, VMCode *code) {
 	/* If the opcode does not fit reallocate */
 	if (grow_bytecode(code, sizeof(uint8_t)) != 0) {return 1;}
@@ -149,15 +610,17 @@ static int write_opcode(uint8_t opcode, VMCode *code) {
 }
 
 static int write_number(double number, VMCode *code) {
-	assert(code->length > 0);
+	float  single = (float)number;
+	size_t size   = code->precision == VM_FLOAT ? sizeof(float) : sizeof(double);
+
 	/* If the number literal does not fit reallocate */
-	if (grow_bytecode(code, sizeof(double)) != 0) {return 1;}
+	if (grow_bytecode(code, size) != 0) {return 1;}
 
 	/* Cast the number into a byte sequence */
-	uint8_t *array = (uint8_t *)&number;
+	uint8_t *array = code->precision == VM_FLOAT ? (uint8_t *)&single : (uint8_t *)&number;
 
 	/* Write the bytes. */
-	for (size_t i = 0; i < sizeof(double) / sizeof(uint8_t); ++i) {
+	for (size_t i = 0; i < size / sizeof(uint8_t); ++i) {
 		code->code[code->length++] = array[i];
 	}
 
@@ -168,16 +631,179 @@ static int grow_bytecode(VMCode *code, size_t by) {
 	#define GROW_BY 64 /**< By how many bytes to grow the sequence. */
 
 	if (code->length + by > code->capacity) {
-		uint8_t *new_code = realloc(code->code, (code->capacity + GROW_BY) * sizeof(uint8_t));
+		/* Copied bytecode of a memo can be longer than the usual step. */
+		size_t capacity = code->capacity + (by > GROW_BY ? by + GROW_BY : GROW_BY);
+		uint8_t *new_code = realloc(code->code, capacity * sizeof(uint8_t));
+		STATISTICS(statistics_count_allocation();)
 		if (new_code == NULL) {
-			fprintf(stderr, "Memory error: could no grow bytecode sequence.\n");
+			status_report("Memory error: could no grow bytecode sequence.\n");
+			return 1;
+		}
+		code->code     = new_code;
+		code->capacity = capacity;
+	}
+
+	return 0;
+	#undef GROW_BY
+}
+
+
+static int pool_constants(const SyntaxNode *const node, VMRegisterCode *code, struct node_uses *uses) {
+	double number; /* Value of a constant node. */
+
+	struct node_use *use = node_use(node, uses);
+	if (!use) {return 1;}
+	/* Shared nodes are only visited the first time. */
+	if (++use->parents > 1) {
+		if (use->parents == 2 && node->arity > 0) {++uses->shared;}
+		return 0;
+	}
+
+	switch (node->operator_value) {
+	case OP_NUMBER: number = node->numeric_value; break;
+	case OP_PI    : number = PI;                  break;
+	case OP_E     : number = E;                   break;
+	default:
+		for (int i = 0; i < node->arity; ++i) {
+			if (pool_constants(node->operand[i], code, uses) != 0) {return 1;}
+		}
+		return 0;
+	}
+
+	/* Every constant is stored only once. */
+	if (constant_register(number, code) != VM_REGISTER_X) {return 0;}
+	if (1 + code->constants >= UINT16_MAX) {
+		status_report("Compiler error: too many constants for register code.\n");
+		return 1;
+	}
+
+	double *new_pool = realloc(code->pool, (code->constants + 1) * sizeof(double));
+	if (!new_pool) {
+		status_report("Memory error: could not grow constant pool.\n");
+		return 1;
+	}
+	code->pool = new_pool;
+	code->pool[code->constants++] = number;
+
+	return 0;
+}
+
+static struct node_use *node_use(const SyntaxNode *const node, struct node_uses *uses) {
+	size_t mask  = uses->capacity - 1;
+	size_t index = ((uintptr_t)node / sizeof(SyntaxNode)) & mask;
+	while (uses->entries[index].node && uses->entries[index].node != node) {
+		index = (index + 1) & mask;
+	}
+	if (uses->entries[index].node) {return &uses->entries[index];}
+
+	/* Keep the load factor at one half at most. */
+	if (2 * (uses->count + 1) > uses->capacity) {
+		struct node_uses grown = *uses;
+		grown.capacity = 2 * uses->capacity;
+		grown.count    = 0;
+		grown.entries  = calloc(grown.capacity, sizeof(struct node_use));
+		if (!grown.entries) {
+			status_report("Memory error: could not grow map of node uses.\n");
+			return NULL;
+		}
+		for (size_t i = 0; i < uses->capacity; ++i) {
+			if (uses->entries[i].node) {*node_use(uses->entries[i].node, &grown) = uses->entries[i];}
+		}
+		free(uses->entries);
+		*uses = grown;
+		return node_use(node, uses);
+	}
+
+	uses->entries[index] = (struct node_use){.node = node, .parents = 0, .reg = VM_REGISTER_X};
+	++uses->count;
+	return &uses->entries[index];
+}
+
+static uint16_t constant_register(double number, const VMRegisterCode *code) {
+	for (size_t i = 0; i < code->constants; ++i) {
+		/* Compare the bytes, so 0 and -0 are different constants. */
+		if (memcmp(&code->pool[i], &number, sizeof(double)) == 0) {
+			return (uint16_t)(1 + i);
+		}
+	}
+	return VM_REGISTER_X;
+}
+
+static int compile_register_node(const SyntaxNode *const node, VMRegisterCode *code, struct node_uses *uses, size_t level, uint16_t *reg) {
+	/* First temporary register available to this node. */
+	size_t temporary = 1 + code->constants + uses->shared + level;
+
+	switch (node->operator_value) {
+	case OP_X_VAR :
+		if (node->numeric_value != 0) {
+			status_report("Compiler error: register code has no indexed variables.\n");
+			return 1;
+		}
+		*reg = VM_REGISTER_X;
+		return 0;
+	case OP_NUMBER: *reg = constant_register(node->numeric_value, code); return 0;
+	case OP_PI    : *reg = constant_register(PI, code);                 return 0;
+	case OP_E     : *reg = constant_register(E, code);                  return 0;
+	default: break;
+	}
+
+	if (temporary >= UINT16_MAX) {
+		status_report("Compiler error: expression too deep for register code.\n");
+		return 1;
+	}
+
+	VMRegisterInstruction instruction = {
+		.opcode = operator_to_opcode[node->operator_value],
+		.dst    = (uint16_t)temporary,
+		.a      = VM_REGISTER_X,
+		.b      = VM_REGISTER_X,
+	};
+
+	/* A shared node has its own register, and is computed only once. */
+	struct node_use *use = node_use(node, uses);
+	if (!use) {return 1;}
+	if (use->parents > 1) {
+		if (use->reg != VM_REGISTER_X) {*reg = use->reg; return 0;}
+		instruction.dst = (uint16_t)(1 + code->constants + uses->assigned++);
+	}
+
+	/* Integer powers take the multiplications of the stack machine, the
+	 * exponent takes the place of the second register. */
+	struct fused fused = fuse(node);
+	if (fused.opcode == OPC_POWI) {
+		instruction.opcode = OPC_POWI;
+		instruction.b      = (uint16_t)fused.exponent;
+		if (compile_register_node(fused.operand, code, uses, level, &instruction.a) != 0) {return 1;}
+	} else if (node->arity > 0) {
+		if (compile_register_node(node->operand[0], code, uses, level, &instruction.a) != 0) {return 1;}
+	}
+	if (node->arity > 1 && fused.opcode != OPC_POWI) {
+		/* Keep the first operand if it lives in our temporary register. */
+		size_t used = instruction.a == temporary ? 1 : 0;
+		if (compile_register_node(node->operand[1], code, uses, level + used, &instruction.b) != 0) {return 1;}
+	}
+
+	if (temporary + 1 > code->registers) {code->registers = temporary + 1;}
+	/* All nodes are known by now, so the entry has not moved. */
+	if (use->parents > 1) {use->reg = instruction.dst;}
+	*reg = instruction.dst;
+	return write_instruction(instruction, code);
+}
+
+static int write_instruction(VMRegisterInstruction instruction, VMRegisterCode *code) {
+	#define GROW_BY 16 /**< By how many instructions to grow the array. */
+
+	if (code->length == code->capacity) {
+		VMRegisterInstruction *new_code = realloc(code->code, (code->capacity + GROW_BY) * sizeof(VMRegisterInstruction));
+		if (new_code == NULL) {
+			status_report("Memory error: could no grow register code.\n");
 			return 1;
 		}
 		code->code      = new_code;
 		code->capacity += GROW_BY;
 	}
+	code->code[code->length++] = instruction;
 
 	return 0;
 	#undef GROW_BY
 }
-
@@ -8,6 +8,7 @@
 
 #include "../../syntax_node/syntax_node.h"
 #include "../../virtual_machine/vm_code.h"
+#include <stdio.h>
 
 /** Run the compiler backend.
  *
@@ -19,9 +20,146 @@
  *  This function runs the compiler backend to generate the virtual machine
  *  bytecode from a syntax tree. The caller of the function is responsible for
  *  ownership of the code object. If compilation fails the code object will
- *  remain `NULL`.
+ *  remain `NULL`. On success the code object also carries the maximum stack
+ *  depth the virtual machine needs in order to execute the code.
  */
 int compiler_backend(const SyntaxNode *const tree, VMCode **code);
 
+/** Run the compiler backend for numbers of a given precision.
+ *
+ *  @param tree       Pointer to the root of the syntax tree.
+ *  @param precision  Precision of the numbers of the code.
+ *  @param code       Pointer to the resulting VMCode, must be NULL.
+ *
+ *  @return  Exit status, 0 if no error, non-0 otherwise.
+ *
+ *  Same as `compiler_backend`, which compiles for `VM_DOUBLE`. Code of
+ *  `VM_FLOAT` holds its number literals as `float` and only runs on the float
+ *  machines.
+ *
+ *  @sa machine_execute_float, machine_execute_batch_float
+ */
+int compiler_backend_precision(const SyntaxNode *const tree, VMPrecision precision, VMCode **code);
+
+/** Bytecode of the nodes of a syntax graph, kept between compilations.
+ *
+ *  The bytecode of a node is one contiguous run of bytes in the bytecode of
+ *  every tree it is part of, and it only depends on the node and its
+ *  operands. The memo remembers for every compiled node where its bytecode
+ *  has been written, later compilations copy it from there instead of
+ *  compiling the node again. The buffers of all compilations are kept until
+ *  the memo is cleared.
+ *
+ *  The nodes are known by their address, so they must never change while the
+ *  memo is in use; this is the case for the nodes of a syntax node table. The
+ *  memo must be cleared along with the table.
+ *
+ *  @sa compiler_backend_memo_init, compiler_backend_memo_clear,
+ *      compiler_backend_memoised
+ */
+typedef struct compiler_backend_memo {
+	struct compiler_backend_fragment *entries; /**< Open addressed hash table. */
+	size_t  capacity;    /**< Number of entries, a power of two.     */
+	size_t  count;       /**< Number of nodes in the memo.          */
+	VMCode *buffers;     /**< Bytecode of every compilation.        */
+	size_t  generations; /**< Number of buffers.                    */
+	size_t  size;        /**< Bytes of all the buffers.             */
+	size_t  compiled;    /**< Nodes compiled by the latest call.    */
+} CompilerBackendMemo;
+
+/** Initialises an empty memo.
+ *
+ *  @param memo  The memo to initialise.
+ */
+void compiler_backend_memo_init(CompilerBackendMemo *memo);
+
+/** Forgets the bytecode of all nodes and frees the memory of a memo.
+ *
+ *  @param memo  The memo to clear, it can be used again afterwards.
+ */
+void compiler_backend_memo_clear(CompilerBackendMemo *memo);
+
+/** Run the compiler backend, reusing the bytecode of earlier compilations.
+ *
+ *  @param graph  Root of the syntax graph, all its nodes must stay unchanged
+ *                while the memo is in use.
+ *  @param memo   Memo of the bytecode of the nodes.
+ *  @param code   Pointer to the resulting VMCode, must be NULL.
+ *
+ *  @return  Exit status, 0 if no error, non-0 otherwise.
+ *
+ *  The result is the same as that of `compiler_backend`, but only the nodes
+ *  which are not in the memo yet are compiled, the bytecode of all other
+ *  nodes is copied. The number of nodes compiled is stored in the memo.
+ */
+int compiler_backend_memoised(const SyntaxNode *const graph, CompilerBackendMemo *memo, VMCode **code);
+
+/** Run the compiler backend to generate register code.
+ *
+ *  @param tree  Pointer to the root of the syntax tree.
+ *  @param code  Pointer to the resulting register code, must be NULL.
+ *
+ *  @return  Exit status, 0 if no error, non-0 otherwise.
+ *
+ *  This is the alternative to `compiler_backend`, it generates three-address
+ *  register code with a separate constant pool instead of stack bytecode. The
+ *  instructions are meant to be executed in forward order. Ownership is the
+ *  same as for `compiler_backend`.
+ *
+ *  @sa machine_execute_register
+ */
+int compiler_backend_register(const SyntaxNode *const tree, VMRegisterCode **code);
+
+/** Run the compiler backend to generate native machine code.
+ *
+ *  @param code    The bytecode to translate.
+ *  @param native  Pointer to store the resulting native code in.
+ *
+ *  @return  Exit status, 0 if no error, non-0 otherwise.
+ *
+ *  This is a just-in-time compiler: the bytecode is translated into x86-64
+ *  machine code in executable memory, which can then be called directly
+ *  through the function pointer of the native code, without any dispatch.
+ *  Translation fails if native code is not available on the platform (see
+ *  `VM_NATIVE_CODE`) or the system refuses to map executable memory; callers
+ *  are expected to fall back to the virtual machine in that case. On failure
+ *  the native code is cleared. The caller owns the native code on success.
+ */
+int compiler_backend_native(const VMCode code, VMNativeCode *native);
+
+/** Run the compiler backend to generate C source code.
+ *
+ *  @param function    Syntax tree of the function.
+ *  @param derivative  Syntax tree of the derivative, or `NULL`.
+ *  @param name        Name of the C function, must be a valid identifier.
+ *  @param file        File to write the source code to.
+ *
+ *  @return  Exit status, 0 if no error, non-0 otherwise.
+ *
+ *  This is an ahead-of-time alternative to the virtual machine: the trees are
+ *  written as a standalone C file defining `double name(double x)` and, if a
+ *  derivative is given, `double name_derivative(double x)`. The file only
+ *  needs *math.h* and is meant to be compiled with full optimisation and
+ *  linked directly into a program. The trees should be condensed or
+ *  simplified first, the source code is written exactly as the trees are.
+ */
+int compiler_backend_c(const SyntaxNode *const function, const SyntaxNode *const derivative, const char *name, FILE *file);
+
+/** Run the compiler backend to generate a C++ kernel.
+ *
+ *  @param function    Syntax tree of the function.
+ *  @param derivative  Syntax tree of the derivative, or `NULL`.
+ *  @param name        Name of the kernel, must be a valid identifier.
+ *  @param file        File to write the header to.
+ *
+ *  @return  Exit status, 0 if no error, non-0 otherwise.
+ *
+ *  Like `compiler_backend_c`, except that the trees are written as a C++
+ *  header defining `struct name` with the static member functions `value`
+ *  and, if a derivative is given, `derivative`. The struct is meant for
+ *  `newton::solve<name>` of *method/newton.hpp*, which the header includes.
+ */
+int compiler_backend_cpp(const SyntaxNode *const function, const SyntaxNode *const derivative, const char *name, FILE *file);
+
 #endif /* NEWTON_COMPILER_BACKEND_H */
 
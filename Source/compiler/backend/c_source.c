@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "backend.h"
+#include "../../status/status.h"
+
+/* C source code:
+ *
+ * Instead of bytecode the tree is written as a C expression, which is the
+ * body of a function `double name(double x)`. Operators and functions keep
+ * their spelling from `operator_to_string` wherever C spells them the same;
+ * only the power and the logarithm become calls of `pow` and `log`. Every
+ * operation is put in parentheses, so the precedence of the tree is kept no
+ * matter how C would group the operators.
+ *
+ * Numbers are written with 17 significant digits, which is enough to read
+ * back exactly the same double. Constants such as pi are written as their
+ * value, so the code does not depend on `M_PI` being defined.
+ *
+ * C++ source code is the same expression, only the functions are those of
+ * namespace `std` and an integer power is unrolled into multiplications by
+ * `newton::Power` of *newton.hpp*, just as the virtual machine would do it.
+ * The function and its derivative become the static member functions `value`
+ * and `derivative` of a struct, which is the type `newton::solve` takes.
+ * Where the expression contains no call of a function from *cmath* the
+ * members are `constexpr`, so they can even be evaluated during compilation.
+ */
+
+/** Languages of the source code. */
+enum language {
+	LANGUAGE_C,   /**< C99.   */
+	LANGUAGE_CPP, /**< C++11. */
+};
+
+/** Largest integer power unrolled in C++, like `OPC_POWI`. */
+#define MAX_POWER  255
+
+/** Names the C source code must not define, `NULL`-terminated.
+ *
+ *  These are the keywords of C99 and the functions of *math.h* the code
+ *  calls.
+ */
+static const char *const reserved_c[] = {
+	"auto", "break", "case", "char", "const", "continue", "default", "do",
+	"double", "else", "enum", "extern", "float", "for", "goto", "if",
+	"inline", "int", "long", "register", "restrict", "return", "short",
+	"signed", "sizeof", "static", "struct", "switch", "typedef", "union",
+	"unsigned", "void", "volatile", "while", "_Bool", "_Complex",
+	"_Imaginary",
+	"pow", "exp", "log", "sin", "cos", "tan",
+	NULL
+};
+
+/** Names the C++ source code must not define, `NULL`-terminated.
+ *
+ *  These are the keywords of C++11, the alternative spellings of the
+ *  operators and the members of the struct.
+ */
+static const char *const reserved_cpp[] = {
+	"alignas", "alignof", "asm", "auto", "bool", "break", "case", "catch",
+	"char", "char16_t", "char32_t", "class", "const", "constexpr",
+	"const_cast", "continue", "decltype", "default", "delete", "do",
+	"double", "dynamic_cast", "else", "enum", "explicit", "export", "extern",
+	"false", "float", "for", "friend", "goto", "if", "inline", "int", "long",
+	"mutable", "namespace", "new", "noexcept", "nullptr", "operator",
+	"private", "protected", "public", "register", "reinterpret_cast",
+	"return", "short", "signed", "sizeof", "static", "static_assert",
+	"static_cast", "struct", "switch", "template", "this", "thread_local",
+	"throw", "true", "try", "typedef", "typeid", "typename", "union",
+	"unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while",
+	"and", "and_eq", "bitand", "bitor", "compl", "not", "not_eq", "or",
+	"or_eq", "xor", "xor_eq",
+	"value", "derivative", "newton", "std",
+	NULL
+};
+
+/** Writes the C expression of a node.
+ *
+ *  @param node      The node to write.
+ *  @param language  The language to write.
+ *  @param file      The file to write to.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int write_node(const SyntaxNode *const node, enum language language, FILE *file);
+
+/** Writes a number as a C double literal.
+ *
+ *  @param number  The number to write.
+ *  @param file    The file to write to.
+ */
+static void write_number(double number, FILE *file);
+
+/** Writes one function definition.
+ *
+ *  @param tree    The expression of the function.
+ *  @param name    Name of the function.
+ *  @param suffix  Appended to the name.
+ *  @param file    The file to write to.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int write_function(const SyntaxNode *const tree, const char *name, const char *suffix, FILE *file);
+
+/** Writes one member function of a C++ kernel.
+ *
+ *  @param tree  The expression of the function.
+ *  @param name  Name of the member function.
+ *  @param file  The file to write to.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int write_member(const SyntaxNode *const tree, const char *name, FILE *file);
+
+/** The exponent of a power which C++ unrolls, or 0. */
+static unsigned int unrolled_power(const SyntaxNode *const node);
+
+/** Whether an expression calls a function of the C++ library.
+ *
+ *  @param node  Root of the expression.
+ *  @param x     Pointer to a flag which is set if the expression uses x.
+ */
+static int calls_library(const SyntaxNode *const node, int *x);
+
+/** Checks that source code can be written for a function.
+ *
+ *  @param function    The function.
+ *  @param derivative  Its derivative, or `NULL`.
+ *
+ *  @return  0 if it can, non-0 otherwise.
+ */
+static int check_function(const SyntaxNode *const function, const SyntaxNode *const derivative);
+
+/** Whether a string can name the function or struct of the source code.
+ *
+ *  It must be an identifier which is not a keyword of the language, nor any
+ *  other name the source code itself needs, like `pow` from *math.h* in C or
+ *  the members of the struct in C++.
+ *
+ *  @param name      The name.
+ *  @param language  The language of the source code.
+ *
+ *  @return  1 if the name can be used, 0 otherwise.
+ */
+static int is_identifier(const char *name, enum language language);
+
+
+int compiler_backend_c(const SyntaxNode *const function, const SyntaxNode *const derivative, const char *name, FILE *file) {
+	if (!is_identifier(name, LANGUAGE_C)) {
+		status_report("Compiler error: '%s' is not a valid C function name.\n", name);
+		return 1;
+	}
+	if (check_function(function, derivative) != 0) {return 1;}
+
+	fprintf(file, "/* Generated by newton, do not edit. */\n\n#include <math.h>\n\n");
+	if (write_function(function, name, "", file) != 0) {return 1;}
+	if (derivative && write_function(derivative, name, "_derivative", file) != 0) {return 1;}
+
+	if (ferror(file)) {
+		status_report("Compiler error: could not write C source code.\n");
+		return 1;
+	}
+	return 0;
+}
+
+int compiler_backend_cpp(const SyntaxNode *const function, const SyntaxNode *const derivative, const char *name, FILE *file) {
+	if (!is_identifier(name, LANGUAGE_CPP)) {
+		status_report("Compiler error: '%s' is not a valid C++ struct name.\n", name);
+		return 1;
+	}
+	if (check_function(function, derivative) != 0) {return 1;}
+
+	fprintf(file, "/* Generated by newton, do not edit. */\n\n#ifndef NEWTON_%s_HPP\n#define NEWTON_%s_HPP\n\n", name, name);
+	fprintf(file, "#include <cmath>\n#include \"newton.hpp\"\n\nstruct %s {\n", name);
+	if (write_member(function, "value", file) != 0) {return 1;}
+	if (derivative && write_member(derivative, "derivative", file) != 0) {return 1;}
+	fprintf(file, "};\n\n#endif\n");
+
+	if (ferror(file)) {
+		status_report("Compiler error: could not write C++ source code.\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int write_function(const SyntaxNode *const tree, const char *name, const char *suffix, FILE *file) {
+	fprintf(file, "double %s%s(double x) {\n\t(void)x;\n\treturn ", name, suffix);
+	if (write_node(tree, LANGUAGE_C, file) != 0) {return 1;}
+	fprintf(file, ";\n}\n\n");
+	return 0;
+}
+
+static int write_node(const SyntaxNode *const node, enum language language, FILE *file) {
+	const char *op = operator_to_string[node->operator_value];
+	const char *prefix = language == LANGUAGE_CPP ? "std::" : "";
+
+	switch (node->operator_value) {
+	case OP_NUMBER: write_number(node->numeric_value, file); return 0;
+	case OP_PI    : write_number(PI, file);                  return 0;
+	case OP_E     : write_number(E , file);                  return 0;
+	case OP_X_VAR : fprintf(file, "x");                      return 0;
+
+	case OP_NEGATE:
+		fprintf(file, "(-");
+		if (write_node(node->operand[0], language, file) != 0) {return 1;}
+		fprintf(file, ")");
+		return 0;
+
+	case OP_PLUS  :
+	case OP_MINUS :
+	case OP_TIMES :
+	case OP_DIVIDE:
+		fprintf(file, "(");
+		if (write_node(node->operand[0], language, file) != 0) {return 1;}
+		fprintf(file, " %s ", op);
+		if (write_node(node->operand[1], language, file) != 0) {return 1;}
+		fprintf(file, ")");
+		return 0;
+
+	case OP_POWER :
+		if (language == LANGUAGE_CPP && unrolled_power(node) != 0) {
+			fprintf(file, "newton::Power<%u>::of(", unrolled_power(node));
+			if (write_node(node->operand[0], language, file) != 0) {return 1;}
+			fprintf(file, ")");
+			return 0;
+		}
+		fprintf(file, "%spow(", prefix);
+		if (write_node(node->operand[0], language, file) != 0) {return 1;}
+		fprintf(file, ", ");
+		if (write_node(node->operand[1], language, file) != 0) {return 1;}
+		fprintf(file, ")");
+		return 0;
+
+	case OP_LN    : op = "log"; /* fall through */
+	case OP_EXP   :
+	case OP_SIN   :
+	case OP_COS   :
+	case OP_TAN   :
+		fprintf(file, "%s%s(", prefix, op);
+		if (write_node(node->operand[0], language, file) != 0) {return 1;}
+		fprintf(file, ")");
+		return 0;
+
+	default: break;
+	}
+
+	status_report("Compiler error: cannot write operator '%s' as C.\n", op);
+	return 1;
+}
+
+static int write_member(const SyntaxNode *const tree, const char *name, FILE *file) {
+	int x = 0; /* Whether the parameter is used. */
+	const char *specifier = calls_library(tree, &x) ? "inline" : "constexpr";
+	fprintf(file, "\tstatic %s double %s(double%s) {\n\t\treturn ", specifier, name, x ? " x" : "");
+	if (write_node(tree, LANGUAGE_CPP, file) != 0) {return 1;}
+	fprintf(file, ";\n\t}\n");
+	return 0;
+}
+
+static unsigned int unrolled_power(const SyntaxNode *const node) {
+	const SyntaxNode *exponent = node->operand[1];
+	if (exponent->operator_value != OP_NUMBER) {return 0;}
+	double n = exponent->numeric_value;
+	return n >= 1 && n <= MAX_POWER && n == (unsigned int)n ? (unsigned int)n : 0;
+}
+
+static int calls_library(const SyntaxNode *const node, int *x) {
+	int calls = 0;
+	switch (node->operator_value) {
+	case OP_X_VAR : *x = 1; return 0;
+	case OP_POWER : calls = unrolled_power(node) == 0; break;
+	case OP_EXP   :
+	case OP_LN    :
+	case OP_SIN   :
+	case OP_COS   :
+	case OP_TAN   : calls = 1; break;
+	default       : break;
+	}
+	for (int i = 0; i < node->arity; ++i) {
+		if (calls_library(node->operand[i], x)) {calls = 1;}
+	}
+	return calls;
+}
+
+static void write_number(double number, FILE *file) {
+	if (isnan(number)) {fprintf(file, "NAN"); return;}
+	if (isinf(number)) {fprintf(file, number < 0 ? "(-HUGE_VAL)" : "HUGE_VAL"); return;}
+
+	char digits[32];
+	snprintf(digits, sizeof digits, "%.17g", number);
+	/* Without a point or exponent C would read an integer literal. */
+	const char *point = strpbrk(digits, ".e") ? "" : ".0";
+	fprintf(file, signbit(number) ? "(%s%s)" : "%s%s", digits, point);
+}
+
+static int check_function(const SyntaxNode *const function, const SyntaxNode *const derivative) {
+	/* Check everything before the first line is written. */
+	if (syntax_node_uses_indexed_variables(function) || (derivative && syntax_node_uses_indexed_variables(derivative))) {
+		status_report("Compiler error: C source has no indexed variables.\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int is_identifier(const char *name, enum language language) {
+	if (!name || !(isalpha((unsigned char)name[0]) || name[0] == '_')) {return 0;}
+	for (const char *c = name; *c; ++c) {
+		if (!(isalnum((unsigned char)*c) || *c == '_')) {return 0;}
+	}
+
+	const char *const *reserved = language == LANGUAGE_CPP ? reserved_cpp : reserved_c;
+	for (; *reserved; ++reserved) {
+		if (strcmp(name, *reserved) == 0) {return 0;}
+	}
+	return 1;
+}
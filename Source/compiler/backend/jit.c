@@ -0,0 +1,307 @@
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "backend.h"
+#include "../../virtual_machine/vm.h"
+#include "../../virtual_machine/opcodes.h"
+#include "../../status/status.h"
+
+#if VM_NATIVE_CODE
+	#include <sys/mman.h>
+	#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+		#define MAP_ANONYMOUS  MAP_ANON
+	#endif
+#endif
+
+/* Native code:
+ *
+ * The bytecode is first decoded into threaded code, which verifies it and puts
+ * the instructions into the order of execution. Every instruction is then
+ * translated into a short sequence of x86-64 instructions on scalar SSE2
+ * doubles, following the System V calling convention: X arrives in XMM0 and
+ * the result is returned in XMM0.
+ *
+ * The stack of the virtual machine becomes a stack frame of the native
+ * function, every slot of the VM stack is one fixed slot in the frame. The
+ * depth of the stack is known, so the frame is allocated once on entry, and
+ * since the position of the stack pointer is known for every instruction at
+ * compile time, the slots are addressed directly relative to RBP:
+ *
+ *     [rbp -  8]           X
+ *     [rbp - 16 - 8 * i]   slot i of the VM stack
+ *
+ * The top of the stack is not kept in its slot but in XMM0 instead. Only when
+ * a new value is pushed the old top is spilled into its slot. This way
+ * operations take their first operand from XMM0 and leave their result there,
+ * and XMM0 is exactly where functions take their argument and return their
+ * result. Arithmetic is done inline, functions are called in libm through
+ * their absolute address. The frame is kept aligned to 16 bytes, as required
+ * for calls.
+ *
+ * The code is assembled into an ordinary buffer first, then copied into
+ * memory which is mapped writable and finally made executable, but never
+ * both at the same time.
+ */
+
+#if VM_NATIVE_CODE
+
+/** Buffer to assemble machine code into. */
+struct assembler {
+	uint8_t *code;     /**< The machine code.                 */
+	size_t   length;   /**< Number of bytes of code.          */
+	size_t   capacity; /**< Size of the buffer.               */
+	int      error;    /**< Non-0 if the buffer could not grow. */
+};
+
+/** Appends bytes of machine code.
+ *
+ *  @param a      The assembler.
+ *  @param bytes  The bytes to append.
+ *  @param n      Number of bytes.
+ *
+ *  Errors are remembered by the assembler, so that a sequence of instructions
+ *  can be emitted without checking every single one.
+ */
+static void emit(struct assembler *a, const void *bytes, size_t n);
+
+/** Appends an SSE2 instruction `op xmm, [rbp + displacement]`.
+ *
+ *  @param a     The assembler.
+ *  @param op    Opcode byte after the `F2 0F` prefix.
+ *  @param xmm   Number of the XMM register.
+ *  @param disp  Displacement of the memory operand relative to RBP.
+ */
+static void emit_sse(struct assembler *a, uint8_t op, uint8_t xmm, int32_t disp);
+
+/** Appends an SSE2 instruction `op xmm, xmm`.
+ *
+ *  @param a    The assembler.
+ *  @param op   Opcode byte after the `F2 0F` prefix.
+ *  @param dst  Number of the destination XMM register.
+ *  @param src  Number of the source XMM register.
+ */
+static void emit_sse_register(struct assembler *a, uint8_t op, uint8_t dst, uint8_t src);
+
+/** Appends a load of a constant into an XMM register, through RAX.
+ *
+ *  @param a       The assembler.
+ *  @param xmm     Number of the XMM register.
+ *  @param number  The constant.
+ */
+static void emit_constant(struct assembler *a, uint8_t xmm, double number);
+
+/** Appends a call of a function of one or two doubles.
+ *
+ *  @param a         The assembler.
+ *  @param function  Address of the function.
+ */
+static void emit_call(struct assembler *a, uintptr_t function);
+
+/** Displacement of a slot of the VM stack relative to RBP. */
+static int32_t slot(size_t i);
+
+/** Opcodes of SSE2 instructions, after the `F2 0F` prefix. */
+enum {
+	SSE_LOAD  = 0x10, /**< movsd xmm, m64 */
+	SSE_STORE = 0x11, /**< movsd m64, xmm */
+	SSE_ADD   = 0x58, /**< addsd xmm, m64 */
+	SSE_MUL   = 0x59, /**< mulsd xmm, m64 */
+	SSE_SUB   = 0x5c, /**< subsd xmm, m64 */
+	SSE_DIV   = 0x5e, /**< divsd xmm, m64 */
+};
+
+/** Displacement of X relative to RBP. */
+#define X_SLOT  (-8)
+
+#endif /* VM_NATIVE_CODE */
+
+
+int compiler_backend_native(const VMCode code, VMNativeCode *native) {
+	*native = (VMNativeCode){.memory = NULL, .size = 0, .function = NULL};
+
+	#if !VM_NATIVE_CODE
+	(void)code;
+	return 1;
+	#else
+	int error = 0; /* No error. */
+	VMThreadedCode   threaded;
+	struct assembler a = {.code = NULL, .length = 0, .capacity = 0, .error = 0};
+
+	if (vm_threaded_code_decode(code, &threaded) != 0) {return 1;}
+
+	/* Frame of X and the stack slots, rounded up to 16 bytes. */
+	uint32_t frame = (uint32_t)(8 + 8 * threaded.depth + 15) & ~(uint32_t)15;
+	size_t   sp    = 0; /* Number of values on the VM stack. */
+
+	/* push rbp; mov rbp, rsp; sub rsp, frame; movsd [rbp - 8], xmm0 */
+	emit(&a, (uint8_t[]){0x55, 0x48, 0x89, 0xe5, 0x48, 0x81, 0xec}, 7);
+	emit(&a, &frame, 4);
+	emit_sse(&a, SSE_STORE, 0, X_SLOT);
+
+	for (size_t i = 0; i < threaded.length; ++i) {
+		const VMInstruction *instruction = &threaded.instructions[i];
+		double   number; /* Value of a constant. */
+
+		switch (instruction->opcode) {
+		case OPC_NUM  : number = instruction->operand; goto constant;
+		case OPC_PI   : number = PI;                   goto constant;
+		case OPC_E    : number = E;                    goto constant;
+		constant:
+			if (sp > 0) {emit_sse(&a, SSE_STORE, 0, slot(sp - 1));}
+			emit_constant(&a, 0, number);
+			++sp;
+			break;
+
+		case OPC_VAR_X:
+			if (sp > 0) {emit_sse(&a, SSE_STORE, 0, slot(sp - 1));}
+			emit_sse(&a, SSE_LOAD, 0, X_SLOT);
+			++sp;
+			break;
+
+		case OPC_NEG  :
+			/* Flip the sign bit: mov rax, 1 << 63; movq xmm1, rax; xorpd xmm0, xmm1 */
+			emit(&a, (uint8_t[]){0x48, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0x80}, 10);
+			emit(&a, (uint8_t[]){0x66, 0x48, 0x0f, 0x6e, 0xc8}, 5);
+			emit(&a, (uint8_t[]){0x66, 0x0f, 0x57, 0xc1}, 4);
+			break;
+
+		/* The top of the stack is the first operand. */
+		case OPC_ADD  : emit_sse(&a, SSE_ADD, 0, slot(sp - 2)); --sp; break;
+		case OPC_SUB  : emit_sse(&a, SSE_SUB, 0, slot(sp - 2)); --sp; break;
+		case OPC_MULT : emit_sse(&a, SSE_MUL, 0, slot(sp - 2)); --sp; break;
+		case OPC_DIV  : emit_sse(&a, SSE_DIV, 0, slot(sp - 2)); --sp; break;
+		case OPC_POW  :
+			emit_sse(&a, SSE_LOAD, 1, slot(sp - 2));
+			emit_call(&a, (uintptr_t)pow);
+			--sp;
+			break;
+
+		case OPC_EXP  : emit_call(&a, (uintptr_t)exp); break;
+		case OPC_LN   : emit_call(&a, (uintptr_t)log); break;
+		case OPC_SIN  : emit_call(&a, (uintptr_t)sin); break;
+		case OPC_COS  : emit_call(&a, (uintptr_t)cos); break;
+		case OPC_TAN  : emit_call(&a, (uintptr_t)tan); break;
+
+		/* The constants of fused opcodes go through XMM1. */
+		case OPC_ADDC :
+			emit_constant(&a, 1, instruction->operand);
+			emit_sse_register(&a, SSE_ADD, 0, 1);
+			break;
+		case OPC_MULC :
+			emit_constant(&a, 1, instruction->operand);
+			emit_sse_register(&a, SSE_MUL, 0, 1);
+			break;
+		case OPC_MADDC:
+			emit_constant(&a, 1, instruction->operand);
+			emit_sse_register(&a, SSE_MUL, 0, 1);
+			emit_constant(&a, 1, instruction->addend);
+			emit_sse_register(&a, SSE_ADD, 0, 1);
+			break;
+		case OPC_POWI : {
+			/* The multiplications of machine_integer_power, unrolled, with the
+			 * base in XMM1. */
+			unsigned int n = (unsigned int)instruction->operand;
+			if (n == 0) {emit_constant(&a, 0, 1.0); break;}
+			int bit = 0;
+			while (n >> (bit + 1)) {++bit;}
+			/* movapd xmm1, xmm0 */
+			emit(&a, (uint8_t[]){0x66, 0x0f, 0x28, 0xc8}, 4);
+			while (bit-- > 0) {
+				emit_sse_register(&a, SSE_MUL, 0, 0);
+				if (n >> bit & 1) {emit_sse_register(&a, SSE_MUL, 0, 1);}
+			}
+			break;
+		}
+
+		default: /* The end of the threaded code, the result is in XMM0. */
+			/* leave; ret */
+			emit(&a, (uint8_t[]){0xc9, 0xc3}, 2);
+			break;
+		}
+	}
+	vm_threaded_code_clear(&threaded);
+	if (a.error) {error = 1; goto end;}
+
+	/* Copy the code into its own pages, then make them executable. */
+	native->size   = a.length;
+	native->memory = mmap(NULL, a.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (native->memory == MAP_FAILED) {
+		native->memory = NULL;
+		error = 1;
+		goto end;
+	}
+	memcpy(native->memory, a.code, a.length);
+	if (mprotect(native->memory, a.length, PROT_READ | PROT_EXEC) != 0) {
+		error = 1;
+		goto end;
+	}
+	/* ISO C has no conversion from data to function pointers, copy the bytes. */
+	memcpy(&native->function, &native->memory, sizeof native->function);
+
+end:
+	free(a.code);
+	if (error) {vm_native_code_clear(native);}
+	return error;
+	#endif /* VM_NATIVE_CODE */
+}
+
+#if VM_NATIVE_CODE
+
+static void emit(struct assembler *a, const void *bytes, size_t n) {
+	#define GROW_BY 256 /**< By how many bytes to grow the buffer. */
+
+	if (a->error) {return;}
+	if (a->length + n > a->capacity) {
+		uint8_t *new_code = realloc(a->code, a->capacity + GROW_BY);
+		if (!new_code) {
+			status_report("Memory error: could not grow native code.\n");
+			a->error = 1;
+			return;
+		}
+		a->code      = new_code;
+		a->capacity += GROW_BY;
+	}
+	memcpy(a->code + a->length, bytes, n);
+	a->length += n;
+
+	#undef GROW_BY
+}
+
+static void emit_sse(struct assembler *a, uint8_t op, uint8_t xmm, int32_t disp) {
+	/* ModRM: [rbp + disp32] with the register in the reg field. */
+	emit(a, (uint8_t[]){0xf2, 0x0f, op, (uint8_t)(0x85 | xmm << 3)}, 4);
+	emit(a, &disp, 4);
+}
+
+static void emit_sse_register(struct assembler *a, uint8_t op, uint8_t dst, uint8_t src) {
+	/* ModRM: register to register. */
+	emit(a, (uint8_t[]){0xf2, 0x0f, op, (uint8_t)(0xc0 | dst << 3 | src)}, 4);
+}
+
+static void emit_constant(struct assembler *a, uint8_t xmm, double number) {
+	uint64_t bits;
+	memcpy(&bits, &number, sizeof bits);
+	/* mov rax, imm64; movq xmm, rax */
+	emit(a, (uint8_t[]){0x48, 0xb8}, 2);
+	emit(a, &bits, 8);
+	emit(a, (uint8_t[]){0x66, 0x48, 0x0f, 0x6e, (uint8_t)(0xc0 | xmm << 3)}, 5);
+}
+
+static void emit_call(struct assembler *a, uintptr_t function) {
+	uint64_t address = function;
+	/* mov rax, imm64; call rax */
+	emit(a, (uint8_t[]){0x48, 0xb8}, 2);
+	emit(a, &address, 8);
+	emit(a, (uint8_t[]){0xff, 0xd0}, 2);
+}
+
+static int32_t slot(size_t i) {
+	return -16 - 8 * (int32_t)i;
+}
+
+#endif /* VM_NATIVE_CODE */
@@ -1,17 +1,34 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "frontend.h"
+#include "../../statistics/statistics.h"
+#include "../../status/status.h"
 
 /*===[ DECLARATIONS ]=========================================================*/
 
 /*---[ Constants and enumerations ]-------------------------------------------*/
 #define STRING_BUFFER_LENGTH  3 /**< Maximum length of an operator string. */
 
-#define STACK_SIZE_DEFAULT    7 /**< Default starting size for the operator-
-and operand stack. */
+/** Capacity of the operand and operator stack for a source code string.
+ *
+ *  Every token takes at least one character, and there can be no more
+ *  implicit multiplications than there are gaps between tokens, so a string of
+ *  `n` characters never makes more than `2n + 1` nodes. Neither stack can hold
+ *  more nodes than that, so the stacks never need to grow.
+ */
+#define STACK_CAPACITY(length)  (2 * (length) + 1)
+
+/** Capacity of the stacks which live on the C stack.
+ *
+ *  Strings short enough for stacks of this size, which are most of them, do
+ *  not allocate any memory for the stacks at all, longer strings allocate the
+ *  memory for both stacks at once.
+ */
+#define SMALL_STACK_CAPACITY  128
 
 /** Enum of possible machine states.
  *
@@ -39,6 +56,7 @@ enum lexer_state{
 	ST_DEC_PNT   , /**< Right after reading a decimal point.            */
 	ST_DEC_NUM   , /**< After encountering a decimal point.             */
 	ST_SYMBOL    , /**< State for non-alphanumeric characters.          */
+	ST_INDEX     , /**< Gathering the digits of an indexed variable.    */
 	LEXER_STATES , /**< Useful constant, not an actual state.           */
 };
 
@@ -128,6 +146,14 @@ typedef struct lexer {
 	 */
 	double power;
 
+	/** Index of an indexed variable.
+	 *
+	 *  The letter _x_ followed by digits is an indexed variable, like _x1_ or
+	 *  _x12_. The digits are collected here in the same way as the digits of a
+	 *  number are collected in the number buffer.
+	 */
+	unsigned int index;
+
 	/** String buffer for collecting characters into a string.
 	 *
 	 *  Characters read by the machine are stored in this buffer until a non-letter
@@ -190,6 +216,9 @@ typedef struct parser {
 	 *  substitute the binary minus for a unary negate.
 	 */
 	SyntaxNode *previous_node;
+
+	/** Arena to allocate the nodes in, or `NULL` to allocate each on its own. */
+	SyntaxNodeArena *arena;
 } Parser;
 
 /** Struct for the machine's transition information.
@@ -239,6 +268,8 @@ static int pop_operator(Parser *p);
  *
  *  @param stack  The stack to push onto.
  *  @param node   Pointer to the node to push.
+ *
+ *  @return  0 on success, non-0 if the stack is full.
  */
 static int syntax_node_stack_push(struct syntax_node_stack *stack, SyntaxNode *value);
 
@@ -248,10 +279,7 @@ static int syntax_node_stack_push(struct syntax_node_stack *stack, SyntaxNode *v
  *
  *  @return  Pointer to the node that has been popped off the stack.
  *
- *  Note that if the stack fails to shrink the old memory still remains valid.
- *  As such it is not necessary to handle the returned error code, it is
- *  optional. The capacity of the stack will remain untouched in that case.
- *  There is no error message printed either.
+ *  The stacks never shrink, popping cannot fail and always returns 0.
  */
 static int syntax_node_stack_pop(struct syntax_node_stack *stack, SyntaxNode **value);
 
@@ -341,6 +369,34 @@ static int append_char(Lexer *l);
  */
 static int pass_number_node(Lexer *l);
 
+/** Lexer action that starts the index of an indexed variable.
+ *
+ *  This action is called when a digit follows a letter. The only word which
+ *  can be followed by a digit is the variable _x_, anything else is a format
+ *  error. The string buffer is reset and the digit starts the index.
+ *
+ *  @sa index
+ */
+static int begin_index(Lexer *l);
+
+/** Lexer action that appends a digit to the index of a variable.
+ *
+ *  If the index becomes larger than `MAX_VARIABLES` a format error is thrown.
+ *
+ *  @sa index
+ */
+static int append_index(Lexer *l);
+
+/** Lexer action that passes an indexed variable node.
+ *
+ *  This action constructs a variable node out of the index and passes it to
+ *  the syntax tree builder. Like a number an indexed variable followed by a
+ *  letter is followed by an implicit multiplication.
+ *
+ *  @sa index, pass_syntax_node
+ */
+static int pass_variable_node(Lexer *l);
+
 /** Lexer action that passes a function node.
  *
  *  This action constructs a function node out of the string buffer, passes it
@@ -383,7 +439,7 @@ static enum operator_associativity op_assoc(enum operator_type t);
  *  The first coordinate corresponds to the current state, the second one to
  *  the type of symbol that's read.
  */
-static struct transition_instruction lexer_transition_table[LEXER_STATES][CHAR_CLASSES] = {
+static const struct transition_instruction lexer_transition_table[LEXER_STATES][CHAR_CLASSES] = {
 	[ST_START] = {
 		[ CH_LETTER  ] = { .next_state = ST_LETTER  , .action = append_char        },
 		[ CH_DIGIT   ] = { .next_state = ST_NUMBER  , .action = append_digit       },
@@ -410,7 +466,7 @@ static struct transition_instruction lexer_transition_table[LEXER_STATES][CHAR_C
 	},
 	[ST_LETTER] = {
 		[ CH_LETTER  ] = { .next_state = ST_LETTER  , .action = append_char        },
-		[ CH_DIGIT   ] = { .next_state = ST_ERROR   , .action = no_act             },
+		[ CH_DIGIT   ] = { .next_state = ST_INDEX   , .action = begin_index        },
 		[ CH_DECIMAL ] = { .next_state = ST_ERROR   , .action = no_act             },
 		[ CH_SYMBOL  ] = { .next_state = ST_SYMBOL  , .action = pass_function_node },
 		[ CH_SPACE   ] = { .next_state = ST_START   , .action = pass_function_node },
@@ -448,56 +504,54 @@ static struct transition_instruction lexer_transition_table[LEXER_STATES][CHAR_C
 		[ CH_SPACE   ] = { .next_state = ST_START   , .action = no_act             },
 		[ CH_UNKNOWN ] = { .next_state = ST_ERROR   , .action = no_act             },
 	},
+	[ST_INDEX] = {
+		[ CH_LETTER  ] = { .next_state = ST_LETTER  , .action = pass_variable_node },
+		[ CH_DIGIT   ] = { .next_state = ST_INDEX   , .action = append_index       },
+		[ CH_DECIMAL ] = { .next_state = ST_ERROR   , .action = no_act             },
+		[ CH_SYMBOL  ] = { .next_state = ST_SYMBOL  , .action = pass_variable_node },
+		[ CH_SPACE   ] = { .next_state = ST_START   , .action = pass_variable_node },
+		[ CH_UNKNOWN ] = { .next_state = ST_ERROR   , .action = no_act             },
+	},
 };
 
 /*===[ IMPLEMENTATIONS ]======================================================*/
 
 int compiler_frontend(const char *const source, SyntaxNode **tree) {
+	return compiler_frontend_arena(source, NULL, tree);
+}
+
+int compiler_frontend_arena(const char *const source, SyntaxNodeArena *arena, SyntaxNode **tree) {
 	assert(*tree == NULL); /* Must be NULL. */
 
 	int error = 0; /* No error */
-	Lexer  *l; /* Lexer used by the backend.  */
-	Parser *p; /* Parser used by the backend. */
-
-	/* Set up the lexer and parser */
-	l = malloc(sizeof(Lexer));
-	if (!l) {
-		fprintf(stderr, "Memory error: could not allocate backend lexer.\n");
-		error = 1;
-		goto end;
-	}
-
-	/* The lexer's parser */ {
-		l->parser = malloc(sizeof(struct parser));
-		if (!l->parser) {
-			error = 1;
-			fprintf(stderr, "Memory error: could not allocate backend parser.\n");
-			free(l);
-			goto end;
-		}
-
-		l->parser->operand_stack = (struct syntax_node_stack){
-			.stack = malloc(2 * sizeof(SyntaxNode *)),
-			.count = 0,
-			.capacity = 2
-		};
-
-		l->parser->operator_stack = (struct syntax_node_stack){
-			.stack = malloc(2 * sizeof(SyntaxNode *)),
-			.count = 0,
-			.capacity = 2
-		};
-
-		if (!l->parser->operand_stack.stack || !l->parser->operator_stack.stack) {
-			fprintf(stderr, "Memory error: could not allocate parser stacks.\n");
-			free(l->parser);
-			l->parser = NULL;
-			free(l);
-			error = 1;
-			goto end;
+	size_t capacity = STACK_CAPACITY(strlen(source));
+	SyntaxNode *small_stacks[2 * SMALL_STACK_CAPACITY]; /* Stacks of short strings. */
+	SyntaxNode **stacks = small_stacks;
+
+	/* The lexer and parser live on the C stack, the stacks are presized. */
+	Parser  parser;
+	Lexer   lexer = {.parser = &parser};
+	Lexer  *l = &lexer;  /* Lexer used by the backend.  */
+	Parser *p = &parser; /* Parser used by the backend. */
+
+	if (capacity > SMALL_STACK_CAPACITY) {
+		stacks = malloc(2 * capacity * sizeof(SyntaxNode *));
+		STATISTICS(statistics_count_allocation();)
+		if (!stacks) {
+			status_report("Memory error: could not allocate parser stacks.\n");
+			return 1;
 		}
 	}
-	p = l->parser;
+	/* All nodes of the tree in one block, unless the arena has room already. */
+	if (syntax_node_arena_reserve(arena, capacity) != 0) {
+		if (stacks != small_stacks) {free(stacks);}
+		return 1;
+	}
+
+	p->operand_stack  = (struct syntax_node_stack){.stack = stacks           , .count = 0, .capacity = capacity};
+	p->operator_stack = (struct syntax_node_stack){.stack = stacks + capacity, .count = 0, .capacity = capacity};
+	p->previous_node  = NULL;
+	p->arena = arena;
 
 	/* Lexer fields */
 
@@ -513,8 +567,12 @@ int compiler_frontend(const char *const source, SyntaxNode **tree) {
 	/* set up the number buffer for collecting digits into numbers */
 	l->number_buffer = 0.0;
 	l->power = 0.1;
+	l->index = 0;
 
-	lexer_transition_table[l->current_state][digest_input_char(l, l->read_head)].action(l);
+	error = lexer_transition_table[l->current_state][digest_input_char(l, l->read_head)].action(l);
+	if (error) {
+		goto cleanup;
+	}
 	++(l->read_head);
 
 	/* This is the actual lexing process */
@@ -541,7 +599,10 @@ int compiler_frontend(const char *const source, SyntaxNode **tree) {
 		/* Use that information to transition into the new state */
 		l->current_state = lexer_transition_table[l->current_state][chr].next_state;
 		/* Perform the action of the previous state */
-		lexer_transition_table[l->previous_state][chr].action(l);
+		error = lexer_transition_table[l->previous_state][chr].action(l);
+		if (error) {
+			goto cleanup;
+		}
 
 		++l->read_head;
 	}
@@ -551,7 +612,8 @@ int compiler_frontend(const char *const source, SyntaxNode **tree) {
 	/* If an exception occurred */
 	if (l->current_state == ST_ERROR) {
 		/* This is an exception, so the exit code should not be the same as for an error */
-		fprintf(stderr, "Formating error while parsing function.");
+		status_report("Formating error while parsing function.\n");
+		error = 1;
 		goto cleanup;
 	}
 
@@ -562,7 +624,7 @@ int compiler_frontend(const char *const source, SyntaxNode **tree) {
 		/* By this point there should be no opening parentheses      *
 		 * on the stack anymore. If there are we have a syntax error */
 		if(p->operator_stack.stack[p->operator_stack.count-1]->operator_value == OP_LEFT_BRACE){
-			fprintf(stderr, "Syntax error: no matching closing parenthesis found.\n");
+			status_report("Syntax error: no matching closing parenthesis found.\n");
 			error = 1;
 			goto cleanup;
 		}
@@ -570,7 +632,7 @@ int compiler_frontend(const char *const source, SyntaxNode **tree) {
 	}
 
 	if (p->operand_stack.count != 1) {
-		fprintf(stderr, "Syntax Error: More operands than operators");
+		status_report("Syntax Error: More operands than operators.\n");
 		error = 1;
 		goto cleanup;
 	}
@@ -584,23 +646,20 @@ cleanup:
 	for (int i = 0; i < p->operator_stack.count; ++i) {
 		/* If there is anything left on the operator stack we have had an error. */
 		error = error ? error : 1;
-		syntax_node_destroy(p->operator_stack.stack[i]);
+		syntax_node_arena_destroy(p->arena, p->operator_stack.stack[i]);
 	}
-	free(p->operator_stack.stack);
 
 	/* On success the last tree will have been popped already */
 	for (int i = 0; i < p->operand_stack.count; ++i) {
 		error = error ? error : 1;
-		syntax_node_destroy(p->operand_stack.stack[i]);
+		syntax_node_arena_destroy(p->arena, p->operand_stack.stack[i]);
 	}
-	free(p->operand_stack.stack);
+	if (stacks != small_stacks) {free(stacks);}
 
-	free(p);
-	p = l->parser = NULL;
-	free(l);
-	l = NULL;
+	if (l->previous_node && l->previous_node->operator_value == OP_RIGHT_BRACE) {
+		syntax_node_arena_destroy(p->arena, l->previous_node);
+	}
 
-end:
 	return error;
 }
 
@@ -615,7 +674,7 @@ static int parse_node(struct parser *p, struct syntax_node *node) {
 	if (token == OP_NUMBER || token_is_constant(token) || token_is_variable(token)) {
 		error = syntax_node_stack_push(&p->operand_stack, node);
 		if (error) {
-			fprintf(stderr, "Parser Error: Could not push operand to stack.\n");
+			status_report("Parser Error: Could not push operand to stack.\n");
 		}
 		return error;
 	}
@@ -624,7 +683,7 @@ static int parse_node(struct parser *p, struct syntax_node *node) {
 	if (token_is_function(token)) {
 		error = syntax_node_stack_push(&p->operator_stack, node);
 		if (error) {
-			fprintf(stderr, "Parser Error: Could not push operator to stack.\n");
+			status_report("Parser Error: Could not push operator to stack.\n");
 		}
 		return error;
 	}
@@ -635,6 +694,8 @@ static int parse_node(struct parser *p, struct syntax_node *node) {
 		while (p->operator_stack.count > 0) {
 			/* Operator on top of the operator stack. */
 			#define STACK_TOP p->operator_stack.stack[p->operator_stack.count-1]->operator_value
+			/* An opening parenthesis shields the operators below it. */
+			if (STACK_TOP == OP_LEFT_BRACE) {break;}
 			/* Precedences, and asserting they are not 0 */
 			unsigned int precedence_current = operator_precedence[token    ];
 			unsigned int precedence_top     = operator_precedence[STACK_TOP];
@@ -660,7 +721,7 @@ static int parse_node(struct parser *p, struct syntax_node *node) {
 			if (CONDITION_A || CONDITION_B) {
 				error = pop_operator(p);
 				if (error) {
-					fprintf(stderr, "Parser error: Could not pop operator from stack.\n");
+					status_report("Parser error: Could not pop operator from stack.\n");
 					return error;
 				}
 			} else {
@@ -672,16 +733,16 @@ static int parse_node(struct parser *p, struct syntax_node *node) {
 		}
 		error = syntax_node_stack_push(&p->operator_stack, node);
 		if (error) {
-			fprintf(stderr, "Parser Error: Could not push operator to stack.\n");
+			status_report("Parser Error: Could not push operator to stack.\n");
 		}
 		return error;
 	}
 
 	/* If the token is a left parenthesis push it onto the operator stack */
 	if (token == OP_LEFT_BRACE) {
-		syntax_node_stack_push(&p->operator_stack, node);
+		error = syntax_node_stack_push(&p->operator_stack, node);
 		if (error) {
-			fprintf(stderr, "Parser Error: Could not push operator to stack.\n");
+			status_report("Parser Error: Could not push operator to stack.\n");
 		}
 		return error;
 	}
@@ -692,14 +753,14 @@ static int parse_node(struct parser *p, struct syntax_node *node) {
 			/* If we find a matching closing brace... */
 			if (p->operator_stack.stack[p->operator_stack.count-1]->operator_value == OP_LEFT_BRACE) {
 				/* Free it and throw it away */
-				free(p->operator_stack.stack[--p->operator_stack.count]);
+				syntax_node_arena_destroy(p->arena, p->operator_stack.stack[--p->operator_stack.count]);
 
 				/* If the top of the operator stack is a function pop it as well. */
 				#define STACK_TOP p->operator_stack.stack[p->operator_stack.count-1]->operator_value
 				if (p->operator_stack.count > 0 && token_is_function(STACK_TOP)) {
 					error = pop_operator(p);
 						if (error) {
-							fprintf(stderr, "Parser error: Could not pop operator from stack.\n");
+							status_report("Parser error: Could not pop operator from stack.\n");
 						}
 				}
 				#undef TOP_OP
@@ -712,12 +773,12 @@ static int parse_node(struct parser *p, struct syntax_node *node) {
 
 		// If we made it to here it means we have emptied the stack
 		// without finding the closing brace. That's a syntax error.
-		fprintf(stderr, "Syntax error: no matching opening parenthesis found.\n");
+		status_report("Syntax error: no matching opening parenthesis found.\n");
 		return 1;
 	}
 
 	/* If the token is none of these types we have an undefined type */
-	fprintf(stderr, "Syntax error: unknown type of token %i.\n", token);
+	status_report("Syntax error: unknown type of token %i.\n", token);
 	return 1;
 }
 
@@ -731,7 +792,7 @@ static int pop_operator(Parser *p) {
 	/* pop the right amount of operands off the output stack... */
 	for (int i = op->arity; i > 0; --i) {
 		if (p->operand_stack.count == 0) {
-			fprintf(stderr, "Syntax error: operator has too few operands.\n");
+			status_report("Syntax error: operator has too few operands.\n");
 			error = 1;
 			goto end;
 		}
@@ -742,7 +803,7 @@ static int pop_operator(Parser *p) {
 	/* push this operator node to the output stack */
 	error = syntax_node_stack_push(&p->operand_stack, op);
 	if (error) {
-		fprintf(stderr, "Parser error: Could not push operator to stack after popping.\n");
+		status_report("Parser error: Could not push operator to stack after popping.\n");
 	}
 
 end:
@@ -754,51 +815,24 @@ end:
 static int syntax_node_stack_push(struct syntax_node_stack *stack, SyntaxNode *value ) {
 	assert(0 <= stack->count && stack->count <= stack->capacity);
 
-	int error = 0; /* No error. */
-
-	// Stack will grow if it is full (top == capacity - 1)
-	//
-	// Example: capacity = 4, top = 3
-	//          => Stack full; after increment: top == capacity
-	if(stack->count == stack->capacity) {
-		SyntaxNode **new_stack = realloc(stack->stack, 2 * stack->count * sizeof(SyntaxNode*));
-		if (!new_stack) {
-			fprintf(stderr, "Memory error: Stack overflow, could not grow stack.\n");
-			error = 1;
-			goto end;
-		}
-		stack->stack = new_stack;
-		stack->capacity = 2 * stack->count;
+	/* The stacks are presized, they can only overflow if the bound is wrong. */
+	if (stack->count == stack->capacity) {
+		status_report("Parser error: stack overflow.\n");
+		return 1;
 	}
 	stack->stack[stack->count++] = value;
 
-end:
 	assert(0 < stack->count && stack->count <= stack->capacity);
-	return error;
+	return 0;
 }
 
 static int syntax_node_stack_pop(struct syntax_node_stack *stack, SyntaxNode **value) {
 	assert(0 < stack->count && stack->count <= stack->capacity);
 
-	int error = 0; /* No error. */
 	*value = stack->stack[--stack->count];
 
-	// Stack will shrink by half if it is only one quarter full, but avoid a
-	// stack with no capacity.
-	//
-	// Example: capacity = 8, count = 2
-	//          => 4*count = 4*2 = 8 = capacity
-	//          => capacity shrunk to 2*2 = 4
-	if (4 * stack->count <= stack->capacity && stack->count > 0) {
-		SyntaxNode **new_stack = realloc(stack->stack, (2 * stack->count) * sizeof(SyntaxNode *));
-		if (!new_stack) {error = 1; goto end;}
-		stack->stack = new_stack;
-		stack->capacity = 2 * stack->count;
-	}
-
-end:
 	assert(0 <= stack->count && stack->count < stack->capacity);
-	return error;
+	return 0;
 }
 
 /*---[ Action implementation ]------------------------------------------------*/
@@ -830,10 +864,10 @@ static int append_char(Lexer *l) {
 	if (l->string_ptr - &(l->string_buf[0]) >= STRING_BUFFER_LENGTH) {
 		error = 1;
 		l->current_state = ST_ERROR;
-		fprintf(stderr,
-		        "Error while parsing: string buffer full, currently %s, trying to append %c.\n"
-		        "The maximum length of a legal function string is %i.\n",
-		        l->string_buf, *l->string_ptr, STRING_BUFFER_LENGTH
+		status_report(
+		              "Error while parsing: string buffer full, currently %s, trying to append %c.\n"
+		              "The maximum length of a legal function string is %i.\n",
+		              l->string_buf, *l->string_ptr, STRING_BUFFER_LENGTH
 		);
 		goto end;
 	}
@@ -877,6 +911,62 @@ end:
 	return error;
 }
 
+static int begin_index(Lexer *l) {
+	/* Only the variable x can carry an index. */
+	if (l->string_ptr != l->string_buf + 1 || (l->string_buf[0] != 'x' && l->string_buf[0] != 'X')) {
+		*l->string_ptr = '\0';
+		status_report("Format error: %s cannot be followed by a digit.\n", l->string_buf);
+		l->current_state = ST_ERROR;
+		return 1;
+	}
+	/* reset the string buffer */
+	for (int i = 0; i < STRING_BUFFER_LENGTH; ++i) {
+		(l->string_buf)[i] = '\0';
+	}
+	l->string_ptr = &(l->string_buf[0]);
+
+	l->index = 0;
+	return append_index(l);
+}
+
+static int append_index(Lexer *l) {
+	l->index = l->index * 10 + (unsigned int) (*l->read_head - '0');
+	if (l->index > MAX_VARIABLES) {
+		status_report("Format error: variable index is larger than %i.\n", MAX_VARIABLES);
+		l->current_state = ST_ERROR;
+		return 1;
+	}
+	return 0;
+}
+
+static int pass_variable_node(Lexer *l) {
+	int error = 0; /* No error */
+
+	/* x0 would be the same as x, there is only x and x1, x2, ... */
+	if (l->index == 0) {
+		status_report("Format error: variable indices start at 1.\n");
+		l->current_state = ST_ERROR;
+		error = 1;
+		goto end;
+	}
+	error = pass_syntax_node(l, OP_X_VAR, (double) l->index);
+	if (error) {goto end;}
+	l->index = 0;
+
+	/* if the variable is followed by a letter also pass a TIMES */
+	if (l->current_state == ST_LETTER) {
+		error = pass_syntax_node(l, OP_TIMES, 0);
+		if (error) {goto end;}
+		append_char(l);
+	}
+	if (l->current_state == ST_SYMBOL) {
+		error = pass_symbol_node(l);
+	}
+
+end:
+	return error;
+}
+
 static int pass_function_node(Lexer *l) {
 	int error = 0; /* No error. */
 
@@ -885,9 +975,9 @@ static int pass_function_node(Lexer *l) {
 	Operator o = string_to_operator(l->string_buf);
 
 	if (!o) {
-		fprintf(stderr,
-		        "Format error: Unknown function %s.\n",
-		        l->string_buf
+		status_report(
+		              "Format error: Unknown function %s.\n",
+		              l->string_buf
 		);
 		error = 1;
 		goto end;
@@ -924,7 +1014,7 @@ static int pass_symbol_node(Lexer *l) {
 	p = l->previous_node == NULL ? OP_UNKNOWN : l->previous_node->operator_value;
 
 	if (o == OP_UNKNOWN) {
-		fprintf(stderr, "Format error: unknown symbol %c.\n", l->symb);
+		status_report("Format error: unknown symbol %c.\n", l->symb);
 		error = 1;
 		goto end;
 	}
@@ -943,11 +1033,11 @@ end:
 
 static int pass_syntax_node(Lexer *l, Operator o, double n) {
 	int error = 0; /* No error. */
-	SyntaxNode *node = syntax_node_construct(o, n);
+	SyntaxNode *node = syntax_node_arena_construct(l->parser->arena, o, n);
 
 	if (!node) {
-		fprintf(stderr,
-		        "Compiler error: could not pass not to parser.\n"
+		status_report(
+		              "Compiler error: could not pass not to parser.\n"
 		);
 		error = 1;
 		goto end;
@@ -956,13 +1046,15 @@ static int pass_syntax_node(Lexer *l, Operator o, double n) {
 	/* implicit OP_TIMES */
 	if (l->previous_node) {
 		Operator p = l->previous_node->operator_value;
-		/* preceding an opening brace after a nullary token */
-		if (o == OP_LEFT_BRACE && l->previous_node->arity == 0) {
+		/* preceding an opening brace after a nullary token (braces are
+		 * nullary as well, but not tokens in this sense) */
+		if (o == OP_LEFT_BRACE && l->previous_node->arity == 0 && p != OP_LEFT_BRACE && p != OP_RIGHT_BRACE) {
 			error |= pass_syntax_node(l, OP_TIMES, 0);
 		}
 
-		// succeeding a closing brace before a unary or nullary token
-		if (p == OP_RIGHT_BRACE && node->arity < 2) {
+		// succeeding a closing brace before a unary or nullary token, except
+		// for another closing brace
+		if (p == OP_RIGHT_BRACE && node->arity < 2 && o != OP_RIGHT_BRACE) {
 			error |= pass_syntax_node(l, OP_TIMES, 0);
 		}
 		// This is not quite right, even an n-ary token following a closing
@@ -973,8 +1065,12 @@ static int pass_syntax_node(Lexer *l, Operator o, double n) {
 			goto end;
 		}
 	}
+	/* A closing brace is not kept by the parser, only here. */
+	if (l->previous_node && l->previous_node->operator_value == OP_RIGHT_BRACE) {
+		syntax_node_arena_destroy(l->parser->arena, l->previous_node);
+	}
 	l->previous_node = node;
-	parse_node(l->parser, node);
+	error = parse_node(l->parser, node);
 
 end:
 	return error;
@@ -1022,8 +1118,8 @@ enum char_class digest_input_char(Lexer *l, const char *character) {
 		return CH_SPACE;
 	}
 
-	fprintf(
-		stderr, "Format error: character \'%c\' from the input formula does not"
+	status_report(
+		"Format error: character \'%c\' from the input formula does not"
 		"correspond to any known symbol or function. Error noticed at position %li .\n",
 		*character, l->read_head - l->string_to_parse
 	);
@@ -17,5 +17,19 @@
  */
 int compiler_frontend(const char *const source, SyntaxNode **tree);
 
+/** Run the compiler frontend, allocating the tree in an arena.
+ *
+ *  @param source  Source code string.
+ *  @param arena   Arena to allocate the nodes of the tree in.
+ *  @param tree    Pointer to the root of the resulting tree.
+ *
+ *  @return  Exit status, 0 if no error, non-0 otherwise.
+ *
+ *  Same as `compiler_frontend`, except that the tree belongs to the arena and
+ *  is released along with it. Passing `NULL` for the arena is the same as
+ *  calling `compiler_frontend`.
+ */
+int compiler_frontend_arena(const char *const source, SyntaxNodeArena *arena, SyntaxNode **tree);
+
 #endif /* NEWTON_COMPILER_FRONTEND_H */
 
@@ -0,0 +1,318 @@
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "library.h"
+#include "../virtual_machine/vm_cartridge.h"
+#include "../status/status.h"
+
+/* Cache:
+ *
+ * The entries are kept in two structures at once: a hash table with chaining
+ * to find the entry of a function string, and a doubly linked list in the
+ * order of use, the most recently used entry first. Every hit moves its entry
+ * to the front of the list, and when the cache is full entries are evicted
+ * from the back.
+ *
+ * The cache owns one reference of every handle and hands out further
+ * references. Evicting an entry only drops the reference of the cache, so a
+ * handle which is still in use elsewhere lives on until its last owner is
+ * done with it.
+ *
+ * The key of an entry is the normalised function string: white space is
+ * removed, except for a single space between two characters which would
+ * otherwise run together into a different token, like the two numbers in
+ * `2 3`.
+ */
+
+/** Number of buckets of a new cache, must be a power of two. */
+#define INITIAL_BUCKETS  64
+
+/** Entry of the cache. */
+struct newton_cache_entry {
+	char           *key;      /**< Normalised function string.         */
+	uint64_t        hash;     /**< Hash of the key.                    */
+	size_t          size;     /**< Memory of the entry in bytes.       */
+	NewtonFunction *function; /**< Handle of the function.             */
+	struct newton_cache_entry *next;  /**< Next entry of the bucket.   */
+	struct newton_cache_entry *newer; /**< Entry used more recently.   */
+	struct newton_cache_entry *older; /**< Entry used less recently.   */
+};
+
+struct newton_cache {
+	pthread_mutex_t lock;                /**< Protects the entire cache.  */
+	struct newton_cache_entry **buckets; /**< Hash table of the entries.  */
+	size_t bucket_count;                 /**< Number of buckets.          */
+	struct newton_cache_entry *newest;   /**< Most recently used entry.   */
+	struct newton_cache_entry *oldest;   /**< Least recently used entry.  */
+	size_t capacity;                     /**< Maximum memory in bytes.    */
+	NewtonCacheStatistics statistics;    /**< Counters of the cache.      */
+};
+
+/** Normalises a function string.
+ *
+ *  @param source  The function string.
+ *
+ *  @return  New string without white space, owned by the caller, `NULL` on
+ *           failure.
+ */
+static char *normalise(const char *source);
+
+/** Finds the entry of a key.
+ *
+ *  @param cache  The cache to search, must be locked.
+ *  @param key    The normalised function string.
+ *  @param hash   Hash of the key.
+ *
+ *  @return  The entry, `NULL` if there is none.
+ */
+static struct newton_cache_entry *find_entry(const NewtonCache *cache, const char *key, uint64_t hash);
+
+/** Moves an entry to the front of the list of use.
+ *
+ *  @param cache  The cache of the entry, must be locked.
+ *  @param entry  The entry, must not be in the list.
+ */
+static void push_front(NewtonCache *cache, struct newton_cache_entry *entry);
+
+/** Takes an entry out of the list of use.
+ *
+ *  @param cache  The cache of the entry, must be locked.
+ *  @param entry  The entry, must be in the list.
+ */
+static void unlink_entry(NewtonCache *cache, struct newton_cache_entry *entry);
+
+/** Evicts the least recently used entry.
+ *
+ *  @param cache  The cache, must be locked and not empty.
+ */
+static void evict_oldest(NewtonCache *cache);
+
+/** Doubles the number of buckets once there are more entries than buckets.
+ *
+ *  @param cache  The cache, must be locked.
+ *
+ *  Failing to grow is not an error, the chains just get longer.
+ */
+static void grow_buckets(NewtonCache *cache);
+
+
+NewtonCache *newton_cache_create(size_t capacity) {
+	NewtonCache *cache = malloc(sizeof(NewtonCache));
+	if (!cache) {
+		status_report("Memory error: could not allocate function cache.\n");
+		return NULL;
+	}
+	*cache = (NewtonCache){
+		.buckets      = calloc(INITIAL_BUCKETS, sizeof(struct newton_cache_entry *)),
+		.bucket_count = INITIAL_BUCKETS,
+		.newest       = NULL,
+		.oldest       = NULL,
+		.capacity     = capacity,
+		.statistics   = {0, 0, 0, 0, 0},
+	};
+	if (!cache->buckets) {
+		status_report("Memory error: could not allocate function cache.\n");
+		free(cache);
+		return NULL;
+	}
+	if (pthread_mutex_init(&cache->lock, NULL) != 0) {
+		status_report("Error: could not create lock of function cache.\n");
+		free(cache->buckets);
+		free(cache);
+		return NULL;
+	}
+	return cache;
+}
+
+void newton_cache_destroy(NewtonCache *cache) {
+	if (!cache) {return;}
+	while (cache->oldest) {evict_oldest(cache);}
+	pthread_mutex_destroy(&cache->lock);
+	free(cache->buckets);
+	free(cache);
+}
+
+NewtonFunction *newton_cache_lookup(NewtonCache *cache, const char *const source, int *error) {
+	NewtonFunction *function = NULL;
+	struct newton_cache_entry *entry;
+
+	if (error) {*error = 0;}
+	char *key = normalise(source);
+	if (!key) {
+		if (error) {*error = 1;}
+		return NULL;
+	}
+	uint64_t hash = vm_cartridge_hash(key);
+
+	pthread_mutex_lock(&cache->lock);
+	entry = find_entry(cache, key, hash);
+	if (entry) {
+		++cache->statistics.hits;
+		unlink_entry(cache, entry);
+		push_front(cache, entry);
+		function = newton_function_retain(entry->function);
+	} else {
+		++cache->statistics.misses;
+	}
+	pthread_mutex_unlock(&cache->lock);
+
+	if (function) {
+		free(key);
+		return function;
+	}
+
+	/* Compile without holding the lock. */
+	function = newton_function_compile(key, error);
+	if (!function) {
+		free(key);
+		return NULL;
+	}
+
+	entry = malloc(sizeof(struct newton_cache_entry));
+	if (!entry) {
+		/* The function works all the same, it is just not cached. */
+		free(key);
+		return function;
+	}
+	*entry = (struct newton_cache_entry){
+		.key      = key,
+		.hash     = hash,
+		.size     = sizeof *entry + strlen(key) + 1 + newton_function_size(function),
+		.function = function,
+		.next     = NULL,
+		.newer    = NULL,
+		.older    = NULL,
+	};
+	if (entry->size > cache->capacity) {
+		free(entry->key);
+		free(entry);
+		return function;
+	}
+
+	pthread_mutex_lock(&cache->lock);
+	struct newton_cache_entry *other = find_entry(cache, key, hash);
+	if (other) {
+		/* Another thread has compiled the same function in the meantime. */
+		unlink_entry(cache, other);
+		push_front(cache, other);
+		NewtonFunction *shared = newton_function_retain(other->function);
+		pthread_mutex_unlock(&cache->lock);
+		newton_function_destroy(function);
+		free(entry->key);
+		free(entry);
+		return shared;
+	}
+
+	while (cache->statistics.memory + entry->size > cache->capacity) {evict_oldest(cache);}
+	grow_buckets(cache);
+	size_t bucket = entry->hash & (cache->bucket_count - 1);
+	entry->next = cache->buckets[bucket];
+	cache->buckets[bucket] = entry;
+	push_front(cache, entry);
+	++cache->statistics.entries;
+	cache->statistics.memory += entry->size;
+
+	/* One reference for the cache, one for the caller. */
+	newton_function_retain(function);
+	pthread_mutex_unlock(&cache->lock);
+
+	return function;
+}
+
+NewtonCacheStatistics newton_cache_statistics(NewtonCache *cache) {
+	pthread_mutex_lock(&cache->lock);
+	NewtonCacheStatistics statistics = cache->statistics;
+	pthread_mutex_unlock(&cache->lock);
+	return statistics;
+}
+
+static char *normalise(const char *source) {
+	#define IS_WORD(c)  (isalnum((unsigned char)(c)) || (c) == '.')
+
+	char *key = malloc(strlen(source) + 1);
+	if (!key) {
+		status_report("Memory error: could not normalise function string.\n");
+		return NULL;
+	}
+
+	size_t length = 0;
+	for (const char *c = source; *c; ++c) {
+		if (!isspace((unsigned char)*c)) {
+			key[length++] = *c;
+			continue;
+		}
+		/* Skip the entire run of white space. */
+		while (isspace((unsigned char)c[1])) {++c;}
+		if (length > 0 && IS_WORD(key[length - 1]) && IS_WORD(c[1])) {key[length++] = ' ';}
+	}
+	key[length] = '\0';
+	return key;
+
+	#undef IS_WORD
+}
+
+static struct newton_cache_entry *find_entry(const NewtonCache *cache, const char *key, uint64_t hash) {
+	struct newton_cache_entry *entry = cache->buckets[hash & (cache->bucket_count - 1)];
+	while (entry && !(entry->hash == hash && strcmp(entry->key, key) == 0)) {
+		entry = entry->next;
+	}
+	return entry;
+}
+
+static void push_front(NewtonCache *cache, struct newton_cache_entry *entry) {
+	entry->newer = NULL;
+	entry->older = cache->newest;
+	if (cache->newest) {cache->newest->newer = entry;}
+	cache->newest = entry;
+	if (!cache->oldest) {cache->oldest = entry;}
+}
+
+static void unlink_entry(NewtonCache *cache, struct newton_cache_entry *entry) {
+	if (entry->newer) {entry->newer->older = entry->older;} else {cache->newest = entry->older;}
+	if (entry->older) {entry->older->newer = entry->newer;} else {cache->oldest = entry->newer;}
+	entry->newer = entry->older = NULL;
+}
+
+static void evict_oldest(NewtonCache *cache) {
+	struct newton_cache_entry *entry = cache->oldest;
+	unlink_entry(cache, entry);
+
+	struct newton_cache_entry **link = &cache->buckets[entry->hash & (cache->bucket_count - 1)];
+	while (*link != entry) {link = &(*link)->next;}
+	*link = entry->next;
+
+	++cache->statistics.evictions;
+	--cache->statistics.entries;
+	cache->statistics.memory -= entry->size;
+
+	newton_function_destroy(entry->function);
+	free(entry->key);
+	free(entry);
+}
+
+static void grow_buckets(NewtonCache *cache) {
+	if (cache->statistics.entries < cache->bucket_count) {return;}
+
+	size_t bucket_count = 2 * cache->bucket_count;
+	struct newton_cache_entry **buckets = calloc(bucket_count, sizeof(struct newton_cache_entry *));
+	if (!buckets) {return;}
+
+	for (size_t i = 0; i < cache->bucket_count; ++i) {
+		struct newton_cache_entry *entry = cache->buckets[i];
+		while (entry) {
+			struct newton_cache_entry *next = entry->next;
+			size_t bucket = entry->hash & (bucket_count - 1);
+			entry->next = buckets[bucket];
+			buckets[bucket] = entry;
+			entry = next;
+		}
+	}
+	free(cache->buckets);
+	cache->buckets      = buckets;
+	cache->bucket_count = bucket_count;
+}
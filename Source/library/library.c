@@ -0,0 +1,481 @@
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "library.h"
+#include "../compiler/compiler.h"
+#include "../method/method.h"
+#include "../syntax_node/syntax_node.h"
+#include "../syntax_node/syntax_node_table.h"
+#include "../virtual_machine/vm.h"
+#include "../virtual_machine/vm_code.h"
+#include "../status/status.h"
+
+/** Compiled function and derivative.
+ *
+ *  All the members are written once by `newton_function_compile` and only
+ *  read afterwards, except for the number of references which is protected by
+ *  the lock. If the bytecode could be translated to native code the native
+ *  code is used for solving, otherwise the virtual machine.
+ */
+struct newton_function {
+	char        *source;            /**< Copy of the source code.         */
+	VMCode       function;          /**< Bytecode of the function.        */
+	VMCode       derivative;        /**< Bytecode of the derivative.      */
+	VMNativeCode native_function;   /**< Native function, if available.   */
+	VMNativeCode native_derivative; /**< Native derivative, if available. */
+	double      *coefficients;      /**< Coefficients of a polynomial.    */
+	size_t       degree;            /**< Degree of a polynomial.          */
+	size_t          references;     /**< Number of owners of the handle.  */
+	pthread_mutex_t lock;           /**< Protects the references.         */
+};
+
+/** Editor of a function.
+ *
+ *  The table and the memo keep the nodes and the bytecode of all versions of
+ *  the function, until they grow beyond `EDITOR_MEMORY` and are started over.
+ *  The arena only holds the syntax tree of the latest source.
+ */
+struct newton_editor {
+	SyntaxNodeTable     table; /**< Unique nodes of all versions.       */
+	CompilerBackendMemo memo;  /**< Bytecode of the nodes of the table. */
+	SyntaxNodeArena     arena; /**< Syntax tree of the latest source.   */
+};
+
+/** Memory of the table and the memo of an editor beyond which they are
+ *  started over, in bytes.
+ */
+#define EDITOR_MEMORY  (32 * 1024 * 1024)
+
+/** Compiled system of functions.
+ *
+ *  There is no code for the Jacobian, its rows are the gradients of the
+ *  functions, which are computed by reverse-mode differentiation.
+ */
+struct newton_system {
+	size_t  count; /**< Number of functions and variables. */
+	VMCode *code;  /**< Code of every function.            */
+};
+
+/** Allocates a new handle without any code.
+ *
+ *  @param source  Source code of the function, it is copied.
+ *
+ *  @return  The handle, `NULL` on failure.
+ */
+static NewtonFunction *new_function(const char *const source);
+
+/** Compiles the rest of a handle from its simplified function.
+ *
+ *  @param function  Handle with the bytecode of the function and derivative.
+ *  @param tree      Simplified syntax tree of the function.
+ *
+ *  @return  0 on success, non-0 on error.
+ *
+ *  Polynomials get their coefficients, and the bytecode is translated to
+ *  native code if possible.
+ */
+static int finish_function(NewtonFunction *function, const SyntaxNode *tree);
+
+/** Frees a handle and everything it owns, regardless of its references.
+ *
+ *  @param function  The handle to free.
+ */
+static void free_function(NewtonFunction *function);
+
+/** Checks that a function only uses the variables of a system.
+ *
+ *  @param tree   Syntax tree of the function.
+ *  @param count  Number of variables of the system.
+ *
+ *  @return  0 if all variables are among x1 to x(count), non-0 otherwise.
+ */
+static int check_variables(const SyntaxNode *tree, size_t count);
+
+/** Checks that a function is a single function, not one of a system.
+ *
+ *  @param tree  Syntax tree of the function.
+ *
+ *  @return  0 if it only uses the variable x, non-0 otherwise.
+ */
+static int check_single(const SyntaxNode *tree);
+
+/** Compiles a syntax tree and moves the code into a handle.
+ *
+ *  @param tree  The tree to compile.
+ *  @param code  Code of the handle to store the code in.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int compile_tree(const SyntaxNode *tree, VMCode *code);
+
+
+NewtonFunction *newton_function_compile(const char *const source, int *error) {
+	int exit_status = 0; /* No error. */
+
+	SyntaxNodeArena arena;           /* All nodes of the trees.  */
+	SyntaxNode *function_tree = NULL;
+	SyntaxNode *derivative_tree;
+
+	syntax_node_arena_init(&arena, 0);
+
+	NewtonFunction *function = new_function(source);
+	if (!function) {exit_status = 1; goto end;}
+
+	if (compiler_frontend_arena(source, &arena, &function_tree) != 0) {
+		exit_status = 1;
+		goto end;
+	}
+	if ((exit_status = check_single(function_tree)) != 0) {goto end;}
+	syntax_node_arena_simplify(&arena, function_tree);
+
+	derivative_tree = syntax_node_arena_derive(&arena, function_tree);
+	if (!derivative_tree) {exit_status = 1; goto end;}
+	syntax_node_arena_simplify(&arena, derivative_tree);
+
+	exit_status = compile_tree(function_tree, &function->function);
+	if (exit_status != 0) {goto end;}
+	exit_status = compile_tree(derivative_tree, &function->derivative);
+	if (exit_status != 0) {goto end;}
+
+	exit_status = finish_function(function, function_tree);
+
+end:
+	syntax_node_arena_release(&arena);
+	if (exit_status != 0 && function) {
+		free_function(function);
+		function = NULL;
+	}
+	if (error) {*error = exit_status;}
+	return function;
+}
+
+NewtonEditor *newton_editor_create(void) {
+	NewtonEditor *editor = malloc(sizeof(NewtonEditor));
+	if (!editor) {
+		status_report("Memory error: could not allocate editor.\n");
+		return NULL;
+	}
+	if (syntax_node_table_init(&editor->table) != 0) {
+		free(editor);
+		return NULL;
+	}
+	compiler_backend_memo_init(&editor->memo);
+	syntax_node_arena_init(&editor->arena, 0);
+	return editor;
+}
+
+void newton_editor_destroy(NewtonEditor *editor) {
+	if (!editor) {return;}
+	compiler_backend_memo_clear(&editor->memo);
+	syntax_node_table_release(&editor->table);
+	syntax_node_arena_release(&editor->arena);
+	free(editor);
+}
+
+NewtonFunction *newton_editor_compile(NewtonEditor *editor, const char *const source, int *error) {
+	int exit_status = 0; /* No error. */
+	NewtonFunction *function = NULL;
+	SyntaxNode     *tree     = NULL;
+	VMCode         *code     = NULL;
+
+	/* Start over once the old versions take up too much memory. The memo
+	 * knows the nodes by address, it must go along with the table. */
+	if (editor->memo.size + editor->table.count * sizeof(SyntaxNode) > EDITOR_MEMORY) {
+		compiler_backend_memo_clear(&editor->memo);
+		syntax_node_table_release(&editor->table);
+		if (syntax_node_table_init(&editor->table) != 0) {exit_status = 1; goto end;}
+	}
+	syntax_node_arena_reset(&editor->arena);
+
+	function = new_function(source);
+	if (!function) {exit_status = 1; goto end;}
+
+	if (compiler_frontend_arena(source, &editor->arena, &tree) != 0) {
+		exit_status = 1;
+		goto end;
+	}
+	if ((exit_status = check_single(tree)) != 0) {goto end;}
+	/* Unchanged parts of the tree are the same nodes as in earlier versions,
+	 * their simplified form and derivative are known already. */
+	SyntaxNode *function_graph = syntax_node_table_simplify(&editor->table, syntax_node_table_import(&editor->table, tree));
+	if (!function_graph) {exit_status = 1; goto end;}
+	SyntaxNode *derivative_graph = syntax_node_table_simplify(&editor->table, syntax_node_table_derive(&editor->table, function_graph));
+	if (!derivative_graph) {exit_status = 1; goto end;}
+
+	if ((exit_status = compiler_backend_memoised(function_graph, &editor->memo, &code)) != 0) {goto end;}
+	function->function = *code;
+	free(code);
+	code = NULL;
+	if ((exit_status = compiler_backend_memoised(derivative_graph, &editor->memo, &code)) != 0) {goto end;}
+	function->derivative = *code;
+	free(code);
+
+	exit_status = finish_function(function, function_graph);
+
+end:
+	if (exit_status != 0 && function) {
+		free_function(function);
+		function = NULL;
+	}
+	if (error) {*error = exit_status;}
+	return function;
+}
+
+NewtonFunction *newton_function_retain(NewtonFunction *function) {
+	pthread_mutex_lock(&function->lock);
+	++function->references;
+	pthread_mutex_unlock(&function->lock);
+	return function;
+}
+
+void newton_function_destroy(NewtonFunction *function) {
+	if (!function) {return;}
+
+	pthread_mutex_lock(&function->lock);
+	size_t references = --function->references;
+	pthread_mutex_unlock(&function->lock);
+
+	if (references == 0) {free_function(function);}
+}
+
+size_t newton_function_size(const NewtonFunction *function) {
+	return sizeof *function
+	     + strlen(function->source) + 1
+	     + function->function.capacity
+	     + function->derivative.capacity
+	     + function->native_function.size
+	     + function->native_derivative.size
+	     + (function->coefficients ? (function->degree + 1) * sizeof(double) : 0);
+}
+
+static NewtonFunction *new_function(const char *const source) {
+	NewtonFunction *function = malloc(sizeof(NewtonFunction));
+	if (!function) {
+		status_report("Memory error: could not allocate function handle.\n");
+		return NULL;
+	}
+	*function = (NewtonFunction){
+		.source     = malloc(strlen(source) + 1),
+		.function   = {.length = 0, .capacity = 0, .depth = 0, .code = NULL},
+		.derivative = {.length = 0, .capacity = 0, .depth = 0, .code = NULL},
+		.native_function   = {.memory = NULL, .size = 0, .function = NULL},
+		.native_derivative = {.memory = NULL, .size = 0, .function = NULL},
+		.coefficients = NULL,
+		.degree       = 0,
+		.references = 1,
+	};
+	if (pthread_mutex_init(&function->lock, NULL) != 0) {
+		status_report("Error: could not create lock of function handle.\n");
+		free(function->source);
+		free(function);
+		return NULL;
+	}
+	if (!function->source) {
+		status_report("Memory error: could not copy function source.\n");
+		free_function(function);
+		return NULL;
+	}
+	strcpy(function->source, source);
+	return function;
+}
+
+static int finish_function(NewtonFunction *function, const SyntaxNode *tree) {
+	/* Expanded polynomials are evaluated by Horner's scheme instead of the
+	 * code, factored ones would lose their accuracy near the roots. */
+	double coefficients[POLYNOMIAL_MAX_DEGREE + 1];
+	if (syntax_node_is_expanded(tree) && syntax_node_polynomial(tree, coefficients, &function->degree) == 0) {
+		function->coefficients = malloc((function->degree + 1) * sizeof(double));
+		if (!function->coefficients) {
+			status_report("Memory error: could not allocate the coefficients.\n");
+			return 1;
+		}
+		memcpy(function->coefficients, coefficients, (function->degree + 1) * sizeof(double));
+	}
+
+	/* Native code is optional, only use it if both parts can be translated. */
+	if (compiler_backend_native(function->function  , &function->native_function  ) != 0 ||
+	    compiler_backend_native(function->derivative, &function->native_derivative) != 0) {
+		vm_native_code_clear(&function->native_function);
+		vm_native_code_clear(&function->native_derivative);
+	}
+	return 0;
+}
+
+static void free_function(NewtonFunction *function) {
+	pthread_mutex_destroy(&function->lock);
+	vm_code_clear(&function->function);
+	vm_code_clear(&function->derivative);
+	vm_native_code_clear(&function->native_function);
+	vm_native_code_clear(&function->native_derivative);
+	free(function->coefficients);
+	free(function->source);
+	free(function);
+}
+
+const char *newton_function_source(const NewtonFunction *function) {
+	return function->source;
+}
+
+int newton_function_evaluate(const NewtonFunction *function, double x, double *value, double *derivative) {
+	int error = 0; /* No error. */
+	double result;
+
+	if (function->coefficients) {
+		double p, d;
+		method_polynomial_evaluate(function->coefficients, function->degree, x, &p, &d);
+		if (value     ) {*value      = p;}
+		if (derivative) {*derivative = d;}
+		return error;
+	}
+	if (function->native_function.function) {
+		if (value     ) {*value      = function->native_function.function(x);}
+		if (derivative) {*derivative = function->native_derivative.function(x);}
+		return error;
+	}
+
+	VirtualMachine machine = {.code = function->function, .reg_x = x};
+	if (value) {
+		if ((error = machine_execute(&machine, &result)) != 0) {return error;}
+		*value = result;
+	}
+	if (derivative) {
+		machine_load_code(&machine, function->derivative);
+		if ((error = machine_execute(&machine, &result)) != 0) {return error;}
+		*derivative = result;
+	}
+	return error;
+}
+
+double newton_function_solve(const NewtonFunction *function, double guess, int *error) {
+	if (function->coefficients) {
+		return method_iterate_polynomial(function->coefficients, function->degree, guess, error, 0);
+	}
+	if (function->native_function.function) {
+		return method_iterate_native(function->native_function.function, function->native_derivative.function, guess, error, 0);
+	}
+	return method_iterate(function->function, function->derivative, guess, error, 0);
+}
+
+void newton_function_solve_batch(const NewtonFunction *function, const double *guesses, double *roots, int *errors, size_t count) {
+	if (function->coefficients || function->native_function.function) {
+		for (size_t i = 0; i < count; ++i) {
+			int error;
+			roots[i] = newton_function_solve(function, guesses[i], &error);
+			if (errors) {errors[i] = error;}
+		}
+		return;
+	}
+	method_iterate_batch(function->function, function->derivative, guesses, roots, errors, count);
+}
+
+double *newton_function_search(const NewtonFunction *function, double lower, double upper, size_t seeds, size_t threads, double tolerance, size_t *count, int *error) {
+	return method_search(function->function, lower, upper, seeds, threads, tolerance, count, error);
+}
+
+NewtonSystem *newton_system_compile(const char *const *sources, size_t count, int *error) {
+	int exit_status = 0; /* No error. */
+
+	SyntaxNodeArena arena; /* All nodes of the trees. */
+	syntax_node_arena_init(&arena, 0);
+
+	NewtonSystem *system = NULL;
+	if (count == 0 || count > MAX_VARIABLES) {
+		status_report("Error: a system must have between 1 and %i functions.\n", MAX_VARIABLES);
+		exit_status = 1;
+		goto end;
+	}
+	system = malloc(sizeof(NewtonSystem));
+	if (!system) {
+		status_report("Memory error: could not allocate system handle.\n");
+		exit_status = 1;
+		goto end;
+	}
+	*system = (NewtonSystem){
+		.count = count,
+		.code  = calloc(count, sizeof(VMCode)),
+	};
+	if (!system->code) {
+		status_report("Memory error: could not allocate system code.\n");
+		exit_status = 1;
+		goto end;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		SyntaxNode *function_tree = NULL;
+		if (compiler_frontend_arena(sources[i], &arena, &function_tree) != 0) {
+			exit_status = 1;
+			goto end;
+		}
+		if (check_variables(function_tree, count) != 0) {
+			status_report("Error: function %zu of the system may only use the variables x1 to x%zu.\n", i + 1, count);
+			exit_status = 1;
+			goto end;
+		}
+		syntax_node_arena_simplify(&arena, function_tree);
+		if ((exit_status = compile_tree(function_tree, &system->code[i])) != 0) {goto end;}
+		/* The tree is compiled, its nodes can go. */
+		syntax_node_arena_reset(&arena);
+	}
+
+end:
+	syntax_node_arena_release(&arena);
+	if (exit_status != 0) {
+		newton_system_destroy(system);
+		system = NULL;
+	}
+	if (error) {*error = exit_status;}
+	return system;
+}
+
+void newton_system_destroy(NewtonSystem *system) {
+	if (!system) {return;}
+	if (system->code) {
+		for (size_t i = 0; i < system->count; ++i) {
+			vm_code_clear(&system->code[i]);
+		}
+	}
+	free(system->code);
+	free(system);
+}
+
+size_t newton_system_count(const NewtonSystem *system) {
+	return system->count;
+}
+
+double newton_system_solve(const NewtonSystem *system, double *x, int *error) {
+	MethodOptions options = method_default_options;
+	options.solver = METHOD_DAMPED;
+	return method_solve_system(system->code, NULL, system->count, x, &options, error);
+}
+
+static int check_variables(const SyntaxNode *tree, size_t count) {
+	if (tree->operator_value == OP_X_VAR) {
+		return tree->numeric_value >= 1 && tree->numeric_value <= count ? 0 : 1;
+	}
+	for (int i = 0; i < tree->arity; ++i) {
+		if (check_variables(tree->operand[i], count) != 0) {return 1;}
+	}
+	return 0;
+}
+
+static int check_single(const SyntaxNode *tree) {
+	if (syntax_node_uses_indexed_variables(tree)) {
+		status_report("Error: indexed variables need a system of functions.\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int compile_tree(const SyntaxNode *tree, VMCode *code) {
+	VMCode *compiled = NULL;
+	if (compiler_backend(tree, &compiled) != 0) {return 1;}
+
+	/* The code is embedded into the handle, only the wrapper goes. */
+	*code = *compiled;
+	free(compiled);
+	return 0;
+}
@@ -0,0 +1,375 @@
+#ifndef NEWTON_LIBRARY_H
+#define NEWTON_LIBRARY_H
+
+/** @file library.h
+ *
+ *  Public interface of the Newton library.
+ *
+ *  This is the interface for programs which embed Newton's method instead of
+ *  running the command-line program. A function is compiled once into a
+ *  handle, which holds the bytecode of both the function and its derivative.
+ *  The handle can then be evaluated and solved as often as needed without
+ *  ever running the compiler again.
+ *
+ *  A handle is never changed after it has been compiled, and every
+ *  evaluation runs on its own virtual machine. This makes all functions
+ *  reentrant, and any number of threads can share the same handle without
+ *  locking. Handles are reference counted, so several owners can share one
+ *  handle and it is only destroyed when the last one lets go of it.
+ *
+ *  A cache of handles keeps the most recently used functions around, so that
+ *  the same function string is compiled only once. An editor compiles one
+ *  function which keeps changing, reusing what has not changed. A pool solves
+ *  functions on threads of its own, without blocking the caller.
+ *
+ *  Functions which fail return an error code and print a message to the
+ *  standard error. A thread which has attached a status of *status/status.h*
+ *  gets the message recorded in its status instead, so that concurrent callers
+ *  can tell their errors apart.
+ *
+ *  To build the library run `make lib`, which produces `libnewton.a`.
+ */
+
+#include <stddef.h>
+
+/** Opaque handle of a compiled function.
+ *
+ *  @sa newton_function_compile, newton_function_destroy
+ */
+typedef struct newton_function NewtonFunction;
+
+/** Compiles a function into a new handle.
+ *
+ *  @param source  Source code of the function, like for the command-line
+ *                 program.
+ *  @param error   Pointer to store an error code in, 0 on success.
+ *
+ *  @return  The handle, owned by the caller, `NULL` on failure.
+ *
+ *  The function is parsed, simplified, derived and compiled to bytecode. The
+ *  source string is copied, it does not need to outlive the handle. The only
+ *  variable of a function is x, indexed variables like x1 are an error; they
+ *  belong to systems, see `newton_system_compile`.
+ */
+NewtonFunction *newton_function_compile(const char *const source, int *error);
+
+/** Adds an owner to a handle.
+ *
+ *  @param function  The handle to share.
+ *
+ *  @return  The same handle, which must be destroyed one more time.
+ */
+NewtonFunction *newton_function_retain(NewtonFunction *function);
+
+/** Destroys a handle.
+ *
+ *  @param function  The handle to destroy, may be `NULL`.
+ *
+ *  This removes one owner of the handle, the handle itself is only destroyed
+ *  when the last owner destroys it.
+ */
+void newton_function_destroy(NewtonFunction *function);
+
+/** Memory used by a handle.
+ *
+ *  @param function  The handle of the function.
+ *
+ *  @return  Number of bytes of the handle, its source and its code.
+ */
+size_t newton_function_size(const NewtonFunction *function);
+
+/** Source code of a function.
+ *
+ *  @param function  The handle of the function.
+ *
+ *  @return  The source code the handle has been compiled from.
+ */
+const char *newton_function_source(const NewtonFunction *function);
+
+/** Evaluates a function and its derivative.
+ *
+ *  @param function    The handle of the function.
+ *  @param x           Value of the variable.
+ *  @param value       Pointer to store the function value in, or `NULL`.
+ *  @param derivative  Pointer to store the derivative in, or `NULL`.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+int newton_function_evaluate(const NewtonFunction *function, double x, double *value, double *derivative);
+
+/** Finds a root of a function using Newton's method.
+ *
+ *  @param function  The handle of the function.
+ *  @param guess     Starting value of the method.
+ *  @param error     Pointer to store an error code in, 0 on success.
+ *
+ *  @return  Approximation of the root.
+ *
+ *  @sa method_iterate
+ */
+double newton_function_solve(const NewtonFunction *function, double guess, int *error);
+
+/** Finds roots of a function from many guesses.
+ *
+ *  @param function  The handle of the function.
+ *  @param guesses   Starting values of the method, `count` of them.
+ *  @param roots     Array to store the approximations in, may be `guesses`.
+ *  @param errors    Array to store the error codes in, may be `NULL`.
+ *  @param count     Number of guesses.
+ *
+ *  Each result is the same as that of `newton_function_solve` for its guess.
+ *  A function which runs on the virtual machine is solved from all guesses in
+ *  lockstep on the batched machine; native code and polynomials are faster one
+ *  guess at a time.
+ *
+ *  @sa method_iterate_batch
+ */
+void newton_function_solve_batch(const NewtonFunction *function, const double *guesses, double *roots, int *errors, size_t count);
+
+/** Finds all roots of a function in an interval.
+ *
+ *  @param function   The handle of the function.
+ *  @param lower      Lower bound of the interval.
+ *  @param upper      Upper bound of the interval.
+ *  @param seeds      Number of starting values.
+ *  @param threads    Number of threads to distribute the seeds over.
+ *  @param tolerance  Roots closer than this are considered the same root.
+ *  @param count      Pointer to store the number of distinct roots in.
+ *  @param error      Pointer to store an error code in, 0 on success.
+ *
+ *  @return  Array of the distinct roots in ascending order, owned by the
+ *           caller. `NULL` if no root has been found or an error occurred.
+ *
+ *  @sa method_search
+ */
+double *newton_function_search(const NewtonFunction *function, double lower, double upper, size_t seeds, size_t threads, double tolerance, size_t *count, int *error);
+
+/** Opaque handle of an editor of a function.
+ *
+ *  Programs which compile a function again after every little change, like
+ *  an interactive program on every key stroke, can pass every version to the
+ *  same editor. The editor remembers the simplified form, the derivative and
+ *  the bytecode of every part of the function it has seen, and only the parts
+ *  which have been edited are simplified, derived and compiled anew. An
+ *  editor must not be used by several threads at once, but the handles it
+ *  returns are ordinary function handles.
+ *
+ *  @sa newton_editor_create, newton_editor_destroy, newton_editor_compile
+ */
+typedef struct newton_editor NewtonEditor;
+
+/** Creates a new editor.
+ *
+ *  @return  The editor, owned by the caller, `NULL` on failure.
+ */
+NewtonEditor *newton_editor_create(void);
+
+/** Destroys an editor.
+ *
+ *  @param editor  The editor to destroy, may be `NULL`.
+ *
+ *  Handles which have been compiled by the editor stay valid.
+ */
+void newton_editor_destroy(NewtonEditor *editor);
+
+/** Compiles the latest version of a function into a new handle.
+ *
+ *  @param editor  The editor of the function.
+ *  @param source  Source code of the function.
+ *  @param error   Pointer to store an error code in, 0 on success.
+ *
+ *  @return  The handle, owned by the caller, `NULL` on failure.
+ *
+ *  The handle behaves exactly like one from `newton_function_compile`, only
+ *  the unchanged parts of the function are not compiled again. The source
+ *  does not need to be related to the earlier versions at all.
+ */
+NewtonFunction *newton_editor_compile(NewtonEditor *editor, const char *const source, int *error);
+
+/** Opaque handle of a compiled system of functions.
+ *
+ *  @sa newton_system_compile, newton_system_destroy
+ */
+typedef struct newton_system NewtonSystem;
+
+/** Compiles a system of functions into a new handle.
+ *
+ *  @param sources  Source code of the functions, in the variables x1 to xn
+ *                  where n is the number of functions.
+ *  @param count    Number of functions.
+ *  @param error    Pointer to store an error code in, 0 on success.
+ *
+ *  @return  The handle, owned by the caller, `NULL` on failure.
+ *
+ *  Every function is parsed, simplified and compiled. There is no need to
+ *  derive the functions, the Jacobian matrix is computed alongside the
+ *  functions when solving. A function which uses the plain variable x or a
+ *  variable beyond xn is an error. Like a function handle a
+ *  system handle is never changed after it has been compiled.
+ */
+NewtonSystem *newton_system_compile(const char *const *sources, size_t count, int *error);
+
+/** Destroys a system handle.
+ *
+ *  @param system  The handle to destroy, may be `NULL`.
+ */
+void newton_system_destroy(NewtonSystem *system);
+
+/** Number of functions and variables of a system.
+ *
+ *  @param system  The handle of the system.
+ *
+ *  @return  The number of functions.
+ */
+size_t newton_system_count(const NewtonSystem *system);
+
+/** Finds a root of a system using Newton's method.
+ *
+ *  @param system  The handle of the system.
+ *  @param x       The starting values of the variables, overwritten by the
+ *                 approximation of the root.
+ *  @param error   Pointer to store an error code in, 0 on success.
+ *
+ *  @return  Largest absolute value of the functions at the approximation.
+ *
+ *  The steps are damped, every step is halved until it reduces the largest
+ *  function value.
+ *
+ *  @sa method_solve_system
+ */
+double newton_system_solve(const NewtonSystem *system, double *x, int *error);
+
+/** Cache of compiled functions.
+ *
+ *  The cache maps function strings to handles and keeps the least recently
+ *  used functions out once the memory of all handles exceeds its capacity.
+ *  Function strings which only differ in white space are the same entry. All
+ *  functions of a cache can be called from any number of threads at once.
+ *
+ *  @sa newton_cache_create, newton_cache_destroy
+ */
+typedef struct newton_cache NewtonCache;
+
+/** Counters of a cache. */
+typedef struct newton_cache_statistics {
+	size_t hits;      /**< Number of lookups which found their function. */
+	size_t misses;    /**< Number of lookups which had to compile.       */
+	size_t evictions; /**< Number of functions evicted from the cache.   */
+	size_t entries;   /**< Number of functions in the cache.             */
+	size_t memory;    /**< Memory used by the functions in bytes.        */
+} NewtonCacheStatistics;
+
+/** Creates a new empty cache.
+ *
+ *  @param capacity  Maximum amount of memory of the functions in bytes.
+ *
+ *  @return  The cache, owned by the caller, `NULL` on failure.
+ */
+NewtonCache *newton_cache_create(size_t capacity);
+
+/** Destroys a cache.
+ *
+ *  @param cache  The cache to destroy, may be `NULL`.
+ *
+ *  Handles which have been returned by the cache stay valid until their
+ *  owners destroy them.
+ */
+void newton_cache_destroy(NewtonCache *cache);
+
+/** Looks up a function, compiling it if it is not in the cache.
+ *
+ *  @param cache   The cache to look in.
+ *  @param source  Source code of the function.
+ *  @param error   Pointer to store an error code in, 0 on success.
+ *
+ *  @return  Handle of the function, `NULL` on failure. The caller becomes an
+ *           owner of the handle and must destroy it when done.
+ *
+ *  Compilation happens outside the lock of the cache, other threads can keep
+ *  using the cache in the meantime. A function which is larger than the
+ *  entire capacity is compiled but not kept.
+ */
+NewtonFunction *newton_cache_lookup(NewtonCache *cache, const char *const source, int *error);
+
+/** Reads the counters of a cache.
+ *
+ *  @param cache  The cache.
+ *
+ *  @return  Copy of the counters.
+ */
+NewtonCacheStatistics newton_cache_statistics(NewtonCache *cache);
+
+/** Pool of threads which solve functions in the background.
+ *
+ *  Jobs are submitted to a queue of fixed capacity and solved by a fixed
+ *  number of worker threads, the result of every job is passed to a callback.
+ *  Any number of threads can submit jobs at once. Consecutive jobs of the same
+ *  function are solved together by `newton_function_solve_batch`.
+ *
+ *  @sa newton_pool_create, newton_pool_destroy, newton_pool_submit
+ */
+typedef struct newton_pool NewtonPool;
+
+/** Receives the result of a job of a pool.
+ *
+ *  @param context  The context passed along with the job.
+ *  @param root     Approximation of the root.
+ *  @param error    Error code of the solve, 0 on success.
+ *
+ *  The callback is called on a worker thread of the pool. It must not block
+ *  for long, the worker solves no further jobs in the meantime.
+ */
+typedef void (*NewtonCallback)(void *context, double root, int error);
+
+/** Error code of `newton_pool_submit` if the queue of the pool is full. */
+#define NEWTON_POOL_FULL  1
+
+/** Creates a new pool and starts its threads.
+ *
+ *  @param threads   Number of worker threads, at least one.
+ *  @param capacity  Number of jobs the queue can hold, at least one.
+ *
+ *  @return  The pool, owned by the caller, `NULL` on failure.
+ */
+NewtonPool *newton_pool_create(size_t threads, size_t capacity);
+
+/** Destroys a pool.
+ *
+ *  @param pool  The pool to destroy, may be `NULL`.
+ *
+ *  The jobs still in the queue are solved and their callbacks called before
+ *  the threads stop. No more jobs may be submitted once destruction has begun.
+ */
+void newton_pool_destroy(NewtonPool *pool);
+
+/** Submits a job to a pool.
+ *
+ *  @param pool      The pool.
+ *  @param function  The handle of the function, the pool keeps it alive until
+ *                   the job is done.
+ *  @param guess     Starting value of the method.
+ *  @param callback  Function to receive the result.
+ *  @param context   Passed on to the callback.
+ *  @param wait      Whether to wait for room if the queue is full.
+ *
+ *  @return  0 if the job has been queued, `NEWTON_POOL_FULL` if the queue is
+ *           full and `wait` is 0.
+ *
+ *  A full queue is how the pool pushes back: a caller which cannot afford to
+ *  block passes 0 for `wait` and gets to decide what to do with the job, like
+ *  rejecting the request which it came from. The error code passed to the
+ *  callback is that of `newton_function_solve`, messages of failed jobs are
+ *  not printed.
+ */
+int newton_pool_submit(NewtonPool *pool, NewtonFunction *function, double guess, NewtonCallback callback, void *context, int wait);
+
+/** Waits until a pool has no more jobs.
+ *
+ *  @param pool  The pool.
+ *
+ *  Returns once the queue is empty and the callbacks of all jobs have
+ *  returned. Jobs submitted in the meantime are waited for as well.
+ */
+void newton_pool_wait(NewtonPool *pool);
+
+#endif /* NEWTON_LIBRARY_H */
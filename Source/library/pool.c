@@ -0,0 +1,212 @@
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "library.h"
+#include "../virtual_machine/vm.h"
+#include "../status/status.h"
+
+/* Pool:
+ *
+ * The queue is a ring buffer of fixed capacity under one lock, with one
+ * condition for workers waiting for jobs and one for submitters waiting for
+ * room. Any number of threads can submit and any number of workers take jobs
+ * out, the lock is only held to move jobs in and out of the ring, never while
+ * solving.
+ *
+ * A worker takes the job at the head of the queue along with all the jobs
+ * right behind it which have the same function, up to `VM_LANES` of them, and
+ * solves them in one call of `newton_function_solve_batch`. Requests for the
+ * same function tend to come in bursts, and a burst is then solved together
+ * on the batched machine. Jobs are never taken out of order, so a burst which
+ * is interleaved with other functions is solved in smaller batches.
+ *
+ * Every queued job owns a reference of its function, which the worker drops
+ * once the callback has returned.
+ */
+
+/** Job waiting in the queue of a pool. */
+struct newton_job {
+	NewtonFunction *function; /**< Function to solve, one reference.  */
+	double          guess;    /**< Starting value of the method.      */
+	NewtonCallback  callback; /**< Receives the result.               */
+	void           *context;  /**< Passed on to the callback.         */
+};
+
+struct newton_pool {
+	pthread_mutex_t lock;       /**< Protects everything below.          */
+	pthread_cond_t  jobs_ready; /**< Signalled when jobs are queued.     */
+	pthread_cond_t  room_ready; /**< Signalled when jobs are taken out.  */
+	pthread_cond_t  idle;       /**< Signalled when all jobs are done.   */
+	struct newton_job *queue;   /**< Ring buffer of the jobs.            */
+	size_t capacity;            /**< Number of slots of the ring.        */
+	size_t head;                /**< Slot of the oldest job.             */
+	size_t queued;              /**< Number of jobs in the ring.         */
+	size_t running;             /**< Jobs taken out but not yet done.    */
+	int    stopping;            /**< Set once the pool is destroyed.     */
+	pthread_t *threads;         /**< The worker threads.                 */
+	size_t     thread_count;    /**< Number of worker threads.           */
+};
+
+/** Entry point of the worker threads.
+ *
+ *  @param argument  Pointer to the pool.
+ *
+ *  @return  Always NULL.
+ */
+static void *work(void *argument);
+
+/** Stops the workers and waits for them to finish.
+ *
+ *  @param pool     The pool.
+ *  @param started  Number of workers which have been started.
+ */
+static void stop_workers(NewtonPool *pool, size_t started);
+
+
+NewtonPool *newton_pool_create(size_t threads, size_t capacity) {
+	if (threads == 0 || capacity == 0) {
+		status_report("Error: a pool needs at least one thread and one slot.\n");
+		return NULL;
+	}
+	NewtonPool *pool = malloc(sizeof(NewtonPool));
+	if (!pool) {
+		status_report("Memory error: could not allocate pool.\n");
+		return NULL;
+	}
+	*pool = (NewtonPool){
+		.queue        = malloc(capacity * sizeof(struct newton_job)),
+		.capacity     = capacity,
+		.head         = 0,
+		.queued       = 0,
+		.running      = 0,
+		.stopping     = 0,
+		.threads      = malloc(threads * sizeof(pthread_t)),
+		.thread_count = threads,
+	};
+	if (!pool->queue || !pool->threads) {
+		status_report("Memory error: could not allocate pool.\n");
+		goto error;
+	}
+	if (pthread_mutex_init(&pool->lock, NULL) != 0) {
+		status_report("Error: could not create lock of pool.\n");
+		goto error;
+	}
+	pthread_cond_init(&pool->jobs_ready, NULL);
+	pthread_cond_init(&pool->room_ready, NULL);
+	pthread_cond_init(&pool->idle      , NULL);
+
+	for (size_t t = 0; t < threads; ++t) {
+		if (pthread_create(&pool->threads[t], NULL, work, pool) != 0) {
+			status_report("Error: could not start thread %zu of pool.\n", t);
+			stop_workers(pool, t);
+			goto error;
+		}
+	}
+	return pool;
+
+error:
+	free(pool->threads);
+	free(pool->queue);
+	free(pool);
+	return NULL;
+}
+
+void newton_pool_destroy(NewtonPool *pool) {
+	if (!pool) {return;}
+	stop_workers(pool, pool->thread_count);
+	free(pool->threads);
+	free(pool->queue);
+	free(pool);
+}
+
+int newton_pool_submit(NewtonPool *pool, NewtonFunction *function, double guess, NewtonCallback callback, void *context, int wait) {
+	pthread_mutex_lock(&pool->lock);
+	while (pool->queued == pool->capacity) {
+		if (!wait) {
+			pthread_mutex_unlock(&pool->lock);
+			return NEWTON_POOL_FULL;
+		}
+		pthread_cond_wait(&pool->room_ready, &pool->lock);
+	}
+	pool->queue[(pool->head + pool->queued) % pool->capacity] = (struct newton_job){
+		.function = newton_function_retain(function),
+		.guess    = guess,
+		.callback = callback,
+		.context  = context,
+	};
+	++pool->queued;
+	pthread_cond_signal(&pool->jobs_ready);
+	pthread_mutex_unlock(&pool->lock);
+	return 0;
+}
+
+void newton_pool_wait(NewtonPool *pool) {
+	pthread_mutex_lock(&pool->lock);
+	while (pool->queued > 0 || pool->running > 0) {
+		pthread_cond_wait(&pool->idle, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static void *work(void *argument) {
+	NewtonPool *pool = argument;
+	struct newton_job jobs[VM_LANES]; /* Jobs taken out of the queue.   */
+	double guesses[VM_LANES], roots[VM_LANES];
+	int    errors[VM_LANES];
+
+	/* The callbacks get the error codes, the messages are dropped. */
+	NewtonStatus status = {.errors = 0};
+	status_attach(&status);
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;) {
+		while (pool->queued == 0 && !pool->stopping) {
+			pthread_cond_wait(&pool->jobs_ready, &pool->lock);
+		}
+		if (pool->queued == 0) {break;}
+
+		/* The head of the queue and the jobs for its function behind it. */
+		size_t count = 0;
+		do {
+			jobs[count++] = pool->queue[pool->head];
+			pool->head = (pool->head + 1) % pool->capacity;
+			--pool->queued;
+		} while (count < VM_LANES && pool->queued > 0 && pool->queue[pool->head].function == jobs[0].function);
+		pool->running += count;
+		pthread_cond_broadcast(&pool->room_ready);
+		pthread_mutex_unlock(&pool->lock);
+
+		for (size_t i = 0; i < count; ++i) {guesses[i] = jobs[i].guess;}
+		newton_function_solve_batch(jobs[0].function, guesses, roots, errors, count);
+		status_reset(&status);
+		for (size_t i = 0; i < count; ++i) {
+			jobs[i].callback(jobs[i].context, roots[i], errors[i]);
+			newton_function_destroy(jobs[i].function);
+		}
+
+		pthread_mutex_lock(&pool->lock);
+		pool->running -= count;
+		if (pool->queued == 0 && pool->running == 0) {pthread_cond_broadcast(&pool->idle);}
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	status_attach(NULL);
+	return NULL;
+}
+
+static void stop_workers(NewtonPool *pool, size_t started) {
+	pthread_mutex_lock(&pool->lock);
+	pool->stopping = 1;
+	pthread_cond_broadcast(&pool->jobs_ready);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (size_t t = 0; t < started; ++t) {pthread_join(pool->threads[t], NULL);}
+
+	pthread_cond_destroy(&pool->jobs_ready);
+	pthread_cond_destroy(&pool->room_ready);
+	pthread_cond_destroy(&pool->idle);
+	pthread_mutex_destroy(&pool->lock);
+}
@@ -1,10 +1,17 @@
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
+#include <float.h>
+#include <pthread.h>
 
 #include "method.h"
 #include "../virtual_machine/vm.h"
 #include "../virtual_machine/vm_code.h"
 #include "../syntax_node/syntax_node.h"
+#include "../statistics/statistics.h"
+#include "../status/status.h"
 
 /** Maximum amount of iterations before giving up.
  *
@@ -22,22 +29,245 @@
  */
 #define EPSILON  0.0000001
 
+/** Number of seeds a search thread takes off the queue at once.
+ *
+ *  Small chunks keep the threads busy until the very end of the search even
+ *  if some seeds take much longer than others, large chunks mean fewer trips
+ *  to the queue.
+ */
+#define SEARCH_CHUNK  8
+
+/** Maximum number of times the damped method halves a step.
+ *
+ *  After that many halvings the step is taken even if it does not reduce the
+ *  function value, the search has then run into the round-off of the function.
+ */
+#define MAX_HALVINGS  30
+
+/** Relative size of a derivative below which it counts as zero.
+ *
+ *  A derivative is considered zero if the step it yields is more than this
+ *  many times larger than the approximation itself; such a step throws the
+ *  method so far away that it is lost anyway.
+ */
+#define FLAT_RATIO  1e10
+
+/** Ratio of steps which marks a 2-cycle.
+ *
+ *  If the approximation returns to within this fraction of the last step of
+ *  where it was two steps ago it is going back and forth.
+ */
+#define CYCLE_RATIO  1e-3
+
+/** Number of steps in a row which have to look like a 2-cycle. */
+#define CYCLE_STEPS  2
+
+/** Number of steps in a row which have to grow both |x| and |f| before the
+ *  method is considered to diverge.
+ */
+#define BLOWUP_STEPS  6
+
+/** Number of values from which on the batched machine is faster than
+ *  executing the values one at a time.
+ *
+ *  A chunk of arithmetic costs about as much as 8 to 12 values one at a time,
+ *  with calls of libm it is more, those are not vectorised.
+ */
+#define BATCH_MIN  16
+
+/** Size of a step in float, relative to the approximation, at which the
+ *  method has stalled.
+ *
+ *  A step of a few units in the last place of float is all round-off, the
+ *  approximation does not get any better in float.
+ */
+#define STALL_RATIO  (4 * FLT_EPSILON)
+
+/** Observer of the iterations of Newton's method.
+ *
+ *  The watch is fed every approximation along with its function value and
+ *  derivative and looks out for hopeless cases: values which are no longer
+ *  finite, a derivative too flat to give a meaningful step, an approximation
+ *  which alternates between two points, and an approximation which runs off
+ *  to infinity while the function value keeps growing. None of these ever
+ *  converge, so there is no point in going through the remaining iterations.
+ */
+struct watch {
+	double x_1;    /**< x_{n-1}                                   */
+	double x_2;    /**< x_{n-2}                                   */
+	double f_1;    /**< |f(x_{n-1})|                              */
+	int    steps;  /**< Number of approximations observed.       */
+	int    cycles; /**< Steps in a row that look like a 2-cycle. */
+	int    growth; /**< Steps in a row that grow |x| and |f|.    */
+};
+
+/** Initial state of a watch. */
+#define WATCH_INIT  {.x_1 = 0, .x_2 = 0, .f_1 = 0, .steps = 0, .cycles = 0, .growth = 0}
+
+/** Observes one step of Newton's method.
+ *
+ *  @param watch  The watch.
+ *  @param x_n    The current approximation.
+ *  @param f_xn   Function value of the approximation.
+ *  @param d_xn   Derivative of the approximation.
+ *
+ *  @return  0 if the method may go on, otherwise the reason to give up.
+ */
+static int watch_step(struct watch *watch, double x_n, double f_xn, double d_xn);
+
+/** Prints why Newton's method has failed to the standard error.
+ *
+ *  @param failure     Error code of the method, VM errors are not printed.
+ *  @param iterations  Number of iterations passed.
+ *  @param x_n         The last approximation.
+ *  @param f_xn        Function value of the last approximation.
+ */
+static void report_failure(int failure, int iterations, double x_n, double f_xn);
+
+/** State of a multi-start search shared between all threads.
+ *
+ *  Seeds are handed out from a common queue: an idle thread locks the queue,
+ *  takes the next chunk of seeds and releases is again. Seeds that diverge run
+ *  through all iterations and take much longer than seeds that converge, this
+ *  way no thread sits idle while another one is still stuck with a long list
+ *  of slow seeds.
+ *
+ *  Only the seeds which survive pruning are queued, the results are stored by
+ *  position in the queue.
+ */
+struct search {
+	VMCode function; /**< VM code of the function, shared read-only.  */
+	double lower;    /**< Lower bound of the interval.                */
+	double upper;    /**< Upper bound of the interval.                */
+	double first;    /**< The first seed.                             */
+	double step;     /**< Distance between two neighbouring seeds.    */
+	size_t seeds;    /**< Total number of seeds.                      */
+
+	size_t *queue;   /**< Indices of the seeds to run.                */
+	size_t  queued;  /**< Number of seeds in the queue.               */
+
+	pthread_mutex_t lock; /**< Protects the queue.                    */
+	size_t          next; /**< Position of the next seed in the queue. */
+
+	double *roots;   /**< Result for every queued seed.               */
+	int    *status;  /**< Exit status for every queued seed, 0 if converged. */
+};
+
+/** Queues the seeds whose cells may contain a root.
+ *
+ *  @param search   The search, the seeds are appended to its queue.
+ *  @param machine  Machine with the function code loaded.
+ *  @param first    Index of the first seed of a range.
+ *  @param last     Index one past the last seed of the range.
+ *
+ *  Every seed owns the cell of all points closer to it than to any other seed.
+ *  If interval arithmetic proves that the function has no root on the union
+ *  of the cells of the range, all its seeds are dropped; otherwise the range
+ *  is halved until single seeds are left. The search is a bisection, ranges
+ *  without roots are dropped after a few evaluations, and a long interval with
+ *  only a few roots costs a number of evaluations proportional to the roots
+ *  times the logarithm of the seeds rather than to the seeds.
+ */
+static void prune_seeds(struct search *search, VirtualMachine *machine, size_t first, size_t last);
+
+/** Runs Newton's method on dual numbers without reporting failure.
+ *
+ *  @param machine     Machine with the function code and initial guess loaded.
+ *  @param f_xn        Pointer to store the last function value in.
+ *  @param iterations  Pointer to store the number of iterations in.
+ *  @param print       Whether to print the individual steps.
+ *
+ *  @return  0 if the method converged, the reason of its failure or the VM
+ *           error otherwise. The approximation remains in the X register.
+ */
+static int iterate_fused(VirtualMachine *machine, double *f_xn, int *iterations, int print);
+
+/** Entry point of the search threads.
+ *
+ *  @param argument  Pointer to the shared search state.
+ *
+ *  @return  Always NULL.
+ */
+static void *search_thread(void *argument);
+
+/** Evaluates a piece of code at a point.
+ *
+ *  @param machine  Machine to execute the code on.
+ *  @param code     The code.
+ *  @param x        Value of the variable.
+ *  @param result   Pointer to store the result in.
+ *
+ *  @return  0 on success, the VM error otherwise.
+ */
+static int evaluate(VirtualMachine *machine, VMCode code, double x, double *result);
+
+/** Evaluates a piece of code at many points.
+ *
+ *  @param code    The code.
+ *  @param x       Values of the variable, `count` of them.
+ *  @param result  Array to store the results in.
+ *  @param count   Number of values, at most `VM_LANES`.
+ *
+ *  @return  0 on success, the VM error otherwise.
+ *
+ *  The batched machine always computes a whole chunk of lanes, fewer than
+ *  `BATCH_MIN` values are cheaper to execute one at a time. Both machines
+ *  compute the same results.
+ */
+static int evaluate_batch(VMCode code, const double *x, double *result, size_t count);
+
+/** Evaluates a piece of code of float precision at many points.
+ *
+ *  Same as `evaluate_batch` on the float machines.
+ */
+static int evaluate_batch_float(VMCode code, const float *x, float *result, size_t count);
+
+/** Merges the roots of a search which belong to the same root.
+ *
+ *  @param machine    Machine with the code of the function loaded.
+ *  @param roots      The roots in ascending order, overwritten by the merged
+ *                    ones.
+ *  @param count      Number of roots.
+ *  @param tolerance  Roots closer than this are the same root.
+ *
+ *  @return  Number of merged roots.
+ *
+ *  Newton's method stops once |f| < EPSILON, which leaves a root of higher
+ *  multiplicity anywhere in the flat stretch around it, far more than the
+ *  tolerance apart from seed to seed. Neighbouring roots are therefore also
+ *  the same root if the function is within EPSILON halfway between them.
+ *  Of every group of merged roots and the points halfway between them the
+ *  one with the smallest |f| is kept.
+ */
+static size_t merge_roots(VirtualMachine *machine, double *roots, size_t count, double tolerance);
+
+/** Compare function for sorting numbers in ascending order. */
+static int compare_doubles(const void *a, const void *b);
+
 double method_iterate(VMCode function, VMCode derivative, double guess, int *error, int print) {
-	VirtualMachine machine = {.code = {.length = 0, .capacity = 0, .code = NULL}, .reg_x = guess};
+	VirtualMachine machine = {.code = {.length = 0, .capacity = 0, .depth = 0, .code = NULL}, .reg_x = guess};
 
 	double f_xn, d_xn, x_n_1; /* f(x_n) and f'(x_n), x_{n-1}  */
 	int    iterations  = 0;   /* Number of iterations passed. */
 	int    exit_status = 0;   /* No error.                    */
+	struct watch watch = WATCH_INIT;
+
+	STATISTICS(NewtonStatistics *statistics = statistics_current(); uint64_t cycles;)
 
 	do {
 		machine_load_code(&machine, function);
+		STATISTICS(if (statistics) {cycles = statistics_cycles();})
 		if((exit_status = machine_execute(&machine, &f_xn)) != 0) {goto end;}
+		STATISTICS(if (statistics) {statistics->function_cycles += statistics_cycles() - cycles;})
 		if (print) {x_n_1 = machine.reg_x;}
 
 		if (fabs(f_xn) < EPSILON) {goto end;}
 
 		machine_load_code(&machine, derivative);
+		STATISTICS(if (statistics) {cycles = statistics_cycles();})
 		if((exit_status = machine_execute(&machine, &d_xn)) != 0) {goto end;}
+		STATISTICS(if (statistics) {statistics->derivative_cycles += statistics_cycles() - cycles;})
+		if ((exit_status = watch_step(&watch, machine.reg_x, f_xn, d_xn)) != 0) {break;}
 
 		machine.reg_x = machine.reg_x - f_xn / d_xn;
 		if (print) {
@@ -47,14 +277,618 @@ double method_iterate(VMCode function, VMCode derivative, double guess, int *err
 
 		++iterations;
 	} while (iterations < MAX_ITERATIONS);
-	fprintf(stderr, "Error: could not find a suitable result, aborting. \n"
-	        "  After %i iterations the best result is %.4f with"
-	        "  a function value of %.4f.\n", iterations, machine.reg_x, f_xn
-	);
-	exit_status = -1;
+	if (exit_status == 0) {exit_status = METHOD_EXHAUSTED;}
+	report_failure(exit_status, iterations, machine.reg_x, f_xn);
 
 end:
+	STATISTICS(statistics_count_solve(statistics, iterations, exit_status);)
+	if (error) {*error = exit_status;}
+	return machine.reg_x;
+}
+
+
+
+double method_iterate_native(VMNativeFunction function, VMNativeFunction derivative, double guess, int *error, int print) {
+	double x_n = guess;     /* x_n         */
+	double f_xn, d_xn;      /* f(x_n) and f'(x_n) */
+	int    iterations  = 0; /* Number of iterations passed. */
+	int    exit_status = 0; /* No error.                    */
+	struct watch watch = WATCH_INIT;
+
+	STATISTICS(NewtonStatistics *statistics = statistics_current(); uint64_t cycles;)
+
+	do {
+		STATISTICS(if (statistics) {cycles = statistics_cycles();})
+		f_xn = function(x_n);
+		STATISTICS(if (statistics) {statistics->function_cycles += statistics_cycles() - cycles;})
+		if (fabs(f_xn) < EPSILON) {goto end;}
+
+		STATISTICS(if (statistics) {cycles = statistics_cycles();})
+		d_xn = derivative(x_n);
+		STATISTICS(if (statistics) {statistics->derivative_cycles += statistics_cycles() - cycles;})
+		if ((exit_status = watch_step(&watch, x_n, f_xn, d_xn)) != 0) {break;}
+		if (print) {
+			printf("%3i: % .3f = % .3f - % .3f / % .3f; ", iterations, x_n - f_xn / d_xn, x_n, f_xn, d_xn);
+			printf("\n");
+		}
+		x_n = x_n - f_xn / d_xn;
+
+		++iterations;
+	} while (iterations < MAX_ITERATIONS);
+	if (exit_status == 0) {exit_status = METHOD_EXHAUSTED;}
+	report_failure(exit_status, iterations, x_n, f_xn);
+
+end:
+	STATISTICS(statistics_count_solve(statistics, iterations, exit_status);)
+	if (error) {*error = exit_status;}
+	return x_n;
+}
+
+void method_iterate_batch(VMCode function, VMCode derivative, const double *guesses, double *roots, int *errors, size_t count) {
+	STATISTICS(NewtonStatistics *statistics = statistics_current(); uint64_t cycles;)
+
+	for (size_t first = 0; first < count; first += VM_LANES) {
+		size_t lanes = count - first < VM_LANES ? count - first : VM_LANES;
+		double x[VM_LANES], f[VM_LANES], d[VM_LANES]; /* Of the running guesses.   */
+		size_t lane[VM_LANES];         /* Guess of every running one.      */
+		int    status[VM_LANES];       /* Exit status of every guess.      */
+		struct watch watch[VM_LANES];  /* Watch of every guess.            */
+		size_t running    = lanes;     /* Number of guesses still running. */
+		int    iterations = 0;         /* Number of iterations passed.     */
+		int    vm_error   = 0;         /* Error of the virtual machine.    */
+
+		for (size_t i = 0; i < lanes; ++i) {
+			x[i] = roots[first + i] = guesses[first + i];
+			lane[i]   = i;
+			status[i] = METHOD_EXHAUSTED;
+			watch[i]  = (struct watch)WATCH_INIT;
+		}
+
+		while (running > 0 && iterations < MAX_ITERATIONS) {
+			STATISTICS(if (statistics) {cycles = statistics_cycles();})
+			if ((vm_error = evaluate_batch(function, x, f, running)) != 0) {break;}
+			STATISTICS(if (statistics) {statistics->function_cycles += statistics_cycles() - cycles;})
+
+			/* Converged guesses drop out, the others move to the front. */
+			size_t kept = 0;
+			for (size_t k = 0; k < running; ++k) {
+				if (fabs(f[k]) < EPSILON) {
+					status[lane[k]] = 0;
+					STATISTICS(statistics_count_solve(statistics, iterations, 0);)
+					continue;
+				}
+				x[kept] = x[k]; f[kept] = f[k]; lane[kept] = lane[k];
+				++kept;
+			}
+			if ((running = kept) == 0) {break;}
+
+			STATISTICS(if (statistics) {cycles = statistics_cycles();})
+			if ((vm_error = evaluate_batch(derivative, x, d, running)) != 0) {break;}
+			STATISTICS(if (statistics) {statistics->derivative_cycles += statistics_cycles() - cycles;})
+
+			/* Hopeless guesses drop out, the others take their step. */
+			kept = 0;
+			for (size_t k = 0; k < running; ++k) {
+				int failure = watch_step(&watch[lane[k]], x[k], f[k], d[k]);
+				if (failure != 0) {
+					status[lane[k]] = failure;
+					report_failure(failure, iterations, x[k], f[k]);
+					STATISTICS(statistics_count_solve(statistics, iterations, failure);)
+					continue;
+				}
+				x[kept] = x[k] - f[k] / d[k]; f[kept] = f[k]; lane[kept] = lane[k];
+				roots[first + lane[kept]] = x[kept];
+				++kept;
+			}
+			running = kept;
+			++iterations;
+		}
+
+		/* Whatever is still running has failed the same way. */
+		for (size_t k = 0; k < running; ++k) {
+			if (vm_error != 0) {
+				status[lane[k]] = vm_error;
+			} else {
+				report_failure(METHOD_EXHAUSTED, iterations, x[k], f[k]);
+			}
+			STATISTICS(statistics_count_solve(statistics, iterations, status[lane[k]]);)
+		}
+		if (errors) {
+			for (size_t i = 0; i < lanes; ++i) {errors[first + i] = status[i];}
+		}
+	}
+}
+
+void method_iterate_mixed(VMCode function, VMCode derivative, VMCode function_float, VMCode derivative_float, const double *guesses, double *roots, int *errors, size_t count) {
+	for (size_t first = 0; first < count; first += VM_FLOAT_LANES) {
+		size_t lanes = count - first < VM_FLOAT_LANES ? count - first : VM_FLOAT_LANES;
+		float  x[VM_FLOAT_LANES], f[VM_FLOAT_LANES], d[VM_FLOAT_LANES]; /* Of the running guesses. */
+		size_t lane[VM_FLOAT_LANES];         /* Guess of every running one.       */
+		int    status[VM_FLOAT_LANES];       /* Failure in float, 0 to refine.    */
+		struct watch watch[VM_FLOAT_LANES];  /* Watch of every guess.             */
+		size_t running = lanes;              /* Number of guesses still in float. */
+
+		/* Until a guess leaves float its root is the original guess. */
+		for (size_t i = 0; i < lanes; ++i) {
+			roots[first + i] = guesses[first + i];
+			x[i]      = (float)guesses[first + i];
+			lane[i]   = i;
+			status[i] = 0;
+			watch[i]  = (struct watch)WATCH_INIT;
+		}
+
+		int iterations = 0; /* Number of iterations passed in float. */
+		int vm_error   = 0; /* Error of the float machine.         */
+		for (; running > 0 && iterations < MAX_ITERATIONS; ++iterations) {
+			if ((vm_error = evaluate_batch_float(function_float, x, f, running)) != 0) {break;}
+
+			/* Guesses which have converged leave float. */
+			size_t kept = 0;
+			for (size_t k = 0; k < running; ++k) {
+				if (fabsf(f[k]) < EPSILON) {continue;}
+				x[kept] = x[k]; f[kept] = f[k]; lane[kept] = lane[k];
+				++kept;
+			}
+			if ((running = kept) == 0) {break;}
+			if ((vm_error = evaluate_batch_float(derivative_float, x, d, running)) != 0) {break;}
+
+			/* So do guesses which have stalled or left the range of float. A
+			 * cycle or divergence is not a matter of precision, those fail. */
+			kept = 0;
+			for (size_t k = 0; k < running; ++k) {
+				float step    = f[k] / d[k];
+				int   failure = watch_step(&watch[lane[k]], x[k], f[k], d[k]);
+				if (failure == METHOD_CYCLE || failure == METHOD_DIVERGED) {
+					status[lane[k]] = failure;
+					report_failure(failure, iterations, x[k], f[k]);
+					continue;
+				}
+				if (failure != 0 || !isfinite(x[k] - step) || fabsf(step) <= STALL_RATIO * fabsf(x[k])) {continue;}
+				roots[first + lane[k]] = x[kept] = x[k] - step;
+				lane[kept] = lane[k];
+				++kept;
+			}
+			running = kept;
+		}
+		/* Guesses which are still going after all iterations do not converge
+		 * in double either. After an error the double machine has its say. */
+		for (size_t k = 0; k < running && vm_error == 0; ++k) {
+			status[lane[k]] = METHOD_EXHAUSTED;
+			report_failure(METHOD_EXHAUSTED, iterations, x[k], f[k]);
+		}
+
+		/* The last approximation in float is the guess of the refinement. */
+		double refined[VM_FLOAT_LANES];
+		int    refined_errors[VM_FLOAT_LANES];
+		size_t refining = 0;
+		for (size_t i = 0; i < lanes; ++i) {
+			if (status[i] == 0) {lane[refining] = i; refined[refining++] = roots[first + i];}
+		}
+		method_iterate_batch(function, derivative, refined, refined, refined_errors, refining);
+		for (size_t k = 0; k < refining; ++k) {
+			roots[first + lane[k]] = refined[k];
+			status[lane[k]] = refined_errors[k];
+		}
+		if (errors) {
+			for (size_t i = 0; i < lanes; ++i) {errors[first + i] = status[i];}
+		}
+	}
+}
+
+double method_iterate_fused(VMCode function, double guess, int *error, int print) {
+	VirtualMachine machine = {.code = function, .reg_x = guess};
+
+	double f_xn;            /* f(x_n)                       */
+	int    iterations;      /* Number of iterations passed. */
+	int    exit_status = 0; /* No error.                    */
+
+	exit_status = iterate_fused(&machine, &f_xn, &iterations, print);
+	report_failure(exit_status, iterations, machine.reg_x, f_xn);
+
 	if (error) {*error = exit_status;}
 	return machine.reg_x;
 }
 
+double method_iterate_polynomial(const double *coefficients, size_t degree, double guess, int *error, int print) {
+	double x_n = guess;     /* x_n                          */
+	double f_xn, d_xn;      /* f(x_n), f'(x_n)              */
+	int    iterations  = 0; /* Number of iterations passed. */
+	int    exit_status = 0; /* No error.                    */
+	struct watch watch = WATCH_INIT;
+
+	STATISTICS(NewtonStatistics *statistics = statistics_current();)
+
+	do {
+		method_polynomial_evaluate(coefficients, degree, x_n, &f_xn, &d_xn);
+
+		if (fabs(f_xn) < EPSILON) {goto end;}
+		if ((exit_status = watch_step(&watch, x_n, f_xn, d_xn)) != 0) {break;}
+
+		double x_n_1 = x_n; /* x_{n-1} */
+		x_n -= f_xn / d_xn;
+		if (print) {
+			printf("%3i: % .3f = % .3f - % .3f / % .3f; ", iterations, x_n, x_n_1, f_xn, d_xn);
+			printf("\n");
+		}
+
+		++iterations;
+	} while (iterations < MAX_ITERATIONS);
+	if (exit_status == 0) {exit_status = METHOD_EXHAUSTED;}
+	report_failure(exit_status, iterations, x_n, f_xn);
+
+end:
+	STATISTICS(statistics_count_solve(statistics, iterations, exit_status);)
+	if (error) {*error = exit_status;}
+	return x_n;
+}
+
+const MethodOptions method_default_options = {
+	.solver         = METHOD_NEWTON,
+	.f_tolerance    = EPSILON,
+	.x_tolerance    = 0,
+	.max_iterations = MAX_ITERATIONS,
+	.lower          = 0,
+	.upper          = 0,
+	.print          = 0,
+};
+
+double method_solve(VMCode function, VMCode derivative, VMCode second_derivative, double guess, const MethodOptions *options, int *error) {
+	VirtualMachine machine = {.code = function, .reg_x = guess};
+	const MethodOptions *o = options ? options : &method_default_options;
+
+	double x_n = guess;          /* x_n                                  */
+	double f_xn = NAN, d_xn;     /* f(x_n) and f'(x_n)                   */
+	double step = 0;             /* Last step, x_{n-1} - x_n             */
+	double lower = o->lower;     /* Bracket of the bracketed method,     */
+	double upper = o->upper;     /* the function at the lower bound      */
+	double f_lower = 0;          /* has the other sign than at the upper. */
+	double previous = upper - lower; /* Last step the bracket took.      */
+	int    iterations  = 0;      /* Number of iterations passed.         */
+	int    exit_status = 0;      /* No error.                            */
+	struct watch watch = WATCH_INIT;
+
+	STATISTICS(NewtonStatistics *statistics = statistics_current();)
+
+	if (o->solver == METHOD_HALLEY && second_derivative.length == 0) {
+		status_report("Error: Halley's method needs the second derivative.\n");
+		exit_status = 1;
+		goto end;
+	}
+	if (o->solver == METHOD_BRACKETED) {
+		double f_upper;
+		if ((exit_status = evaluate(&machine, function, lower, &f_lower)) != 0) {goto end;}
+		if ((exit_status = evaluate(&machine, function, upper, &f_upper)) != 0) {goto end;}
+		if (f_lower == 0) {x_n = lower; goto end;}
+		if (f_upper == 0) {x_n = upper; goto end;}
+		if (!(lower < upper) || !((f_lower < 0) != (f_upper < 0)) || isnan(f_lower) || isnan(f_upper)) {
+			status_report("Error: the function does not change its sign over [%f, %f].\n", lower, upper);
+			exit_status = 1;
+			goto end;
+		}
+		if (!(lower < x_n && x_n < upper)) {x_n = (lower + upper) / 2;}
+	}
+
+	if ((exit_status = evaluate(&machine, function, x_n, &f_xn)) != 0) {goto end;}
+	while (iterations < o->max_iterations) {
+		double x_n_1 = x_n; /* x_{n-1} */
+
+		if (fabs(f_xn) < o->f_tolerance) {goto end;}
+		if ((exit_status = evaluate(&machine, derivative, x_n, &d_xn)) != 0) {goto end;}
+		/* The bracket keeps the bracketed method safe, even from a flat derivative. */
+		if (o->solver != METHOD_BRACKETED && (exit_status = watch_step(&watch, x_n, f_xn, d_xn)) != 0) {break;}
+		step = f_xn / d_xn;
+
+		switch (o->solver) {
+		case METHOD_HALLEY: {
+			/* x - 2 f f' / (2 f'^2 - f f''), written in terms of the Newton step. */
+			double s_xn, denominator;
+			if ((exit_status = evaluate(&machine, second_derivative, x_n, &s_xn)) != 0) {goto end;}
+			denominator = 1 - step * s_xn / (2 * d_xn);
+			/* Where the correction breaks down fall back to the Newton step. */
+			if (denominator != 0 && isfinite(denominator)) {step /= denominator;}
+			x_n -= step;
+			if ((exit_status = evaluate(&machine, function, x_n, &f_xn)) != 0) {goto end;}
+			break;
+		}
+		case METHOD_DAMPED: {
+			double f_x = f_xn, lambda = 1;
+			for (int halvings = 0; ; ++halvings, lambda /= 2) {
+				x_n = x_n_1 - lambda * step;
+				if ((exit_status = evaluate(&machine, function, x_n, &f_xn)) != 0) {goto end;}
+				if ((isfinite(f_xn) && fabs(f_xn) < fabs(f_x)) || halvings == MAX_HALVINGS) {break;}
+			}
+			step *= lambda;
+			break;
+		}
+		case METHOD_BRACKETED:
+			x_n -= step;
+			/* Bisect if the Newton step leaves the bracket or does not shrink fast enough. */
+			if (!(lower < x_n && x_n < upper) || fabs(step) > fabs(previous) / 2) {
+				x_n = lower + (upper - lower) / 2;
+			}
+			/* Remember the step taken, not the Newton step proposed. */
+			step     = x_n_1 - x_n;
+			previous = step;
+			if ((exit_status = evaluate(&machine, function, x_n, &f_xn)) != 0) {goto end;}
+			if ((f_xn < 0) == (f_lower < 0)) {
+				lower   = x_n;
+				f_lower = f_xn;
+			} else {
+				upper = x_n;
+			}
+			break;
+		default:
+			x_n -= step;
+			if ((exit_status = evaluate(&machine, function, x_n, &f_xn)) != 0) {goto end;}
+			break;
+		}
+
+		if (o->print) {
+			printf("%3i: % .3f = % .3f - % .3f; ", iterations, x_n, x_n_1, step);
+			printf("\n");
+		}
+		++iterations;
+
+		if (isfinite(f_xn) && fabs(step) <= o->x_tolerance * (1 + fabs(x_n))) {goto end;}
+	}
+	if (exit_status == 0) {
+		if (fabs(f_xn) < o->f_tolerance) {goto end;}
+		exit_status = METHOD_EXHAUSTED;
+	}
+	report_failure(exit_status, iterations, x_n, f_xn);
+
+end:
+	STATISTICS(statistics_count_solve(statistics, iterations, exit_status);)
+	if (error) {*error = exit_status;}
+	return x_n;
+}
+
+double *method_search(VMCode function, double lower, double upper, size_t seeds, size_t threads, double tolerance, size_t *count, int *error) {
+	int exit_status = 0;   /* No error.                           */
+	double *roots   = NULL; /* Resulting roots, in ascending order. */
+	size_t  found   = 0;    /* Number of distinct roots found.      */
+
+	struct search search = {
+		.function = function,
+		.lower    = lower,
+		.upper    = upper,
+		.first    = seeds > 1 ? lower : (lower + upper) / 2,
+		.step     = seeds > 1 ? (upper - lower) / (seeds - 1) : 0,
+		.seeds    = seeds,
+		.queue    = malloc(seeds * sizeof(size_t)),
+		.queued   = 0,
+		.next     = 0,
+		.roots    = malloc(seeds * sizeof(double)),
+		.status   = malloc(seeds * sizeof(int)),
+	};
+	pthread_t *pool = malloc(threads * sizeof(pthread_t));
+	size_t     started = 0; /* Number of threads actually started. */
+
+	if (seeds == 0 || threads == 0 || !search.queue || !search.roots || !search.status || !pool) {
+		exit_status = 1;
+		goto end;
+	}
+	if (pthread_mutex_init(&search.lock, NULL) != 0) {
+		exit_status = 1;
+		goto end;
+	}
+
+	VirtualMachine machine = {.code = function};
+	prune_seeds(&search, &machine, 0, seeds);
+
+	for (; started < threads; ++started) {
+		if (pthread_create(&pool[started], NULL, search_thread, &search) != 0) {break;}
+	}
+	/* If not a single thread could be started do the work ourselves. */
+	if (started == 0) {search_thread(&search);}
+	for (size_t i = 0; i < started; ++i) {pthread_join(pool[i], NULL);}
+	pthread_mutex_destroy(&search.lock);
+
+	/* Keep only roots inside the interval, sorted, with duplicates merged. */
+	for (size_t i = 0; i < search.queued; ++i) {
+		double root = search.roots[i];
+		if (search.status[i] != 0 || root < lower || root > upper) {continue;}
+		search.roots[found++] = root;
+	}
+	qsort(search.roots, found, sizeof(double), compare_doubles);
+	found = merge_roots(&machine, search.roots, found, tolerance);
+	roots = search.roots;
+	search.roots = NULL;
+
+end:
+	free(search.queue);
+	free(search.roots);
+	free(search.status);
+	free(pool);
+	if (count) {*count = exit_status == 0 ? found : 0;}
+	if (error) {*error = exit_status;}
+	return roots;
+}
+
+static int iterate_fused(VirtualMachine *machine, double *f_xn, int *iterations_passed, int print) {
+	double d_xn, x_n_1;     /* f'(x_n), x_{n-1}             */
+	int    iterations  = 0; /* Number of iterations passed. */
+	int    exit_status = 0; /* No error.                    */
+	struct watch watch = WATCH_INIT;
+
+	/* Function and derivative are one evaluation, it counts as the function. */
+	STATISTICS(NewtonStatistics *statistics = statistics_current(); uint64_t cycles;)
+
+	do {
+		STATISTICS(if (statistics) {cycles = statistics_cycles();})
+		if((exit_status = machine_execute_dual(machine, f_xn, &d_xn)) != 0) {goto end;}
+		STATISTICS(if (statistics) {statistics->function_cycles += statistics_cycles() - cycles;})
+		if (print) {x_n_1 = machine->reg_x;}
+
+		if (fabs(*f_xn) < EPSILON) {goto end;}
+		if ((exit_status = watch_step(&watch, machine->reg_x, *f_xn, d_xn)) != 0) {goto end;}
+
+		machine->reg_x = machine->reg_x - *f_xn / d_xn;
+		if (print) {
+			printf("%3i: % .3f = % .3f - % .3f / % .3f; ", iterations, machine->reg_x, x_n_1, *f_xn, d_xn);
+			printf("\n");
+		}
+
+		++iterations;
+	} while (iterations < MAX_ITERATIONS);
+	exit_status = METHOD_EXHAUSTED;
+
+end:
+	STATISTICS(statistics_count_solve(statistics, iterations, exit_status);)
+	*iterations_passed = iterations;
+	return exit_status;
+}
+
+static void *search_thread(void *argument) {
+	struct search *search = argument;
+
+	for (;;) {
+		size_t first, last; /* Chunk of seeds taken off the queue. */
+
+		pthread_mutex_lock(&search->lock);
+		first = search->next;
+		last  = first + SEARCH_CHUNK < search->queued ? first + SEARCH_CHUNK : search->queued;
+		search->next = last;
+		pthread_mutex_unlock(&search->lock);
+
+		if (first >= last) {break;}
+
+		for (size_t i = first; i < last; ++i) {
+			double f_xn;
+			int    iterations;
+			VirtualMachine machine = {
+				.code  = search->function,
+				.reg_x = search->first + search->queue[i] * search->step,
+			};
+			search->status[i] = iterate_fused(&machine, &f_xn, &iterations, 0);
+			search->roots[i]  = machine.reg_x;
+		}
+	}
+
+	return NULL;
+}
+
+static void prune_seeds(struct search *search, VirtualMachine *machine, size_t first, size_t last) {
+	/* The cells end halfway between two seeds and at the bounds. */
+	VMInterval cell = {
+		.lower = first == 0             ? search->lower : search->first + (first - 0.5) * search->step,
+		.upper = last  == search->seeds ? search->upper : search->first + (last  - 0.5) * search->step,
+	};
+	VMInterval range;
+
+	/* If the function cannot be evaluated on intervals its seeds are kept. */
+	if (machine_execute_interval(machine, cell, &range) == 0 && (range.lower > 0 || range.upper < 0)) {return;}
+
+	if (last - first == 1) {
+		search->queue[search->queued++] = first;
+		return;
+	}
+	size_t middle = first + (last - first) / 2;
+	prune_seeds(search, machine, first , middle);
+	prune_seeds(search, machine, middle, last  );
+}
+
+const char *method_failure_to_string(int failure) {
+	switch (failure) {
+	case METHOD_EXHAUSTED : return "ran out of iterations";
+	case METHOD_NOT_FINITE: return "a value is not finite";
+	case METHOD_FLAT      : return "the derivative is zero";
+	case METHOD_CYCLE     : return "the steps go back and forth";
+	case METHOD_DIVERGED  : return "the approximation diverges";
+	default: return NULL;
+	}
+}
+
+static int watch_step(struct watch *watch, double x_n, double f_xn, double d_xn) {
+	if (!isfinite(x_n) || !isfinite(f_xn) || !isfinite(d_xn)) {return METHOD_NOT_FINITE;}
+	if (d_xn == 0 || fabs(f_xn) > FLAT_RATIO * fabs(d_xn) * (1 + fabs(x_n))) {return METHOD_FLAT;}
+
+	/* Back to where it was two steps ago, but not for lack of moving. */
+	if (watch->steps >= 2 && fabs(x_n - watch->x_2) < CYCLE_RATIO * fabs(x_n - watch->x_1)) {
+		if (++watch->cycles >= CYCLE_STEPS) {return METHOD_CYCLE;}
+	} else {
+		watch->cycles = 0;
+	}
+	if (watch->steps >= 1 && fabs(x_n) > 1 && fabs(x_n) > fabs(watch->x_1) && fabs(f_xn) >= watch->f_1) {
+		if (++watch->growth >= BLOWUP_STEPS) {return METHOD_DIVERGED;}
+	} else {
+		watch->growth = 0;
+	}
+
+	watch->x_2 = watch->x_1;
+	watch->x_1 = x_n;
+	watch->f_1 = fabs(f_xn);
+	++watch->steps;
+	return 0;
+}
+
+static void report_failure(int failure, int iterations, double x_n, double f_xn) {
+	const char *reason = method_failure_to_string(failure);
+	if (!reason) {return;}
+	status_report("Error: could not find a suitable result, %s, aborting. \n"
+	              "  After %i iterations the best result is %.4f with"
+	              "  a function value of %.4f.\n", reason, iterations, x_n, f_xn
+	);
+}
+
+static int evaluate(VirtualMachine *machine, VMCode code, double x, double *result) {
+	machine_load_code(machine, code);
+	machine->reg_x = x;
+	return machine_execute(machine, result);
+}
+
+static int evaluate_batch(VMCode code, const double *x, double *result, size_t count) {
+	if (count >= BATCH_MIN) {return machine_execute_batch(&code, x, result, count);}
+
+	VirtualMachine machine = {.code = code};
+	for (size_t i = 0; i < count; ++i) {
+		int error;
+		machine.reg_x = x[i];
+		if ((error = machine_execute(&machine, &result[i])) != 0) {return error;}
+	}
+	return 0;
+}
+
+static int evaluate_batch_float(VMCode code, const float *x, float *result, size_t count) {
+	if (count >= BATCH_MIN) {return machine_execute_batch_float(&code, x, result, count);}
+
+	for (size_t i = 0; i < count; ++i) {
+		int error;
+		if ((error = machine_execute_float(&code, x[i], &result[i])) != 0) {return error;}
+	}
+	return 0;
+}
+
+static size_t merge_roots(VirtualMachine *machine, double *roots, size_t count, double tolerance) {
+	size_t merged   = 0; /* Number of merged roots so far.           */
+	double best_f   = 0; /* |f| of the root kept for the group.      */
+	double previous = 0; /* Previous root, before it was overwritten. */
+
+	for (size_t i = 0; i < count; ++i) {
+		double root = roots[i], f_root, f_middle = NAN;
+		double middle = (previous + root) / 2;
+		machine->reg_x = root;
+		if (machine_execute(machine, &f_root) != 0) {f_root = NAN;}
+		if (i > 0) {
+			machine->reg_x = middle;
+			if (machine_execute(machine, &f_middle) != 0) {f_middle = NAN;}
+		}
+		int same = i > 0 && (root - previous <= tolerance || fabs(f_middle) < EPSILON);
+		previous = root;
+
+		/* A new group, unless both are close or flat in between. */
+		if (!same) {
+			roots[merged++] = root + 0.0; /* Adding 0 turns -0 into 0. */
+			best_f = fabs(f_root);
+			continue;
+		}
+		if (fabs(f_middle) < best_f) {roots[merged - 1] = middle + 0.0; best_f = fabs(f_middle);}
+		if (fabs(f_root)   < best_f) {roots[merged - 1] = root   + 0.0; best_f = fabs(f_root);}
+	}
+	return merged;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
@@ -4,6 +4,30 @@
 #include "../syntax_node/syntax_node.h"
 #include "../virtual_machine/vm_code.h"
 
+/** Reasons for Newton's method to fail.
+ *
+ *  These are the negative error codes of the methods, positive error codes are
+ *  errors of the virtual machine. Every method watches its steps and gives up
+ *  as soon as one of these becomes apparent instead of running through all
+ *  iterations.
+ */
+enum method_failure {
+	METHOD_EXHAUSTED  = -1, /**< Ran out of iterations.                   */
+	METHOD_NOT_FINITE = -2, /**< A value has become infinite or NaN.      */
+	METHOD_FLAT       = -3, /**< The derivative is zero or nearly so.     */
+	METHOD_CYCLE      = -4, /**< The steps go back and forth between two
+	                         *   points.                                  */
+	METHOD_DIVERGED   = -5, /**< The approximation grows without bound.   */
+};
+
+/** Describes the reason for a failure.
+ *
+ *  @param failure  Error code of a method.
+ *
+ *  @return  Short description, or `NULL` if the code is not a failure.
+ */
+const char *method_failure_to_string(int failure);
+
 /** Performs the iterative steps of Newton's method.
  *
  *  This is the heart of the algorithm. The function performs the iterative
@@ -21,5 +45,255 @@
  */
 double method_iterate(VMCode function, VMCode derivative, double guess, int *error, int print);
 
+/** Performs Newton's method on native code.
+ *
+ *  Same as `method_iterate`, except that the function and derivative are
+ *  native functions which are called directly instead of being executed by the
+ *  virtual machine.
+ *
+ *  @param function    Native function.
+ *  @param derivative  Native derivative.
+ *  @param guess       Starting value of the method.
+ *  @param error       Pointer to store an error code in.
+ *  @param print       Whether to print the individual steps.
+ *
+ *  @return  Approximation of the functions root according to Newton's method.
+ *
+ *  @sa compiler_backend_native
+ */
+double method_iterate_native(VMNativeFunction function, VMNativeFunction derivative, double guess, int *error, int print);
+
+/** Performs Newton's method from many guesses at once.
+ *
+ *  @param function    VM code of the function.
+ *  @param derivative  VM code of the derivative.
+ *  @param guesses     Starting values of the method, `count` of them.
+ *  @param roots       Array to store the approximations in, may be `guesses`.
+ *  @param errors      Array to store the error codes in, may be `NULL`.
+ *  @param count       Number of guesses.
+ *
+ *  Each result is the same as that of `method_iterate` for its guess, bit for
+ *  bit. The guesses are iterated in lockstep, `VM_LANES` at a time: every step
+ *  executes the function for all guesses which are still running in one call
+ *  of `machine_execute_batch`, then the derivative for those which have not
+ *  converged yet. Guesses which are done drop out of the batch.
+ *
+ *  @sa machine_execute_batch
+ */
+void method_iterate_batch(VMCode function, VMCode derivative, const double *guesses, double *roots, int *errors, size_t count);
+
+/** Performs Newton's method in float precision and refines the roots in
+ *  double.
+ *
+ *  @param function          VM code of the function.
+ *  @param derivative        VM code of the derivative.
+ *  @param function_float    Code of the function of precision `VM_FLOAT`.
+ *  @param derivative_float  Code of the derivative of precision `VM_FLOAT`.
+ *  @param guesses           Starting values of the method, `count` of them.
+ *  @param roots             Array to store the approximations in, may be
+ *                           `guesses`.
+ *  @param errors            Array to store the error codes in, may be `NULL`.
+ *  @param count             Number of guesses.
+ *
+ *  The guesses are iterated in lockstep on the batched float machine, twice
+ *  as many at once as on the double one, until the function value is within
+ *  the tolerance or a step no longer moves the approximation by more than a
+ *  few digits of float. `method_iterate_batch` then takes over from the last
+ *  approximation, which is usually one or two steps in double, so the roots
+ *  are as accurate as those of `method_iterate`. A guess which the float
+ *  steps find to cycle, to diverge or to need too many iterations is given up
+ *  in float already with that error code, and a guess which wanders about may
+ *  end up at a different root than in double alone.
+ *
+ *  @sa compiler_backend_precision, machine_execute_batch_float
+ */
+void method_iterate_mixed(VMCode function, VMCode derivative, VMCode function_float, VMCode derivative_float, const double *guesses, double *roots, int *errors, size_t count);
+
+/** Performs Newton's method using a single fused evaluation per step.
+ *
+ *  Same as `method_iterate`, except that no derivative code is needed. The
+ *  function is evaluated on dual numbers, which yields the value and the
+ *  derivative of the function in one pass over its code.
+ *
+ *  @param function  VM code of the function.
+ *  @param guess     Starting value of the method.
+ *  @param error     Pointer to store an error code in.
+ *  @param print     Whether to print the individual steps.
+ *
+ *  @return  Approximation of the functions root according to Newton's method.
+ *
+ *  @sa machine_execute_dual
+ */
+double method_iterate_fused(VMCode function, double guess, int *error, int print);
+
+/** Evaluates a polynomial and its derivative by Horner's scheme.
+ *
+ *  @param coefficients  Coefficients of the polynomial, the coefficient of
+ *                       `x^k` at index k.
+ *  @param degree        Degree of the polynomial.
+ *  @param x             Where to evaluate the polynomial.
+ *  @param value         Pointer to store the value in.
+ *  @param derivative    Pointer to store the derivative in.
+ *
+ *  Both come out of the same loop over the coefficients, one multiplication
+ *  and addition each per coefficient, without calling `pow`.
+ *
+ *  @sa syntax_node_polynomial
+ */
+void method_polynomial_evaluate(const double *coefficients, size_t degree, double x, double *value, double *derivative);
+
+/** Performs Newton's method on a polynomial.
+ *
+ *  Same as `method_iterate_fused`, except that the function is a polynomial
+ *  given by its coefficients, which is evaluated by Horner's scheme instead of
+ *  the virtual machine.
+ *
+ *  @param coefficients  Coefficients of the polynomial, the coefficient of
+ *                       `x^k` at index k.
+ *  @param degree        Degree of the polynomial.
+ *  @param guess         Starting value of the method.
+ *  @param error         Pointer to store an error code in.
+ *  @param print         Whether to print the individual steps.
+ *
+ *  @return  Approximation of the polynomial's root according to Newton's
+ *           method.
+ *
+ *  @sa method_polynomial_evaluate
+ */
+double method_iterate_polynomial(const double *coefficients, size_t degree, double guess, int *error, int print);
+
+/** Finds all the roots of a polynomial at once.
+ *
+ *  @param coefficients  Coefficients of the polynomial, the coefficient of
+ *                       `x^k` at index k.
+ *  @param degree        Degree of the polynomial, the leading coefficient
+ *                       must not be zero.
+ *  @param real          Array of `degree` numbers to store the real parts of
+ *                       the roots in.
+ *  @param imaginary     Array of `degree` numbers to store the imaginary parts
+ *                       of the roots in.
+ *  @param error         Pointer to store an error code in.
+ *
+ *  @return  The number of roots, which is the degree; every root is listed as
+ *           often as its multiplicity.
+ *
+ *  The roots are found by the Aberth-Ehrlich method: all approximations move
+ *  at once, each one by a Newton step corrected for the pull of the others,
+ *  so no two converge to the same simple root and there is no need for
+ *  deflation. The roots are sorted by their real and then their imaginary
+ *  parts, roots whose imaginary part vanishes are real. If the method does
+ *  not converge the error is `METHOD_EXHAUSTED` and the roots are the last
+ *  approximations.
+ */
+size_t method_polynomial_roots(const double *coefficients, size_t degree, double *real, double *imaginary, int *error);
+
+/** Solvers of `method_solve`. */
+typedef enum method_solver {
+	METHOD_NEWTON   , /**< Plain Newton's method.                       */
+	METHOD_HALLEY   , /**< Halley's method, using the second derivative. */
+	METHOD_DAMPED   , /**< Newton's method with a backtracking search.  */
+	METHOD_BRACKETED, /**< Newton's method safeguarded by bisection.    */
+} MethodSolver;
+
+/** Options of `method_solve`.
+ *
+ *  The method has converged once the function value is smaller than the
+ *  function tolerance, or once a step is smaller than the step tolerance
+ *  relative to the approximation, |dx| <= x_tolerance * (1 + |x|). A step
+ *  tolerance of 0 turns the second criterion off.
+ *
+ *  @sa method_default_options
+ */
+typedef struct method_options {
+	MethodSolver solver;         /**< Which solver to use.                    */
+	double       f_tolerance;    /**< Tolerance of the function value.        */
+	double       x_tolerance;    /**< Relative tolerance of a step.           */
+	int          max_iterations; /**< Iterations before giving up.            */
+	double       lower;          /**< Lower bound of the bracket, if needed.  */
+	double       upper;          /**< Upper bound of the bracket, if needed.  */
+	int          print;          /**< Whether to print the individual steps.  */
+} MethodOptions;
+
+/** Options of plain Newton's method with the limits of `method_iterate`. */
+extern const MethodOptions method_default_options;
+
+/** Finds a root of a function using one of the solvers.
+ *
+ *  @param function           VM code of the function.
+ *  @param derivative         VM code of the derivative.
+ *  @param second_derivative  VM code of the second derivative, only needed by
+ *                            Halley's method; empty code otherwise.
+ *  @param guess              Starting value of the method.
+ *  @param options            The options, `NULL` for the default options.
+ *  @param error              Pointer to store an error code in.
+ *
+ *  @return  Approximation of the function's root.
+ *
+ *  Halley's method converges cubically instead of quadratically, at the cost
+ *  of one more evaluation per step. The damped method halves every step until
+ *  it reduces |f|, which keeps Newton's method from overshooting far away
+ *  from the root. The bracketed method needs a bracket [lower, upper] over
+ *  which the function changes its sign; it takes the Newton step if it lands
+ *  inside the bracket and shrinks it fast enough, and bisects the bracket
+ *  otherwise, so it always converges. A guess outside of the bracket starts at
+ *  its middle.
+ */
+double method_solve(VMCode function, VMCode derivative, VMCode second_derivative, double guess, const MethodOptions *options, int *error);
+
+/** Finds a root of a system of functions using Newton's method.
+ *
+ *  @param functions  Array of the VM code of the n functions, in the
+ *                    variables x1 to xn.
+ *  @param jacobian   Array of the VM code of the n * n partial derivatives,
+ *                    row by row: the element `i * n + j` is the derivative of
+ *                    function i by the variable x(j+1).
+ *                    `NULL` to compute the Jacobian by reverse-mode
+ *                    differentiation of the functions instead.
+ *  @param n          Number of functions and variables.
+ *  @param x          The starting values of the variables, overwritten by the
+ *                    approximation of the root.
+ *  @param options    The options, `NULL` for the default options.
+ *  @param error      Pointer to store an error code in.
+ *
+ *  @return  Largest absolute value of the functions at the approximation.
+ *
+ *  Every step solves a linear system with the Jacobian by LU decomposition.
+ *  Only the plain and the damped solver are supported, the damped one halves
+ *  every step until it reduces the largest function value. The tolerances
+ *  apply to the largest function value and to the largest step. A singular
+ *  Jacobian fails with `METHOD_FLAT`.
+ */
+double method_solve_system(const VMCode *functions, const VMCode *jacobian, size_t n, double *x, const MethodOptions *options, int *error);
+
+/** Searches an interval for roots by running Newton's method from many seeds.
+ *
+ *  @param function   VM code of the function.
+ *  @param lower      Lower bound of the interval.
+ *  @param upper      Upper bound of the interval.
+ *  @param seeds      Number of starting values, evenly spread over the
+ *                    interval including both bounds.
+ *  @param threads    Number of threads to distribute the seeds over.
+ *  @param tolerance  Roots closer than this are considered the same root, so
+ *                    are roots with a function value below the tolerance of
+ *                    the method halfway between them.
+ *  @param count      Pointer to store the number of distinct roots in.
+ *  @param error      Pointer to store an error code in.
+ *
+ *  @return  Array of the distinct roots inside the interval in ascending
+ *           order, owned by the caller. `NULL` if no root has been found or an
+ *           error occurred.
+ *
+ *  Before any seed is run, the interval is bisected along the seeds and the
+ *  function is evaluated on intervals: the seeds of every part on which the
+ *  function provably has no root are dropped, so Newton's method only runs
+ *  near possible roots. Every remaining seed is an independent run of the
+ *  fused Newton's method. The runs are distributed over a pool of threads
+ *  through a shared queue, so threads that finish early take over the
+ *  remaining seeds. Seeds which do not converge or whose root lies outside
+ *  the interval are discarded silently. The function is compiled only once
+ *  and its code is shared by all threads.
+ */
+double *method_search(VMCode function, double lower, double upper, size_t seeds, size_t threads, double tolerance, size_t *count, int *error);
+
 #endif /* NEWTON_METHOD_H */
 
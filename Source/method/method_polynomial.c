@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include <complex.h>
+
+#include "method.h"
+#include "../status/status.h"
+
+/* Roots of polynomials:
+ *
+ * The Aberth-Ehrlich method improves approximations z_1, ..., z_n of all the
+ * n roots at the same time. With the Newton step r = p(z_k) / p'(z_k) of one
+ * approximation its new value is
+ *
+ *     z_k - r / (1 - r * sum_{j != k} 1 / (z_k - z_j))
+ *
+ * which is Newton's method applied to p(z) / prod_{j != k} (z - z_j): the
+ * other approximations repel z_k, so it heads for a root none of them has
+ * taken. The approximations are updated one after the other with the newest
+ * values of the others, and those which have converged stay put.
+ *
+ * An approximation has converged once |p(z_k)| is below the round-off of
+ * evaluating p at z_k, which is bounded by the same Horner's scheme applied to
+ * the absolute values of the coefficients at |z_k|. Below that bound the
+ * value carries no more information, and this also stops roots of higher
+ * multiplicity, which converge slowly and only to a few digits.
+ */
+
+/** Maximum number of sweeps over all the approximations. */
+#define ABERTH_ITERATIONS  500
+
+/** Angle of the first starting value on the circle, in radians.
+ *
+ *  Starting values on the real axis or in conjugate pairs could never leave
+ *  it, a turn off the axis breaks the symmetry.
+ */
+#define ABERTH_ANGLE  0.7
+
+/** Relative size of the imaginary part of a root below which it is real.
+ *
+ *  A double root is only found to about half the digits, and its two
+ *  approximations often come out as a conjugate pair of that size.
+ */
+#define REAL_TOLERANCE  1e-7
+
+/** Evaluates a polynomial and its derivative at a complex point.
+ *
+ *  @param c           Coefficients, the coefficient of `x^k` at index k.
+ *  @param degree      Degree of the polynomial.
+ *  @param z           Where to evaluate the polynomial.
+ *  @param value       Pointer to store the value in.
+ *  @param derivative  Pointer to store the derivative in.
+ *
+ *  @return  Bound of the round-off error of the value.
+ */
+static double evaluate_complex(const double *c, size_t degree, double complex z, double complex *value, double complex *derivative);
+
+/** Makes the complex roots of a real polynomial exact conjugate pairs.
+ *
+ *  @param z       The roots, real roots have an imaginary part of exactly 0.
+ *  @param n       Number of roots.
+ *  @param paired  Array of n flags to mark the roots of the lower half-plane
+ *                 which have been paired, cleared on entry.
+ *
+ *  The two members of each pair are approximated independently, and differ in
+ *  the last digits. Each root in the upper half-plane is paired with the
+ *  nearest unpaired root in the lower one and both are set to their mean.
+ */
+static void pair_conjugates(double complex *z, size_t n, char *paired);
+
+/** Orders complex numbers by their real and then by their imaginary part. */
+static int compare_roots(const void *a, const void *b);
+
+
+void method_polynomial_evaluate(const double *coefficients, size_t degree, double x, double *value, double *derivative) {
+	double p = coefficients[degree]; /* p(x)  */
+	double d = 0;                    /* p'(x) */
+	for (size_t k = degree; k-- > 0;) {
+		d = d * x + p;
+		p = p * x + coefficients[k];
+	}
+	*value      = p;
+	*derivative = d;
+}
+
+size_t method_polynomial_roots(const double *coefficients, size_t degree, double *real, double *imaginary, int *error) {
+	int    exit_status = 0; /* No error.                        */
+	size_t zeros = 0;       /* Roots which are exactly zero.    */
+	double complex *z = malloc(degree * sizeof(double complex));
+	char *converged   = calloc(degree, 1);
+
+	if (degree > 0 && (!z || !converged)) {
+		status_report("Memory error: could not allocate the roots.\n");
+		exit_status = 1;
+		goto end;
+	}
+
+	/* Every vanishing low coefficient factors out one root x = 0. */
+	while (zeros < degree && coefficients[zeros] == 0) {z[zeros] = 0; converged[zeros] = 1; ++zeros;}
+	const double *c = coefficients + zeros;
+	size_t        n = degree - zeros;
+	double complex *w = z + zeros;
+
+	if (n > 0) {
+		/* Start on a circle around the centroid of the roots whose radius
+		 * bounds the magnitudes of the roots. */
+		double complex centre = -c[n - 1] / (n * c[n]);
+		double radius = 0;
+		for (size_t k = 0; k < n; ++k) {
+			double r = pow(fabs(c[k] / c[n]), 1.0 / (n - k));
+			if (r > radius) {radius = r;}
+		}
+		for (size_t k = 0; k < n; ++k) {
+			w[k] = centre + radius * cexp(I * (2 * PI * k / n + ABERTH_ANGLE));
+		}
+	}
+
+	size_t remaining = n; /* Approximations which have not converged. */
+	for (int iteration = 0; remaining > 0 && iteration < ABERTH_ITERATIONS; ++iteration) {
+		for (size_t k = 0; k < n; ++k) {
+			if (converged[zeros + k]) {continue;}
+
+			double complex p, d;
+			double bound = evaluate_complex(c, n, w[k], &p, &d);
+			if (cabs(p) <= bound) {converged[zeros + k] = 1; --remaining; continue;}
+
+			double complex ratio = p / d;
+			double complex repulsion = 0;
+			for (size_t j = 0; j < n; ++j) {
+				if (j != k) {repulsion += 1 / (w[k] - w[j]);}
+			}
+			double complex step = ratio / (1 - ratio * repulsion);
+			/* At a critical point p' vanishes, nudge the approximation instead. */
+			if (!isfinite(creal(step)) || !isfinite(cimag(step))) {step = DBL_EPSILON * (1 + cabs(w[k]));}
+			w[k] -= step;
+		}
+	}
+	if (remaining > 0) {
+		status_report("Error: could not find all roots of the polynomial, %s.\n", method_failure_to_string(METHOD_EXHAUSTED));
+		exit_status = METHOD_EXHAUSTED;
+	}
+
+	/* The real roots of a real polynomial come out with a tiny imaginary part. */
+	for (size_t k = 0; k < degree; ++k) {
+		if (fabs(cimag(z[k])) <= REAL_TOLERANCE * (1 + cabs(z[k]))) {z[k] = creal(z[k]);}
+	}
+	memset(converged, 0, degree);
+	pair_conjugates(z, degree, converged);
+	qsort(z, degree, sizeof(double complex), compare_roots);
+	for (size_t k = 0; k < degree; ++k) {
+		real[k]      = creal(z[k]);
+		imaginary[k] = cimag(z[k]);
+	}
+
+end:
+	free(z);
+	free(converged);
+	if (error) {*error = exit_status;}
+	return exit_status == 0 || exit_status == METHOD_EXHAUSTED ? degree : 0;
+}
+
+static double evaluate_complex(const double *c, size_t degree, double complex z, double complex *value, double complex *derivative) {
+	double complex p = c[degree]; /* p(z)                                  */
+	double complex d = 0;         /* p'(z)                                 */
+	double bound = fabs(c[degree]); /* Absolute coefficients at |z|.       */
+	double r = cabs(z);
+	for (size_t k = degree; k-- > 0;) {
+		d = d * z + p;
+		p = p * z + c[k];
+		bound = bound * r + fabs(c[k]);
+	}
+	*value      = p;
+	*derivative = d;
+	/* Every step of Horner's scheme rounds once for the product and once for
+	 * the sum. */
+	return 4 * DBL_EPSILON * bound;
+}
+
+static void pair_conjugates(double complex *z, size_t n, char *paired) {
+	for (size_t k = 0; k < n; ++k) {
+		if (!(cimag(z[k]) > 0)) {continue;}
+
+		size_t nearest = n;
+		for (size_t j = 0; j < n; ++j) {
+			if (!(cimag(z[j]) < 0) || paired[j]) {continue;}
+			if (nearest == n || cabs(conj(z[j]) - z[k]) < cabs(conj(z[nearest]) - z[k])) {nearest = j;}
+		}
+		if (nearest == n) {continue;}
+
+		double complex mean = (z[k] + conj(z[nearest])) / 2;
+		z[k]       = mean;
+		z[nearest] = conj(mean);
+		paired[nearest] = 1;
+	}
+}
+
+static int compare_roots(const void *a, const void *b) {
+	double complex x = *(const double complex *)a, y = *(const double complex *)b;
+	if (creal(x) != creal(y)) {return (creal(x) > creal(y)) - (creal(x) < creal(y));}
+	return (cimag(x) > cimag(y)) - (cimag(x) < cimag(y));
+}
@@ -0,0 +1,259 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+
+#include "method.h"
+#include "../virtual_machine/vm.h"
+#include "../virtual_machine/vm_code.h"
+#include "../statistics/statistics.h"
+#include "../status/status.h"
+
+/* Newton's method for systems:
+ *
+ * For a system F(x) = 0 of n functions in n variables one step solves the
+ * linear system J(x_n) d = F(x_n), where J is the Jacobian matrix of all the
+ * partial derivatives, and then x_{n+1} = x_n - d. The systems we solve are
+ * small, at most `MAX_VARIABLES` unknowns, so the Jacobian is factored by a
+ * plain LU decomposition with partial pivoting. Even the largest Jacobian fits
+ * into the cache, and the inner loops run along the rows of the row-major
+ * matrix, so blocking would not pay for itself.
+ */
+
+/** Maximum number of times the damped method halves a step. */
+#define MAX_HALVINGS  30
+
+/** Work space of the method, allocated as one block. */
+struct system_work {
+	double *f;        /**< Function values F(x_n).            */
+	double *jacobian; /**< Jacobian J(x_n), factored in place. */
+	double *step;     /**< The step d.                        */
+	double *x_n_1;    /**< The approximation x_{n-1}.         */
+	size_t *pivot;    /**< Row exchanges of the factorisation. */
+};
+
+/** Evaluates every function of the system.
+ *
+ *  @param machine  Machine with the variables in its register file.
+ *  @param code     Array of the code of each function.
+ *  @param n        Number of functions.
+ *  @param result   Array to store the values in.
+ *  @param norm     Pointer to store the largest absolute value in.
+ *
+ *  @return  0 on success, the VM error otherwise.
+ */
+static int evaluate_system(VirtualMachine *machine, const VMCode *code, size_t n, double *result, double *norm);
+
+/** Evaluates the Jacobian of a system by reverse-mode differentiation.
+ *
+ *  @param machine   Machine with the variables in its register file.
+ *  @param code      Array of the code of each function.
+ *  @param n         Number of functions.
+ *  @param tape      Tape reserved for all the functions.
+ *  @param jacobian  Row-major n by n matrix to store the gradients in.
+ *
+ *  @return  0 on success, the VM error otherwise.
+ */
+static int evaluate_gradients(VirtualMachine *machine, const VMCode *code, size_t n, VMTape *tape, double *jacobian);
+
+/** Factors a matrix into a lower and an upper triangular matrix in place.
+ *
+ *  @param matrix  Row-major n by n matrix, overwritten by its factors.
+ *  @param n       Number of rows and columns.
+ *  @param pivot   Array to store the row exchanges in.
+ *
+ *  @return  0 on success, `METHOD_FLAT` if the matrix is singular or nearly so.
+ *
+ *  The unit diagonal of the lower factor is not stored.
+ */
+static int lu_factor(double *matrix, size_t n, size_t *pivot);
+
+/** Solves a linear system using the factors of its matrix.
+ *
+ *  @param lu     The factors, as computed by `lu_factor`.
+ *  @param n      Number of rows and columns.
+ *  @param pivot  Row exchanges of the factorisation.
+ *  @param b      The right-hand side, overwritten by the solution.
+ */
+static void lu_solve(const double *lu, size_t n, const size_t *pivot, double *b);
+
+/** Largest absolute value of the elements of a vector.
+ *
+ *  @param v  The vector.
+ *  @param n  Number of elements.
+ *
+ *  @return  The maximum norm of the vector.
+ */
+static double max_norm(const double *v, size_t n);
+
+
+double method_solve_system(const VMCode *functions, const VMCode *jacobian, size_t n, double *x, const MethodOptions *options, int *error) {
+	const MethodOptions *o = options ? options : &method_default_options;
+	VirtualMachine machine = {.reg_vars = x, .reg_count = n};
+	VMTape tape = {.entries = NULL, .capacity = 0, .length = 0};
+
+	double  norm = NAN;     /* Maximum norm of F(x_n).       */
+	int     iterations = 0; /* Number of iterations passed.  */
+	int     exit_status = 0; /* No error.                    */
+	double *block = malloc(n * (n + 3) * sizeof(double));
+	struct system_work work = {
+		.f        = block,
+		.jacobian = block ? block + n         : NULL,
+		.step     = block ? block + n * (n + 1) : NULL,
+		.x_n_1    = block ? block + n * (n + 2) : NULL,
+		.pivot    = malloc(n * sizeof(size_t)),
+	};
+
+	STATISTICS(NewtonStatistics *statistics = statistics_current();)
+
+	if (n == 0 || n > MAX_VARIABLES) {
+		status_report("Error: a system must have between 1 and %i functions.\n", MAX_VARIABLES);
+		exit_status = 1;
+		goto end;
+	}
+	if (o->solver != METHOD_NEWTON && o->solver != METHOD_DAMPED) {
+		status_report("Error: systems can only be solved by the plain or the damped method.\n");
+		exit_status = 1;
+		goto end;
+	}
+	if (!block || !work.pivot) {
+		status_report("Memory error: could not allocate the Jacobian.\n");
+		exit_status = 1;
+		goto end;
+	}
+
+	/* Without the code of the partial derivatives the gradients are taped. */
+	for (size_t i = 0; !jacobian && i < n; ++i) {
+		if (vm_tape_reserve(&tape, functions[i]) != 0) {exit_status = 1; goto end;}
+	}
+
+	if ((exit_status = evaluate_system(&machine, functions, n, work.f, &norm)) != 0) {goto end;}
+	while (iterations < o->max_iterations) {
+		double previous = norm; /* Norm before the step. */
+		double lambda   = 1;    /* Damping of the step.  */
+
+		if (norm < o->f_tolerance) {goto end;}
+		if (!isfinite(norm)) {exit_status = METHOD_NOT_FINITE; break;}
+
+		exit_status = jacobian
+		            ? evaluate_system(&machine, jacobian, n * n, work.jacobian, NULL)
+		            : evaluate_gradients(&machine, functions, n, &tape, work.jacobian);
+		if (exit_status != 0) {goto end;}
+		if ((exit_status = lu_factor(work.jacobian, n, work.pivot)) != 0) {break;}
+		for (size_t i = 0; i < n; ++i) {
+			work.step[i]  = work.f[i];
+			work.x_n_1[i] = x[i];
+		}
+		lu_solve(work.jacobian, n, work.pivot, work.step);
+		if (!isfinite(max_norm(work.step, n))) {exit_status = METHOD_NOT_FINITE; break;}
+
+		for (int halvings = 0; ; ++halvings, lambda /= 2) {
+			for (size_t i = 0; i < n; ++i) {x[i] = work.x_n_1[i] - lambda * work.step[i];}
+			if ((exit_status = evaluate_system(&machine, functions, n, work.f, &norm)) != 0) {goto end;}
+			/* The plain method always takes the full step. */
+			if (o->solver != METHOD_DAMPED || (isfinite(norm) && norm < previous) || halvings == MAX_HALVINGS) {break;}
+		}
+
+		if (o->print) {
+			printf("%3i: |F(x)| = %g, |dx| = %g\n", iterations, norm, lambda * max_norm(work.step, n));
+		}
+		++iterations;
+
+		if (isfinite(norm) && lambda * max_norm(work.step, n) <= o->x_tolerance * (1 + max_norm(x, n))) {goto end;}
+	}
+	if (exit_status == 0) {
+		if (norm < o->f_tolerance) {goto end;}
+		exit_status = METHOD_EXHAUSTED;
+	}
+	if (method_failure_to_string(exit_status)) {
+		status_report("Error: could not solve the system, %s, aborting.\n"
+		              "  After %i iterations the largest function value is %.4f.\n",
+		              exit_status == METHOD_FLAT ? "the Jacobian is singular" : method_failure_to_string(exit_status),
+		              iterations, norm
+		);
+	}
+
+end:
+	STATISTICS(statistics_count_solve(statistics, iterations, exit_status);)
+	free(block);
+	free(work.pivot);
+	vm_tape_clear(&tape);
+	if (error) {*error = exit_status;}
+	return norm;
+}
+
+static int evaluate_system(VirtualMachine *machine, const VMCode *code, size_t n, double *result, double *norm) {
+	int error = 0; /* No error. */
+	for (size_t i = 0; i < n; ++i) {
+		machine_load_code(machine, code[i]);
+		if ((error = machine_execute(machine, &result[i])) != 0) {return error;}
+	}
+	if (norm) {*norm = max_norm(result, n);}
+	return error;
+}
+
+static int evaluate_gradients(VirtualMachine *machine, const VMCode *code, size_t n, VMTape *tape, double *jacobian) {
+	int error = 0; /* No error. */
+	double value;
+	for (size_t i = 0; i < n; ++i) {
+		machine_load_code(machine, code[i]);
+		if ((error = machine_execute_gradient(machine, tape, &value, &jacobian[i * n])) != 0) {return error;}
+	}
+	return error;
+}
+
+static int lu_factor(double *matrix, size_t n, size_t *pivot) {
+	#define M(i, j)  matrix[(i) * n + (j)]
+	/* Pivots this small compared to the matrix are round-off, not information. */
+	double tiny = n * DBL_EPSILON * max_norm(matrix, n * n);
+
+	for (size_t k = 0; k < n; ++k) {
+		/* Partial pivoting: bring the largest element of the column up. */
+		size_t p = k;
+		for (size_t i = k + 1; i < n; ++i) {
+			if (fabs(M(i, k)) > fabs(M(p, k))) {p = i;}
+		}
+		if (!(fabs(M(p, k)) > tiny)) {return METHOD_FLAT;}
+		pivot[k] = p;
+		if (p != k) {
+			for (size_t j = 0; j < n; ++j) {
+				double t = M(k, j);
+				M(k, j) = M(p, j);
+				M(p, j) = t;
+			}
+		}
+		for (size_t i = k + 1; i < n; ++i) {
+			double l = M(i, k) /= M(k, k);
+			for (size_t j = k + 1; j < n; ++j) {M(i, j) -= l * M(k, j);}
+		}
+	}
+	return 0;
+	#undef M
+}
+
+static void lu_solve(const double *lu, size_t n, const size_t *pivot, double *b) {
+	#define LU(i, j)  lu[(i) * n + (j)]
+	/* Forward substitution with the row exchanges applied on the way. */
+	for (size_t k = 0; k < n; ++k) {
+		double t = b[pivot[k]];
+		b[pivot[k]] = b[k];
+		b[k] = t;
+		for (size_t j = 0; j < k; ++j) {b[k] -= LU(k, j) * b[j];}
+	}
+	/* Backward substitution. */
+	for (size_t k = n; k-- > 0;) {
+		for (size_t j = k + 1; j < n; ++j) {b[k] -= LU(k, j) * b[j];}
+		b[k] /= LU(k, k);
+	}
+	#undef LU
+}
+
+static double max_norm(const double *v, size_t n) {
+	double norm = 0;
+	for (size_t i = 0; i < n; ++i) {
+		/* NaN must not get lost in the comparisons. */
+		if (isnan(v[i])) {return NAN;}
+		if (fabs(v[i]) > norm) {norm = fabs(v[i]);}
+	}
+	return norm;
+}
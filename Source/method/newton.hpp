@@ -0,0 +1,187 @@
+#ifndef NEWTON_HPP
+#define NEWTON_HPP
+
+/** @file newton.hpp
+ *
+ *  Newton's method for C++ kernels generated ahead of time.
+ *
+ *  `newton --f function --k name` writes a header with a `struct name` whose
+ *  static member functions `value` and `derivative` compute the function and
+ *  its derivative. The kernel is a type, so `newton::solve<name>(guess)`
+ *  instantiates the loop of `method_iterate` for exactly that function: there
+ *  is no virtual machine and no call through a pointer, the compiler sees the
+ *  whole expression and can inline it into the loop.
+ *
+ *  The loop follows `method_iterate` step by step: the same tolerance, the
+ *  same limit of iterations and the same watch for hopeless cases, with the
+ *  same error codes. Nothing is printed, errors are only returned.
+ *
+ *  The header needs C++11 and nothing but the standard library, the library
+ *  of the command-line program is not used at all.
+ */
+
+#include <cmath>
+#include <cstddef>
+
+namespace newton {
+
+/** Reasons for Newton's method to fail, as in `enum method_failure`. */
+enum failure {
+	METHOD_EXHAUSTED  = -1, /**< Ran out of iterations.               */
+	METHOD_NOT_FINITE = -2, /**< A value has become infinite or NaN.  */
+	METHOD_FLAT       = -3, /**< The derivative is zero or nearly so. */
+	METHOD_CYCLE      = -4, /**< The steps go back and forth between two
+	                         *   points.                              */
+	METHOD_DIVERGED   = -5, /**< The approximation grows without bound. */
+};
+
+/** Constants of the method, the same as in *method.c*. */
+static const int    MAX_ITERATIONS = 100;
+static const double EPSILON        = 0.0000001;
+static const double FLAT_RATIO     = 1e10;
+static const double CYCLE_RATIO    = 1e-3;
+static const int    CYCLE_STEPS    = 2;
+static const int    BLOWUP_STEPS   = 6;
+
+/** Number of guesses `solve` iterates side by side. */
+static const std::size_t LANES = 8;
+
+/** Raises a number to a constant power by multiplications.
+ *
+ *  The multiplications are those of `machine_integer_power`, only unrolled at
+ *  compile time: an odd power is the next lower one times the base, an even
+ *  power is the square of half of it.
+ */
+template<unsigned int N> struct Power {
+	static constexpr double of(double x) {
+		return N % 2 ? Power<N - 1>::of(x) * x : Power<N / 2>::of(x) * Power<N / 2>::of(x);
+	}
+};
+
+template<> struct Power<0> {
+	static constexpr double of(double) {return 1;}
+};
+
+/** Observer of the iterations, see `struct watch` of *method.c*. */
+struct watch {
+	double x_1    = 0; /**< x_{n-1}                                   */
+	double x_2    = 0; /**< x_{n-2}                                   */
+	double f_1    = 0; /**< |f(x_{n-1})|                              */
+	int    steps  = 0; /**< Number of approximations observed.       */
+	int    cycles = 0; /**< Steps in a row that look like a 2-cycle. */
+	int    growth = 0; /**< Steps in a row that grow |x| and |f|.    */
+
+	/** Observes one step.
+	 *
+	 *  @return  0 if the method may go on, otherwise the reason to give up.
+	 */
+	int step(double x_n, double f_xn, double d_xn) {
+		if (!std::isfinite(x_n) || !std::isfinite(f_xn) || !std::isfinite(d_xn)) {return METHOD_NOT_FINITE;}
+		if (d_xn == 0 || std::fabs(f_xn) > FLAT_RATIO * std::fabs(d_xn) * (1 + std::fabs(x_n))) {return METHOD_FLAT;}
+
+		if (steps >= 2 && std::fabs(x_n - x_2) < CYCLE_RATIO * std::fabs(x_n - x_1)) {
+			if (++cycles >= CYCLE_STEPS) {return METHOD_CYCLE;}
+		} else {
+			cycles = 0;
+		}
+		if (steps >= 1 && std::fabs(x_n) > 1 && std::fabs(x_n) > std::fabs(x_1) && std::fabs(f_xn) >= f_1) {
+			if (++growth >= BLOWUP_STEPS) {return METHOD_DIVERGED;}
+		} else {
+			growth = 0;
+		}
+
+		x_2 = x_1;
+		x_1 = x_n;
+		f_1 = std::fabs(f_xn);
+		++steps;
+		return 0;
+	}
+};
+
+/** Performs Newton's method on a generated kernel.
+ *
+ *  @tparam Expr   The kernel, a type with static functions `value` and
+ *                 `derivative` of a double.
+ *  @param  guess  Starting value of the method.
+ *  @param  error  Pointer to store an error code in, may be `nullptr`.
+ *
+ *  @return  Approximation of the root, the same as `method_iterate` yields.
+ */
+template<class Expr> double solve(double guess, int *error = nullptr) {
+	double x_n = guess;
+	double f_xn = 0, d_xn;
+	int exit_status = 0;
+	watch w;
+
+	for (int iterations = 0; iterations < MAX_ITERATIONS; ++iterations) {
+		f_xn = Expr::value(x_n);
+		if (std::fabs(f_xn) < EPSILON) {goto end;}
+		d_xn = Expr::derivative(x_n);
+		if ((exit_status = w.step(x_n, f_xn, d_xn)) != 0) {goto end;}
+		x_n = x_n - f_xn / d_xn;
+	}
+	exit_status = METHOD_EXHAUSTED;
+
+end:
+	if (error) {*error = exit_status;}
+	return x_n;
+}
+
+/** Performs Newton's method from many guesses.
+ *
+ *  @tparam Expr     The kernel.
+ *  @param  guesses  Starting values, `count` of them.
+ *  @param  roots    Array to store the approximations in, may be `guesses`.
+ *  @param  count    Number of guesses.
+ *  @param  errors   Array to store the error codes in, may be `nullptr`.
+ *
+ *  Each result is the same as that of `solve` for its guess. The guesses are
+ *  iterated in lockstep, `LANES` at a time: the function and derivative of
+ *  all of them are evaluated in one loop without branches, which the
+ *  compiler can vectorise, only the bookkeeping of the steps is done one
+ *  guess at a time. Guesses which are done are carried along unchanged.
+ */
+template<class Expr> void solve(const double *guesses, double *roots, std::size_t count, int *errors = nullptr) {
+	for (std::size_t first = 0; first < count; first += LANES) {
+		std::size_t lanes = count - first < LANES ? count - first : LANES;
+		double x[LANES], f[LANES], d[LANES];
+		int    status[LANES];
+		bool   active[LANES];
+		watch  w[LANES];
+
+		for (std::size_t i = 0; i < LANES; ++i) {
+			x[i] = i < lanes ? guesses[first + i] : 0;
+			status[i] = METHOD_EXHAUSTED;
+			active[i] = i < lanes;
+		}
+
+		std::size_t remaining = lanes;
+		for (int iterations = 0; remaining > 0 && iterations < MAX_ITERATIONS; ++iterations) {
+			for (std::size_t i = 0; i < LANES; ++i) {
+				f[i] = Expr::value(x[i]);
+				d[i] = Expr::derivative(x[i]);
+			}
+			for (std::size_t i = 0; i < LANES; ++i) {
+				if (!active[i]) {continue;}
+				int failure = std::fabs(f[i]) < EPSILON ? 0 : w[i].step(x[i], f[i], d[i]);
+				if (std::fabs(f[i]) < EPSILON || failure != 0) {
+					status[i] = failure;
+					active[i] = false;
+					--remaining;
+				}
+			}
+			for (std::size_t i = 0; i < LANES; ++i) {
+				x[i] = active[i] ? x[i] - f[i] / d[i] : x[i];
+			}
+		}
+
+		for (std::size_t i = 0; i < lanes; ++i) {
+			roots[first + i] = x[i];
+			if (errors) {errors[first + i] = status[i];}
+		}
+	}
+}
+
+} /* namespace newton */
+
+#endif /* NEWTON_HPP */
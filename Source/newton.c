@@ -1,10 +1,20 @@
+#define _POSIX_C_SOURCE 200809L /* sysconf, getline, mmap */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "compiler/compiler.h"
 #include "virtual_machine/vm.h"
 #include "method/method.h"
+#include "virtual_machine/vm_cartridge.h"
+#include "library/library.h"
 
 /** Exit codes of the program. */
 enum exit_codes {
@@ -13,14 +23,196 @@ enum exit_codes {
 	EX_COMPILER , /**< Compiler failure.           */
 };
 
+/** Default number of seeds when searching an interval. */
+#define DEFAULT_SEEDS  100
+
+/** Maximum length of the path of a cartridge file. */
+#define MAX_PATH_LENGTH  4096
+
+/** Memory of the compiled functions kept around when streaming jobs. */
+#define STREAM_CACHE_CAPACITY  (64 * 1024 * 1024)
+
+/** Size of the output buffer when streaming jobs. */
+#define STREAM_BUFFER_SIZE  (64 * 1024)
+
+/** Roots closer than this are considered the same root when searching. */
+#define ROOT_TOLERANCE  0.0001
+
+/** Text representations of the arguments passed to the program.
+ *
+ *  Every argument which has not been passed remains `NULL`.
+ */
+typedef struct arguments {
+	const char *function; /**< Function string.                    */
+	const char *guess;    /**< Initial guess.                      */
+	const char *print;    /**< Print option.                       */
+	const char *lower;    /**< Lower bound of the search interval. */
+	const char *upper;    /**< Upper bound of the search interval. */
+	const char *seeds;    /**< Number of seeds for the search.     */
+	const char *threads;  /**< Number of threads for the search.   */
+	const char *c_name;   /**< Name of the C function to emit.     */
+	const char *cpp_name; /**< Name of the C++ kernel to emit.     */
+	const char *cache;    /**< Directory of cached cartridges.     */
+	const char *stream;   /**< File of jobs, `-` for stdin.        */
+	const char *solver;   /**< Name of the solver.                 */
+	const char *f_tolerance; /**< Tolerance of the function value. */
+	const char *x_tolerance; /**< Relative tolerance of a step.    */
+	const char *roots;    /**< All roots of a polynomial option.   */
+} Arguments;
+
 /** Handles arguments passed to the program.
  *
- *  @param argc  Number of arguments passed.
- *  @param argv  Array or argument strings.
+ *  @param argc       Number of arguments passed.
+ *  @param argv       Array or argument strings.
+ *  @param arguments  Structure to store the argument strings in.
  *
  *  @return  0 if no errors were found, otherwise an error code.
  */
-int handle_arguments(int argc, const char *argv[], const char **function, const char **guess, const char **print);
+int handle_arguments(int argc, const char *argv[], Arguments *arguments);
+
+/** Searches the interval given by the arguments for all roots of a function.
+ *
+ *  @param function   VM code of the function.
+ *  @param arguments  Arguments passed to the program.
+ *
+ *  @return  Exit status of the program.
+ */
+int search_interval(VMCode function, const Arguments *arguments);
+
+/** Finds a root with the solver and tolerances given by the arguments.
+ *
+ *  @param arguments  Arguments passed to the program.
+ *  @param arena      Arena for the syntax trees.
+ *
+ *  @return  Exit status of the program.
+ *
+ *  The function and its derivative are always compiled, as is the second
+ *  derivative for Halley's method; the cache directory is not used.
+ */
+int solve_with_solver(const Arguments *arguments, SyntaxNodeArena *arena);
+
+/** Solves the system of functions given by the arguments.
+ *
+ *  @param arguments  Arguments passed to the program.
+ *
+ *  @return  Exit status of the program.
+ *
+ *  The functions and the guesses are separated by semicolons, there must be
+ *  one guess per function.
+ */
+int solve_system(const Arguments *arguments);
+
+/** Splits a string at every semicolon.
+ *
+ *  @param string  The string, every semicolon is overwritten by a NUL.
+ *  @param parts   Array to store the start of every part in.
+ *  @param limit   Maximum number of parts.
+ *
+ *  @return  The number of parts, or 0 if there are more than `limit`.
+ */
+size_t split_list(char *string, const char **parts, size_t limit);
+
+/** Finds all roots of a polynomial, complex ones included.
+ *
+ *  @param arguments  Arguments passed to the program.
+ *  @param arena      Arena for the syntax trees.
+ *
+ *  @return  Exit status of the program.
+ *
+ *  Functions which are not polynomials in x are an error.
+ */
+int polynomial_roots(const Arguments *arguments, SyntaxNodeArena *arena);
+
+/** Compiles the function given by the arguments, or loads it from the cache.
+ *
+ *  @param arguments  Arguments passed to the program.
+ *  @param arena      Arena for the syntax trees.
+ *  @param cartridge  Cartridge to store the code in.
+ *  @param tree       Pointer to store the simplified syntax tree in, remains
+ *                    `NULL` if the code has been loaded from the cache.
+ *
+ *  @return  Exit status of the program.
+ *
+ *  Without a cache directory only the function is compiled, the derivative is
+ *  computed alongside by the VM. With a cache directory the cartridge file of
+ *  the function is loaded if there is one and the compiler is skipped
+ *  entirely. Otherwise the function and its derivative are compiled and
+ *  written to the cache for the next run.
+ */
+int compile_function(const Arguments *arguments, SyntaxNodeArena *arena, VMCartridge *cartridge, SyntaxNode **tree);
+
+/** A number as it is to be printed.
+ *
+ *  @param x  The number.
+ *
+ *  @return  0 if the number prints as zero, so it is printed without a sign,
+ *           the number itself otherwise.
+ */
+double printed(double x);
+
+/** Compiles a syntax tree and moves the code into a cartridge.
+ *
+ *  @param tree       The tree to compile.
+ *  @param precision  Precision of the numbers of the code.
+ *  @param code       VMCode of the cartridge to store the code in.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+int compile_tree(const SyntaxNode *tree, VMPrecision precision, VMCode *code);
+
+/** Writes the function and its derivative as source to the standard output.
+ *
+ *  @param source  Source code of the function.
+ *  @param arena   Arena for the syntax trees.
+ *  @param name    Name of the C function or C++ kernel.
+ *  @param cpp     Whether to write a C++ kernel instead of C functions.
+ *
+ *  @return  Exit status of the program.
+ */
+int emit_c_source(const char *source, SyntaxNodeArena *arena, const char *name, int cpp);
+
+/** Source of jobs when streaming, one job per line.
+ *
+ *  A file is mapped into memory as a whole, the standard input is read line
+ *  by line. Either way every line is copied into the line buffer, so it can
+ *  be terminated.
+ */
+struct job_reader {
+	const char *data;     /**< Mapped file, or `NULL` when reading stdin. */
+	size_t      size;     /**< Size of the mapped file.                   */
+	size_t      position; /**< Position of the next line in the file.     */
+	char       *line;     /**< Buffer of the current line.                */
+	size_t      capacity; /**< Size of the line buffer.                   */
+	int         error;    /**< Set once a line could not be read.         */
+};
+
+/** Solves a stream of jobs, one function and guess per line.
+ *
+ *  @param arguments  Arguments passed to the program.
+ *
+ *  @return  Exit status of the program.
+ *
+ *  Every line holds a function string and a guess, separated by a tab. For
+ *  every job the root is written on a line of its own, or `nan` if the job
+ *  failed, so the output lines match the input lines; blank lines are
+ *  skipped. Errors are reported on the standard error with their line number.
+ *  If the jobs cannot be read to the end the exit status is not 0 either.
+ *
+ *  Compiled functions are kept in a cache, a run of lines with the same
+ *  function compiles it only once and does not even look it up again.
+ */
+int solve_stream(const Arguments *arguments);
+
+/** Reads the next line of jobs.
+ *
+ *  @param reader  The reader.
+ *
+ *  @return  The line without its line break, `NULL` at the end or on error.
+ *
+ *  On error the error flag of the reader is set, so the caller can tell the
+ *  end of the jobs from a failure to read them.
+ */
+char *read_job(struct job_reader *reader);
 
 /** Prints usage instructions to the standard output. */
 void print_usage(void);
@@ -32,88 +224,126 @@ int main(int argc, const char *argv[]) {
 	double x_0, x_n;     /* Initial and resulting value of Newton's method.  */
 	int print_steps = 0; /* Print every step of the iteration.               */
 
-	const char *function_string = NULL; /* Text representation of function.  */
-	const char *guess_string    = NULL; /* Text representation of guess.     */
-	const char *print_string    = NULL; /* Text representation print option. */
+	Arguments arguments = {NULL}; /* Text representation of the arguments.  */
 
-	SyntaxNode *function_tree   = NULL; /* Syntax tree of the function.      */
-	SyntaxNode *derivative_tree = NULL; /* Syntax tree of the derivative.    */
+	SyntaxNodeArena arena;              /* Arena of the syntax trees.        */
+	SyntaxNode *tree = NULL;            /* Tree of the function.             */
+	VMCartridge cartridge = {NULL};     /* Code of the function.             */
+	double coefficients[POLYNOMIAL_MAX_DEGREE + 1]; /* Of a polynomial.      */
+	size_t degree;                      /* Degree of a polynomial.           */
 
-	VMCode *function_vm_code    = NULL; /* VM code of the function.          */
-	VMCode *derivative_vm_code  = NULL; /* VM code of the derivative.        */
+	syntax_node_arena_init(&arena, 0);
 
-	if (handle_arguments(argc, argv, &function_string, &guess_string, &print_string) != 0) {
+	if (handle_arguments(argc, argv, &arguments) != 0) {
 		fprintf(stderr, "Error: invalid arguments.\n");
 		print_usage();
 		exit_status = EX_ARGS;
 		goto end;
 	}
-	if (!function_string || !guess_string) {
+	if (arguments.stream) {
+		exit_status = solve_stream(&arguments);
+		goto end;
+	}
+	/* Either a guess, an interval to search, a C or C++ name or the roots
+	 * flag is needed. */
+	if (!arguments.function || (!arguments.guess && !(arguments.lower && arguments.upper) && !arguments.c_name && !arguments.cpp_name && !arguments.roots)) {
 		fprintf(stderr, "Error: invalid arguments.\n");
 		print_usage();
 		exit_status = EX_ARGS;
 		goto end;
 	}
-	if (print_string) {print_steps = 1;}
-
-	x_0 = strtod(guess_string, NULL);
-
+	if (arguments.print) {print_steps = 1;}
 
-	if (compiler_frontend(function_string, &function_tree)) {
-		fprintf(stderr, "Compiler frontend error.\n");
-		exit_status = EX_COMPILER;
+	if (strchr(arguments.function, ';')) {
+		exit_status = solve_system(&arguments);
 		goto end;
 	}
 
-	syntax_node_condense(function_tree); // optimizes the syntax tree
+	if (arguments.c_name || arguments.cpp_name) {
+		const char *name = arguments.c_name ? arguments.c_name : arguments.cpp_name;
+		exit_status = emit_c_source(arguments.function, &arena, name, !arguments.c_name);
+		goto end;
+	}
 
-	// Now derive the function tree and condense it again
-	derivative_tree = syntax_node_derive(function_tree);
-	syntax_node_condense(derivative_tree);
+	if (arguments.roots) {
+		exit_status = polynomial_roots(&arguments, &arena);
+		goto end;
+	}
 
-	if (compiler_backend(function_tree, &function_vm_code) != 0) {
-		fprintf(stderr, "Compiler backend error.\n");
-		exit_status = EX_COMPILER;
+	if (arguments.solver || arguments.f_tolerance || arguments.x_tolerance) {
+		exit_status = solve_with_solver(&arguments, &arena);
 		goto end;
 	}
-	if (compiler_backend(derivative_tree, &derivative_vm_code) != 0) {
-		fprintf(stderr, "Compiler backend error.\n");
-		exit_status = 1;
+
+	exit_status = compile_function(&arguments, &arena, &cartridge, &tree);
+	if (exit_status != EX_SUCCESS) {goto end;}
+
+	if (!arguments.guess) {
+		exit_status = search_interval(cartridge.function, &arguments);
 		goto end;
 	}
 
 	// Perform Newton's method.
-	x_n = method_iterate(*function_vm_code, *derivative_vm_code, x_0, &exit_status, print_steps);
+	x_0 = strtod(arguments.guess, NULL);
+	/* Horner's scheme only if it evaluates the polynomial as written. */
+	if (tree && syntax_node_is_expanded(tree) && syntax_node_polynomial(tree, coefficients, &degree) == 0) {
+		x_n = method_iterate_polynomial(coefficients, degree, x_0, &exit_status, print_steps);
+	} else {
+		x_n = method_iterate_fused(cartridge.function, x_0, &exit_status, print_steps);
+	}
+	if (exit_status > 0) {
+		/* Failures of the method have been reported already, VM errors not. */
+		fprintf(stderr, "Error: the function could not be evaluated.\n");
+	}
 	if (exit_status != EX_SUCCESS) {goto end;}
 
 
-	printf("  The root of \'%s\' with starting value %f is: %f.\n",function_string, x_0, x_n);
+	printf("  The root of \'%s\' with starting value %f is: %f.\n", arguments.function, x_0, x_n);
 
 end:
+	vm_cartridge_unload(&cartridge);
+	syntax_node_arena_release(&arena);
     return exit_status;
 }
 
 
-int handle_arguments(int argc, const char *argv[], const char **function, const char **guess, const char **print) {
+int handle_arguments(int argc, const char *argv[], Arguments *arguments) {
 	int error = 0; /* Will be non-0 if an error occurs. */
 
-	if (argc == 3) { /* newton f g */
-		*function = argv[1];
-		*guess    = argv[2];
+	if (argc == 3 && strncmp(argv[1], "--", 2) != 0) { /* newton f g */
+		arguments->function = argv[1];
+		arguments->guess    = argv[2];
 		goto end;
 	}
 
 	for (int i = 1; i < argc; ++i) {
-		if (strncmp(argv[i], "--f", 3) == 0) {
-			*function = argv[++i];
+		/* Options which take a value. */
+		const char **value = NULL;
+		if      (strncmp(argv[i], "--f", 3) == 0) {value = &arguments->function;}
+		else if (strncmp(argv[i], "--g", 3) == 0) {value = &arguments->guess   ;}
+		else if (strncmp(argv[i], "--a", 3) == 0) {value = &arguments->lower   ;}
+		else if (strncmp(argv[i], "--b", 3) == 0) {value = &arguments->upper   ;}
+		else if (strncmp(argv[i], "--n", 3) == 0) {value = &arguments->seeds   ;}
+		else if (strncmp(argv[i], "--t", 3) == 0) {value = &arguments->threads ;}
+		else if (strncmp(argv[i], "--c", 3) == 0) {value = &arguments->c_name  ;}
+		else if (strncmp(argv[i], "--k", 3) == 0) {value = &arguments->cpp_name;}
+		else if (strncmp(argv[i], "--d", 3) == 0) {value = &arguments->cache   ;}
+		else if (strncmp(argv[i], "--s", 3) == 0) {value = &arguments->stream  ;}
+		else if (strncmp(argv[i], "--m", 3) == 0) {value = &arguments->solver  ;}
+		else if (strncmp(argv[i], "--e", 3) == 0) {value = &arguments->f_tolerance;}
+		else if (strncmp(argv[i], "--x", 3) == 0) {value = &arguments->x_tolerance;}
+
+		if (value) {
+			if (i + 1 >= argc) {error = 1; goto end;}
+			*value = argv[++i];
 			continue;
 		}
-		if (strncmp(argv[i], "--g", 3) == 0) {
-			*guess = argv[++i];
+		if (strncmp(argv[i], "--p", 3) == 0) {
+			arguments->print = argv[i];
 			continue;
 		}
-		if (strncmp(argv[i], "--p", 3) == 0) {
-			*print = argv[i];
+		if (strncmp(argv[i], "--r", 3) == 0) {
+			arguments->roots = argv[i];
 			continue;
 		}
 		/* If it does not match any known string. */
@@ -125,6 +355,430 @@ end:
 	return error;
 }
 
+int search_interval(VMCode function, const Arguments *arguments) {
+	int    error   = 0; /* Exit status of the search.    */
+	size_t count   = 0; /* Number of roots found.        */
+	double lower   = strtod(arguments->lower, NULL);
+	double upper   = strtod(arguments->upper, NULL);
+	long   seeds   = arguments->seeds   ? strtol(arguments->seeds, NULL, 10)   : DEFAULT_SEEDS;
+	long   threads = arguments->threads ? strtol(arguments->threads, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (seeds < 1 || threads < 1 || !(lower <= upper)) {
+		fprintf(stderr, "Error: invalid search interval, seeds or threads.\n");
+		print_usage();
+		return EX_ARGS;
+	}
+
+	double *roots = method_search(function, lower, upper, seeds, threads, ROOT_TOLERANCE, &count, &error);
+	if (error != 0) {
+		fprintf(stderr, "Error: could not search the interval.\n");
+		goto end;
+	}
+
+	printf("  Found %zu root(s) of \'%s\' in [%f, %f]:\n", count, arguments->function, lower, upper);
+	for (size_t i = 0; i < count; ++i) {printf("    %f\n", printed(roots[i]));}
+
+end:
+	free(roots);
+	return error;
+}
+
+int polynomial_roots(const Arguments *arguments, SyntaxNodeArena *arena) {
+	int    error = 0;   /* Exit status of the method.   */
+	size_t degree;      /* Degree of the polynomial.    */
+	SyntaxNode *tree = NULL;
+	double coefficients[POLYNOMIAL_MAX_DEGREE + 1];
+	double real[POLYNOMIAL_MAX_DEGREE], imaginary[POLYNOMIAL_MAX_DEGREE];
+
+	if (compiler_frontend_arena(arguments->function, arena, &tree)) {
+		fprintf(stderr, "Compiler frontend error.\n");
+		return EX_COMPILER;
+	}
+	syntax_node_arena_simplify(arena, tree);
+	if (syntax_node_polynomial(tree, coefficients, &degree) != 0) {
+		fprintf(stderr, "Error: '%s' is not a polynomial of degree at most %i.\n", arguments->function, POLYNOMIAL_MAX_DEGREE);
+		return EX_ARGS;
+	}
+	if (degree == 0) {
+		fprintf(stderr, "Error: '%s' is constant.\n", arguments->function);
+		return EX_ARGS;
+	}
+
+	size_t count = method_polynomial_roots(coefficients, degree, real, imaginary, &error);
+	if (count == 0) {return error;}
+
+	printf("  The %zu root(s) of \'%s\' are:\n", count, arguments->function);
+	for (size_t i = 0; i < count; ++i) {
+		double a = printed(real[i]);
+		if (imaginary[i] == 0) {printf("    %f\n", a);}
+		else {printf("    %f %c %fi\n", a, imaginary[i] < 0 ? '-' : '+', fabs(imaginary[i]));}
+	}
+	return error;
+}
+
+int solve_with_solver(const Arguments *arguments, SyntaxNodeArena *arena) {
+	static const struct {
+		const char  *name;
+		MethodSolver solver;
+	} solvers[] = {
+		{"newton" , METHOD_NEWTON   },
+		{"halley" , METHOD_HALLEY   },
+		{"damped" , METHOD_DAMPED   },
+		{"bracket", METHOD_BRACKETED},
+	};
+
+	int exit_status = EX_SUCCESS;
+	MethodOptions options = method_default_options;
+	SyntaxNode *trees[3] = {NULL}; /* Function and its derivatives.  */
+	VMCode      codes[3] = {{.length = 0, .capacity = 0, .depth = 0, .code = NULL},
+	                        {.length = 0, .capacity = 0, .depth = 0, .code = NULL},
+	                        {.length = 0, .capacity = 0, .depth = 0, .code = NULL}};
+	VMCode      floats[2] = {{.length = 0, .capacity = 0, .depth = 0, .code = NULL},
+	                         {.length = 0, .capacity = 0, .depth = 0, .code = NULL}};
+	size_t      count    = 2;      /* Number of trees to compile.   */
+	/* The mixed solver is plain Newton's method in float first. */
+	int         mixed    = arguments->solver && strcmp(arguments->solver, "mixed") == 0;
+
+	if (mixed && (arguments->f_tolerance || arguments->x_tolerance || arguments->print)) {
+		fprintf(stderr, "Error: the mixed solver takes neither tolerances nor --p.\n");
+		print_usage();
+		return EX_ARGS;
+	}
+	if (arguments->solver && !mixed) {
+		size_t i = 0;
+		while (i < sizeof solvers / sizeof solvers[0] && strcmp(solvers[i].name, arguments->solver) != 0) {++i;}
+		if (i == sizeof solvers / sizeof solvers[0]) {
+			fprintf(stderr, "Error: unknown solver '%s'.\n", arguments->solver);
+			print_usage();
+			return EX_ARGS;
+		}
+		options.solver = solvers[i].solver;
+	}
+	if (arguments->f_tolerance) {options.f_tolerance = strtod(arguments->f_tolerance, NULL);}
+	if (arguments->x_tolerance) {options.x_tolerance = strtod(arguments->x_tolerance, NULL);}
+	if (arguments->print) {options.print = 1;}
+	if (options.solver == METHOD_BRACKETED) {
+		if (!(arguments->lower && arguments->upper)) {
+			fprintf(stderr, "Error: the bracketed solver needs a bracket --a lower --b upper.\n");
+			print_usage();
+			return EX_ARGS;
+		}
+		options.lower = strtod(arguments->lower, NULL);
+		options.upper = strtod(arguments->upper, NULL);
+	} else if (!arguments->guess) {
+		fprintf(stderr, "Error: the solver needs a guess.\n");
+		print_usage();
+		return EX_ARGS;
+	}
+	if (options.solver == METHOD_HALLEY) {count = 3;}
+
+	if (compiler_frontend_arena(arguments->function, arena, &trees[0])) {
+		fprintf(stderr, "Compiler frontend error.\n");
+		return EX_COMPILER;
+	}
+	syntax_node_arena_simplify(arena, trees[0]);
+	for (size_t i = 1; i < count; ++i) {
+		trees[i] = syntax_node_arena_derive(arena, trees[i - 1]);
+		if (!trees[i]) {
+			fprintf(stderr, "Error: could not derive the function.\n");
+			return EX_COMPILER;
+		}
+		syntax_node_arena_simplify(arena, trees[i]);
+	}
+	for (size_t i = 0; i < count; ++i) {
+		if (compile_tree(trees[i], VM_DOUBLE, &codes[i]) != 0) {exit_status = EX_COMPILER; goto end;}
+	}
+
+	/* Without a guess the bracketed solver starts in the middle of the bracket. */
+	double x_0 = arguments->guess ? strtod(arguments->guess, NULL) : (options.lower + options.upper) / 2;
+	double x_n;
+	if (mixed) {
+		for (size_t i = 0; i < count; ++i) {
+			if (compile_tree(trees[i], VM_FLOAT, &floats[i]) != 0) {exit_status = EX_COMPILER; goto end;}
+		}
+		method_iterate_mixed(codes[0], codes[1], floats[0], floats[1], &x_0, &x_n, &exit_status, 1);
+	} else {
+		x_n = method_solve(codes[0], codes[1], codes[2], x_0, &options, &exit_status);
+	}
+	if (exit_status != EX_SUCCESS) {goto end;}
+
+	printf("  The root of \'%s\' with starting value %f is: %f.\n", arguments->function, x_0, x_n);
+
+end:
+	for (size_t i = 0; i < count; ++i) {vm_code_clear(&codes[i]);}
+	for (size_t i = 0; i < 2; ++i) {vm_code_clear(&floats[i]);}
+	return exit_status;
+}
+
+int solve_system(const Arguments *arguments) {
+	int exit_status = EX_SUCCESS;
+	const char *sources[MAX_VARIABLES], *guesses[MAX_VARIABLES];
+	double x[MAX_VARIABLES];
+	char *functions = malloc(strlen(arguments->function) + 1);
+	char *values    = arguments->guess ? malloc(strlen(arguments->guess) + 1) : NULL;
+	NewtonSystem *system = NULL;
+
+	if (!arguments->guess) {
+		fprintf(stderr, "Error: a system needs one guess per function.\n");
+		print_usage();
+		exit_status = EX_ARGS;
+		goto end;
+	}
+	if (!functions || !values) {
+		fprintf(stderr, "Memory error: could not copy the system.\n");
+		exit_status = EX_COMPILER;
+		goto end;
+	}
+	strcpy(functions, arguments->function);
+	strcpy(values   , arguments->guess);
+
+	size_t count = split_list(functions, sources, MAX_VARIABLES);
+	if (count == 0 || split_list(values, guesses, MAX_VARIABLES) != count) {
+		fprintf(stderr, "Error: a system needs one guess per function, and at most %i functions.\n", MAX_VARIABLES);
+		print_usage();
+		exit_status = EX_ARGS;
+		goto end;
+	}
+	for (size_t i = 0; i < count; ++i) {x[i] = strtod(guesses[i], NULL);}
+
+	system = newton_system_compile(sources, count, &exit_status);
+	if (!system) {
+		fprintf(stderr, "Compiler error.\n");
+		exit_status = EX_COMPILER;
+		goto end;
+	}
+	newton_system_solve(system, x, &exit_status);
+	if (exit_status != EX_SUCCESS) {goto end;}
+
+	printf("  The root of the system \'%s\' with starting values %s is:\n", arguments->function, arguments->guess);
+	for (size_t i = 0; i < count; ++i) {printf("    x%zu = %f\n", i + 1, x[i]);}
+
+end:
+	newton_system_destroy(system);
+	free(functions);
+	free(values);
+	return exit_status;
+}
+
+size_t split_list(char *string, const char **parts, size_t limit) {
+	size_t count = 0;
+	for (char *part = string; part; ++count) {
+		if (count == limit) {return 0;}
+		parts[count] = part;
+		part = strchr(part, ';');
+		if (part) {*part++ = '\0';}
+	}
+	return count;
+}
+
+int compile_function(const Arguments *arguments, SyntaxNodeArena *arena, VMCartridge *cartridge, SyntaxNode **tree) {
+	SyntaxNode *function_tree = NULL;
+	SyntaxNode *derivative_tree;
+	char path[MAX_PATH_LENGTH];
+
+	int cached = arguments->cache && vm_cartridge_path(arguments->cache, arguments->function, path, sizeof path) == 0;
+	if (cached && vm_cartridge_load(path, cartridge) == 0) {
+		if (strcmp(cartridge->source, arguments->function) == 0) {return EX_SUCCESS;}
+		/* Another function with the same hash, it will be overwritten. */
+		vm_cartridge_unload(cartridge);
+	}
+
+	if (compiler_frontend_arena(arguments->function, arena, &function_tree)) {
+		fprintf(stderr, "Compiler frontend error.\n");
+		return EX_COMPILER;
+	}
+	syntax_node_arena_simplify(arena, function_tree); // optimizes the syntax tree
+	*tree = function_tree;
+	if (syntax_node_uses_indexed_variables(function_tree)) {
+		fprintf(stderr, "Error: indexed variables need a system of functions.\n");
+		return EX_COMPILER;
+	}
+
+	// The derivative is computed alongside the function by the VM, it is only
+	// needed for the cache.
+	if (compile_tree(function_tree, VM_DOUBLE, &cartridge->function) != 0) {return EX_COMPILER;}
+	if (!cached) {return EX_SUCCESS;}
+
+	derivative_tree = syntax_node_arena_derive(arena, function_tree);
+	if (!derivative_tree) {
+		fprintf(stderr, "Error: could not derive the function.\n");
+		return EX_COMPILER;
+	}
+	syntax_node_arena_simplify(arena, derivative_tree);
+	if (compile_tree(derivative_tree, VM_DOUBLE, &cartridge->derivative) != 0) {return EX_COMPILER;}
+
+	/* Not being able to write the cache is no reason to stop. */
+	vm_cartridge_write(path, arguments->function, cartridge->function, cartridge->derivative);
+	return EX_SUCCESS;
+}
+
+double printed(double x) {
+	return fabs(x) < 5e-7 ? 0.0 : x;
+}
+
+int compile_tree(const SyntaxNode *tree, VMPrecision precision, VMCode *code) {
+	VMCode *compiled = NULL;
+	if (compiler_backend_precision(tree, precision, &compiled) != 0) {
+		fprintf(stderr, "Compiler backend error.\n");
+		return 1;
+	}
+
+	/* The code is moved into the cartridge, only the wrapper goes. */
+	*code = *compiled;
+	free(compiled);
+	return 0;
+}
+
+int emit_c_source(const char *source, SyntaxNodeArena *arena, const char *name, int cpp) {
+	SyntaxNode *function = NULL;
+	if (compiler_frontend_arena(source, arena, &function)) {
+		fprintf(stderr, "Compiler frontend error.\n");
+		return EX_COMPILER;
+	}
+	syntax_node_arena_simplify(arena, function);
+
+	SyntaxNode *derivative = syntax_node_arena_derive(arena, function);
+	if (!derivative) {
+		fprintf(stderr, "Error: could not derive the function.\n");
+		return EX_COMPILER;
+	}
+	syntax_node_arena_simplify(arena, derivative);
+
+	int error = cpp ? compiler_backend_cpp(function, derivative, name, stdout)
+	                : compiler_backend_c(function, derivative, name, stdout);
+	if (error != 0) {
+		fprintf(stderr, "Compiler backend error.\n");
+		return EX_COMPILER;
+	}
+	return EX_SUCCESS;
+}
+
+int solve_stream(const Arguments *arguments) {
+	int    exit_status = EX_SUCCESS;
+	size_t number      = 0;    /* Number of the current line.      */
+	char  *previous    = NULL; /* Function of the previous job.    */
+	NewtonFunction *function = NULL; /* Handle of the previous job. */
+	struct job_reader reader = {.data = NULL, .size = 0, .position = 0, .line = NULL, .capacity = 0, .error = 0};
+	struct stat status;
+
+	if (strcmp(arguments->stream, "-") != 0) {
+		int file = open(arguments->stream, O_RDONLY);
+		if (file < 0) {
+			fprintf(stderr, "Error: could not open '%s': %s.\n", arguments->stream, strerror(errno));
+			return EX_ARGS;
+		}
+		if (fstat(file, &status) == 0 && status.st_size > 0) {
+			reader.size = (size_t)status.st_size;
+			reader.data = mmap(NULL, reader.size, PROT_READ, MAP_PRIVATE, file, 0);
+		}
+		close(file);
+		if (reader.data == MAP_FAILED) {
+			fprintf(stderr, "Error: could not map '%s': %s.\n", arguments->stream, strerror(errno));
+			return EX_ARGS;
+		}
+		if (!reader.data) {return EX_SUCCESS;} /* Empty file. */
+	}
+
+	NewtonCache *cache = newton_cache_create(STREAM_CACHE_CAPACITY);
+	if (!cache) {exit_status = EX_COMPILER; goto end;}
+	setvbuf(stdout, NULL, _IOFBF, STREAM_BUFFER_SIZE);
+
+	for (char *line; (line = read_job(&reader)); ) {
+		int    error = 0;
+		double root;
+		char  *rest;
+
+		++number;
+		if (line[strspn(line, " \t\r")] == '\0') {continue;}
+
+		char *tab = strrchr(line, '\t');
+		if (!tab) {
+			fprintf(stderr, "Line %zu: expected a function and a guess separated by a tab.\n", number);
+			goto failed;
+		}
+		*tab = '\0';
+		double guess = strtod(tab + 1, &rest);
+		if (rest == tab + 1 || rest[strspn(rest, " \r")] != '\0') {
+			fprintf(stderr, "Line %zu: invalid guess '%s'.\n", number, tab + 1);
+			goto failed;
+		}
+
+		if (!previous || strcmp(previous, line) != 0) {
+			newton_function_destroy(function);
+			free(previous);
+			previous = malloc(strlen(line) + 1);
+			function = previous ? newton_cache_lookup(cache, line, &error) : NULL;
+			if (!function) {
+				fprintf(stderr, "Line %zu: could not compile '%s'.\n", number, line);
+				free(previous);
+				previous = NULL;
+				goto failed;
+			}
+			strcpy(previous, line);
+		}
+
+		root = newton_function_solve(function, guess, &error);
+		if (error != 0) {
+			fprintf(stderr, "Line %zu: no root found.\n", number);
+			goto failed;
+		}
+		printf("%.17g\n", root);
+		continue;
+
+	failed:
+		exit_status = EX_COMPILER;
+		printf("nan\n");
+	}
+	if (reader.error) {exit_status = EX_ARGS;}
+
+end:
+	newton_function_destroy(function);
+	newton_cache_destroy(cache);
+	free(previous);
+	free(reader.line);
+	if (reader.data) {munmap((void *)reader.data, reader.size);}
+	fflush(stdout);
+	return exit_status;
+}
+
+char *read_job(struct job_reader *reader) {
+	size_t length;
+
+	if (!reader->data) {
+		ssize_t read = getline(&reader->line, &reader->capacity, stdin);
+		if (read < 0) {
+			if (ferror(stdin)) {
+				fprintf(stderr, "Error: could not read jobs: %s.\n", strerror(errno));
+				reader->error = 1;
+			}
+			return NULL;
+		}
+		length = (size_t)read;
+	} else {
+		if (reader->position >= reader->size) {return NULL;}
+		const char *start = reader->data + reader->position;
+		const char *stop  = memchr(start, '\n', reader->size - reader->position);
+		length = stop ? (size_t)(stop - start) + 1 : reader->size - reader->position;
+		reader->position += length;
+
+		if (length + 1 > reader->capacity) {
+			char *line = realloc(reader->line, length + 1);
+			if (!line) {
+				fprintf(stderr, "Memory error: could not read line of jobs.\n");
+				reader->error = 1;
+				return NULL;
+			}
+			reader->line     = line;
+			reader->capacity = length + 1;
+		}
+		memcpy(reader->line, start, length);
+		reader->line[length] = '\0';
+	}
+
+	if (length > 0 && reader->line[length - 1] == '\n') {reader->line[--length] = '\0';}
+	return reader->line;
+}
+
 void print_usage(void) {
 	printf(
 		"Usage: newton --f function --g guess [--p]\n"
@@ -132,8 +786,38 @@ void print_usage(void) {
 		"Or:    newtown 'f' 'g'\n"
 		"       where 'f' is the function and 'g' the guessed root.\n"
 		"\n"
+		"Or:    newton --f function --a lower --b upper [--n seeds] [--t threads]\n"
+		"       to search the interval [lower, upper] for all roots.\n"
+		"\n"
+		"Or:    newton --f function --c name\n"
+		"       to write C source code of 'name' and 'name_derivative'.\n"
+		"\n"
+		"Or:    newton --f function --k name\n"
+		"       to write a C++ kernel 'name' for newton::solve<name> of newton.hpp.\n"
+		"\n"
+		"Or:    newton --f polynomial --r\n"
+		"       to find all real and complex roots of a polynomial in x.\n"
+		"\n"
+		"Or:    newton --f 'f1; f2; ...' --g 'g1; g2; ...'\n"
+		"       to solve a system of functions in the variables x1, x2, ...\n"
+		"\n"
+		"Or:    newton --s jobs\n"
+		"       to solve every line 'function<tab>guess' of the file 'jobs',\n"
+		"       or of the standard input if 'jobs' is '-'.\n"
+		"\n"
+		"Or:    newton --f function --g guess --m solver [--e f_tolerance] [--x x_tolerance]\n"
+		"       to solve with 'newton', 'halley', 'damped', 'bracket' or 'mixed'.\n"
+		"       The bracketed solver takes --a lower --b upper as the bracket, the\n"
+		"       guess is optional. The method stops once |f| < f_tolerance or the\n"
+		"       step is below x_tolerance relative to the root. The mixed solver\n"
+		"       takes neither tolerances nor --p.\n"
+		"\n"
+		"Solving and searching can take --d directory to keep compiled functions in\n"
+		"that directory, so the same function is only compiled once.\n"
+		"\n"
 		"Both options are equally valid, it's a matter of personal preference.\n"
 		"The optional --p flat prints the iteration steps.\n"
+		"When searching, Newton's method is run from 'seeds' evenly spread\n"
+		"starting values on 'threads' threads at once.\n"
 	);
 }
-
@@ -26,5 +26,14 @@
 /** Maximum arity of any operator */
 #define MAX_ARITY  2
 
+/** Maximum index of an indexed variable x1, x2, ...
+ *
+ *  The index of a variable takes one byte of bytecode.
+ */
+#define MAX_VARIABLES  255
+
+/** Maximum degree of a polynomial which gets a fast path of its own. */
+#define POLYNOMIAL_MAX_DEGREE  64
+
 #endif /* NEWTON_NEWTON_H */
 
@@ -0,0 +1,65 @@
+#define _POSIX_C_SOURCE 200809L /* pthreads, clock_gettime */
+
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "statistics.h"
+
+/* The statistics of each thread are found through a thread-specific key,
+ * which is created the first time it is needed. Hooks look the statistics up
+ * once per call of a function and not once per opcode.
+ */
+
+/** Key of the statistics of each thread. */
+static pthread_key_t key;
+
+/** Makes sure the key is created only once. */
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+/** Whether the key could be created. */
+static int key_valid = 0;
+
+/** Creates the key. */
+static void create_key(void);
+
+
+void statistics_attach(NewtonStatistics *statistics) {
+	pthread_once(&key_once, create_key);
+	if (key_valid) {pthread_setspecific(key, statistics);}
+}
+
+NewtonStatistics *statistics_current(void) {
+	pthread_once(&key_once, create_key);
+	return key_valid ? pthread_getspecific(key) : NULL;
+}
+
+void statistics_reset(NewtonStatistics *statistics) {
+	memset(statistics, 0, sizeof *statistics);
+}
+
+uint64_t statistics_cycles(void) {
+	#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+	return __builtin_ia32_rdtsc();
+	#else
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+	#endif
+}
+
+void statistics_count_allocation(void) {
+	NewtonStatistics *statistics = statistics_current();
+	if (statistics) {++statistics->allocations;}
+}
+
+void statistics_count_solve(NewtonStatistics *statistics, int iterations, int exit_status) {
+	if (!statistics) {return;}
+	++statistics->solves;
+	statistics->iterations += (uint64_t)iterations;
+	if (exit_status != 0) {++statistics->failures;}
+}
+
+static void create_key(void) {
+	key_valid = pthread_key_create(&key, NULL) == 0;
+}
@@ -0,0 +1,87 @@
+#ifndef NEWTON_STATISTICS_H
+#define NEWTON_STATISTICS_H
+
+/** @file statistics.h
+ *
+ *  Instrumentation of the virtual machine, Newton's method and allocations.
+ *
+ *  Statistics are only collected if the program is compiled with
+ *  `NEWTON_STATISTICS` defined, otherwise every hook disappears from the code
+ *  and costs nothing at all. The functions of this file exist either way, so
+ *  code using them compiles without the flag, the statistics just remain 0.
+ *
+ *  Statistics are collected per thread: a thread attaches its own statistics
+ *  structure and everything the thread does from then on is counted into it,
+ *  without any locking. Threads started by the program, like the threads of
+ *  `method_search`, have nothing attached and are not counted. The structure
+ *  belongs to the caller, who can read it at any time, reset it, or hand it to
+ *  whatever collects metrics.
+ *
+ *  Cycles are read from the time stamp counter on x86 processors and are
+ *  nanoseconds everywhere else. Measuring every single opcode has a cost of
+ *  its own, so compare cycles between opcodes rather than with timings of an
+ *  uninstrumented build.
+ */
+
+#include <stdint.h>
+
+/** Turns a statement into an instrumentation hook.
+ *
+ *  The statement is only compiled if `NEWTON_STATISTICS` is defined.
+ */
+#ifdef NEWTON_STATISTICS
+	#define STATISTICS(...)  __VA_ARGS__
+#else
+	#define STATISTICS(...)
+#endif
+
+/** Number of possible opcodes, one entry per value of an opcode byte. */
+#define STATISTICS_OPCODES  256
+
+/** Statistics collected by one thread. */
+typedef struct newton_statistics {
+	uint64_t opcode_count [STATISTICS_OPCODES]; /**< Executions per opcode.  */
+	uint64_t opcode_cycles[STATISTICS_OPCODES]; /**< Cycles per opcode.      */
+	uint64_t solves;            /**< Number of runs of Newton's method.       */
+	uint64_t iterations;        /**< Iterations of all runs together.         */
+	uint64_t failures;          /**< Runs which did not converge.             */
+	uint64_t function_cycles;   /**< Cycles evaluating the function.          */
+	uint64_t derivative_cycles; /**< Cycles evaluating the derivative.        */
+	uint64_t allocations;       /**< Number of allocations and reallocations. */
+} NewtonStatistics;
+
+/** Attaches statistics to the calling thread.
+ *
+ *  @param statistics  Statistics to count into, `NULL` to stop counting.
+ *
+ *  The statistics are not reset, counting continues from their current state.
+ */
+void statistics_attach(NewtonStatistics *statistics);
+
+/** Statistics of the calling thread.
+ *
+ *  @return  The attached statistics, `NULL` if there are none.
+ */
+NewtonStatistics *statistics_current(void);
+
+/** Resets all counters to 0.
+ *
+ *  @param statistics  The statistics to reset.
+ */
+void statistics_reset(NewtonStatistics *statistics);
+
+/** Current value of the cycle counter. */
+uint64_t statistics_cycles(void);
+
+/** Counts a finished run of Newton's method.
+ *
+ *  @param statistics   Statistics of the thread, or `NULL`.
+ *  @param iterations   Number of iterations of the run.
+ *  @param exit_status  Exit status of the run, non-0 if it failed.
+ */
+void statistics_count_solve(NewtonStatistics *statistics, int iterations, int exit_status);
+
+/** Counts one allocation for the calling thread, if it has statistics. */
+void statistics_count_allocation(void);
+
+#endif /* NEWTON_STATISTICS_H */
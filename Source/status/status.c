@@ -0,0 +1,60 @@
+#define _POSIX_C_SOURCE 200809L /* pthreads */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "status.h"
+
+/* The status of each thread is found through a thread-specific key, the same
+ * way as the statistics are. Errors are rare, looking the status up on every
+ * report costs nothing worth mentioning.
+ */
+
+/** Key of the status of each thread. */
+static pthread_key_t key;
+
+/** Makes sure the key is created only once. */
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+
+/** Whether the key could be created. */
+static int key_valid = 0;
+
+/** Creates the key. */
+static void create_key(void);
+
+
+void status_attach(NewtonStatus *status) {
+	pthread_once(&key_once, create_key);
+	if (key_valid) {pthread_setspecific(key, status);}
+}
+
+NewtonStatus *status_current(void) {
+	pthread_once(&key_once, create_key);
+	return key_valid ? pthread_getspecific(key) : NULL;
+}
+
+void status_reset(NewtonStatus *status) {
+	status->errors     = 0;
+	status->message[0] = '\0';
+}
+
+void status_report(const char *format, ...) {
+	NewtonStatus *status = status_current();
+	va_list arguments;
+
+	va_start(arguments, format);
+	if (!status) {
+		vfprintf(stderr, format, arguments);
+	} else if (status->errors++ == 0) {
+		vsnprintf(status->message, STATUS_MESSAGE, format, arguments);
+		size_t length = strlen(status->message);
+		if (length > 0 && status->message[length - 1] == '\n') {status->message[length - 1] = '\0';}
+	}
+	va_end(arguments);
+}
+
+static void create_key(void) {
+	key_valid = pthread_key_create(&key, NULL) == 0;
+}
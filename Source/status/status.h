@@ -0,0 +1,65 @@
+#ifndef NEWTON_STATUS_H
+#define NEWTON_STATUS_H
+
+/** @file status.h
+ *
+ *  Error messages of the compiler, the virtual machine and the methods.
+ *
+ *  Errors are detected deep inside the program, far from any code which could
+ *  do something about them, and are reported with a message at the point
+ *  where they are detected; the functions themselves only return an error
+ *  code. By default the messages go to the standard error, which is right for
+ *  the command-line program.
+ *
+ *  A thread can attach a status of its own instead, just like it attaches
+ *  statistics. From then on every message of that thread is recorded in the
+ *  status and nothing is printed, so a program running many solves at once
+ *  can tell which error belongs to which of them. The status belongs to the
+ *  caller and no other thread ever touches it, there is no locking.
+ */
+
+#include <stddef.h>
+
+/** Maximum length of a recorded message, including the terminating 0. */
+#define STATUS_MESSAGE  256
+
+/** Errors reported by one thread. */
+typedef struct newton_status {
+	size_t errors;                 /**< Number of messages reported.       */
+	char   message[STATUS_MESSAGE]; /**< The first message, cut off if it
+	                                 *   is too long, without the newline. */
+} NewtonStatus;
+
+/** Attaches a status to the calling thread.
+ *
+ *  @param status  Status to record messages in, `NULL` to print them again.
+ *
+ *  The status is not reset, recording continues from its current state.
+ */
+void status_attach(NewtonStatus *status);
+
+/** Status of the calling thread.
+ *
+ *  @return  The attached status, `NULL` if there is none.
+ */
+NewtonStatus *status_current(void);
+
+/** Clears all errors of a status.
+ *
+ *  @param status  The status to reset.
+ */
+void status_reset(NewtonStatus *status);
+
+/** Reports an error.
+ *
+ *  @param format  Format of the message, as for `printf`, followed by its
+ *                 arguments.
+ *
+ *  The message is recorded in the status of the calling thread, or printed to
+ *  the standard error if the thread has no status. Only the first message is
+ *  kept, it is the one which is closest to the cause; the messages after it
+ *  are usually the callers giving up one after the other.
+ */
+void status_report(const char *format, ...);
+
+#endif /* NEWTON_STATUS_H */
@@ -6,6 +6,9 @@
 #include <math.h>
 
 #include "syntax_node.h"
+#include "syntax_node_builder.h"
+#include "../statistics/statistics.h"
+#include "../status/status.h"
 
 /** Syntax node operation for number nodes.
  *
@@ -147,11 +150,13 @@ static double syntax_node_operation_failure(SyntaxNode *node, double value);
  *  The derivative of a number node or a constant node is always a number node
  *  with numeric value 0.
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_number(const SyntaxNode * const node);
+static SyntaxNode *derive_number(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives negation nodes.
  *
@@ -161,11 +166,13 @@ static SyntaxNode *derive_number(const SyntaxNode * const node);
  *
  *  @f[ (-f)' = - f' @f]
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_negate(const SyntaxNode * const node);
+static SyntaxNode *derive_negate(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives addition nodes.
  *
@@ -174,11 +181,13 @@ static SyntaxNode *derive_negate(const SyntaxNode * const node);
  *
  *  @f[ (f + g)' = f' + g' @f]
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_plus(const SyntaxNode * const node);
+static SyntaxNode *derive_plus(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives subtraction nodes.
  *
@@ -187,11 +196,13 @@ static SyntaxNode *derive_plus(const SyntaxNode * const node);
  *
  *  @f[ (f - g)' = f' - g' @f]
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_minus(const SyntaxNode * const node);
+static SyntaxNode *derive_minus(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives multiplication nodes.
  *
@@ -202,11 +213,13 @@ static SyntaxNode *derive_minus(const SyntaxNode * const node);
  *
  *  @f[ (f g)' = f' g + f g' @f]
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_times(const SyntaxNode * const node);
+static SyntaxNode *derive_times(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives division nodes.
  *
@@ -218,11 +231,13 @@ static SyntaxNode *derive_times(const SyntaxNode * const node);
  *
  *  @f[ \left( \frac{f}{g} \right)' = \frac{ (f' g - f g') }{ g^2 } @f]
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_divide(const SyntaxNode * const node);
+static SyntaxNode *derive_divide(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives power-of nodes.
  *
@@ -236,11 +251,13 @@ static SyntaxNode *derive_divide(const SyntaxNode * const node);
  *
  *  in which case negative values for the child are allowed.
  *
- *  @param node  The node we derive from
+ *  @param node      The node we derive from (read-only)
+ *  @param builder   Builder of the new nodes
+ *  @param variable  Index of the variable to derive by
  *
  *  @return  Pointer to node derived from the @a node
  */
-static SyntaxNode *derive_power(const SyntaxNode * const node);
+static SyntaxNode *derive_power(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives exponential function nodes.
  *
@@ -251,11 +268,13 @@ static SyntaxNode *derive_power(const SyntaxNode * const node);
  *
  *  @f[ \exp'(f) = f' \cdot \exp(f) @f]
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_exp(const SyntaxNode * const node);
+static SyntaxNode *derive_exp(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives natural logarithm nodes.
  *
@@ -264,11 +283,13 @@ static SyntaxNode *derive_exp(const SyntaxNode * const node);
  *
  *  @f[ \ln'(f) = \frac{f'}{f} @f]
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_ln(const SyntaxNode * const node);
+static SyntaxNode *derive_ln(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives sine nodes.
  *
@@ -278,11 +299,13 @@ static SyntaxNode *derive_ln(const SyntaxNode * const node);
  *
  *  @f[ \sin'(f) = f' \cdot \cos(f) @f]
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_sine(const SyntaxNode * const node);
+static SyntaxNode *derive_sine(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives cosine nodes.
  *
@@ -292,11 +315,13 @@ static SyntaxNode *derive_sine(const SyntaxNode * const node);
  *
  *  @f[ \cos'(f) = -f' \cdot \sin(f) @f]
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_cosine(const SyntaxNode * const node);
+static SyntaxNode *derive_cosine(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives tangent nodes.
  *
@@ -306,24 +331,29 @@ static SyntaxNode *derive_cosine(const SyntaxNode * const node);
  *
  *  @f[ \tan'(f) = f' \cdot \frac{ \sin(f) }{ \cos(f) } @f]
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_tangent(const SyntaxNode * const node);
+static SyntaxNode *derive_tangent(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** Derives variable nodes.
  *
- *  The derivative of a variable node is always a number node with value 1.
+ *  The derivative of a variable node is a number node with value 1 if it is
+ *  the variable to derive by, and with value 0 otherwise.
  *
- *  @param node  The node we derive from.
+ *  @param node      The node we derive from (read-only).
+ *  @param builder   Builder of the new nodes.
+ *  @param variable  Index of the variable to derive by.
  *
  *  @return  Pointer to node derived from the @a node.
  */
-static SyntaxNode *derive_x(const SyntaxNode * const node);
+static SyntaxNode *derive_x(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 /** This should never happen and if it does it's a program error. */
-static SyntaxNode *derive_failure(const SyntaxNode * const node);
+static SyntaxNode *derive_failure(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
 
 
 /** Array holding the arity for each operator.
@@ -333,7 +363,7 @@ static SyntaxNode *derive_failure(const SyntaxNode * const node);
  *  operator simply pass the operator as the index, like
  *  `operator_arity[TIMES_OP]`.
  */
-static int operator_arity[NUMBER_OF_OPERATORS] = {
+const int operator_arity[NUMBER_OF_OPERATORS] = {
 	[ OP_UNKNOWN     ] = 0,
 	[ OP_NUMBER      ] = 0,
 	[ OP_NEGATE      ] = 1,
@@ -363,7 +393,7 @@ static int operator_arity[NUMBER_OF_OPERATORS] = {
  *  the number of operators, because we don't need any operation for
  *  parentheses.
  */
-static double (*operation_list[NUMBER_OF_OPERATORS])(SyntaxNode *node, double value) = {
+static double (*const operation_list[NUMBER_OF_OPERATORS])(SyntaxNode *node, double value) = {
 	[ OP_UNKNOWN     ] = syntax_node_operation_failure               ,
 	[ OP_NUMBER      ] = syntax_node_operation_number_value          ,
 	[ OP_NEGATE      ] = syntax_node_operation_negate                ,
@@ -384,7 +414,7 @@ static double (*operation_list[NUMBER_OF_OPERATORS])(SyntaxNode *node, double va
 	[ OP_RIGHT_BRACE ] = syntax_node_operation_failure               ,
 };
 
-unsigned int operator_precedence[NUMBER_OF_OPERATORS] = {
+const unsigned int operator_precedence[NUMBER_OF_OPERATORS] = {
 	[ OP_NUMBER      ] = 0, /* error if this occurs */
 	[ OP_NEGATE      ] = 3,
 	[ OP_PLUS        ] = 1,
@@ -405,6 +435,27 @@ unsigned int operator_precedence[NUMBER_OF_OPERATORS] = {
 	[ OP_UNKNOWN     ] = 0, /* error if this occurs */
 };
 
+const char *const operator_to_string[NUMBER_OF_OPERATORS] = {
+	[ OP_UNKNOWN     ] = "?"  ,
+	[ OP_NUMBER      ] = "#"  ,
+	[ OP_NEGATE      ] = "-"  ,
+	[ OP_PLUS        ] = "+"  ,
+	[ OP_MINUS       ] = "-"  ,
+	[ OP_TIMES       ] = "*"  ,
+	[ OP_DIVIDE      ] = "/"  ,
+	[ OP_POWER       ] = "^"  ,
+	[ OP_EXP         ] = "exp",
+	[ OP_LN          ] = "ln" ,
+	[ OP_SIN         ] = "sin",
+	[ OP_COS         ] = "cos",
+	[ OP_TAN         ] = "tan",
+	[ OP_X_VAR       ] = "x"  ,
+	[ OP_PI          ] = "pi" ,
+	[ OP_E           ] = "e"  ,
+	[ OP_LEFT_BRACE  ] = "("  ,
+	[ OP_RIGHT_BRACE ] = ")"  ,
+};
+
 /** Array of function pointers to derivation functions.
  *
  *  This array maps an operator to a corresponding derivation method. The
@@ -414,7 +465,7 @@ unsigned int operator_precedence[NUMBER_OF_OPERATORS] = {
  *  array is *array of pointers to functions that take a pointer to a syntax
  *  node as the argument and return a pointer to another syntax node*.
  */
-static SyntaxNode * (*derivation_table[NUMBER_OF_OPERATORS])(const SyntaxNode * const node) = {
+static SyntaxNode * (*const derivation_table[NUMBER_OF_OPERATORS])(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) = {
 	[ OP_NUMBER      ] = derive_number  ,
 	[ OP_NEGATE      ] = derive_negate  ,
 	[ OP_PLUS        ] = derive_plus    ,
@@ -438,8 +489,9 @@ static SyntaxNode * (*derivation_table[NUMBER_OF_OPERATORS])(const SyntaxNode *
 
 SyntaxNode* syntax_node_construct(Operator op, double number) {
 	SyntaxNode *ptr = (SyntaxNode *)malloc(sizeof(SyntaxNode));
+	STATISTICS(statistics_count_allocation();)
 	if (!ptr) {
-		fprintf(stderr, "Memory error: Could not allocate memory for syntax node.\n");
+		status_report("Memory error: Could not allocate memory for syntax node.\n");
 		return NULL;
 	}
 	*ptr = (SyntaxNode){op, number, operator_arity[op]};
@@ -449,7 +501,7 @@ SyntaxNode* syntax_node_construct(Operator op, double number) {
 SyntaxNode *syntax_node_copy(const SyntaxNode * const original){
 	SyntaxNode * const copy = syntax_node_construct(original->operator_value, original->numeric_value);
 	if (!copy) {
-		fprintf(stderr, "Memory error: Could not copy syntax node.\n");
+		status_report("Memory error: Could not copy syntax node.\n");
 		return NULL;
 	}
 
@@ -484,6 +536,10 @@ void syntax_node_destroy(SyntaxNode *node) {
 }
 
 int syntax_node_condense(SyntaxNode *node) {
+	return syntax_node_arena_condense(NULL, node);
+}
+
+int syntax_node_arena_condense(SyntaxNodeArena *arena, SyntaxNode *node) {
 	// a variable can never be condensed
 	if (node->operator_value == OP_X_VAR) {
 		return 0;
@@ -495,7 +551,7 @@ int syntax_node_condense(SyntaxNode *node) {
 	// now check if the operands can all be condensed by recursively condensing them.
 	for (int i = 0; i < node->arity; i++) {
 		// if at least one operand is not condensable the value will be 0
-		condensable *= syntax_node_condense(node->operand[i]);
+		condensable *= syntax_node_arena_condense(arena, node->operand[i]);
 	}
 	
 	// if we can condense we should do so now
@@ -506,7 +562,7 @@ int syntax_node_condense(SyntaxNode *node) {
 		node->operator_value = OP_NUMBER;
 		// free all the child nodes, set their pointers to NULL...
 		for (int i = 0; i < node->arity; ++i) {
-			syntax_node_destroy(node->operand[i]);
+			syntax_node_arena_destroy(arena, node->operand[i]);
 			node->operand[i] = NULL;
 		}
 		// ... and set he node's arity to 0.
@@ -525,13 +581,21 @@ int syntax_node_is_constant(SyntaxNode *node) {
 	int is_constant = 1; /* True */
 	for (int i = 0; i < node->arity; i++) {
 		/* If any child is not constant the result will be 0. */
-		is_constant *= syntax_node_is_constant(node->operand[0]);
+		is_constant *= syntax_node_is_constant(node->operand[i]);
 		if (!is_constant) {break;}
 	}
 
 	return is_constant;
 }
 
+int syntax_node_uses_indexed_variables(const SyntaxNode *node) {
+	if (node->operator_value == OP_X_VAR) {return node->numeric_value != 0;}
+	for (unsigned int i = 0; i < node->arity; ++i) {
+		if (syntax_node_uses_indexed_variables(node->operand[i])) {return 1;}
+	}
+	return 0;
+}
+
 /*--[ Operations ]------------------------------------------------------------*/
 
 double syntax_node_operate(SyntaxNode *node, double value) {
@@ -565,12 +629,8 @@ static double syntax_node_operation_multiply(SyntaxNode *node, double value) {
 
 static double syntax_node_operation_divide(SyntaxNode *node, double value) {
 	assert(node->operator_value == OP_DIVIDE);
-	double divisor = syntax_node_operate(node->operand[1], value);
-	if (divisor == 0) {
-		fprintf(stderr, "Method error: trying to divide by zero. Try another guess value.\n");
-		exit(1);
-	}
-	return syntax_node_operate(node->operand[0], value) / divisor;
+	/* Division by zero is infinite or NaN, just like in the virtual machine. */
+	return syntax_node_operate(node->operand[0], value) / syntax_node_operate(node->operand[1], value);
 }
 
 static double syntax_node_operation_power(SyntaxNode *node, double value) {
@@ -623,198 +683,129 @@ static double syntax_node_operation_failure(SyntaxNode *node, double value) {
 }
 
 SyntaxNode *syntax_node_derive(SyntaxNode *node) {
-	return derivation_table[node->operator_value](node);
+	return syntax_node_arena_derive(NULL, node);
 }
 
-static SyntaxNode *derive_number(const SyntaxNode * const node) {
-	assert(node->operator_value == OP_NUMBER);
-	return syntax_node_construct(OP_NUMBER, 0.0);
+SyntaxNode *syntax_node_arena_derive(SyntaxNodeArena *arena, const SyntaxNode *node) {
+	return syntax_node_arena_derive_partial(arena, node, 0);
 }
 
-static SyntaxNode *derive_negate(const SyntaxNode * const node) {
-	assert(node->operator_value == OP_NEGATE);
-	SyntaxNode *new_node = syntax_node_construct(OP_NEGATE, 0.0);
-	new_node->operand[0] = syntax_node_derive(node->operand[0]);
-	return new_node;
+SyntaxNode *syntax_node_arena_derive_partial(SyntaxNodeArena *arena, const SyntaxNode *node, unsigned int variable) {
+	SyntaxNodeBuilder builder = syntax_node_tree_builder(arena);
+	/* The rules never change the node, the builder only copies it. */
+	return syntax_node_build_derivative(&builder, (SyntaxNode *)node, variable);
 }
 
-static SyntaxNode *derive_plus(const SyntaxNode * const node) {
-	assert(node->operator_value == OP_PLUS);
-	SyntaxNode *new_node = syntax_node_construct(OP_PLUS, 0.0);
+SyntaxNode *syntax_node_build_derivative(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
+	return derivation_table[node->operator_value](builder, node, variable);
+}
 
-	new_node->operand[0] = syntax_node_derive(node->operand[0]);
-	new_node->operand[1] = syntax_node_derive(node->operand[1]);
+/* Shorthands for building the derivative. Every further use of a node of the
+ * original needs to be shared, the derivatives of the operands are new. */
+#define NODE(op, a, b)  builder->node(builder, OP_ ## op, 0.0, (a), (b))
+#define NUMBER(n)       builder->node(builder, OP_NUMBER, (n), NULL, NULL)
+#define SHARE(n)        builder->share(builder, (n))
+#define D(n)            builder->derive(builder, (n), variable)
 
-	return new_node;
+static SyntaxNode *derive_number(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
+	assert(node->operator_value == OP_NUMBER || node->operator_value == OP_PI || node->operator_value == OP_E);
+	return NUMBER(0.0);
 }
 
-static SyntaxNode *derive_minus(const SyntaxNode * const node) {
-	assert(node->operator_value == OP_MINUS);
-	SyntaxNode *new_node = syntax_node_construct(OP_MINUS, 0.0);
+static SyntaxNode *derive_negate(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
+	assert(node->operator_value == OP_NEGATE);
+	return NODE(NEGATE, D(node->operand[0]), NULL);
+}
 
-	new_node->operand[0] = syntax_node_derive(node->operand[0]);
-	new_node->operand[1] = syntax_node_derive(node->operand[1]);
+static SyntaxNode *derive_plus(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
+	assert(node->operator_value == OP_PLUS);
+	return NODE(PLUS, D(node->operand[0]), D(node->operand[1]));
+}
 
-	return new_node;
+static SyntaxNode *derive_minus(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
+	assert(node->operator_value == OP_MINUS);
+	return NODE(MINUS, D(node->operand[0]), D(node->operand[1]));
 }
 
-static SyntaxNode *derive_times(const SyntaxNode * const node) {
+static SyntaxNode *derive_times(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
 	assert(node->operator_value == OP_TIMES);
-	SyntaxNode *new_node = syntax_node_construct(OP_PLUS, 0.0);
+	SyntaxNode *A = node->operand[0], *B = node->operand[1];
 
-	new_node->operand[0] = syntax_node_construct(OP_TIMES, 0.0);
-	new_node->operand[1] = syntax_node_construct(OP_TIMES, 0.0);
-	
-	new_node->operand[0]->operand[0] = syntax_node_derive(node->operand[0]);
-	new_node->operand[0]->operand[1] = syntax_node_copy(node->operand[1]);
-	
-	new_node->operand[1]->operand[0] = syntax_node_copy(node->operand[0]);
-	new_node->operand[1]->operand[1] = syntax_node_derive(node->operand[1]);
-	
-	return new_node;
+	/* A' * B + A * B' */
+	return NODE(PLUS, NODE(TIMES, D(A), SHARE(B)), NODE(TIMES, SHARE(A), D(B)));
 }
 
-static SyntaxNode *derive_divide(const SyntaxNode * const node) {
+static SyntaxNode *derive_divide(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
 	assert(node->operator_value == OP_DIVIDE);
-	SyntaxNode *new_node = syntax_node_construct(OP_DIVIDE, 0.0);
+	SyntaxNode *A = node->operand[0], *B = node->operand[1];
 
-	new_node->operand[0] = syntax_node_construct(OP_MINUS, 0.0);
-	new_node->operand[1] = syntax_node_construct(OP_TIMES, 0.0);
-	
-	new_node->operand[0]->operand[0] = syntax_node_construct(OP_TIMES, 0.0);
-	new_node->operand[0]->operand[1] = syntax_node_construct(OP_TIMES, 0.0);
-	
-	new_node->operand[0]->operand[0]->operand[0] = syntax_node_derive(node->operand[0]);
-	new_node->operand[0]->operand[0]->operand[1] = syntax_node_copy(node->operand[1]);
-	
-	new_node->operand[0]->operand[1]->operand[0] = syntax_node_copy(node->operand[0]);
-	new_node->operand[0]->operand[1]->operand[1] = syntax_node_derive(node->operand[1]);
-	
-	new_node->operand[1]->operand[0] = syntax_node_copy(node->operand[1]);
-	new_node->operand[1]->operand[1] = syntax_node_copy(node->operand[1]);
-	
-	return new_node;
+	/* (A' * B - A * B') / (B * B) */
+	return NODE(DIVIDE,
+		NODE(MINUS, NODE(TIMES, D(A), SHARE(B)), NODE(TIMES, SHARE(A), D(B))),
+		NODE(TIMES, SHARE(B), SHARE(B))
+	);
 }
 
-static SyntaxNode *derive_power(const SyntaxNode * const node) {
+static SyntaxNode *derive_power(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
 	assert(node->operator_value == OP_POWER);
-	SyntaxNode *new_node = syntax_node_construct(OP_TIMES, 0.0);
-	
+	SyntaxNode *A = node->operand[0], *B = node->operand[1];
+
+	// If the exponent is constant use the power rule B * A ^ (B - 1) * A'.
+	// The general rule below would need ln(A), which is forbidden for negative
+	// numbers, but pow(x, y) is allowed for negative x and integer y. It would
+	// also divide by A, which fails for A = 0.
+	if (syntax_node_is_constant(B)) {
+		return NODE(TIMES, NODE(TIMES, SHARE(B), NODE(POWER, SHARE(A), NODE(MINUS, SHARE(B), NUMBER(1.0)))), D(A));
+	}
+
 	/* A ^ B = exp(ln(A) * B)              */
 	/* A ^ B * ((A' / A) * B + ln(A) * B') */
-
-	new_node->operand[0] = syntax_node_construct(OP_POWER, 0.0);
-	new_node->operand[1] = syntax_node_construct(OP_PLUS , 0.0);
-
-	// A ^ B
-	new_node->operand[0]->operand[0] = syntax_node_copy(node->operand[0]);
-	new_node->operand[0]->operand[1] = syntax_node_copy(node->operand[1]);
-
-	// [A' / A] * [B] + [ln(A)] * [B']
-	new_node->operand[1]->operand[0] = syntax_node_construct(OP_TIMES, 0.0);
-	new_node->operand[1]->operand[1] = syntax_node_construct(OP_TIMES, 0.0);
-
-	// [A' / A] * [B]
-	new_node->operand[1]->operand[0]->operand[0] = syntax_node_construct(OP_DIVIDE, 0.0);
-	new_node->operand[1]->operand[0]->operand[1] = syntax_node_copy(node->operand[1]);
-
-	// A' / A
-	new_node->operand[1]->operand[0]->operand[0]->operand[0] = syntax_node_derive(node->operand[0]);
-	new_node->operand[1]->operand[0]->operand[0]->operand[1] = syntax_node_copy(  node->operand[0]);
-
-	// [ln(A)] * B'
-	new_node->operand[1]->operand[1]->operand[0] = syntax_node_construct(OP_LN, 0.0);
-	new_node->operand[1]->operand[1]->operand[1] = syntax_node_derive(node->operand[1]);
-
-	new_node->operand[1]->operand[1]->operand[0]->operand[0] = syntax_node_copy(node->operand[0]);
-	
-	// If the exponent is a real number, its derivative will be 0. Remove that
-	// part from the sum to remove the ln; we need to to this, because ln(x) is
-	// forbidden for negative numbers, but pow(x, y) is allowed for negative x and
-	// integer y.
-	if (syntax_node_is_constant(node->operand[1])) { // if the B can be condensed into a number
-		// destroy it the OP_TIMES from (ln(A) * B')
-		syntax_node_destroy(new_node->operand[1]->operand[1]);
-		// and create new node with a value of 0 in its place
-		new_node->operand[1]->operand[1] = syntax_node_construct(OP_NUMBER, 0.0);
-	}
-	
-	return new_node;
+	return NODE(TIMES,
+		SHARE(node),
+		NODE(PLUS, NODE(TIMES, NODE(DIVIDE, D(A), SHARE(A)), SHARE(B)), NODE(TIMES, NODE(LN, SHARE(A), NULL), D(B)))
+	);
 }
 
-static SyntaxNode *derive_exp(const SyntaxNode * const node) {
+static SyntaxNode *derive_exp(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
 	assert(node->operator_value == OP_EXP);
-	SyntaxNode *new_node = syntax_node_construct(OP_TIMES, 0.0);
-
-	new_node->operand[0] = syntax_node_derive(syntax_node_copy(node->operand[0]));
-	new_node->operand[1] = syntax_node_copy(node->operand[0]);
-
-	return new_node;
+	return NODE(TIMES, D(node->operand[0]), SHARE(node));
 }
 
-static SyntaxNode *derive_ln(const SyntaxNode * const node) {
+static SyntaxNode *derive_ln(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
 	assert(node->operator_value == OP_LN);
-	SyntaxNode *new_node = syntax_node_construct(OP_TIMES, 0.0);
-
-	new_node->operand[0] = syntax_node_derive(node->operand[0]);
-	new_node->operand[1] = syntax_node_construct(OP_DIVIDE, 0.0);
-
-	new_node->operand[1]->operand[0] = syntax_node_construct(OP_NUMBER, 1.0);
-	new_node->operand[1]->operand[1] = syntax_node_copy(node->operand[0]);
-
-	return new_node;
+	return NODE(TIMES, D(node->operand[0]), NODE(DIVIDE, NUMBER(1.0), SHARE(node->operand[0])));
 }
 
-static SyntaxNode *derive_sine(const SyntaxNode * const node) {
+static SyntaxNode *derive_sine(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
 	assert(node->operator_value == OP_SIN);
-	SyntaxNode *new_node = syntax_node_construct(OP_TIMES, 0.0);
-
-	new_node->operand[0] = syntax_node_derive(node->operand[0]);
-	new_node->operand[1] = syntax_node_construct(OP_COS, 0.0);
-
-	new_node->operand[1]->operand[0] = syntax_node_copy(node->operand[0]);
-
-	return new_node;
+	return NODE(TIMES, D(node->operand[0]), NODE(COS, SHARE(node->operand[0]), NULL));
 }
 
-static SyntaxNode *derive_cosine(const SyntaxNode * const node) {
+static SyntaxNode *derive_cosine(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
 	assert(node->operator_value == OP_COS);
-	SyntaxNode *new_node = syntax_node_construct(OP_TIMES, 0.0);
-
-	new_node->operand[0] = syntax_node_construct(OP_NUMBER, -1.0);
-	new_node->operand[1] = syntax_node_construct(OP_TIMES, 0);
-
-	new_node->operand[1]->operand[0] = syntax_node_construct(OP_SIN, 0);
-	new_node->operand[1]->operand[1] = syntax_node_derive(node->operand[0]);
-
-	new_node->operand[1]->operand[0]->operand[0] = syntax_node_copy(node->operand[0]);
-
-	return new_node;
+	return NODE(TIMES, NUMBER(-1.0), NODE(TIMES, NODE(SIN, SHARE(node->operand[0]), NULL), D(node->operand[0])));
 }
 
-static SyntaxNode *derive_tangent(const SyntaxNode * const node) {
+static SyntaxNode *derive_tangent(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
 	assert(node->operator_value == OP_TAN);
-	SyntaxNode *new_node = syntax_node_construct(OP_DIVIDE, 0.0);
-
-	new_node->operand[0] = syntax_node_derive(node->operand[0]);
-	new_node->operand[1] = syntax_node_construct(OP_POWER, 1.0);
-
-	new_node->operand[1]->operand[0] = syntax_node_construct(OP_COS, 1.0);
-	new_node->operand[1]->operand[1] = syntax_node_construct(OP_NUMBER, 2.0);
-
-	new_node->operand[1]->operand[0]->operand[0] = syntax_node_copy(node->operand[0]);
-	return new_node;
+	return NODE(DIVIDE, D(node->operand[0]), NODE(POWER, NODE(COS, SHARE(node->operand[0]), NULL), NUMBER(2.0)));
 }
 
-static SyntaxNode *derive_x(const SyntaxNode * const node) {
+static SyntaxNode *derive_x(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
 	assert(node->operator_value == OP_X_VAR);
-	return syntax_node_construct(OP_NUMBER, 1.0);
+	return NUMBER(node->numeric_value == variable ? 1.0 : 0.0);
 }
 
-static SyntaxNode *derive_failure(const SyntaxNode * const node) {
-	assert(0); /* Fails always. */
+static SyntaxNode *derive_failure(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
+	status_report("Syntax error: cannot derive operator %i.\n", node->operator_value);
+	return NULL;
 }
 
+#undef NODE
+#undef NUMBER
+#undef SHARE
+#undef D
+
 Operator char_to_operator(char *c) {
 	Operator o = OP_UNKNOWN;
 
@@ -37,7 +37,7 @@ typedef enum operator_type{
 	OP_SIN              , /**< Sine function.                 */
 	OP_COS              , /**< Cosine function.               */
 	OP_TAN              , /**< Tangent function.              */
-	OP_X_VAR            , /**< X variable.                    */
+	OP_X_VAR            , /**< X variable, or an indexed one. */
 	OP_PI               , /**< Constant π (pi).               */
 	OP_E                , /**< Constant e (Euler's number).   */
 	OP_LEFT_BRACE       , /**< Left parenthesis.              */
@@ -45,6 +45,11 @@ typedef enum operator_type{
 	NUMBER_OF_OPERATORS , /**< Total number or operators.     */
 } Operator;
 
+/** Largest integer exponent which is turned into a chain of multiplications
+ *  by the simplifier.
+ */
+#define MAX_POWER_CHAIN  8
+
 /** Precedence of the node's operator.
  *
  *  Higher number means higher precedence. Functions are the highest, followed
@@ -53,10 +58,17 @@ typedef enum operator_type{
  *  appear in a precedence comparison, i.e.  numbers, constants, variables and
  *  undefined operators. If they do it is an error.
  */
-unsigned int operator_precedence[NUMBER_OF_OPERATORS];
+extern const unsigned int operator_precedence[NUMBER_OF_OPERATORS];
+
+/** Arity of each operator, i.e. the number of its operands. */
+extern const int operator_arity[NUMBER_OF_OPERATORS];
 
-/** Maps an operator type to a string. */
-char *operator_to_string[NUMBER_OF_OPERATORS];
+/** Maps an operator type to a string.
+ *
+ *  The strings are the spelling of the operators in function strings, number
+ *  nodes are represented by `#` because their spelling is their value.
+ */
+extern const char *const operator_to_string[NUMBER_OF_OPERATORS];
 
 /** Struct representing a syntax tree node.
  *
@@ -72,10 +84,12 @@ typedef struct syntax_node {
 
 	/** Numeric value for number nodes.
 	 *
-	 *  If a node is not a number node this value will be ignored and is best
-	 *  set to 0. It might be possible to use the numeric value to store
-	 *  results of child operations for operator nodes, but such a feature is
-	 *  not planned and I am not certain if there would be any benefit to it.
+	 *  For a variable this is its index: 0 for X itself and `i` for the
+	 *  indexed variable `xi`. If a node is neither a number nor a variable
+	 *  node this value will be ignored and is best set to 0. It might be
+	 *  possible to use the numeric results of child operations for operator
+	 *  nodes, but such a feature is not planned and I am not certain if there
+	 *  would be any benefit to it.
 	 */
 	double numeric_value;
 
@@ -96,6 +110,28 @@ typedef struct syntax_node {
 	struct syntax_node *operand[MAX_ARITY];
 } SyntaxNode;
 
+/** Arena of syntax nodes.
+ *
+ *  Instead of allocating every node individually an arena hands out nodes from
+ *  large blocks of memory and releases all of them at once. This is meant for
+ *  entire trees which are built up and thrown away as a whole, like the ones
+ *  made by the compiler frontend or the derivation. A node from an arena must
+ *  never be passed to `syntax_node_destroy`; use the `syntax_node_arena_`
+ *  variants of the functions on it instead.
+ *
+ *  Every function taking an arena also accepts `NULL` for the arena, in which
+ *  case it behaves just like its counterpart without an arena and every node
+ *  is allocated on its own.
+ *
+ *  @sa syntax_node_arena_init, syntax_node_arena_release
+ */
+typedef struct syntax_node_arena {
+	struct syntax_node_arena_block *blocks; /**< Blocks, the newest first. */
+	size_t used;       /**< Number of nodes used in the newest block.     */
+	size_t block_size; /**< Number of nodes in the next block to allocate. */
+	size_t nodes;      /**< Number of nodes handed out in total.           */
+} SyntaxNodeArena;
+
 /** Creates a syntax node by allocation the memory, filling in the values and
  *  returning a pointer to it.
  *
@@ -160,6 +196,26 @@ double syntax_node_operate(SyntaxNode *node, double value);
  */
 int syntax_node_condense(SyntaxNode *node);
 
+/** Simplifies a (sub-)tree of syntax nodes algebraically.
+ *
+ *  This goes beyond condensing: the tree is first condensed, then rewritten
+ *  with algebraic identities until nothing more can be done. Identities like
+ *  @f$ f \cdot 1 = f @f$, @f$ f + 0 = f @f$ or @f$ --f = f @f$ remove nodes,
+ *  constants are gathered from products and sums and folded together even if
+ *  they were not adjacent, and small integer powers of variables become
+ *  products, like @f$ x^3 = x \cdot x \cdot x @f$. Derived trees especially
+ *  are full of such terms.
+ *
+ *  Like condensing the tree is changed in place and the root stays the root,
+ *  even if its contents change.
+ *
+ *  @param node  The root of the tree to simplify.
+ *
+ *  @return  0 on success, non-0 on error. On error the tree is still valid,
+ *           only not as simple as it could be.
+ */
+int syntax_node_simplify(SyntaxNode *node);
+
 /** Whether a syntax node, or rather its sub-tree, is a constant number or not.
  *
  *  Any node that does not contain any variable nodes in its sub-tree is a
@@ -171,6 +227,17 @@ int syntax_node_condense(SyntaxNode *node);
  */
 int syntax_node_is_constant(SyntaxNode *node);
 
+/** Whether a syntax tree uses any indexed variable x1, x2, ...
+ *
+ *  Only systems of functions have indexed variables, a single function has
+ *  only the variable x.
+ *
+ *  @param node  The root of the sub-tree we want to check.
+ *
+ *  @return  1 if it does, 0 otherwise.
+ */
+int syntax_node_uses_indexed_variables(const SyntaxNode *node);
+
 /** Takes in the root of a syntax tree and returns its derivative recursively.
  *
  *  This function works recursively: first it uses the node's operator to
@@ -186,6 +253,163 @@ int syntax_node_is_constant(SyntaxNode *node);
  */
 SyntaxNode *syntax_node_derive(SyntaxNode *node);
 
+/** Initialises an empty arena.
+ *
+ *  @param arena  The arena to initialise.
+ *  @param size   Number of nodes in the first block, 0 for a default size.
+ *
+ *  No memory is allocated until the first node is constructed. Every new block
+ *  is twice as large as the previous one.
+ */
+void syntax_node_arena_init(SyntaxNodeArena *arena, size_t size);
+
+/** Releases all the nodes of an arena at once.
+ *
+ *  @param arena  The arena to release.
+ *
+ *  All nodes ever constructed in the arena become invalid. The arena is empty
+ *  afterwards and can be used again.
+ */
+void syntax_node_arena_release(SyntaxNodeArena *arena);
+
+/** Invalidates all the nodes of an arena, but keeps its memory.
+ *
+ *  @param arena  The arena to reset.
+ *
+ *  Only the largest block is kept for the nodes to come, so an arena which is
+ *  reset and reused for trees of similar size stops allocating altogether.
+ */
+void syntax_node_arena_reset(SyntaxNodeArena *arena);
+
+/** Makes sure an arena can hand out a number of nodes without allocating.
+ *
+ *  @param arena  The arena, may be `NULL`.
+ *  @param count  Number of nodes to reserve.
+ *
+ *  @return  0 on success, non-0 on error.
+ *
+ *  If the newest block does not have enough room left a new block is added
+ *  which is large enough for all of them; the rest of the old block is not
+ *  used anymore.
+ */
+int syntax_node_arena_reserve(SyntaxNodeArena *arena, size_t count);
+
+/** Creates a syntax node in an arena.
+ *
+ *  @param arena   The arena to allocate the node in.
+ *  @param op      The operator token.
+ *  @param number  The number value for number nodes, *0* otherwise.
+ *
+ *  @return  Pointer to the created syntax node, `NULL` on failure.
+ *
+ *  @sa syntax_node_construct
+ */
+SyntaxNode *syntax_node_arena_construct(SyntaxNodeArena *arena, Operator op, double number);
+
+/** Copies a tree into an arena.
+ *
+ *  @param arena     The arena to allocate the copy in.
+ *  @param original  The original node to copy (read-only).
+ *
+ *  @return  Pointer to the copy, `NULL` on failure.
+ *
+ *  @sa syntax_node_copy
+ */
+SyntaxNode *syntax_node_arena_copy(SyntaxNodeArena *arena, const SyntaxNode *const original);
+
+/** Destroys a tree which belongs to an arena.
+ *
+ *  @param arena  The arena of the node.
+ *  @param node   The node to destroy.
+ *
+ *  Nodes in an arena are only released all at once, so this does nothing
+ *  unless the arena is `NULL`.
+ *
+ *  @sa syntax_node_destroy
+ */
+void syntax_node_arena_destroy(SyntaxNodeArena *arena, SyntaxNode *node);
+
+/** Condenses a tree which belongs to an arena.
+ *
+ *  @param arena  The arena of the tree.
+ *  @param node   The node we want to condense.
+ *
+ *  @return  1 if the condensing was successful, 0 if not.
+ *
+ *  @sa syntax_node_condense
+ */
+int syntax_node_arena_condense(SyntaxNodeArena *arena, SyntaxNode *node);
+
+/** Simplifies a tree which belongs to an arena.
+ *
+ *  @param arena  The arena of the tree.
+ *  @param node   The root of the tree to simplify.
+ *
+ *  @return  0 on success, non-0 on error.
+ *
+ *  @sa syntax_node_simplify
+ */
+int syntax_node_arena_simplify(SyntaxNodeArena *arena, SyntaxNode *node);
+
+/** Derives a tree into an arena.
+ *
+ *  @param arena  The arena to allocate the derived tree in.
+ *  @param node   The root note of the tree or sub-tree to derive.
+ *
+ *  @return  The root node of the derived tree or sub-tree.
+ *
+ *  The original tree does not need to belong to the same arena, or to any
+ *  arena at all. The derived tree shares no nodes with the original.
+ *
+ *  @sa syntax_node_derive
+ */
+SyntaxNode *syntax_node_arena_derive(SyntaxNodeArena *arena, const SyntaxNode *node);
+
+/** Derives a tree partially with respect to one variable into an arena.
+ *
+ *  @param arena     The arena to allocate the derived tree in.
+ *  @param node      The root note of the tree or sub-tree to derive.
+ *  @param variable  Index of the variable, 0 for X.
+ *
+ *  @return  The root node of the derived tree or sub-tree.
+ *
+ *  All other variables are held constant. Deriving with respect to X is the
+ *  same as `syntax_node_arena_derive`.
+ */
+SyntaxNode *syntax_node_arena_derive_partial(SyntaxNodeArena *arena, const SyntaxNode *node, unsigned int variable);
+
+/** Collects the coefficients of a tree which is a polynomial in X.
+ *
+ *  @param node          Root of the tree.
+ *  @param coefficients  Array of at least `POLYNOMIAL_MAX_DEGREE + 1` numbers
+ *                       to store the coefficients in, the coefficient of
+ *                       `x^k` is stored at index k.
+ *  @param degree        Pointer to store the degree of the polynomial in.
+ *
+ *  @return  0 if the tree is a polynomial, non-0 otherwise.
+ *
+ *  A tree is a polynomial if it is made of numbers, constants, X, sums,
+ *  differences, products, quotients by constants and powers with constant
+ *  non-negative integer exponents, whatever its shape. Trees of a higher
+ *  degree than `POLYNOMIAL_MAX_DEGREE` are not considered polynomials. Only
+ *  the coefficients up to the degree are written.
+ */
+int syntax_node_polynomial(const SyntaxNode *node, double *coefficients, size_t *degree);
+
+/** Whether a tree is written as a sum of monomials.
+ *
+ *  @param node  Root of the tree.
+ *
+ *  @return  1 if none of the terms of the tree contains a sum or difference,
+ *           0 otherwise.
+ *
+ *  Only then do the coefficients of `syntax_node_polynomial` evaluate to
+ *  about the same numbers as the tree. A product like @f$ (x - 1)(x - 2)
+ *  \cdots (x - 20) @f$ is exact near its roots, but its expanded coefficients
+ *  cancel there and lose all accuracy.
+ */
+int syntax_node_is_expanded(const SyntaxNode *node);
+
 /** Returns an operator based on the passed char.
  *
  *  @param c  pointer to a character to turn into operator.
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "syntax_node.h"
+#include "syntax_node_builder.h"
+#include "../statistics/statistics.h"
+#include "../status/status.h"
+
+/** Default number of nodes in the first block of an arena. */
+#define DEFAULT_BLOCK_SIZE  64
+
+/** Block of memory holding the nodes of an arena.
+ *
+ *  The blocks of an arena form a list, the newest block is at the head of the
+ *  list. Nodes are taken from the newest block until it is full, then a new
+ *  block twice the size is added in front.
+ */
+struct syntax_node_arena_block {
+	struct syntax_node_arena_block *next; /**< Next older block.         */
+	size_t     size;    /**< Number of nodes in this block.              */
+	SyntaxNode nodes[]; /**< The nodes themselves.                       */
+};
+
+/** Adds a new block in front of the blocks of an arena.
+ *
+ *  @param arena  The arena.
+ *  @param size   Number of nodes of the block.
+ *
+ *  @return  0 on success, non-0 on error.
+ *
+ *  The next block will be twice as large, so the newest block is always the
+ *  largest one.
+ */
+static int add_block(SyntaxNodeArena *arena, size_t size);
+
+/** Makes a tree node for the tree builder.
+ *
+ *  The operands become part of the new node, if it cannot be made they are
+ *  destroyed.
+ */
+static SyntaxNode *tree_node(const SyntaxNodeBuilder *builder, Operator op, double number, SyntaxNode *a, SyntaxNode *b);
+
+/** Copies a tree for the tree builder, trees never share nodes. */
+static SyntaxNode *tree_share(const SyntaxNodeBuilder *builder, SyntaxNode *node);
+
+void syntax_node_arena_init(SyntaxNodeArena *arena, size_t size) {
+	*arena = (SyntaxNodeArena){
+		.blocks     = NULL,
+		.used       = 0,
+		.block_size = size > 0 ? size : DEFAULT_BLOCK_SIZE,
+		.nodes      = 0,
+	};
+}
+
+void syntax_node_arena_release(SyntaxNodeArena *arena) {
+	struct syntax_node_arena_block *block = arena->blocks;
+	while (block) {
+		struct syntax_node_arena_block *next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->blocks = NULL;
+	arena->used   = 0;
+	arena->nodes  = 0;
+}
+
+void syntax_node_arena_reset(SyntaxNodeArena *arena) {
+	if (!arena->blocks) {return;}
+
+	/* The newest block is always the largest one, keep only that one. */
+	struct syntax_node_arena_block *newest = arena->blocks;
+	struct syntax_node_arena_block *block  = newest->next;
+	while (block) {
+		struct syntax_node_arena_block *next = block->next;
+		free(block);
+		block = next;
+	}
+	newest->next  = NULL;
+	arena->used   = 0;
+	arena->nodes  = 0;
+}
+
+int syntax_node_arena_reserve(SyntaxNodeArena *arena, size_t count) {
+	if (!arena) {return 0;}
+	if (arena->blocks && arena->blocks->size - arena->used >= count) {return 0;}
+	return add_block(arena, count > arena->block_size ? count : arena->block_size);
+}
+
+SyntaxNode *syntax_node_arena_construct(SyntaxNodeArena *arena, Operator op, double number) {
+	if (!arena) {return syntax_node_construct(op, number);}
+
+	/* Get a new block if the current one is full. */
+	if (!arena->blocks || arena->used == arena->blocks->size) {
+		if (add_block(arena, arena->block_size) != 0) {return NULL;}
+	}
+
+	SyntaxNode *node = &arena->blocks->nodes[arena->used++];
+	++arena->nodes;
+	*node = (SyntaxNode){op, number, operator_arity[op]};
+	return node;
+}
+
+SyntaxNode *syntax_node_arena_copy(SyntaxNodeArena *arena, const SyntaxNode *const original) {
+	if (!arena) {return syntax_node_copy(original);}
+
+	SyntaxNode *const copy = syntax_node_arena_construct(arena, original->operator_value, original->numeric_value);
+	if (!copy) {return NULL;}
+
+	for (int i = 0; i < copy->arity; ++i) {
+		copy->operand[i] = syntax_node_arena_copy(arena, original->operand[i]);
+		/* Nodes allocated so far are reclaimed with the arena. */
+		if (!copy->operand[i]) {return NULL;}
+	}
+
+	return copy;
+}
+
+void syntax_node_arena_destroy(SyntaxNodeArena *arena, SyntaxNode *node) {
+	if (!arena) {syntax_node_destroy(node);}
+	/* Otherwise the node is released along with the arena. */
+}
+
+SyntaxNodeBuilder syntax_node_tree_builder(SyntaxNodeArena *arena) {
+	return (SyntaxNodeBuilder){
+		.node     = tree_node,
+		.share    = tree_share,
+		.derive   = syntax_node_build_derivative,
+		.simplify = syntax_node_build_simplified,
+		.data     = arena,
+	};
+}
+
+static SyntaxNode *tree_node(const SyntaxNodeBuilder *builder, Operator op, double number, SyntaxNode *a, SyntaxNode *b) {
+	SyntaxNodeArena *arena = builder->data;
+	SyntaxNode *operands[MAX_ARITY] = {a, b};
+	unsigned int arity = operator_arity[op];
+
+	int missing = 0;
+	for (unsigned int i = 0; i < arity; ++i) {
+		if (!operands[i]) {missing = 1;}
+	}
+	SyntaxNode *node = missing ? NULL : syntax_node_arena_construct(arena, op, number);
+	if (!node) {
+		for (unsigned int i = 0; i < arity; ++i) {
+			if (operands[i]) {syntax_node_arena_destroy(arena, operands[i]);}
+		}
+		return NULL;
+	}
+
+	for (unsigned int i = 0; i < arity; ++i) {
+		node->operand[i] = operands[i];
+	}
+	return node;
+}
+
+static SyntaxNode *tree_share(const SyntaxNodeBuilder *builder, SyntaxNode *node) {
+	return syntax_node_arena_copy(builder->data, node);
+}
+
+static int add_block(SyntaxNodeArena *arena, size_t size) {
+	struct syntax_node_arena_block *block = malloc(sizeof(struct syntax_node_arena_block) + size * sizeof(SyntaxNode));
+	STATISTICS(statistics_count_allocation();)
+	if (!block) {
+		status_report("Memory error: Could not allocate memory for syntax node arena.\n");
+		return 1;
+	}
+	block->next       = arena->blocks;
+	block->size       = size;
+	arena->blocks     = block;
+	arena->used       = 0;
+	arena->block_size = 2 * size;
+	return 0;
+}
@@ -0,0 +1,71 @@
+#ifndef NEWTON_SYNTAX_NODE_BUILDER_H
+#define NEWTON_SYNTAX_NODE_BUILDER_H
+
+/** @file syntax_node_builder.h
+ *
+ *  Header file for the rules of derivation and simplification.
+ *
+ *  The same rules apply to syntax trees and to the shared nodes of a syntax
+ *  node table, only the nodes are made differently: a tree needs a fresh copy
+ *  of an operand for every use, while a table hands out the same node for the
+ *  same contents and remembers what it has derived or simplified before. A
+ *  builder wraps these differences, and the rules only ever make nodes
+ *  through it. None of the rules changes an existing node.
+ */
+
+#include "syntax_node.h"
+
+typedef struct syntax_node_builder SyntaxNodeBuilder;
+
+/** How the nodes of one representation are made. */
+struct syntax_node_builder {
+	/** Returns a node with the given contents, `NULL` on failure.
+	 *
+	 *  Operands beyond the arity of the operator are ignored, if any other
+	 *  operand is `NULL` the result is `NULL` as well.
+	 */
+	SyntaxNode *(*node)(const SyntaxNodeBuilder *builder, Operator op, double number, SyntaxNode *a, SyntaxNode *b);
+
+	/** Returns an existing node for another use, `NULL` on failure. */
+	SyntaxNode *(*share)(const SyntaxNodeBuilder *builder, SyntaxNode *node);
+
+	/** Derives a node with respect to a variable, `NULL` on failure. */
+	SyntaxNode *(*derive)(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
+
+	/** Simplifies a condensed node, `NULL` on failure or for `NULL`. */
+	SyntaxNode *(*simplify)(const SyntaxNodeBuilder *builder, SyntaxNode *node);
+
+	/** The arena or table the nodes belong to. */
+	void *data;
+};
+
+/** Returns the builder of the trees of an arena.
+ *
+ *  @param arena  The arena to allocate the nodes in, or NULL.
+ *
+ *  @return  Builder which copies shared operands and does not remember
+ *           anything.
+ */
+SyntaxNodeBuilder syntax_node_tree_builder(SyntaxNodeArena *arena);
+
+/** Derives a node by the rules of `syntax_node_derive`.
+ *
+ *  @param builder   Builder of the nodes, its `derive` derives the operands.
+ *  @param node      The node to derive (read-only).
+ *  @param variable  Index of the variable to derive by.
+ *
+ *  @return  The derivative, `NULL` on failure.
+ */
+SyntaxNode *syntax_node_build_derivative(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
+
+/** Simplifies a condensed node by the rules of `syntax_node_simplify`.
+ *
+ *  @param builder  Builder of the nodes, its `simplify` simplifies the
+ *                  operands.
+ *  @param node     The node to simplify (read-only), or `NULL`.
+ *
+ *  @return  The simplified node, `NULL` on failure or for `NULL`.
+ */
+SyntaxNode *syntax_node_build_simplified(const SyntaxNodeBuilder *builder, SyntaxNode *node);
+
+#endif /* NEWTON_SYNTAX_NODE_BUILDER_H */
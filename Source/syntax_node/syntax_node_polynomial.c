@@ -0,0 +1,182 @@
+#include <math.h>
+
+#include "syntax_node.h"
+
+/* Polynomials:
+ *
+ * A tree is a polynomial in X if it is built only from numbers, constants,
+ * the variable X, sums, differences, products, quotients by constants, and
+ * powers with a constant non-negative integer exponent. The coefficients are
+ * collected bottom-up: every sub-tree yields the dense vector of its own
+ * coefficients, and every operator combines the vectors of its operands.
+ *
+ * The vector of the first operand is built right in the vector of the node,
+ * only the other operand needs one of its own. The parser builds long sums and
+ * products leaning to the left, so those do not pile up vectors on the C
+ * stack; to be sure the depth of the recursion is limited.
+ *
+ * Whether the tree is expanded already is a separate question: collecting
+ * multiplies out every product, which rounds differently than the tree.
+ */
+
+/** Deepest tree which is examined for a polynomial. */
+#define MAX_DEPTH  128
+
+/** Dense vector of coefficients, `c[k]` belongs to `x^k`. */
+struct polynomial {
+	size_t degree;                        /**< Degree, 0 for constants. */
+	double c[POLYNOMIAL_MAX_DEGREE + 1];  /**< The coefficients.        */
+};
+
+/** Collects the coefficients of a (sub-)tree.
+ *
+ *  @param node   Root of the (sub-)tree.
+ *  @param p      Polynomial to store the coefficients in.
+ *  @param depth  Depth of the node in the tree.
+ *
+ *  @return  0 if the tree is a polynomial, non-0 otherwise.
+ */
+static int collect(const SyntaxNode *node, struct polynomial *p, size_t depth);
+
+/** Combines the coefficients of the first operand of a node with the second.
+ *
+ *  @param node   The binary operator node.
+ *  @param p      Coefficients of the first operand, overwritten by those of
+ *                the node.
+ *  @param depth  Depth of the node in the tree.
+ *
+ *  @return  0 if the node is a polynomial, non-0 otherwise.
+ */
+static int combine(const SyntaxNode *node, struct polynomial *p, size_t depth);
+
+/** Multiplies a polynomial by another one.
+ *
+ *  @param p  The first factor, overwritten by the product.
+ *  @param q  The second factor.
+ *
+ *  @return  0 on success, non-0 if the degree would be too large.
+ */
+static int multiply(struct polynomial *p, const struct polynomial *q);
+
+/** Whether a (sub-)tree contains a sum or difference.
+ *
+ *  @param node   Root of the (sub-)tree.
+ *  @param depth  Depth of the node in the tree.
+ *
+ *  @return  1 if it does or it is too deep, 0 otherwise.
+ */
+static int has_sum(const SyntaxNode *node, size_t depth);
+
+
+int syntax_node_polynomial(const SyntaxNode *node, double *coefficients, size_t *degree) {
+	struct polynomial p;
+	if (collect(node, &p, 0) != 0) {return 1;}
+
+	/* Leading zeros do not count towards the degree. */
+	while (p.degree > 0 && p.c[p.degree] == 0) {--p.degree;}
+	for (size_t k = 0; k <= p.degree; ++k) {coefficients[k] = p.c[k];}
+	*degree = p.degree;
+	return 0;
+}
+
+int syntax_node_is_expanded(const SyntaxNode *node) {
+	/* Descend the sums and differences of the terms, e.g. c0 + c1 * x - x * x. */
+	size_t depth = 0;
+	while (node->operator_value == OP_PLUS || node->operator_value == OP_MINUS) {
+		if (++depth > MAX_DEPTH || has_sum(node->operand[1], depth)) {return 0;}
+		node = node->operand[0];
+	}
+	return !has_sum(node, depth);
+}
+
+static int collect(const SyntaxNode *node, struct polynomial *p, size_t depth) {
+	if (depth > MAX_DEPTH) {return 1;}
+	p->degree = 0;
+
+	switch (node->operator_value) {
+	case OP_NUMBER: p->c[0] = node->numeric_value; return 0;
+	case OP_PI    : p->c[0] = PI;                  return 0;
+	case OP_E     : p->c[0] = E;                   return 0;
+	case OP_X_VAR :
+		/* Indexed variables belong to systems, not to polynomials in X. */
+		if (node->numeric_value != 0) {return 1;}
+		p->degree = 1;
+		p->c[0] = 0;
+		p->c[1] = 1;
+		return 0;
+	case OP_NEGATE:
+		if (collect(node->operand[0], p, depth + 1) != 0) {return 1;}
+		for (size_t k = 0; k <= p->degree; ++k) {p->c[k] = -p->c[k];}
+		return 0;
+	case OP_PLUS  :
+	case OP_MINUS :
+	case OP_TIMES :
+	case OP_DIVIDE:
+	case OP_POWER :
+		if (collect(node->operand[0], p, depth + 1) != 0) {return 1;}
+		return combine(node, p, depth);
+	default:
+		return 1;
+	}
+}
+
+static int combine(const SyntaxNode *node, struct polynomial *p, size_t depth) {
+	struct polynomial q;
+	if (collect(node->operand[1], &q, depth + 1) != 0) {return 1;}
+
+	switch (node->operator_value) {
+	case OP_PLUS  :
+	case OP_MINUS : {
+		double sign = node->operator_value == OP_PLUS ? 1 : -1;
+		for (size_t k = p->degree + 1; k <= q.degree; ++k) {p->c[k] = 0;}
+		if (q.degree > p->degree) {p->degree = q.degree;}
+		for (size_t k = 0; k <= q.degree; ++k) {p->c[k] += sign * q.c[k];}
+		return 0;
+	}
+	case OP_TIMES :
+		return multiply(p, &q);
+	case OP_DIVIDE:
+		/* Only division by a constant keeps a polynomial. */
+		if (q.degree != 0 || q.c[0] == 0) {return 1;}
+		for (size_t k = 0; k <= p->degree; ++k) {p->c[k] /= q.c[0];}
+		return 0;
+	case OP_POWER : {
+		double n = q.c[0];
+		if (q.degree != 0 || n < 0 || n != floor(n) || n * p->degree > POLYNOMIAL_MAX_DEGREE) {return 1;}
+		/* A constant to any power is folded right away. */
+		if (p->degree == 0) {
+			p->c[0] = pow(p->c[0], n);
+			return 0;
+		}
+		struct polynomial base = *p;
+		p->degree = 0;
+		p->c[0]   = 1;
+		for (double i = 0; i < n; ++i) {
+			if (multiply(p, &base) != 0) {return 1;}
+		}
+		return 0;
+	}
+	default:
+		return 1;
+	}
+}
+
+static int multiply(struct polynomial *p, const struct polynomial *q) {
+	double product[POLYNOMIAL_MAX_DEGREE + 1] = {0};
+	if (p->degree + q->degree > POLYNOMIAL_MAX_DEGREE) {return 1;}
+
+	for (size_t i = 0; i <= p->degree; ++i) {
+		for (size_t j = 0; j <= q->degree; ++j) {product[i + j] += p->c[i] * q->c[j];}
+	}
+	p->degree += q->degree;
+	for (size_t k = 0; k <= p->degree; ++k) {p->c[k] = product[k];}
+	return 0;
+}
+
+static int has_sum(const SyntaxNode *node, size_t depth) {
+	if (depth > MAX_DEPTH || node->operator_value == OP_PLUS || node->operator_value == OP_MINUS) {return 1;}
+	for (unsigned int i = 0; i < node->arity; ++i) {
+		if (has_sum(node->operand[i], depth + 1)) {return 1;}
+	}
+	return 0;
+}
@@ -0,0 +1,244 @@
+#include <math.h>
+
+#include "syntax_node.h"
+#include "syntax_node_builder.h"
+
+/* Simplification:
+ *
+ * The tree is simplified bottom-up: first all operands of a node, then the
+ * node itself. A node is rewritten by the first rule that matches, and then
+ * the rules are tried again until none matches anymore. The rules do not
+ * change any node, instead they return the rewritten form, which is made
+ * through a builder. This way the same rules serve syntax trees and the
+ * shared nodes of a syntax node table. A tree is rewritten in an arena, the
+ * nodes it leaves behind are released along with the arena, and at the end
+ * the root takes on the contents of the result.
+ *
+ * Commutative operations keep their constant operand first, this way there
+ * is only one side to check. Constants are also pulled upwards through
+ * products and sums, until they meet another constant and can be folded:
+ *
+ *     f * (c * g)  ->  c * (f * g)
+ *     c1 * (c2 * g)  ->  (c1 * c2) * g
+ *
+ * Quotients by constants become products with the reciprocal for the same
+ * reason, but only if the reciprocal is exact, like the one of a power of
+ * two. Otherwise the product would round differently than the quotient, and
+ * the reciprocal of a denormal number is not even finite.
+ *
+ * Identities like `f * 0 = 0` are applied even if *f* could be infinite or
+ * not a number, the same way a person would simplify the term on paper.
+ */
+
+/** Apply the first matching rule to a node.
+ *
+ *  @param builder  Builder of the new nodes.
+ *  @param node     The node to rewrite, its operands are simplified.
+ *
+ *  @return  The rewritten form, the node itself if no rule matched, `NULL`
+ *           on failure.
+ */
+static SyntaxNode *rewrite(const SyntaxNodeBuilder *builder, SyntaxNode *node);
+
+/** Whether a node is a number node of the given value. */
+static int is_number(const SyntaxNode *node, double value);
+
+/** Whether a node is a number whose reciprocal is exact.
+ *
+ *  Only then is multiplying by the reciprocal the same as dividing by the
+ *  number, which is the case for powers of two whose reciprocal is finite.
+ */
+static int has_exact_reciprocal(const SyntaxNode *node);
+
+
+int syntax_node_simplify(SyntaxNode *node) {
+	return syntax_node_arena_simplify(NULL, node);
+}
+
+int syntax_node_arena_simplify(SyntaxNodeArena *arena, SyntaxNode *node) {
+	syntax_node_arena_condense(arena, node);
+
+	/* Nodes on their own are rewritten in a scratch arena, then the result is
+	 * copied back, so the old tree can be destroyed as a whole. */
+	SyntaxNodeArena scratch;
+	syntax_node_arena_init(&scratch, 0);
+	SyntaxNodeBuilder builder = syntax_node_tree_builder(arena ? arena : &scratch);
+
+	SyntaxNode *simplified = syntax_node_build_simplified(&builder, node);
+	if (simplified && !arena) {
+		simplified = syntax_node_copy(simplified);
+		if (simplified) {
+			for (unsigned int i = 0; i < node->arity; ++i) {
+				syntax_node_destroy(node->operand[i]);
+			}
+		}
+	}
+	syntax_node_arena_release(&scratch);
+	if (!simplified) {return 1;}
+
+	if (simplified != node) {
+		*node = *simplified;
+		if (!arena) {
+			/* Destroy only the shell, the operands belong to the node now. */
+			simplified->arity = 0;
+			syntax_node_destroy(simplified);
+		}
+	}
+	return 0;
+}
+
+SyntaxNode *syntax_node_build_simplified(const SyntaxNodeBuilder *builder, SyntaxNode *node) {
+	if (!node) {return NULL;}
+
+	SyntaxNode *operands[MAX_ARITY] = {NULL};
+	int changed = 0;
+	for (unsigned int i = 0; i < node->arity; ++i) {
+		operands[i] = builder->simplify(builder, node->operand[i]);
+		if (!operands[i]) {return NULL;}
+		if (operands[i] != node->operand[i]) {changed = 1;}
+	}
+	if (changed) {
+		node = builder->node(builder, node->operator_value, node->numeric_value, operands[0], operands[1]);
+	}
+
+	while (node) {
+		SyntaxNode *rewritten = rewrite(builder, node);
+		if (rewritten == node) {break;}
+		node = rewritten;
+	}
+	return node;
+}
+
+static SyntaxNode *rewrite(const SyntaxNodeBuilder *builder, SyntaxNode *node) {
+	/* Shorthands for building the rewritten form. */
+	#define NODE(op, a, b)  builder->node(builder, OP_ ## op, 0.0, (a), (b))
+	#define NUMBER(n)       builder->node(builder, OP_NUMBER, (n), NULL, NULL)
+	#define SHARE(n)        builder->share(builder, (n))
+	#define S(n)            builder->simplify(builder, (n))
+
+	SyntaxNode *A = node->operand[0];
+	SyntaxNode *B = node->operand[1];
+
+	/* Fold operators whose operands have all become numbers. */
+	if (node->arity > 0) {
+		int constant = 1;
+		for (unsigned int i = 0; i < node->arity; ++i) {
+			if (node->operand[i]->operator_value != OP_NUMBER) {constant = 0;}
+		}
+		if (constant) {return NUMBER(syntax_node_operate(node, 0.0));}
+	}
+
+	switch (node->operator_value) {
+	case OP_NEGATE:
+		/* --f = f */
+		if (A->operator_value == OP_NEGATE) {return A->operand[0];}
+		/* -(c * f) = (-c) * f */
+		if (A->operator_value == OP_TIMES && A->operand[0]->operator_value == OP_NUMBER) {
+			return NODE(TIMES, NUMBER(-A->operand[0]->numeric_value), A->operand[1]);
+		}
+		break;
+
+	case OP_PLUS:
+		/* 0 + f = f,  f + 0 = f */
+		if (is_number(A, 0.0)) {return B;}
+		if (is_number(B, 0.0)) {return A;}
+		/* f + c = c + f */
+		if (B->operator_value == OP_NUMBER) {return NODE(PLUS, B, A);}
+		/* f + (-g) = f - g */
+		if (B->operator_value == OP_NEGATE) {return NODE(MINUS, A, B->operand[0]);}
+		goto reassociate;
+
+	case OP_MINUS:
+		/* f - 0 = f,  0 - f = -f */
+		if (is_number(B, 0.0)) {return A;}
+		if (is_number(A, 0.0)) {return NODE(NEGATE, B, NULL);}
+		/* f - c = (-c) + f */
+		if (B->operator_value == OP_NUMBER) {return NODE(PLUS, NUMBER(-B->numeric_value), A);}
+		/* f - (-g) = f + g */
+		if (B->operator_value == OP_NEGATE) {return NODE(PLUS, A, B->operand[0]);}
+		break;
+
+	case OP_TIMES:
+		/* 0 * f = 0,  f * 0 = 0,  1 * f = f,  f * 1 = f */
+		if (is_number(A, 0.0) || is_number(B, 0.0)) {return NUMBER(0.0);}
+		if (is_number(A, 1.0)) {return B;}
+		if (is_number(B, 1.0)) {return A;}
+		/* f * c = c * f */
+		if (B->operator_value == OP_NUMBER) {return NODE(TIMES, B, A);}
+		/* (-1) * f = -f */
+		if (is_number(A, -1.0)) {return NODE(NEGATE, B, NULL);}
+		/* c * (-g) = (-c) * g */
+		if (A->operator_value == OP_NUMBER && B->operator_value == OP_NEGATE) {
+			return NODE(TIMES, NUMBER(-A->numeric_value), B->operand[0]);
+		}
+		goto reassociate;
+
+	case OP_DIVIDE:
+		/* f / 1 = f,  0 / f = 0 */
+		if (is_number(B, 1.0)) {return A;}
+		if (is_number(A, 0.0)) {return NUMBER(0.0);}
+		/* (c * f) / g = c * (f / g) */
+		if (A->operator_value == OP_TIMES && A->operand[0]->operator_value == OP_NUMBER) {
+			return NODE(TIMES, A->operand[0], S(NODE(DIVIDE, A->operand[1], B)));
+		}
+		/* f / c = (1 / c) * f, the constant can then meet other constants. */
+		if (has_exact_reciprocal(B)) {
+			return NODE(TIMES, NUMBER(1 / B->numeric_value), A);
+		}
+		break;
+
+	case OP_POWER:
+		/* f ^ 1 = f,  f ^ 0 = 1,  1 ^ f = 1 */
+		if (is_number(B, 1.0)) {return A;}
+		if (is_number(B, 0.0) || is_number(A, 1.0)) {return NUMBER(1.0);}
+		/* Small integer powers of variables become multiplications. */
+		if (A->arity == 0 && B->operator_value == OP_NUMBER) {
+			double n = B->numeric_value;
+			if (n != floor(n) || fabs(n) > MAX_POWER_CHAIN || n == -1.0) {break;}
+
+			SyntaxNode *chain = A;
+			for (int i = 1; i < (int)fabs(n); ++i) {chain = NODE(TIMES, chain, SHARE(A));}
+			return n < 0 ? NODE(DIVIDE, NUMBER(1.0), chain) : chain;
+		}
+		break;
+
+	default:
+		break;
+	}
+	return node;
+
+reassociate:
+	/* Only sums and products get here, the operator is the same below. */
+	if (B->operator_value == node->operator_value && B->operand[0]->operator_value == OP_NUMBER) {
+		/* c1 . (c2 . g) = (c1 . c2) . g */
+		if (A->operator_value == OP_NUMBER) {
+			SyntaxNode operation = {node->operator_value, 0.0, 2, {A, B->operand[0]}};
+			SyntaxNode *c = NUMBER(syntax_node_operate(&operation, 0.0));
+			return builder->node(builder, node->operator_value, 0.0, c, B->operand[1]);
+		}
+		/* f . (c . g) = c . (f . g) */
+		SyntaxNode *f_g = builder->node(builder, node->operator_value, 0.0, A, B->operand[1]);
+		return builder->node(builder, node->operator_value, 0.0, B->operand[0], S(f_g));
+	}
+	/* (c . f) . g = c . (f . g) */
+	if (A->operator_value == node->operator_value && A->operand[0]->operator_value == OP_NUMBER) {
+		SyntaxNode *f_g = builder->node(builder, node->operator_value, 0.0, A->operand[1], B);
+		return builder->node(builder, node->operator_value, 0.0, A->operand[0], S(f_g));
+	}
+	return node;
+
+	#undef NODE
+	#undef NUMBER
+	#undef SHARE
+	#undef S
+}
+
+static int is_number(const SyntaxNode *node, double value) {
+	return node->operator_value == OP_NUMBER && node->numeric_value == value;
+}
+
+static int has_exact_reciprocal(const SyntaxNode *node) {
+	int exponent;
+	if (node->operator_value != OP_NUMBER || !isfinite(1 / node->numeric_value)) {return 0;}
+	return fabs(frexp(node->numeric_value, &exponent)) == 0.5;
+}
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "syntax_node_table.h"
+#include "syntax_node_builder.h"
+#include "../status/status.h"
+
+/* Hash-consing:
+ *
+ * The table is an open addressed hash table with linear probing. The hash of
+ * a node is computed from its operator, the bytes of its number and the
+ * addresses of its operands; the operands are already unique, so there is no
+ * need to descend into them. This makes both hashing and comparing O(1) per
+ * node.
+ *
+ * Next to each node the entry also remembers the derivative, the condensed
+ * and the simplified form of the node once they have been computed. Looking
+ * up the entry of a node is just another hash lookup, where the node is found
+ * by its address.
+ *
+ * Derivation and simplification use the rules of the trees, with a builder
+ * which interns the new nodes and goes through the memoised functions for
+ * the operands.
+ */
+
+/** Number of entries of a new table, must be a power of two. */
+#define INITIAL_CAPACITY  64
+
+/** Entry of the hash table. */
+struct syntax_node_table_entry {
+	SyntaxNode *node;       /**< The node, `NULL` if the entry is empty. */
+	SyntaxNode *derivative; /**< Memoised derivative, or `NULL`.         */
+	SyntaxNode *condensed;  /**< Memoised condensed node, or `NULL`.     */
+	SyntaxNode *simplified; /**< Memoised simplified node, or `NULL`.    */
+};
+
+/** Hash of the contents of a node.
+ *
+ *  @param node  Node to hash, its operands must be unique.
+ *
+ *  @return  The hash value.
+ */
+static size_t hash_node(const SyntaxNode *node);
+
+/** Whether two nodes have the same contents.
+ *
+ *  @param a  First node.
+ *  @param b  Second node, its operands must be unique.
+ *
+ *  @return  1 if the nodes are equal, 0 otherwise.
+ */
+static int equal_nodes(const SyntaxNode *a, const SyntaxNode *b);
+
+/** Finds the entry of a node, or the empty entry where it would go.
+ *
+ *  @param table  The table to search.
+ *  @param node   Node with the contents to search for.
+ *
+ *  @return  Pointer to the entry.
+ */
+static struct syntax_node_table_entry *find_entry(const SyntaxNodeTable *table, const SyntaxNode *node);
+
+/** Doubles the number of entries of the table.
+ *
+ *  @param table  The table to grow.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+static int grow_table(SyntaxNodeTable *table);
+
+/** Returns the builder of the nodes of a table.
+ *
+ *  @param table  The table.
+ *
+ *  @return  Builder which interns the nodes, derives and simplifies with
+ *           memoisation.
+ */
+static SyntaxNodeBuilder table_builder(SyntaxNodeTable *table);
+
+/** Interns a node for the table builder. */
+static SyntaxNode *table_node(const SyntaxNodeBuilder *builder, Operator op, double number, SyntaxNode *a, SyntaxNode *b);
+
+/** Shares a node for the table builder, nodes of a table are shared anyway. */
+static SyntaxNode *table_share(const SyntaxNodeBuilder *builder, SyntaxNode *node);
+
+/** Derives a node for the table builder, this is always by the first variable. */
+static SyntaxNode *table_derive(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable);
+
+/** Simplifies a node for the table builder. */
+static SyntaxNode *table_simplify(const SyntaxNodeBuilder *builder, SyntaxNode *node);
+
+/** Computes the condensed form of a node without memoisation.
+ *
+ *  @param table  The table of the node.
+ *  @param node   The node to condense.
+ *
+ *  @return  Node of the condensed form, `NULL` on failure.
+ */
+static SyntaxNode *condense_node(SyntaxNodeTable *table, SyntaxNode *node);
+
+int syntax_node_table_init(SyntaxNodeTable *table) {
+	syntax_node_arena_init(&table->arena, 0);
+	table->count    = 0;
+	table->capacity = INITIAL_CAPACITY;
+	table->entries  = calloc(INITIAL_CAPACITY, sizeof(struct syntax_node_table_entry));
+	if (!table->entries) {
+		status_report("Memory error: Could not allocate syntax node table.\n");
+		table->capacity = 0;
+		return 1;
+	}
+	return 0;
+}
+
+void syntax_node_table_release(SyntaxNodeTable *table) {
+	syntax_node_arena_release(&table->arena);
+	free(table->entries);
+	table->entries  = NULL;
+	table->count    = 0;
+	table->capacity = 0;
+}
+
+SyntaxNode *syntax_node_table_intern(SyntaxNodeTable *table, Operator op, double number, SyntaxNode *a, SyntaxNode *b) {
+	SyntaxNode node = {op, op == OP_NUMBER || op == OP_X_VAR ? number : 0.0, operator_arity[op]};
+	SyntaxNode *operands[MAX_ARITY] = {a, b};
+	for (unsigned int i = 0; i < node.arity; ++i) {
+		if (!operands[i]) {return NULL;}
+		node.operand[i] = operands[i];
+	}
+
+	struct syntax_node_table_entry *entry = find_entry(table, &node);
+	if (entry->node) {return entry->node;}
+
+	/* Keep the load factor at one half at most. */
+	if (2 * (table->count + 1) > table->capacity) {
+		if (grow_table(table) != 0) {return NULL;}
+		entry = find_entry(table, &node);
+	}
+
+	SyntaxNode *unique = syntax_node_arena_construct(&table->arena, op, node.numeric_value);
+	if (!unique) {return NULL;}
+	*unique = node;
+
+	*entry = (struct syntax_node_table_entry){unique, NULL, NULL, NULL};
+	++table->count;
+	return unique;
+}
+
+SyntaxNode *syntax_node_table_import(SyntaxNodeTable *table, const SyntaxNode *const tree) {
+	SyntaxNode *operands[MAX_ARITY] = {NULL};
+	for (unsigned int i = 0; i < tree->arity; ++i) {
+		operands[i] = syntax_node_table_import(table, tree->operand[i]);
+		if (!operands[i]) {return NULL;}
+	}
+	return syntax_node_table_intern(table, tree->operator_value, tree->numeric_value, operands[0], operands[1]);
+}
+
+SyntaxNode *syntax_node_table_derive(SyntaxNodeTable *table, SyntaxNode *node) {
+	struct syntax_node_table_entry *entry = find_entry(table, node);
+	if (entry->node != node) {return NULL;} /* Not a node of this table. */
+	if (entry->derivative) {return entry->derivative;}
+
+	SyntaxNodeBuilder builder = table_builder(table);
+	SyntaxNode *derivative = syntax_node_build_derivative(&builder, node, 0);
+	if (!derivative) {return NULL;}
+
+	/* The table might have grown in the meantime. */
+	find_entry(table, node)->derivative = derivative;
+	return derivative;
+}
+
+SyntaxNode *syntax_node_table_condense(SyntaxNodeTable *table, SyntaxNode *node) {
+	struct syntax_node_table_entry *entry = find_entry(table, node);
+	if (entry->node != node) {return NULL;} /* Not a node of this table. */
+	if (entry->condensed) {return entry->condensed;}
+
+	SyntaxNode *condensed = condense_node(table, node);
+	if (!condensed) {return NULL;}
+
+	/* The table might have grown in the meantime. */
+	find_entry(table, node)->condensed = condensed;
+	return condensed;
+}
+
+SyntaxNode *syntax_node_table_simplify(SyntaxNodeTable *table, SyntaxNode *node) {
+	if (!node) {return NULL;}
+	struct syntax_node_table_entry *entry = find_entry(table, node);
+	if (entry->node != node) {return NULL;} /* Not a node of this table. */
+	if (entry->simplified) {return entry->simplified;}
+
+	SyntaxNode *condensed = syntax_node_table_condense(table, node);
+	if (!condensed) {return NULL;}
+	SyntaxNodeBuilder builder = table_builder(table);
+	SyntaxNode *simplified = syntax_node_build_simplified(&builder, condensed);
+	if (!simplified) {return NULL;}
+
+	/* The table might have grown in the meantime. The simplified form is
+	 * simplified as well, it does not need to go through the rules again. */
+	find_entry(table, node)->simplified       = simplified;
+	find_entry(table, condensed)->simplified  = simplified;
+	find_entry(table, simplified)->simplified = simplified;
+	return simplified;
+}
+
+static size_t hash_node(const SyntaxNode *node) {
+	/* 64 bit FNV-1a over the fields, the operands by address. */
+	uint64_t hash = 14695981039346656037u;
+	#define MIX(value)  hash = (hash ^ (uint64_t)(value)) * 1099511628211u
+
+	uint64_t bits;
+	memcpy(&bits, &node->numeric_value, sizeof bits);
+	MIX(node->operator_value);
+	MIX(bits);
+	for (unsigned int i = 0; i < node->arity; ++i) {
+		MIX((uintptr_t)node->operand[i]);
+	}
+
+	#undef MIX
+	return (size_t)(hash ^ (hash >> 32));
+}
+
+static int equal_nodes(const SyntaxNode *a, const SyntaxNode *b) {
+	if (a->operator_value != b->operator_value || a->arity != b->arity) {return 0;}
+	/* Compare the bytes, so 0 and -0 are different numbers. */
+	if (memcmp(&a->numeric_value, &b->numeric_value, sizeof(double)) != 0) {return 0;}
+	for (unsigned int i = 0; i < a->arity; ++i) {
+		if (a->operand[i] != b->operand[i]) {return 0;}
+	}
+	return 1;
+}
+
+static struct syntax_node_table_entry *find_entry(const SyntaxNodeTable *table, const SyntaxNode *node) {
+	size_t mask  = table->capacity - 1;
+	size_t index = hash_node(node) & mask;
+
+	while (table->entries[index].node && !equal_nodes(table->entries[index].node, node)) {
+		index = (index + 1) & mask;
+	}
+	return &table->entries[index];
+}
+
+static int grow_table(SyntaxNodeTable *table) {
+	SyntaxNodeTable grown = *table;
+	grown.capacity = 2 * table->capacity;
+	grown.entries  = calloc(grown.capacity, sizeof(struct syntax_node_table_entry));
+	if (!grown.entries) {
+		status_report("Memory error: Could not grow syntax node table.\n");
+		return 1;
+	}
+
+	for (size_t i = 0; i < table->capacity; ++i) {
+		if (!table->entries[i].node) {continue;}
+		*find_entry(&grown, table->entries[i].node) = table->entries[i];
+	}
+
+	free(table->entries);
+	*table = grown;
+	return 0;
+}
+
+static SyntaxNodeBuilder table_builder(SyntaxNodeTable *table) {
+	return (SyntaxNodeBuilder){
+		.node     = table_node,
+		.share    = table_share,
+		.derive   = table_derive,
+		.simplify = table_simplify,
+		.data     = table,
+	};
+}
+
+static SyntaxNode *table_node(const SyntaxNodeBuilder *builder, Operator op, double number, SyntaxNode *a, SyntaxNode *b) {
+	return syntax_node_table_intern(builder->data, op, number, a, b);
+}
+
+static SyntaxNode *table_share(const SyntaxNodeBuilder *builder, SyntaxNode *node) {
+	return node;
+}
+
+static SyntaxNode *table_derive(const SyntaxNodeBuilder *builder, SyntaxNode *node, unsigned int variable) {
+	return syntax_node_table_derive(builder->data, node);
+}
+
+static SyntaxNode *table_simplify(const SyntaxNodeBuilder *builder, SyntaxNode *node) {
+	return syntax_node_table_simplify(builder->data, node);
+}
+
+static SyntaxNode *condense_node(SyntaxNodeTable *table, SyntaxNode *node) {
+	/* A variable can never be condensed. */
+	if (node->operator_value == OP_X_VAR) {return node;}
+
+	SyntaxNode *operands[MAX_ARITY] = {NULL};
+	int condensable = 1; /* Whether all operands are numbers. */
+	for (unsigned int i = 0; i < node->arity; ++i) {
+		operands[i] = syntax_node_table_condense(table, node->operand[i]);
+		if (!operands[i]) {return NULL;}
+		if (operands[i]->operator_value != OP_NUMBER) {condensable = 0;}
+	}
+
+	if (condensable) {
+		/* Operate on a stand-in, the shared node must not be changed. */
+		SyntaxNode operation = {node->operator_value, node->numeric_value, node->arity, {operands[0], operands[1]}};
+		return syntax_node_table_intern(table, OP_NUMBER, syntax_node_operate(&operation, 0.0), NULL, NULL);
+	}
+
+	return syntax_node_table_intern(table, node->operator_value, node->numeric_value, operands[0], operands[1]);
+}
@@ -0,0 +1,124 @@
+#ifndef NEWTON_SYNTAX_NODE_TABLE_H
+#define NEWTON_SYNTAX_NODE_TABLE_H
+
+/** @file syntax_node_table.h
+ *
+ *  Public header file for hash-consed syntax nodes.
+ *
+ *  A syntax node table holds every node at most once: before a node is
+ *  created the table is searched for a node with the same operator, number
+ *  and operands, and if there is one it is returned instead. Since the
+ *  operands are themselves unique, comparing them means comparing pointers,
+ *  so structurally identical sub-trees are always the same node. The result
+ *  is a directed acyclic graph (DAG) instead of a tree.
+ *
+ *  The nodes of a table are shared, so they must never be modified or
+ *  destroyed individually. Instead every operation returns a new (or already
+ *  existing) node of the table, and the entire table is released at once.
+ *
+ *  Derivation, condensation and simplification are memoised per node.
+ *  Derived trees share sub-trees with the original function and among
+ *  themselves, so the derivative of a deep expression only grows linearly with
+ *  the expression. A table which is kept between several versions of a
+ *  function, like the ones of an expression being edited, does not derive or
+ *  simplify the unchanged parts again: they are the same nodes as before.
+ */
+
+#include <stddef.h>
+#include "syntax_node.h"
+
+/** Table of unique syntax nodes.
+ *
+ *  @sa syntax_node_table_init, syntax_node_table_release
+ */
+typedef struct syntax_node_table {
+	SyntaxNodeArena arena;                   /**< Memory of the nodes.        */
+	struct syntax_node_table_entry *entries; /**< Open addressed hash table.  */
+	size_t count;                            /**< Number of nodes.            */
+	size_t capacity;                         /**< Number of entries.          */
+} SyntaxNodeTable;
+
+/** Initialises an empty table.
+ *
+ *  @param table  The table to initialise.
+ *
+ *  @return  0 on success, non-0 on error.
+ */
+int syntax_node_table_init(SyntaxNodeTable *table);
+
+/** Releases a table along with all of its nodes.
+ *
+ *  @param table  The table to release.
+ */
+void syntax_node_table_release(SyntaxNodeTable *table);
+
+/** Returns the unique node with the given contents.
+ *
+ *  @param table   The table to look in.
+ *  @param op      The operator of the node.
+ *  @param number  The number value for number nodes, ignored otherwise.
+ *  @param a       First operand, must be a node of the table or `NULL`.
+ *  @param b       Second operand, must be a node of the table or `NULL`.
+ *
+ *  @return  The node of the table, `NULL` on failure.
+ *
+ *  Operands beyond the arity of the operator are ignored. If there is no such
+ *  node yet it is added to the table.
+ */
+SyntaxNode *syntax_node_table_intern(SyntaxNodeTable *table, Operator op, double number, SyntaxNode *a, SyntaxNode *b);
+
+/** Adds an entire tree to the table.
+ *
+ *  @param table  The table to add to.
+ *  @param tree   Any syntax tree (read-only), it does not belong to the table.
+ *
+ *  @return  The node of the table equivalent to the tree, `NULL` on failure.
+ */
+SyntaxNode *syntax_node_table_import(SyntaxNodeTable *table, const SyntaxNode *const tree);
+
+/** Derives a node of the table.
+ *
+ *  @param table  The table of the node.
+ *  @param node   The node to derive.
+ *
+ *  @return  The node of the table which is the derivative, `NULL` on failure.
+ *
+ *  The rules are those of `syntax_node_derive`, built through the nodes of
+ *  the table. The derivative of every node is computed only once.
+ *
+ *  @sa syntax_node_derive
+ */
+SyntaxNode *syntax_node_table_derive(SyntaxNodeTable *table, SyntaxNode *node);
+
+/** Condenses a node of the table.
+ *
+ *  @param table  The table of the node.
+ *  @param node   The node to condense.
+ *
+ *  @return  The node of the table where every constant sub-graph has been
+ *           replaced by a number node, `NULL` on failure.
+ *
+ *  Unlike `syntax_node_condense` the node itself is not changed, it might be
+ *  shared after all.
+ *
+ *  @sa syntax_node_condense
+ */
+SyntaxNode *syntax_node_table_condense(SyntaxNodeTable *table, SyntaxNode *node);
+
+/** Simplifies a node of the table.
+ *
+ *  @param table  The table of the node.
+ *  @param node   The node to simplify.
+ *
+ *  @return  The node of the table which is the condensed and simplified form
+ *           of the node, `NULL` on failure.
+ *
+ *  The rules are those of `syntax_node_simplify`, and the result is the same
+ *  as simplifying the tree. Every node is simplified only once, and the node
+ *  itself is not changed.
+ *
+ *  @sa syntax_node_simplify
+ */
+SyntaxNode *syntax_node_table_simplify(SyntaxNodeTable *table, SyntaxNode *node);
+
+#endif /* NEWTON_SYNTAX_NODE_TABLE_H */
@@ -4,7 +4,16 @@
 /** Enumeration of opcodes for the virtual machine.
  *
  *  We skip over the number 0x00 because it's easier to debug. The type used
- *  for opcodes should be uint8_t.
+ *  for opcodes should be uint8_t. The byte in front of an indexed variable is
+ *  its index, just like a number literal is in front of its opcode.
+ *
+ *  The opcodes after the indexed variable are fused: each one does the work
+ *  of a few plain instructions on the top of the stack, with constants taken
+ *  from the bytecode like number literals. The constant of `OPC_ADDC` and
+ *  `OPC_MULC` is in front of the opcode; `OPC_MADDC` has the factor in front
+ *  of the opcode and the term in front of the factor; the byte in front of
+ *  `OPC_POWI` is the exponent. The backend selects them by a peephole pass
+ *  over the syntax tree.
  */
 enum vm_opcodes {
 	OPC_NUM   = 0x01, /**< Number literal.       */
@@ -22,6 +31,11 @@ enum vm_opcodes {
 	OPC_VAR_X = 0x0d, /**< Variable X.           */
 	OPC_PI    = 0x0e, /**< Pi constant.          */
 	OPC_E     = 0x0f, /**< E constant.           */
+	OPC_VAR   = 0x10, /**< Indexed variable.     */
+	OPC_ADDC  = 0x11, /**< c + f                 */
+	OPC_MULC  = 0x12, /**< c * f                 */
+	OPC_MADDC = 0x13, /**< c1 * f + c2           */
+	OPC_POWI  = 0x14, /**< f ^ n, integer n      */
 };
 
 #endif /* NEWTON_OPCODES_H */
@@ -1,96 +1,45 @@
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
 #include "vm.h"
 #include "opcodes.h"
+#include "../statistics/statistics.h"
 
-/** Stack of double floating point numbers.
+/** Dual number for forward-mode automatic differentiation.
  *
- *  We use a *count* member rather than a *top* because the type is *size_t*,
- *  which is an unsigned integer type. An empty stack has a *count* of *0*,
- *  whereas the top would have to be an impossible number like *-1*. Since the
- *  type is unsigned this would wrap around be the highest possible unsigned
- *  number, breaking any comparison with the capacity in the process.
+ *  A dual number is a pair of a value and the derivative of that value with
+ *  respect to the variable X. Performing the arithmetic on the pairs carries
+ *  the derivative along with the value, so a single pass over the bytecode
+ *  yields both at the same time.
  */
-typedef struct number_stack {
-	double *stack;    /**< Underlying array of numbers.     */
-	size_t  count;    /**< Number of elements on the stack. */
-	size_t  capacity; /**< Length of the stack array.       */
-} NumberStack;
+typedef struct dual_number {
+	double value;      /**< Value of the expression.           */
+	double derivative; /**< Derivative of the expression by X. */
+} DualNumber;
 
-/** Push a number onto the stack.
+/** Reads a number literal in front of the current position in the bytecode.
  *
- *  @param stack  Stack to push the value on.
- *  @param value  Value to push on the stack.
- *  
- *  @return  0 is everything went right, non-0 otherwise.
- *  
- *  If the stack is too short to hold the new value it will double in size. If
- *  an error occurs during the re-allocation an error code will be returned.
- */
-static int number_stack_pop(NumberStack *stack, double *value);
-
-/** Pop a number off the stack.
+ *  @param code   The bytecode.
+ *  @param index  Pointer to the current index, moved in front of the number.
  *
- *  @param stack  Stack to pop the value off.
- *  @param value  Value to pop off the stack.
- *  
- *  @return  0 is everything went right, non-0 otherwise.
- *  
- *  If the stack is only one quarter full after popping it will half in size.
- *  If an error occurs during the re-allocation an error code will be returned.
+ *  @return  The number.
  */
-static int number_stack_push(NumberStack *stack, double value);
-
-static int number_stack_pop(NumberStack *stack, double *value) {
-	assert(0 < stack->count && stack->count <= stack->capacity);
-
-	int error = 0; /* No error. */
-	*value = stack->stack[--stack->count];
-
-	/* Stack will shrink by half if it is only one quarter full, but avoid a
- 	 * stack with no capacity.
- 	 *
- 	 * Example: capacity = 8, count = 2
- 	 *          => 4*count = 4*2 = 8 = capacity
- 	 *          => capacity shrunk to 2*2 = 4
- 	 */
-	if (4 * stack->count <= stack->capacity && stack->count > 0) {
-		double *new_stack = realloc(stack->stack, (2 * stack->count) * sizeof(double));
-		if (!new_stack) {error = 1; goto end;}
-		stack->stack = new_stack;
-		stack->capacity = 2 * stack->count;
-	}
+static double read_number(const uint8_t *code, int *index);
 
-end:
-	assert(0 <= stack->count && stack->count < stack->capacity);
-	return error;
-}
+double machine_integer_power(double base, unsigned int n) {
+	if (n == 0) {return 1.0;}
+	int bit = 0; /* Position of the leading binary digit. */
+	while (n >> (bit + 1)) {++bit;}
 
-static int number_stack_push(NumberStack *stack, double value) {
-	assert(0 <= stack->count && stack->count <= stack->capacity);
-
-	int error = 0; /* No error. */
-
-	/* Stack will grow if it is full (top == capacity - 1)
- 	 *
-	 * Example: capacity = 4, top = 3
- 	 *          => Stack full; after increment: top == capacity
- 	 */
-	if(stack->count == stack->capacity) {
-		double *new_stack = realloc(stack->stack, 2 * stack->count * sizeof(double));
-		if (!new_stack) {error = 1; goto end;}
-		stack->stack = new_stack;
-		stack->capacity = 2 * stack->count;
+	double power = base;
+	while (bit-- > 0) {
+		power *= power;
+		if (n >> bit & 1) {power *= base;}
 	}
-	stack->stack[stack->count++] = value;
-
-end:
-	assert(0 < stack->count && stack->count <= stack->capacity);
-	return error;
+	return power;
 }
 
-
 VMCode machine_load_code(VirtualMachine *machine, VMCode code) {
 	VMCode old_code = machine->code;
 	machine->code   = code;
@@ -99,41 +48,37 @@ VMCode machine_load_code(VirtualMachine *machine, VMCode code) {
 }
 
 int machine_execute(VirtualMachine *machine, double *result) {
+	/* Reserve at least one slot, VLAs of size 0 are undefined. */
+	double stack[machine->code.depth > 0 ? machine->code.depth : 1];
+
+	return machine_execute_stack(machine, stack, result);
+}
+
+int machine_execute_stack(VirtualMachine *machine, double *stack, double *result) {
 	int error = 0;                      /**< Exit status, 0 mean no error.    */
 	int index = machine->code.length-1; /**< Current index into the bytecode. */
 
 	double tmp[MAX_ARITY]; /**< Temporary registers.       */
 	int    tmp_i = 0;      /**< Index of current register. */
 
-	/** Stack of intermediate numbers. */
-	NumberStack stack = {
-		.stack    = malloc(2 * sizeof(double)),
-		.count    = 0,
-		.capacity = 2,
-	};
+	size_t count = 0; /**< Number of elements on the stack. */
 
-	if (!stack.stack) {
-		error = 1;
-		goto end;
-	}
+	assert(machine->code.precision == VM_DOUBLE);
+	STATISTICS(NewtonStatistics *statistics = statistics_current();)
 
 	/* Macros to save repetitious typing and for readability. */
 
 	/** Pop a number off this function's stack. */
 	#define POP  { \
 		assert(tmp_i < MAX_ARITY); \
-		if(number_stack_pop(&stack, &tmp[tmp_i++]) != 0) { \
-			error = 1; \
-			goto end; \
-		}; \
+		assert(count > 0); \
+		tmp[tmp_i++] = stack[--count]; \
 	}
 
 	/** Push a number to function's stack. */
 	#define PUSH(value) { \
-		if (number_stack_push(&stack, value) != 0) { \
-			error = 1; \
-			goto end; \
-		} \
+		assert(count < machine->code.depth); \
+		stack[count++] = value; \
 		tmp_i = 0; \
 	}
 
@@ -141,13 +86,13 @@ int machine_execute(VirtualMachine *machine, double *result) {
 	while (index >= 0) {
 		if (error != 0) {goto end;}
 		uint8_t opcode = machine->code.code[index--];
+		STATISTICS(uint64_t cycles = statistics ? statistics_cycles() : 0;)
 
 		switch (opcode) {
 		case OPC_NUM: {
-			uint8_t *ptr   = machine->code.code + index - sizeof(double) + 1;
-			double  number = *((double*)ptr);
+			/* Literals are unaligned in the bytecode, they have to be copied. */
+			double number = read_number(machine->code.code, &index);
 			PUSH(number)
-			index -= sizeof(double);
 			break;
 		}
 		case OPC_NEG   :  POP       PUSH(    -tmp[0]           )  break;
@@ -164,18 +109,191 @@ int machine_execute(VirtualMachine *machine, double *result) {
 		case OPC_VAR_X :            PUSH( machine->reg_x       )  break;
 		case OPC_PI    :            PUSH( PI                   )  break;
 		case OPC_E     :            PUSH( E                    )  break;
+		case OPC_VAR   : {
+			uint8_t variable = machine->code.code[index--];
+			if (variable == 0 || variable > machine->reg_count) {error = 1; break;}
+			PUSH( machine->reg_vars[variable - 1] )
+			break;
+		}
+		case OPC_ADDC  : {
+			double c = read_number(machine->code.code, &index);
+			POP PUSH( c + tmp[0] )
+			break;
+		}
+		case OPC_MULC  : {
+			double c = read_number(machine->code.code, &index);
+			POP PUSH( c * tmp[0] )
+			break;
+		}
+		case OPC_MADDC : {
+			double c1 = read_number(machine->code.code, &index);
+			double c2 = read_number(machine->code.code, &index);
+			POP PUSH( c1 * tmp[0] + c2 )
+			break;
+		}
+		case OPC_POWI  : {
+			uint8_t n = machine->code.code[index--];
+			POP PUSH( machine_integer_power(tmp[0], n) )
+			break;
+		}
 
 		default: error = 1; break; /* Unknown opcode. */
 		}
+		STATISTICS(if (statistics) {
+			++statistics->opcode_count[opcode];
+			statistics->opcode_cycles[opcode] += statistics_cycles() - cycles;
+		})
 	}
-	assert(stack.count == 1); /* Only only one number left on the stack. */
-	*result = stack.stack[0];
+	if (error != 0) {goto end;}
+	assert(count == 1); /* Only only one number left on the stack. */
+	*result = stack[0];
 
 end:
-	if (stack.stack) {free(stack.stack);}
 	return error;
 
 	#undef POP
 	#undef PUSH
 }
 
+int machine_execute_dual(VirtualMachine *machine, double *value, double *derivative) {
+	int error = 0;                      /**< Exit status, 0 mean no error.    */
+	int index = machine->code.length-1; /**< Current index into the bytecode. */
+
+	DualNumber tmp[MAX_ARITY]; /**< Temporary registers.       */
+	int        tmp_i = 0;      /**< Index of current register. */
+
+	/** Stack of intermediate dual numbers, at least one slot. */
+	DualNumber stack[machine->code.depth > 0 ? machine->code.depth : 1];
+	size_t     count = 0; /**< Number of elements on the stack. */
+
+	assert(machine->code.precision == VM_DOUBLE);
+	STATISTICS(NewtonStatistics *statistics = statistics_current();)
+
+	/** Pop a dual number off this function's stack. */
+	#define POP  { \
+		assert(tmp_i < MAX_ARITY); \
+		assert(count > 0); \
+		tmp[tmp_i++] = stack[--count]; \
+	}
+
+	/** Push a value and its derivative to function's stack. */
+	#define PUSH(v, d) { \
+		assert(count < machine->code.depth); \
+		stack[count].value      = v; \
+		stack[count].derivative = d; \
+		++count; \
+		tmp_i = 0; \
+	}
+
+	/* Shorthands for the operands and their derivatives. */
+	#define A   tmp[0].value
+	#define B   tmp[1].value
+	#define DA  tmp[0].derivative
+	#define DB  tmp[1].derivative
+
+	while (index >= 0) {
+		if (error != 0) {goto end;}
+		uint8_t opcode = machine->code.code[index--];
+		STATISTICS(uint64_t cycles = statistics ? statistics_cycles() : 0;)
+
+		switch (opcode) {
+		case OPC_NUM: {
+			/* Literals are unaligned in the bytecode, they have to be copied. */
+			double number = read_number(machine->code.code, &index);
+			PUSH(number, 0.0)
+			break;
+		}
+		case OPC_NEG   :  POP       PUSH( -A      , -DA                     )  break;
+		case OPC_ADD   :  POP  POP  PUSH(  A + B  ,  DA + DB                )  break;
+		case OPC_SUB   :  POP  POP  PUSH(  A - B  ,  DA - DB                )  break;
+		case OPC_MULT  :  POP  POP  PUSH(  A * B  ,  DA * B + A * DB        )  break;
+		case OPC_DIV   :  POP  POP  PUSH(  A / B  , (DA * B - A * DB)/(B*B) )  break;
+		case OPC_POW   : {
+			POP POP
+			double power = pow(A, B);
+			/* A constant exponent must not go through the logarithm, because
+			 * pow(x, y) is allowed for negative x and integer y. */
+			double d = DB == 0.0
+			         ? (DA == 0.0 ? 0.0 : B * pow(A, B - 1) * DA)
+			         : power * (DB * log(A) + B * DA / A);
+			PUSH(power, d)
+			break;
+		}
+		case OPC_EXP   : {
+			POP
+			double e = exp(A);
+			PUSH(e, e * DA)
+			break;
+		}
+		case OPC_LN    :  POP       PUSH( log(A)  ,  DA / A                 )  break;
+		case OPC_SIN   :  POP       PUSH( sin(A)  ,  DA * cos(A)            )  break;
+		case OPC_COS   :  POP       PUSH( cos(A)  , -DA * sin(A)            )  break;
+		case OPC_TAN   : {
+			POP
+			double c = cos(A);
+			PUSH(tan(A), DA / (c * c))
+			break;
+		}
+		case OPC_VAR_X :            PUSH( machine->reg_x, 1.0               )  break;
+		case OPC_PI    :            PUSH( PI      , 0.0                     )  break;
+		case OPC_E     :            PUSH( E       , 0.0                     )  break;
+		case OPC_VAR   : {
+			uint8_t variable = machine->code.code[index--];
+			if (variable == 0 || variable > machine->reg_count) {error = 1; break;}
+			PUSH( machine->reg_vars[variable - 1], 0.0 )
+			break;
+		}
+		case OPC_ADDC  : {
+			double c = read_number(machine->code.code, &index);
+			POP PUSH( c + A, DA )
+			break;
+		}
+		case OPC_MULC  : {
+			double c = read_number(machine->code.code, &index);
+			POP PUSH( c * A, c * DA )
+			break;
+		}
+		case OPC_MADDC : {
+			double c1 = read_number(machine->code.code, &index);
+			double c2 = read_number(machine->code.code, &index);
+			POP PUSH( c1 * A + c2, c1 * DA )
+			break;
+		}
+		case OPC_POWI  : {
+			uint8_t n = machine->code.code[index--];
+			POP
+			/* A constant power has no derivative, n - 1 would wrap around. */
+			double dn = n == 0 ? 0.0 : n * machine_integer_power(A, n - 1);
+			PUSH(machine_integer_power(A, n), dn * DA)
+			break;
+		}
+
+		default: error = 1; break; /* Unknown opcode. */
+		}
+		STATISTICS(if (statistics) {
+			++statistics->opcode_count[opcode];
+			statistics->opcode_cycles[opcode] += statistics_cycles() - cycles;
+		})
+	}
+	if (error != 0) {goto end;}
+	assert(count == 1); /* Only only one number left on the stack. */
+	*value      = stack[0].value;
+	*derivative = stack[0].derivative;
+
+end:
+	return error;
+
+	#undef POP
+	#undef PUSH
+	#undef A
+	#undef B
+	#undef DA
+	#undef DB
+}
+
+static double read_number(const uint8_t *code, int *index) {
+	double number;
+	*index -= sizeof(double);
+	memcpy(&number, code + *index + 1, sizeof(double));
+	return number;
+}
@@ -16,7 +16,9 @@
  *  next sequence of bytes is the number literal. Numbers, be they literals or
  *  results of a previous computation, are stored in registers.
  *
- *  The machine has only one register holding the variable X. There are no
+ *  The machine has one register holding the variable X and a register file
+ *  holding the indexed variables x1, x2, ... of a system of functions; the
+ *  byte before an indexed variable's opcode is its index. There are no
  *  registers for processing the arithmetic expression, a stack is used
  *  instead.  We could use temporary registers for the operands of an operator
  *  like this:
@@ -35,15 +37,99 @@
  *      // where `vm` is a pointer to the virtual machine
  *      
  *  The stack does not have to grow, it has a fixed size that matches the
- *  maximum arity of any operator (2 in this case, but it could be larger).
+ *  maximum depth the compiler backend has computed for the code. The stack
+ *  lives either in the C stack frame of the executing function or in a buffer
+ *  provided by the caller, so executing code never touches the heap.
  */
 
+/** Number of values processed at once by the batched machine.
+ *
+ *  @sa machine_execute_batch
+ */
+#define VM_LANES  64
+
+/** Number of values processed at once by the batched float machine, as many
+ *  as fit into the memory of `VM_LANES` doubles.
+ *
+ *  @sa machine_execute_batch_float
+ */
+#define VM_FLOAT_LANES  (2 * VM_LANES)
+
 /** Structure of a virtual machine to run the bytecode of an arithmetic expression. */
 typedef struct virtual_machine {
-	VMCode code;  /**< Compiled bytecode of an arithmetic expression.       */
-	double reg_x; /**< Value of the variable for the arithmetic expression. */
-} VirtualMachine; 
+	VMCode        code;      /**< Compiled bytecode of an arithmetic expression.       */
+	double        reg_x;     /**< Value of the variable for the arithmetic expression. */
+	const double *reg_vars;  /**< Values of the indexed variables, x1 first, or NULL.  */
+	size_t        reg_count; /**< Number of indexed variables in the register file.    */
+} VirtualMachine;
+
+
+/** Single decoded instruction of threaded code.
+ *
+ *  @sa VMThreadedCode
+ */
+typedef struct vm_instruction {
+	const void *handler; /**< Address of the handler, if directly threaded. */
+	uint8_t     opcode;  /**< Opcode of the instruction.                     */
+	double      operand; /**< Number literal or constant of a fused opcode.  */
+	double      addend;  /**< Term of `OPC_MADDC`.                           */
+} VMInstruction;
+
+/** Bytecode decoded into threaded code.
+ *
+ *  Threaded code is an array of instructions in the order in which they are
+ *  executed, with the operands aligned in memory. Decoding verifies the code
+ *  once, so that executing it does not have to check anything. The threaded
+ *  code is independent of the original code and owns its instructions, it
+ *  must be cleared before it can be safely deleted.
+ *
+ *  @sa vm_threaded_code_decode, vm_threaded_code_clear
+ */
+typedef struct vm_threaded_code {
+	VMInstruction *instructions; /**< Array of decoded instructions.     */
+	size_t         length;       /**< Number of instructions.            */
+	size_t         depth;        /**< Maximum depth of the stack.        */
+} VMThreadedCode;
 
+/** Entry of a tape, one per executed instruction.
+ *
+ *  @sa VMTape
+ */
+typedef struct vm_tape_entry {
+	double  value;              /**< Value computed by the instruction.        */
+	double  adjoint;            /**< Derivative of the result by the value.    */
+	double  partial[MAX_ARITY]; /**< Derivatives of the value by the operands. */
+	size_t  operand[MAX_ARITY]; /**< Entries of the operands.                  */
+	uint8_t arity;              /**< Number of operands.                       */
+	uint8_t variable;           /**< Index of an indexed variable, or 0.       */
+	uint8_t varying;            /**< Whether the value depends on a variable.  */
+} VMTapeEntry;
+
+/** Tape recording an execution for reverse-mode differentiation.
+ *
+ *  The tape is a buffer which is reserved once for the code to execute and
+ *  then reused for every execution, recording never allocates memory. The
+ *  tape must be cleared before it can be safely deleted.
+ *
+ *  @sa vm_tape_reserve, vm_tape_clear, machine_execute_gradient
+ */
+typedef struct vm_tape {
+	VMTapeEntry *entries;  /**< Buffer of entries.                  */
+	size_t       capacity; /**< Number of entries the buffer holds. */
+	size_t       length;   /**< Number of entries recorded.         */
+} VMTape;
+
+/** Closed interval of real numbers.
+ *
+ *  The interval with both bounds infinite is the entire real line, it stands
+ *  for a value about which nothing is known, including NaN.
+ *
+ *  @sa machine_execute_interval
+ */
+typedef struct vm_interval {
+	double lower; /**< Lower bound. */
+	double upper; /**< Upper bound. */
+} VMInterval;
 
 /** Loads new code into the machine.
  *
@@ -68,15 +154,225 @@ VMCode machine_load_code(VirtualMachine *machine, VMCode code);
  *  @return  0 if no error occurred, non-0 otherwise.
  *
  *  The machine will be run using the current value of the `reg_x` register and
- *  if it successfully terminates the register will be set to the result of the
- *  expression. If the machine aborts prematurely the register will remain
- *  unchanged. The machine can abort if the internal stack is unable to grow to
- *  accommodate for the numbers to store.
+ *  if it successfully terminates the result will be set to the value of the
+ *  expression. If the machine aborts prematurely the result will remain
+ *  unchanged. The machine can abort if it encounters an unknown opcode or an
+ *  indexed variable which is not in the register file.
  *
  *  To use a different starting value set the register manually before
- *  executing code.
+ *  executing code. The stack is reserved on the C stack according to the depth
+ *  stored in the code, no memory is allocated on the heap.
  */
 int machine_execute(VirtualMachine *machine, double *result);
 
+/** Raises a number to a non-negative integer power by multiplications.
+ *
+ *  @param base  The base.
+ *  @param n     The exponent.
+ *
+ *  @return  The power.
+ *
+ *  The power is computed by squaring and multiplying, going over the binary
+ *  digits of n from the top. This is the operation of `OPC_POWI`, every
+ *  engine performs the same multiplications in the same order, so that they
+ *  all yield the same result.
+ */
+double machine_integer_power(double base, unsigned int n);
+
+/** Execute the loaded bytecode using a caller-provided stack.
+ *
+ *  @param machine  The machine to execute the code.
+ *  @param stack    Array of at least `machine->code.depth` numbers.
+ *  @param result   Pointer to a variable to store the result in, must not be
+ *                  NULL.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  This is the same as `machine_execute`, except that the stack memory is
+ *  provided by the caller. Use this if the same buffer is to be reused for
+ *  many executions of the same code.
+ */
+int machine_execute_stack(VirtualMachine *machine, double *stack, double *result);
+
+/** Execute the loaded bytecode and compute the derivative alongside.
+ *
+ *  @param machine     The machine to execute the code.
+ *  @param value       Pointer to store the value of the expression in.
+ *  @param derivative  Pointer to store the derivative of the expression in.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  Instead of plain numbers the machine operates on dual numbers: every number
+ *  on the stack carries its derivative with respect to X along. This is
+ *  forward-mode automatic differentiation, one pass over the code of a
+ *  function yields both f(x) and f'(x). There is no need for a separate
+ *  derivative code, and every subexpression of the function is evaluated only
+ *  once. Indexed variables are constants with respect to X.
+ *
+ *  Either output remains unchanged if the machine aborts prematurely.
+ */
+int machine_execute_dual(VirtualMachine *machine, double *value, double *derivative);
+
+/** Execute bytecode for an entire array of values of X.
+ *
+ *  @param code    The code to execute.
+ *  @param x       Array of values for the variable X.
+ *  @param result  Array to store the results in, one per value of X.
+ *  @param count   Number of values to process.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  The values are processed in chunks of `VM_LANES` values, every opcode is
+ *  dispatched only once per chunk and performs its operation on all values of
+ *  the chunk in a loop. The stack is laid out as a structure of arrays on the
+ *  C stack, no memory is allocated on the heap. The arrays for X and the
+ *  results may be the same.
+ *
+ *  If an error occurs the contents of the result array are unspecified.
+ */
+int machine_execute_batch(const VMCode *code, const double *x, double *result, size_t count);
+
+/** Execute code of float precision.
+ *
+ *  @param code    The code to execute, of precision `VM_FLOAT`.
+ *  @param x       Value of the variable X.
+ *  @param result  Pointer to store the result in.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  The same machine as `machine_execute`, except that every number is a
+ *  `float` and every operation is the `float` function of libm, like `sinf`.
+ *  Indexed variables are not supported.
+ */
+int machine_execute_float(const VMCode *code, float x, float *result);
+
+/** Execute code of float precision for an entire array of values of X.
+ *
+ *  @param code    The code to execute, of precision `VM_FLOAT`.
+ *  @param x       Array of values for the variable X.
+ *  @param result  Array to store the results in, one per value of X.
+ *  @param count   Number of values to process.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  The same machine as `machine_execute_batch` in float, the chunks are
+ *  `VM_FLOAT_LANES` values wide: a vector register holds twice as many floats
+ *  as doubles. The results are those of `machine_execute_float`.
+ */
+int machine_execute_batch_float(const VMCode *code, const float *x, float *result, size_t count);
+
+/** Decodes bytecode into threaded code.
+ *
+ *  @param code      The bytecode to decode.
+ *  @param threaded  Pointer to the threaded code to create.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  Decoding fails if the bytecode contains an unknown opcode, if a literal is
+ *  truncated or if the operators do not match their operands. In that case the
+ *  threaded code is left empty.
+ */
+int vm_threaded_code_decode(const VMCode code, VMThreadedCode *threaded);
+
+/** Clears threaded code by freeing its instructions.
+ *
+ *  @param code  The threaded code to clear.
+ */
+void vm_threaded_code_clear(VMThreadedCode *const code);
+
+/** Execute threaded code.
+ *
+ *  @param code    The threaded code to execute.
+ *  @param x       Value of the variable X.
+ *  @param result  Pointer to a variable to store the result in.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  The dispatch engine is selected at build time: if `VM_DIRECT_THREADING` is
+ *  defined and the compiler supports GNU C every handler jumps directly to the
+ *  next one, otherwise the decoded opcodes are dispatched through a `switch`.
+ *  The code is shared read-only, so many threads can execute the same code.
+ */
+int machine_execute_threaded(const VMThreadedCode *code, double x, double *result);
+
+/** Execute register code.
+ *
+ *  @param code    The register code to execute.
+ *  @param x       Value of the variable X.
+ *  @param result  Pointer to a variable to store the result in.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  The register file is reserved on the C stack and the constant pool is
+ *  copied into it, then the instructions are executed in order. The code is not
+ *  modified, so many threads can execute the same code.
+ */
+int machine_execute_register(const VMRegisterCode *code, double x, double *result);
+
+/** Makes sure a tape can record an execution of some code.
+ *
+ *  @param tape  The tape, an empty tape is all zeros.
+ *  @param code  The code to be executed.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  The tape grows only if it is too small, so it can be reserved for every
+ *  function of a system in turn and ends up large enough for all of them.
+ */
+int vm_tape_reserve(VMTape *tape, const VMCode code);
+
+/** Clears a tape by freeing its entries.
+ *
+ *  @param tape  The tape to clear.
+ */
+void vm_tape_clear(VMTape *const tape);
+
+/** Execute the loaded bytecode and compute the gradient by all variables.
+ *
+ *  @param machine   The machine to execute the code, with the indexed
+ *                   variables in its register file.
+ *  @param tape      Tape reserved for the code.
+ *  @param value     Pointer to store the value of the expression in.
+ *  @param gradient  Array to store the derivatives by the indexed variables
+ *                   in, one per register of the register file.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  This is reverse-mode automatic differentiation: the execution is recorded
+ *  on the tape, then a single sweep backwards over the tape yields the
+ *  derivatives by all the variables at once. The cost is proportional to the
+ *  length of the code regardless of the number of variables, where deriving
+ *  by every variable on its own is proportional to both. The variable X is a
+ *  constant.
+ *
+ *  The outputs are unspecified if the machine aborts prematurely.
+ */
+int machine_execute_gradient(VirtualMachine *machine, VMTape *tape, double *value, double *gradient);
+
+/** Execute the loaded bytecode on an interval of X.
+ *
+ *  @param machine  The machine to execute the code, the X register is
+ *                  ignored.
+ *  @param x        Interval of the variable X.
+ *  @param result   Pointer to store the interval of the expression in.
+ *
+ *  @return  0 if no error occurred, non-0 otherwise.
+ *
+ *  This is interval arithmetic: every number on the stack is an interval, and
+ *  every operation yields an interval which contains the results of the
+ *  operation for all the numbers of its operand intervals. The bounds are
+ *  rounded outwards, so the resulting interval encloses the value of the
+ *  expression for every X of the interval despite round-off. If the result
+ *  does not contain 0, the expression has no root in the interval.
+ *
+ *  The enclosure is not tight: every occurrence of X is treated as an
+ *  independent value, so `x - x` on [0, 1] yields [-1, 1]. The narrower the
+ *  interval of X, the closer the enclosure. Indexed variables are the points
+ *  of their registers.
+ *
+ *  The output is unspecified if the machine aborts prematurely.
+ */
+int machine_execute_interval(VirtualMachine *machine, VMInterval x, VMInterval *result);
+
 #endif /* NEWTON_VM_H */
 
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "vm.h"
+#include "opcodes.h"
+
+/* Batched execution:
+ *
+ * The batched machine runs the same code over many values of X at once. The
+ * values are processed in chunks of VM_LANES lanes, and every slot of the
+ * stack is an array with one number per lane (structure of arrays). This way
+ * each opcode is decoded only once per chunk and its operation becomes a tight
+ * loop over the lanes with a fixed trip count, which the C compiler can
+ * vectorise.
+ *
+ * If the last chunk is not full the remaining lanes are padded with the last
+ * value; their results are computed but never written out.
+ */
+
+/** Execute the code for one chunk of lanes.
+ *
+ *  @param code    The code to execute.
+ *  @param x       Array of VM_LANES values for the variable X.
+ *  @param result  Array of VM_LANES numbers to store the results in.
+ *  @param stack   Stack of at least `code->depth` slots of lanes.
+ *
+ *  @return 0 on success, non-0 on error.
+ */
+static int execute_chunk(const VMCode *code, const double *x, double *result, double (*stack)[VM_LANES]);
+
+
+int machine_execute_batch(const VMCode *code, const double *x, double *result, size_t count) {
+	int error = 0; /* No error. */
+
+	/* Reserve at least one slot, VLAs of size 0 are undefined. */
+	double stack[code->depth > 0 ? code->depth : 1][VM_LANES];
+	double lanes_x[VM_LANES];      /* Values of X for the current chunk.  */
+	double lanes_result[VM_LANES]; /* Results of the current chunk.       */
+
+	assert(code->precision == VM_DOUBLE);
+
+	for (size_t offset = 0; offset < count; offset += VM_LANES) {
+		size_t lanes = count - offset < VM_LANES ? count - offset : VM_LANES;
+
+		for (size_t l = 0; l < VM_LANES; ++l) {
+			lanes_x[l] = x[offset + (l < lanes ? l : lanes - 1)];
+		}
+		if ((error = execute_chunk(code, lanes_x, lanes_result, stack)) != 0) {goto end;}
+		memcpy(result + offset, lanes_result, lanes * sizeof(double));
+	}
+
+end:
+	return error;
+}
+
+static int execute_chunk(const VMCode *code, const double *x, double *result, double (*stack)[VM_LANES]) {
+	int    error = 0;              /**< Exit status, 0 mean no error.    */
+	int    index = code->length-1; /**< Current index into the bytecode. */
+	size_t count = 0;              /**< Number of slots on the stack.    */
+
+	/* Loop over all lanes of the chunk. */
+	#define LANES  for (size_t l = 0; l < VM_LANES; ++l)
+
+	/** Unary operation: replace the top slot. */
+	#define UNARY(expression) { \
+		assert(count > 0); \
+		double *restrict a = stack[count-1]; \
+		LANES {a[l] = expression;} \
+		break; \
+	}
+
+	/** Binary operation: pop the top slot and combine it with the one below. */
+	#define BINARY(expression) { \
+		assert(count > 1); \
+		double *restrict a = stack[count-1]; \
+		double *restrict b = stack[count-2]; \
+		LANES {b[l] = expression;} \
+		--count; \
+		break; \
+	}
+
+	/** Nullary operation: push a new slot. */
+	#define NULLARY(expression) { \
+		assert(count < code->depth); \
+		double *restrict a = stack[count++]; \
+		LANES {a[l] = expression;} \
+		break; \
+	}
+
+	while (index >= 0) {
+		uint8_t opcode = code->code[index--];
+
+		switch (opcode) {
+		case OPC_NUM: {
+			double number;
+			index -= sizeof(double);
+			memcpy(&number, code->code + index + 1, sizeof(double));
+			NULLARY( number )
+		}
+		case OPC_NEG   :  UNARY(      -a[l]         )
+		case OPC_ADD   :  BINARY(      a[l] + b[l]  )
+		case OPC_SUB   :  BINARY(      a[l] - b[l]  )
+		case OPC_MULT  :  BINARY(      a[l] * b[l]  )
+		case OPC_DIV   :  BINARY(      a[l] / b[l]  )
+		case OPC_POW   :  BINARY(  pow(a[l] , b[l]) )
+		case OPC_EXP   :  UNARY(   exp(a[l])        )
+		case OPC_LN    :  UNARY(   log(a[l])        )
+		case OPC_SIN   :  UNARY(   sin(a[l])        )
+		case OPC_COS   :  UNARY(   cos(a[l])        )
+		case OPC_TAN   :  UNARY(   tan(a[l])        )
+		case OPC_VAR_X :  NULLARY( x[l]             )
+		case OPC_PI    :  NULLARY( PI               )
+		case OPC_E     :  NULLARY( E                )
+		case OPC_ADDC  :
+		case OPC_MULC  :
+		case OPC_MADDC : {
+			double c1, c2; /* Constant in front, and the term of MADDC. */
+			index -= sizeof(double);
+			memcpy(&c1, code->code + index + 1, sizeof(double));
+			if (opcode == OPC_ADDC) {UNARY( c1 + a[l] )}
+			if (opcode == OPC_MULC) {UNARY( c1 * a[l] )}
+			index -= sizeof(double);
+			memcpy(&c2, code->code + index + 1, sizeof(double));
+			UNARY( c1 * a[l] + c2 )
+		}
+		case OPC_POWI  : {
+			/* Same multiplications as machine_integer_power, lane by lane. */
+			unsigned int n = code->code[index--];
+			if (n == 0) {UNARY( 1.0 )}
+			assert(count > 0);
+			double *restrict a = stack[count-1];
+			double base[VM_LANES];
+			memcpy(base, a, sizeof(base));
+			int bit = 0;
+			while (n >> (bit + 1)) {++bit;}
+			while (bit-- > 0) {
+				LANES {a[l] *= a[l];}
+				if (n >> bit & 1) {LANES {a[l] *= base[l];}}
+			}
+			break;
+		}
+
+		default: error = 1; goto end; /* Unknown opcode. */
+		}
+	}
+	assert(count == 1); /* Only only one slot left on the stack. */
+	memcpy(result, stack[0], VM_LANES * sizeof(double));
+
+end:
+	return error;
+
+	#undef LANES
+	#undef UNARY
+	#undef BINARY
+	#undef NULLARY
+}
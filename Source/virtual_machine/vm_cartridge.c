@@ -0,0 +1,243 @@
+#define _POSIX_C_SOURCE 200809L /* mmap, getpid */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "vm_cartridge.h"
+#include "vm.h"
+#include "../status/status.h"
+
+/** Magic bytes at the beginning of every cartridge file. */
+#define MAGIC  "NEWTONVM"
+
+/** Written in the byte order of the machine, tells the order when read. */
+#define BYTE_ORDER_TAG  0x01020304u
+
+/** Header of a cartridge file.
+ *
+ *  All members have fixed sizes and are naturally aligned, so there is no
+ *  padding and the header can be written and mapped as it is.
+ */
+struct vm_cartridge_header {
+	char     magic[8];          /**< Always `MAGIC`.                      */
+	uint32_t version;           /**< `VM_CARTRIDGE_VERSION`.              */
+	uint32_t byte_order;        /**< `BYTE_ORDER_TAG`.                    */
+	uint32_t double_size;       /**< `sizeof(double)`.                    */
+	uint32_t reserved;          /**< Always 0.                            */
+	uint64_t source_hash;       /**< Hash of the source code.             */
+	uint64_t source_length;     /**< Length of the source, without null.  */
+	uint64_t function_length;   /**< Length of the function bytecode.     */
+	uint64_t function_depth;    /**< Stack depth of the function.         */
+	uint64_t derivative_length; /**< Length of the derivative bytecode.   */
+	uint64_t derivative_depth;  /**< Stack depth of the derivative.       */
+	uint64_t code_hash;         /**< Hash of the header and bytecodes.    */
+};
+
+/** Empty cartridge. */
+static const VMCartridge empty_cartridge = {
+	.memory     = NULL,
+	.size       = 0,
+	.source     = NULL,
+	.function   = {.length = 0, .capacity = 0, .depth = 0, .code = NULL},
+	.derivative = {.length = 0, .capacity = 0, .depth = 0, .code = NULL},
+};
+
+/** Basis of the 64 bit FNV-1a hash. */
+#define FNV_BASIS  14695981039346656037u
+
+/** Continues a 64 bit FNV-1a hash over some bytes.
+ *
+ *  @param hash   Hash so far, `FNV_BASIS` to start.
+ *  @param bytes  The bytes to hash.
+ *  @param n      Number of bytes.
+ *
+ *  @return  The new hash.
+ */
+static uint64_t hash_bytes(uint64_t hash, const uint8_t *bytes, size_t n);
+
+/** Hash of a header up to the code hash, followed by both bytecodes.
+ *
+ *  @param header      The header.
+ *  @param function    Bytecode of the function.
+ *  @param derivative  Bytecode of the derivative.
+ *
+ *  @return  The hash to store as the code hash of the header.
+ */
+static uint64_t hash_code(const struct vm_cartridge_header *header, const uint8_t *function, const uint8_t *derivative);
+
+/** Whether the depth of a loaded code is the depth its instructions need.
+ *
+ *  @param code  The code.
+ *
+ *  @return  1 if the code decodes and its depth matches, 0 otherwise.
+ *
+ *  The machines size their stacks by the depth, a wrong depth would let them
+ *  write past the end.
+ */
+static int check_depth(const VMCode code);
+
+
+uint64_t vm_cartridge_hash(const char *source) {
+	return hash_bytes(FNV_BASIS, (const uint8_t *)source, strlen(source));
+}
+
+int vm_cartridge_path(const char *directory, const char *source, char *path, size_t size) {
+	int length = snprintf(path, size, "%s/%016llx" VM_CARTRIDGE_EXTENSION, directory, (unsigned long long)vm_cartridge_hash(source));
+	return length < 0 || (size_t)length >= size;
+}
+
+int vm_cartridge_write(const char *path, const char *source, const VMCode function, const VMCode derivative) {
+	int  error = 0; /* No error. */
+	char temporary[4096];
+
+	if (function.precision != VM_DOUBLE || derivative.precision != VM_DOUBLE) {
+		status_report("Cartridge error: only code of double precision can be written.\n");
+		return 1;
+	}
+
+	struct vm_cartridge_header header = {
+		.magic             = MAGIC,
+		.version           = VM_CARTRIDGE_VERSION,
+		.byte_order        = BYTE_ORDER_TAG,
+		.double_size       = sizeof(double),
+		.reserved          = 0,
+		.source_hash       = vm_cartridge_hash(source),
+		.source_length     = strlen(source),
+		.function_length   = function.length,
+		.function_depth    = function.depth,
+		.derivative_length = derivative.length,
+		.derivative_depth  = derivative.depth,
+		.code_hash         = 0,
+	};
+	header.code_hash = hash_code(&header, function.code, derivative.code);
+
+	/* The process ID keeps concurrent writers of the same file apart. */
+	int length = snprintf(temporary, sizeof temporary, "%s.%ld.tmp", path, (long)getpid());
+	if (length < 0 || (size_t)length >= sizeof temporary) {
+		status_report("Cartridge error: path '%s' is too long.\n", path);
+		return 1;
+	}
+
+	FILE *file = fopen(temporary, "wb");
+	if (!file) {
+		status_report("Cartridge error: could not create '%s': %s.\n", temporary, strerror(errno));
+		return 1;
+	}
+	fwrite(&header        , sizeof header    , 1, file);
+	fwrite(source         , 1, header.source_length + 1, file);
+	fwrite(function.code  , 1, function.length  , file);
+	fwrite(derivative.code, 1, derivative.length, file);
+	if (ferror(file)) {error = 1;}
+	if (fclose(file) != 0) {error = 1;}
+
+	if (!error && rename(temporary, path) != 0) {error = 1;}
+	if (error) {
+		status_report("Cartridge error: could not write '%s': %s.\n", path, strerror(errno));
+		remove(temporary);
+	}
+	return error;
+}
+
+int vm_cartridge_load(const char *path, VMCartridge *cartridge) {
+	struct stat status;
+	const struct vm_cartridge_header *header;
+
+	*cartridge = empty_cartridge;
+
+	int file = open(path, O_RDONLY);
+	if (file < 0) {
+		if (errno != ENOENT) {
+			status_report("Cartridge error: could not open '%s': %s.\n", path, strerror(errno));
+		}
+		return 1;
+	}
+	if (fstat(file, &status) != 0 || (size_t)status.st_size < sizeof *header) {
+		close(file);
+		goto invalid;
+	}
+
+	cartridge->size   = (size_t)status.st_size;
+	cartridge->memory = mmap(NULL, cartridge->size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file); /* The mapping stays valid. */
+	if (cartridge->memory == MAP_FAILED) {
+		cartridge->memory = NULL;
+		goto invalid;
+	}
+
+	header = cartridge->memory;
+	if (memcmp(header->magic, MAGIC, sizeof header->magic) != 0 ||
+	    header->byte_order  != BYTE_ORDER_TAG       ||
+	    header->version     != VM_CARTRIDGE_VERSION ||
+	    header->double_size != sizeof(double)) {
+		goto invalid;
+	}
+
+	/* The sizes must add up exactly, without overflowing. */
+	uint64_t available = cartridge->size - sizeof *header;
+	if (header->source_length     >= available                                               ||
+	    header->function_length   >  available - header->source_length - 1                   ||
+	    header->derivative_length != available - header->source_length - 1 - header->function_length) {
+		goto invalid;
+	}
+
+	uint8_t *data = (uint8_t *)cartridge->memory + sizeof *header;
+	cartridge->source = (const char *)data;
+	if (cartridge->source[header->source_length] != '\0' ||
+	    vm_cartridge_hash(cartridge->source) != header->source_hash) {
+		goto invalid;
+	}
+	data += header->source_length + 1;
+
+	/* The capacity is 0, the code belongs to the mapping. */
+	cartridge->function   = (VMCode){.length = header->function_length  , .capacity = 0, .depth = header->function_depth  , .code = data};
+	data += header->function_length;
+	cartridge->derivative = (VMCode){.length = header->derivative_length, .capacity = 0, .depth = header->derivative_depth, .code = data};
+
+	if (hash_code(header, cartridge->function.code, cartridge->derivative.code) != header->code_hash ||
+	    !check_depth(cartridge->function) || !check_depth(cartridge->derivative)) {
+		goto invalid;
+	}
+	return 0;
+
+invalid:
+	status_report("Cartridge error: '%s' is damaged or was written for another machine.\n", path);
+	vm_cartridge_unload(cartridge);
+	return 1;
+}
+
+void vm_cartridge_unload(VMCartridge *cartridge) {
+	if (cartridge->memory) {
+		munmap(cartridge->memory, cartridge->size);
+	} else {
+		vm_code_clear(&cartridge->function);
+		vm_code_clear(&cartridge->derivative);
+	}
+	*cartridge = empty_cartridge;
+}
+
+static uint64_t hash_bytes(uint64_t hash, const uint8_t *bytes, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		hash = (hash ^ bytes[i]) * 1099511628211u;
+	}
+	return hash;
+}
+
+static uint64_t hash_code(const struct vm_cartridge_header *header, const uint8_t *function, const uint8_t *derivative) {
+	uint64_t hash = hash_bytes(FNV_BASIS, (const uint8_t *)header, offsetof(struct vm_cartridge_header, code_hash));
+	hash = hash_bytes(hash, function, header->function_length);
+	return hash_bytes(hash, derivative, header->derivative_length);
+}
+
+static int check_depth(const VMCode code) {
+	VMThreadedCode threaded;
+	if (vm_threaded_code_decode(code, &threaded) != 0) {return 0;}
+	int matches = threaded.depth == code.depth;
+	vm_threaded_code_clear(&threaded);
+	return matches;
+}
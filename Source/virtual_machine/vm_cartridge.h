@@ -0,0 +1,118 @@
+#ifndef NEWTON_VM_CARTRIDGE_H
+#define NEWTON_VM_CARTRIDGE_H
+
+/** @file vm_cartridge.h
+ *
+ *  Cartridge files, compiled functions stored on disk.
+ *
+ *  Following the cartridge analogy of VMCode, a cartridge file is a cartridge
+ *  which has been put on the shelf: it contains the bytecode of a function and
+ *  its derivative along with everything needed to tell whether it still fits
+ *  the machine. Loading a cartridge file skips the entire compiler.
+ *
+ *  The file starts with a header, followed by the source code of the function
+ *  (including the terminating null character), the bytecode of the function
+ *  and the bytecode of the derivative:
+ *
+ *      +--------+--------+----------+------------+
+ *      | header | source | function | derivative |
+ *      +--------+--------+----------+------------+
+ *
+ *  Number literals are part of the bytecode as the raw bytes of a double, so
+ *  bytecode is only portable between machines with the same byte order and
+ *  the same size of doubles. The header records both, as well as a version
+ *  of the format, and a file which does not match the running program is
+ *  rejected. The header itself is written in the byte order of the machine as
+ *  well, the byte order tag guards it too.
+ *
+ *  Loading maps the file into memory and the code of the cartridge points
+ *  straight into the mapping, nothing is copied. Such code belongs to the
+ *  mapping, it must never be cleared by `vm_code_clear`, instead the entire
+ *  cartridge is unloaded at once.
+ *
+ *  A hash over the header and the bytecode guards against damage, and the
+ *  bytecode is decoded once on loading to check that every instruction is
+ *  known and that the stack depth in the header is the one the code needs.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "vm_code.h"
+
+/** Version of the cartridge file format, changes with the bytecode. */
+#define VM_CARTRIDGE_VERSION  3
+
+/** Extension of cartridge files in a cache directory. */
+#define VM_CARTRIDGE_EXTENSION  ".nvm"
+
+/** Compiled function and derivative, either loaded from a file or owned.
+ *
+ *  If the memory is `NULL` the code is owned by the cartridge like any other
+ *  VMCode, otherwise it points into the mapped file.
+ *
+ *  @sa vm_cartridge_load, vm_cartridge_unload
+ */
+typedef struct vm_cartridge {
+	void       *memory;     /**< Mapping of the file, or `NULL`.     */
+	size_t      size;       /**< Size of the mapping in bytes.       */
+	const char *source;     /**< Source code of a loaded file.       */
+	VMCode      function;   /**< Bytecode of the function.           */
+	VMCode      derivative; /**< Bytecode of the derivative.         */
+} VMCartridge;
+
+/** Hash of the source code of a function.
+ *
+ *  @param source  The source code.
+ *
+ *  @return  64 bit FNV-1a hash of the source code.
+ */
+uint64_t vm_cartridge_hash(const char *source);
+
+/** Path of the cartridge file of a function in a cache directory.
+ *
+ *  @param directory  The cache directory.
+ *  @param source     Source code of the function.
+ *  @param path       Buffer to write the path to.
+ *  @param size       Size of the buffer.
+ *
+ *  @return  0 on success, non-0 if the path does not fit the buffer.
+ *
+ *  The name of the file is the hash of the source code in hexadecimal.
+ */
+int vm_cartridge_path(const char *directory, const char *source, char *path, size_t size);
+
+/** Writes a function and its derivative to a cartridge file.
+ *
+ *  @param path        Path of the file.
+ *  @param source      Source code of the function.
+ *  @param function    Bytecode of the function.
+ *  @param derivative  Bytecode of the derivative.
+ *
+ *  @return  0 on success, non-0 on error.
+ *
+ *  The file is written under a temporary name first and then renamed, so
+ *  other processes reading the same path see either the old file or the
+ *  complete new one.
+ */
+int vm_cartridge_write(const char *path, const char *source, const VMCode function, const VMCode derivative);
+
+/** Loads a cartridge file by mapping it into memory.
+ *
+ *  @param path       Path of the file.
+ *  @param cartridge  Cartridge to load into.
+ *
+ *  @return  0 on success, non-0 if the file does not exist, is damaged or was
+ *           written for a different machine or version.
+ *
+ *  A missing file is not reported, it is the usual case for a cache. On
+ *  failure the cartridge is empty.
+ */
+int vm_cartridge_load(const char *path, VMCartridge *cartridge);
+
+/** Unloads a cartridge, unmapping its file or clearing its code.
+ *
+ *  @param cartridge  The cartridge to unload.
+ */
+void vm_cartridge_unload(VMCartridge *cartridge);
+
+#endif /* NEWTON_VM_CARTRIDGE_H */
@@ -1,10 +1,18 @@
+#define _POSIX_C_SOURCE 200809L /* munmap */
+
 #include "vm_code.h"
 
+#if VM_NATIVE_CODE
+	#include <sys/mman.h>
+#endif
+
 VMCode vm_code_copy(const VMCode original, int *const error) {
 	VMCode copy = {
-		.length   = original.length,
-		.capacity = original.capacity,
-		.code     = malloc(original.capacity * sizeof(uint8_t))
+		.length    = original.length,
+		.capacity  = original.capacity,
+		.depth     = original.depth,
+		.code      = malloc(original.capacity * sizeof(uint8_t)),
+		.precision = original.precision,
 	};
 
 	if (!copy.code || !original.code) {
@@ -19,8 +27,35 @@ end:
 
 void vm_code_clear(VMCode *const code) {
 	free(code->code);
-	code->code     = NULL;
-	code->length   =    0;
-	code->capacity =    0;
+	code->code      = NULL;
+	code->length    =    0;
+	code->capacity  =    0;
+	code->depth     =    0;
+	code->precision = VM_DOUBLE;
 }
 
+
+void vm_register_code_clear(VMRegisterCode *const code) {
+	free(code->code);
+	free(code->pool);
+	*code = (VMRegisterCode){
+		.length    = 0,
+		.capacity  = 0,
+		.code      = NULL,
+		.constants = 0,
+		.pool      = NULL,
+		.registers = 0,
+		.result    = 0,
+	};
+}
+
+void vm_native_code_clear(VMNativeCode *const code) {
+	#if VM_NATIVE_CODE
+	if (code->memory) {munmap(code->memory, code->size);}
+	#endif
+	*code = (VMNativeCode){
+		.memory   = NULL,
+		.size     = 0,
+		.function = NULL,
+	};
+}
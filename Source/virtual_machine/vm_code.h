@@ -14,6 +14,11 @@
  *  punch card) containing the actual code. An empty cartridge contains no
  *  tape, so the pointer to the sequence is `NULL`.
  *
+ *  The cartridge also tells the machine how deep its stack has to be in order
+ *  to run the tape. The depth is computed once by the compiler backend, this
+ *  way the machine can reserve all the memory it needs up front instead of
+ *  growing and shrinking the stack while running.
+ *
  *  A cartridge can be copied as a *deep copy*: the new cartridge has its own
  *  code roll which is a copy of the original one. A shallow copy would share
  *  the code, which would only be useful for passing the same cartridge around.
@@ -21,6 +26,7 @@
  *      +--[CARTRIDGE]--+
  *      |               |
  *      |  length       |
+ *      |  depth        |
  *      |  code         |
  *      |   |           |
  *      +---+-----------+
@@ -33,7 +39,20 @@
  *  any of that in our case.
  */
 
-#include <stdlib.h> //size_t, uint8_t(?)
+#include <stdlib.h> //size_t
+#include <stdint.h> //uint8_t
+
+/** Precision of the numbers of bytecode.
+ *
+ *  The opcodes are the same for either precision, only the number literals in
+ *  front of `OPC_NUM` and the fused opcodes are as wide as the numbers the
+ *  code computes with. Code of one precision only runs on the machines of that
+ *  precision.
+ */
+typedef enum vm_precision {
+	VM_DOUBLE = 0, /**< 8-byte `double`, for all machines but the float ones. */
+	VM_FLOAT  = 1, /**< 4-byte `float`, for the float machines.           */
+} VMPrecision;
 
 /** Structure describing the compiled bytecode of an arithmetic expression.
  *
@@ -43,11 +62,99 @@
  *  @sa vm_code_clear
  */
 typedef struct vm_code {
-	size_t   length;   /**< Length of the bytecode sequence. */
-	size_t   capacity; /**< Length of the bytecode array.    */
-	uint8_t *code;     /**< Array of compiled bytecode.      */
+	size_t      length;    /**< Length of the bytecode sequence. */
+	size_t      capacity;  /**< Length of the bytecode array.    */
+	size_t      depth;     /**< Maximum depth of the VM stack.   */
+	uint8_t    *code;      /**< Array of compiled bytecode.      */
+	VMPrecision precision; /**< Precision of the numbers.        */
 } VMCode;
 
+/** Number of the register which holds the variable X in register code. */
+#define VM_REGISTER_X  0
+
+/** Single three-address instruction of register code.
+ *
+ *  The instruction applies the operation of its opcode to the registers *a*
+ *  and *b* and stores the result in register *dst*. Unary operations ignore
+ *  register *b*, `OPC_POWI` takes it as the exponent instead.
+ */
+typedef struct vm_register_instruction {
+	uint8_t  opcode; /**< Opcode of the operation.          */
+	uint16_t dst;    /**< Register to store the result in.  */
+	uint16_t a;      /**< Register of the first operand.    */
+	uint16_t b;      /**< Register of the second operand.   */
+} VMRegisterInstruction;
+
+/** Structure describing compiled register code of an arithmetic expression.
+ *
+ *  Register code is the alternative to the stack-based bytecode. Instructions
+ *  are executed forward and read their operands from registers and write their
+ *  result to a register, so there is no pushing and popping of numbers. Number
+ *  literals are not part of the instructions, they are kept in a separate
+ *  constant pool.
+ *
+ *  The register file of the machine is laid out as follows: the first register
+ *  holds the variable X, followed by one register for each constant of the
+ *  pool, followed by the temporary registers for intermediate results. Before
+ *  running the code the machine fills in X and copies the constant pool into
+ *  its registers, this way variables and constants need no instructions at
+ *  all.
+ *
+ *      +---+-----------+-----------------+
+ *      | X | constants | temporaries ... |
+ *      +---+-----------+-----------------+
+ *
+ *  Like VMCode the register code owns its arrays and must be cleared before
+ *  it can be safely deleted.
+ *
+ *  @sa vm_register_code_clear
+ */
+typedef struct vm_register_code {
+	size_t                 length;    /**< Number of instructions.            */
+	size_t                 capacity;  /**< Length of the instruction array.   */
+	VMRegisterInstruction *code;      /**< Array of instructions.             */
+	size_t                 constants; /**< Number of constants in the pool.   */
+	double                *pool;      /**< Constant pool.                     */
+	size_t                 registers; /**< Total number of registers needed.  */
+	uint16_t               result;    /**< Register holding the result.       */
+} VMRegisterCode;
+
+/** Whether native code can be generated on this platform.
+ *
+ *  Native code needs an x86-64 processor and an operating system which can
+ *  map memory as executable. Define `VM_NO_NATIVE_CODE` to turn it off
+ *  altogether, everything then runs on the virtual machine.
+ */
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__)) && !defined(VM_NO_NATIVE_CODE)
+	#define VM_NATIVE_CODE  1
+#else
+	#define VM_NATIVE_CODE  0
+#endif
+
+/** Native function compiled from an arithmetic expression.
+ *
+ *  @param x  Value of the variable X.
+ *
+ *  @return  Value of the expression.
+ */
+typedef double (*VMNativeFunction)(double x);
+
+/** Structure describing native machine code of an arithmetic expression.
+ *
+ *  Instead of plugging a cartridge into the virtual machine the expression is
+ *  translated into machine code of the physical machine, which can be called
+ *  just like any other C function. The code lives in its own pages of
+ *  executable memory, which the structure owns. It must be cleared before it
+ *  can be safely deleted.
+ *
+ *  @sa compiler_backend_native, vm_native_code_clear
+ */
+typedef struct vm_native_code {
+	void            *memory;   /**< Executable memory of the code.  */
+	size_t           size;     /**< Size of the memory in bytes.    */
+	VMNativeFunction function; /**< Entry point of the code.        */
+} VMNativeCode;
+
 /** Deep-copy a VM code object.
  *
  *  @param original  The original VM code object to copy.
@@ -81,5 +188,17 @@ VMCode vm_code_copy(const VMCode original, int *const error);
  */
 void vm_code_clear(VMCode *const code);
 
+/** Clears register code by freeing its instructions and constant pool.
+ *
+ *  @param code  The register code to clear.
+ */
+void vm_register_code_clear(VMRegisterCode *const code);
+
+/** Clears native code by unmapping its memory.
+ *
+ *  @param code  The native code to clear.
+ */
+void vm_native_code_clear(VMNativeCode *const code);
+
 #endif /* NEWTON_VM_CODE_H */
 
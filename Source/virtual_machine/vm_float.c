@@ -0,0 +1,261 @@
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "vm.h"
+#include "opcodes.h"
+
+/* Float machines:
+ *
+ * Both machines execute code of float precision, whose number literals are
+ * 4 bytes wide. Every number is a `float` and every operation the float
+ * version of its libm function, so a vector register holds twice as many
+ * lanes and the functions of libm have less to compute. The single machine
+ * is a plain stack machine, the batched one is laid out like the batched
+ * machine of *vm_batch.c*: every slot of the stack is an array with one
+ * number per lane.
+ *
+ * Both perform the same operations in the same order, an integer power takes
+ * the multiplications of `machine_integer_power`, so both yield the same
+ * results. These are not the results of the double machines rounded to
+ * float, every intermediate result is rounded to float as well.
+ */
+
+/** Reads a float literal in front of the current position in the bytecode.
+ *
+ *  @param code   The bytecode.
+ *  @param index  Pointer to the current index, moved in front of the number.
+ *
+ *  @return  The number.
+ */
+static float read_float(const uint8_t *code, int *index);
+
+/** Raises a float to a non-negative integer power by multiplications.
+ *
+ *  @sa machine_integer_power
+ */
+static float integer_power(float base, unsigned int n);
+
+/** Execute the code for one chunk of lanes.
+ *
+ *  @param code    The code to execute.
+ *  @param x       Array of VM_FLOAT_LANES values for the variable X.
+ *  @param result  Array of VM_FLOAT_LANES numbers to store the results in.
+ *  @param stack   Stack of at least `code->depth` slots of lanes.
+ *
+ *  @return 0 on success, non-0 on error.
+ */
+static int execute_chunk(const VMCode *code, const float *x, float *result, float (*stack)[VM_FLOAT_LANES]);
+
+
+int machine_execute_float(const VMCode *code, float x, float *result) {
+	int error = 0;                 /**< Exit status, 0 mean no error.    */
+	int index = code->length - 1;  /**< Current index into the bytecode. */
+
+	/** Stack of floats, at least one slot. */
+	float  stack[code->depth > 0 ? code->depth : 1];
+	size_t count = 0; /**< Number of elements on the stack. */
+
+	float a, b; /* Operands of the current instruction. */
+
+	if (code->precision != VM_FLOAT) {return 1;}
+
+	#define PUSH(v) {assert(count < code->depth); stack[count++] = (v);}
+	#define POP     (assert(count > 0), stack[--count])
+	/* The first operand is on top of the stack. */
+	#define POP2    {a = POP; b = POP;}
+
+	while (index >= 0) {
+		uint8_t opcode = code->code[index--];
+
+		switch (opcode) {
+		case OPC_NUM   :            PUSH( read_float(code->code, &index) )  break;
+		case OPC_NEG   :  a = POP;  PUSH(       -a      )  break;
+		case OPC_ADD   :  POP2      PUSH(        a + b  )  break;
+		case OPC_SUB   :  POP2      PUSH(        a - b  )  break;
+		case OPC_MULT  :  POP2      PUSH(        a * b  )  break;
+		case OPC_DIV   :  POP2      PUSH(        a / b  )  break;
+		case OPC_POW   :  POP2      PUSH( powf(a , b)   )  break;
+		case OPC_EXP   :  a = POP;  PUSH( expf(a)       )  break;
+		case OPC_LN    :  a = POP;  PUSH( logf(a)       )  break;
+		case OPC_SIN   :  a = POP;  PUSH( sinf(a)       )  break;
+		case OPC_COS   :  a = POP;  PUSH( cosf(a)       )  break;
+		case OPC_TAN   :  a = POP;  PUSH( tanf(a)       )  break;
+		case OPC_VAR_X :            PUSH( x             )  break;
+		case OPC_PI    :            PUSH( (float)PI     )  break;
+		case OPC_E     :            PUSH( (float)E      )  break;
+		case OPC_ADDC  : {
+			float c = read_float(code->code, &index);
+			a = POP; PUSH( c + a )
+			break;
+		}
+		case OPC_MULC  : {
+			float c = read_float(code->code, &index);
+			a = POP; PUSH( c * a )
+			break;
+		}
+		case OPC_MADDC : {
+			float c1 = read_float(code->code, &index);
+			float c2 = read_float(code->code, &index);
+			a = POP; PUSH( c1 * a + c2 )
+			break;
+		}
+		case OPC_POWI  : {
+			uint8_t n = code->code[index--];
+			a = POP; PUSH( integer_power(a, n) )
+			break;
+		}
+
+		default: error = 1; goto end; /* Unknown opcode or indexed variable. */
+		}
+	}
+	assert(count == 1); /* Only only one number left on the stack. */
+	*result = stack[0];
+
+end:
+	return error;
+
+	#undef PUSH
+	#undef POP
+	#undef POP2
+}
+
+int machine_execute_batch_float(const VMCode *code, const float *x, float *result, size_t count) {
+	int error = 0; /* No error. */
+
+	/* Reserve at least one slot, VLAs of size 0 are undefined. */
+	float stack[code->depth > 0 ? code->depth : 1][VM_FLOAT_LANES];
+	float lanes_x[VM_FLOAT_LANES];      /* Values of X for the current chunk.  */
+	float lanes_result[VM_FLOAT_LANES]; /* Results of the current chunk.       */
+
+	if (code->precision != VM_FLOAT) {return 1;}
+
+	for (size_t offset = 0; offset < count; offset += VM_FLOAT_LANES) {
+		size_t lanes = count - offset < VM_FLOAT_LANES ? count - offset : VM_FLOAT_LANES;
+
+		for (size_t l = 0; l < VM_FLOAT_LANES; ++l) {
+			lanes_x[l] = x[offset + (l < lanes ? l : lanes - 1)];
+		}
+		if ((error = execute_chunk(code, lanes_x, lanes_result, stack)) != 0) {goto end;}
+		memcpy(result + offset, lanes_result, lanes * sizeof(float));
+	}
+
+end:
+	return error;
+}
+
+static int execute_chunk(const VMCode *code, const float *x, float *result, float (*stack)[VM_FLOAT_LANES]) {
+	int    error = 0;              /**< Exit status, 0 mean no error.    */
+	int    index = code->length-1; /**< Current index into the bytecode. */
+	size_t count = 0;              /**< Number of slots on the stack.    */
+
+	/* Loop over all lanes of the chunk. */
+	#define LANES  for (size_t l = 0; l < VM_FLOAT_LANES; ++l)
+
+	/** Unary operation: replace the top slot. */
+	#define UNARY(expression) { \
+		assert(count > 0); \
+		float *restrict a = stack[count-1]; \
+		LANES {a[l] = expression;} \
+		break; \
+	}
+
+	/** Binary operation: pop the top slot and combine it with the one below. */
+	#define BINARY(expression) { \
+		assert(count > 1); \
+		float *restrict a = stack[count-1]; \
+		float *restrict b = stack[count-2]; \
+		LANES {b[l] = expression;} \
+		--count; \
+		break; \
+	}
+
+	/** Nullary operation: push a new slot. */
+	#define NULLARY(expression) { \
+		assert(count < code->depth); \
+		float *restrict a = stack[count++]; \
+		LANES {a[l] = expression;} \
+		break; \
+	}
+
+	while (index >= 0) {
+		uint8_t opcode = code->code[index--];
+
+		switch (opcode) {
+		case OPC_NUM: {
+			float number = read_float(code->code, &index);
+			NULLARY( number )
+		}
+		case OPC_NEG   :  UNARY(       -a[l]         )
+		case OPC_ADD   :  BINARY(       a[l] + b[l]  )
+		case OPC_SUB   :  BINARY(       a[l] - b[l]  )
+		case OPC_MULT  :  BINARY(       a[l] * b[l]  )
+		case OPC_DIV   :  BINARY(       a[l] / b[l]  )
+		case OPC_POW   :  BINARY(  powf(a[l] , b[l]) )
+		case OPC_EXP   :  UNARY(   expf(a[l])        )
+		case OPC_LN    :  UNARY(   logf(a[l])        )
+		case OPC_SIN   :  UNARY(   sinf(a[l])        )
+		case OPC_COS   :  UNARY(   cosf(a[l])        )
+		case OPC_TAN   :  UNARY(   tanf(a[l])        )
+		case OPC_VAR_X :  NULLARY( x[l]              )
+		case OPC_PI    :  NULLARY( (float)PI         )
+		case OPC_E     :  NULLARY( (float)E          )
+		case OPC_ADDC  :
+		case OPC_MULC  :
+		case OPC_MADDC : {
+			float c1 = read_float(code->code, &index); /* Constant in front. */
+			if (opcode == OPC_ADDC) {UNARY( c1 + a[l] )}
+			if (opcode == OPC_MULC) {UNARY( c1 * a[l] )}
+			float c2 = read_float(code->code, &index); /* Term of MADDC.     */
+			UNARY( c1 * a[l] + c2 )
+		}
+		case OPC_POWI  : {
+			/* Same multiplications as integer_power, lane by lane. */
+			unsigned int n = code->code[index--];
+			if (n == 0) {UNARY( 1.0f )}
+			assert(count > 0);
+			float *restrict a = stack[count-1];
+			float base[VM_FLOAT_LANES];
+			memcpy(base, a, sizeof(base));
+			int bit = 0;
+			while (n >> (bit + 1)) {++bit;}
+			while (bit-- > 0) {
+				LANES {a[l] *= a[l];}
+				if (n >> bit & 1) {LANES {a[l] *= base[l];}}
+			}
+			break;
+		}
+
+		default: error = 1; goto end; /* Unknown opcode or indexed variable. */
+		}
+	}
+	assert(count == 1); /* Only only one slot left on the stack. */
+	memcpy(result, stack[0], VM_FLOAT_LANES * sizeof(float));
+
+end:
+	return error;
+
+	#undef LANES
+	#undef UNARY
+	#undef BINARY
+	#undef NULLARY
+}
+
+static float read_float(const uint8_t *code, int *index) {
+	float number;
+	*index -= sizeof(float);
+	memcpy(&number, code + *index + 1, sizeof(float));
+	return number;
+}
+
+static float integer_power(float base, unsigned int n) {
+	if (n == 0) {return 1.0f;}
+	int bit = 0; /* Position of the leading binary digit. */
+	while (n >> (bit + 1)) {++bit;}
+
+	float power = base;
+	while (bit-- > 0) {
+		power *= power;
+		if (n >> bit & 1) {power *= base;}
+	}
+	return power;
+}
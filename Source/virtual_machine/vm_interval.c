@@ -0,0 +1,270 @@
+#include <string.h>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include "vm.h"
+#include "opcodes.h"
+
+/* Interval arithmetic:
+ *
+ * The machine executes the bytecode like the stack machine, except that every
+ * number on the stack is an interval [lower, upper]. Every operation computes
+ * the bounds of its result from the bounds of its operands in the current
+ * rounding mode, round-to-nearest, which is off by at most half a unit in the
+ * last place; the libm functions are off by less than one. Rounding outwards
+ * is then done by moving each bound one floating-point number further out,
+ * which encloses the exact range without switching the rounding mode of the
+ * whole thread.
+ *
+ * Operations which are not defined everywhere on their operands, like a
+ * division by an interval containing 0 or a logarithm of one reaching below 0,
+ * yield the entire real line. That is always a valid enclosure, it just means
+ * that nothing is known about the value.
+ */
+
+/** The entire real line. */
+static const VMInterval entire = {.lower = -INFINITY, .upper = INFINITY};
+
+/** Rounds an interval outwards.
+ *
+ *  @param lower  Lower bound as rounded to nearest.
+ *  @param upper  Upper bound as rounded to nearest.
+ *
+ *  @return  The interval widened by one unit in the last place on either side,
+ *           the entire real line if a bound is NaN.
+ */
+static VMInterval widen(double lower, double upper);
+
+/** Interval of a product. */
+static VMInterval multiply(VMInterval a, VMInterval b);
+
+/** Interval of a quotient. */
+static VMInterval divide(VMInterval a, VMInterval b);
+
+/** Interval of a power. */
+static VMInterval power(VMInterval a, VMInterval b);
+
+/** Interval of a power computed by multiplications.
+ *
+ *  @param a  Interval of the base.
+ *  @param n  The exponent.
+ *
+ *  @return  The interval of `pow`, widened to also enclose the results of
+ *           `machine_integer_power`.
+ */
+static VMInterval integer_power(VMInterval a, unsigned int n);
+
+/** Interval of the sine or cosine.
+ *
+ *  @param a      Interval of the argument.
+ *  @param f      Either `sin` or `cos`.
+ *  @param peak   Argument of a maximum of the function, the minima lie half a
+ *                period off.
+ *
+ *  @return  The interval of the function.
+ */
+static VMInterval wave(VMInterval a, double (*f)(double), double peak);
+
+/** Interval of the tangent. */
+static VMInterval tangent(VMInterval a);
+
+/** Whether an interval contains one of the points `offset + k * period`.
+ *
+ *  Points just outside the interval count as inside, so that the rounding of
+ *  pi never drops an extremum; counting too many only widens the result.
+ */
+static int contains_periodic(VMInterval a, double offset, double period);
+
+
+int machine_execute_interval(VirtualMachine *machine, VMInterval x, VMInterval *result) {
+	int error = 0;                      /**< Exit status, 0 mean no error.    */
+	int index = machine->code.length-1; /**< Current index into the bytecode. */
+
+	/** Stack of intervals, at least one slot. */
+	VMInterval stack[machine->code.depth > 0 ? machine->code.depth : 1];
+	size_t count = 0; /**< Number of elements on the stack. */
+
+	VMInterval a, b; /* Operands of the current instruction. */
+
+	assert(machine->code.precision == VM_DOUBLE);
+
+	#define PUSH(v) {assert(count < machine->code.depth); stack[count++] = (v);}
+	#define POP     (assert(count > 0), stack[--count])
+	/* The first operand is on top of the stack. */
+	#define POP2    {a = POP; b = POP;}
+
+	while (index >= 0) {
+		uint8_t opcode = machine->code.code[index--];
+
+		switch (opcode) {
+		case OPC_NUM: {
+			double number;
+			index -= sizeof(double);
+			memcpy(&number, machine->code.code + index + 1, sizeof(double));
+			PUSH(((VMInterval){number, number}))
+			break;
+		}
+		case OPC_NEG   :  a = POP;  PUSH(((VMInterval){-a.upper, -a.lower}))                     break;
+		case OPC_ADD   :  POP2      PUSH(widen(a.lower + b.lower, a.upper + b.upper))             break;
+		case OPC_SUB   :  POP2      PUSH(widen(a.lower - b.upper, a.upper - b.lower))             break;
+		case OPC_MULT  :  POP2      PUSH(multiply(a, b))                                          break;
+		case OPC_DIV   :  POP2      PUSH(divide(a, b))                                            break;
+		case OPC_POW   :  POP2      PUSH(power(a, b))                                             break;
+		case OPC_EXP   :  a = POP;  PUSH(widen(exp(a.lower), exp(a.upper)))                       break;
+		case OPC_LN    :  a = POP;  PUSH(a.lower > 0 ? widen(log(a.lower), log(a.upper)) : entire) break;
+		case OPC_SIN   :  a = POP;  PUSH(wave(a, sin, PI / 2))                                    break;
+		case OPC_COS   :  a = POP;  PUSH(wave(a, cos, 0))                                         break;
+		case OPC_TAN   :  a = POP;  PUSH(tangent(a))                                              break;
+		case OPC_VAR_X :            PUSH(x)                                                       break;
+		case OPC_PI    :            PUSH(widen(PI, PI))                                           break;
+		case OPC_E     :            PUSH(widen(E, E))                                             break;
+		case OPC_VAR   : {
+			uint8_t variable = machine->code.code[index--];
+			if (variable == 0 || variable > machine->reg_count) {error = 1; goto end;}
+			double value = machine->reg_vars[variable - 1];
+			PUSH(((VMInterval){value, value}))
+			break;
+		}
+		case OPC_ADDC  :
+		case OPC_MULC  :
+		case OPC_MADDC : {
+			double c1, c2; /* Constant in front, and the term of MADDC. */
+			index -= sizeof(double);
+			memcpy(&c1, machine->code.code + index + 1, sizeof(double));
+			a = POP;
+			if (opcode == OPC_ADDC) {PUSH(widen(c1 + a.lower, c1 + a.upper)) break;}
+			b = multiply((VMInterval){c1, c1}, a);
+			if (opcode == OPC_MULC) {PUSH(b) break;}
+			index -= sizeof(double);
+			memcpy(&c2, machine->code.code + index + 1, sizeof(double));
+			PUSH(widen(b.lower + c2, b.upper + c2))
+			break;
+		}
+		case OPC_POWI  : {
+			unsigned int n = machine->code.code[index--];
+			a = POP;
+			PUSH(integer_power(a, n))
+			break;
+		}
+
+		default: error = 1; goto end; /* Unknown opcode. */
+		}
+	}
+	assert(count == 1); /* Only only one interval left on the stack. */
+	*result = stack[0];
+
+end:
+	return error;
+
+	#undef PUSH
+	#undef POP
+	#undef POP2
+}
+
+static VMInterval widen(double lower, double upper) {
+	if (isnan(lower) || isnan(upper)) {return entire;}
+	return (VMInterval){nextafter(lower, -INFINITY), nextafter(upper, INFINITY)};
+}
+
+static VMInterval multiply(VMInterval a, VMInterval b) {
+	double p[4] = {a.lower * b.lower, a.lower * b.upper, a.upper * b.lower, a.upper * b.upper};
+	double lower = p[0], upper = p[0];
+	for (int i = 1; i < 4; ++i) {
+		/* 0 times infinity, the product could be anything. */
+		if (isnan(p[i])) {return entire;}
+		if (p[i] < lower) {lower = p[i];}
+		if (p[i] > upper) {upper = p[i];}
+	}
+	return widen(lower, upper);
+}
+
+static VMInterval divide(VMInterval a, VMInterval b) {
+	if (b.lower <= 0 && b.upper >= 0) {return entire;}
+	double q[4] = {a.lower / b.lower, a.lower / b.upper, a.upper / b.lower, a.upper / b.upper};
+	double lower = q[0], upper = q[0];
+	for (int i = 1; i < 4; ++i) {
+		if (isnan(q[i])) {return entire;}
+		if (q[i] < lower) {lower = q[i];}
+		if (q[i] > upper) {upper = q[i];}
+	}
+	return widen(lower, upper);
+}
+
+static VMInterval power(VMInterval a, VMInterval b) {
+	double p[4];
+	int corners = 4; /* Number of corner values to consider. */
+
+	if (b.lower == b.upper && b.lower == floor(b.lower)) {
+		/* An integer power is monotonic on either side of 0: negative bases
+		 * are fine, and only the minimum of an even power can lie inside. */
+		double n = b.lower;
+		int zero = a.lower <= 0 && a.upper >= 0;
+		if (n == 0) {return (VMInterval){1, 1};}
+		if (zero && n < 0) {return entire;}
+		p[0] = pow(a.lower, n);
+		p[1] = pow(a.upper, n);
+		corners = 2;
+		if (zero && fmod(n, 2) == 0) {p[corners++] = 0;}
+	} else {
+		/* Otherwise only positive bases are defined. The power is monotonic
+		 * in either operand, so its extremes lie on corners. */
+		if (!(a.lower > 0)) {return entire;}
+		p[0] = pow(a.lower, b.lower);
+		p[1] = pow(a.lower, b.upper);
+		p[2] = pow(a.upper, b.lower);
+		p[3] = pow(a.upper, b.upper);
+	}
+
+	double lower = p[0], upper = p[0];
+	for (int i = 1; i < corners; ++i) {
+		if (isnan(p[i])) {return entire;}
+		if (p[i] < lower) {lower = p[i];}
+		if (p[i] > upper) {upper = p[i];}
+	}
+	/* Exact zeros stay exact, x^2 of [-1, 1] is [0, 1] and not a bit less. */
+	VMInterval result = widen(lower, upper);
+	if (lower == 0) {result.lower = 0;}
+	return result;
+}
+
+static VMInterval integer_power(VMInterval a, unsigned int n) {
+	/* The other machines multiply, and every multiplication rounds. The n - 1
+	 * roundings of binary powering are off by less than n - 1 units of
+	 * DBL_EPSILON / 2 relative to the exact power, pow by less than one unit
+	 * in the last place. Moving the bounds of pow out by n units of
+	 * DBL_EPSILON relative to them covers both, and n of the smallest numbers
+	 * cover the roundings of an underflow. */
+	VMInterval result = power(a, (VMInterval){n, n});
+	if (n <= 1) {return result;}
+	double slack = n * nextafter(0.0, 1.0);
+	if (result.lower != 0 && isfinite(result.lower)) {result.lower -= fabs(result.lower) * n * DBL_EPSILON + slack;}
+	if (result.upper != 0 && isfinite(result.upper)) {result.upper += fabs(result.upper) * n * DBL_EPSILON + slack;}
+	return result;
+}
+
+static VMInterval wave(VMInterval a, double (*f)(double), double peak) {
+	VMInterval unit = {-1, 1};
+	if (!(a.upper - a.lower < 2 * PI)) {return unit;}
+
+	double fa = f(a.lower), fb = f(a.upper);
+	VMInterval result = widen(fa < fb ? fa : fb, fa < fb ? fb : fa);
+	if (contains_periodic(a, peak     , 2 * PI)) {result.upper =  1;}
+	if (contains_periodic(a, peak + PI, 2 * PI)) {result.lower = -1;}
+	if (result.lower < -1) {result.lower = -1;}
+	if (result.upper >  1) {result.upper =  1;}
+	return result;
+}
+
+static VMInterval tangent(VMInterval a) {
+	if (!(a.upper - a.lower < PI) || contains_periodic(a, PI / 2, PI)) {return entire;}
+	return widen(tan(a.lower), tan(a.upper));
+}
+
+static int contains_periodic(VMInterval a, double offset, double period) {
+	double k = floor((a.lower - offset) / period);
+	/* The nearest points on or below the lower bound and above it. */
+	double below = offset + k * period, above = below + period;
+	double slack = 4 * DBL_EPSILON * (fabs(a.lower) + fabs(a.upper) + period);
+	return (below >= a.lower - slack && below <= a.upper + slack)
+	    || (above >= a.lower - slack && above <= a.upper + slack);
+}
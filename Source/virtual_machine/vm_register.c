@@ -0,0 +1,61 @@
+#include <string.h>
+#include <math.h>
+#include "vm.h"
+#include "opcodes.h"
+
+/* Register machine:
+ *
+ * The register machine executes register code front to back. Its register
+ * file lives on the C stack, first comes the register of X, then the
+ * constants, copied from the pool in one go, and then the temporaries. Each
+ * instruction reads its operands straight from the registers and writes its
+ * result back, nothing is pushed or popped.
+ *
+ * An integer power keeps its exponent in place of the second register, so it
+ * takes the same multiplications as on the stack machine. The fused opcodes
+ * with constants are not needed, constants are registers already and a
+ * product followed by a sum rounds the same as the fused opcode.
+ */
+
+int machine_execute_register(const VMRegisterCode *code, double x, double *result) {
+	int error = 0; /**< Exit status, 0 mean no error. */
+
+	/** Register file, there is always at least the register of X. */
+	double reg[code->registers > 0 ? code->registers : 1];
+	reg[VM_REGISTER_X] = x;
+	memcpy(reg + 1, code->pool, code->constants * sizeof(double));
+
+	/* Shorthands for the registers of the current instruction. */
+	#define DST  reg[instruction->dst]
+	#define A    reg[instruction->a  ]
+	#define B    reg[instruction->b  ]
+
+	const VMRegisterInstruction *instruction = code->code;
+	const VMRegisterInstruction *last        = code->code + code->length;
+	for (; instruction < last; ++instruction) {
+		switch (instruction->opcode) {
+		case OPC_NEG   :  DST =    -A         ;  break;
+		case OPC_ADD   :  DST =     A + B     ;  break;
+		case OPC_SUB   :  DST =     A - B     ;  break;
+		case OPC_MULT  :  DST =     A * B     ;  break;
+		case OPC_DIV   :  DST =     A / B     ;  break;
+		case OPC_POW   :  DST = pow(A , B)    ;  break;
+		case OPC_EXP   :  DST = exp(A)        ;  break;
+		case OPC_LN    :  DST = log(A)        ;  break;
+		case OPC_SIN   :  DST = sin(A)        ;  break;
+		case OPC_COS   :  DST = cos(A)        ;  break;
+		case OPC_TAN   :  DST = tan(A)        ;  break;
+		case OPC_POWI  :  DST = machine_integer_power(A, instruction->b);  break;
+
+		default: error = 1; goto end; /* Unknown opcode. */
+		}
+	}
+	*result = reg[code->result];
+
+end:
+	return error;
+
+	#undef DST
+	#undef A
+	#undef B
+}
@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "vm.h"
+#include "opcodes.h"
+#include "../status/status.h"
+
+/* Reverse-mode differentiation:
+ *
+ * The forward pass executes the bytecode like the stack machine, except that
+ * every instruction appends an entry to the tape and the stack holds the
+ * numbers of entries instead of values. An entry records its value, the
+ * entries of its operands and the partial derivatives of its value by them.
+ *
+ * The reverse pass walks the tape backwards and propagates the adjoints, the
+ * derivatives of the result by every entry: the adjoint of the last entry is
+ * 1, and every entry adds its adjoint times its partials to the adjoints of
+ * its operands. The adjoints of the variable entries make up the gradient.
+ * Both passes are linear in the length of the code, no matter how many
+ * variables there are.
+ *
+ * Entries which do not depend on any indexed variable are marked constant.
+ * Their partials are never needed, so they are skipped by the reverse pass.
+ */
+
+/** Sets up a new entry on the tape.
+ *
+ *  @param tape   The tape.
+ *  @param arity  Number of operands of the entry.
+ *
+ *  @return  Pointer to the entry.
+ */
+static VMTapeEntry *append_entry(VMTape *tape, uint8_t arity);
+
+
+int vm_tape_reserve(VMTape *tape, const VMCode code) {
+	/* Every instruction takes at least one byte. */
+	if (code.length <= tape->capacity) {return 0;}
+
+	VMTapeEntry *entries = realloc(tape->entries, code.length * sizeof(VMTapeEntry));
+	if (!entries) {
+		status_report("Memory error: could not grow the tape.\n");
+		return 1;
+	}
+	tape->entries  = entries;
+	tape->capacity = code.length;
+	return 0;
+}
+
+void vm_tape_clear(VMTape *const tape) {
+	free(tape->entries);
+	tape->entries  = NULL;
+	tape->capacity = 0;
+	tape->length   = 0;
+}
+
+int machine_execute_gradient(VirtualMachine *machine, VMTape *tape, double *value, double *gradient) {
+	int error = 0;                      /**< Exit status, 0 mean no error.    */
+	int index = machine->code.length-1; /**< Current index into the bytecode. */
+
+	/** Stack of entries of the tape, at least one slot. */
+	size_t stack[machine->code.depth > 0 ? machine->code.depth : 1];
+	size_t count = 0; /**< Number of elements on the stack. */
+
+	assert(machine->code.precision == VM_DOUBLE);
+	assert(tape->capacity >= machine->code.length);
+	tape->length = 0;
+
+	/* Operands of the current entry and their values. */
+	VMTapeEntry *entry;
+	#define A   tape->entries[entry->operand[0]].value
+	#define B   tape->entries[entry->operand[1]].value
+
+	/** Pop the operands of a new entry off the stack. */
+	#define ENTRY(arity) { \
+		assert(count >= (arity)); \
+		entry = append_entry(tape, arity); \
+		for (int i = 0; i < (arity); ++i) {entry->operand[i] = stack[--count];} \
+		for (int i = 0; i < (arity); ++i) {entry->varying |= tape->entries[entry->operand[i]].varying;} \
+	}
+
+	/** Set the value and the partials of the entry and push it. */
+	#define PUSH(v, da, db) { \
+		entry->value      = v; \
+		entry->partial[0] = da; \
+		entry->partial[1] = db; \
+		assert(count < machine->code.depth); \
+		stack[count++] = tape->length - 1; \
+	}
+
+	while (index >= 0) {
+		uint8_t opcode = machine->code.code[index--];
+
+		switch (opcode) {
+		case OPC_NUM: {
+			double number;
+			index -= sizeof(double);
+			memcpy(&number, machine->code.code + index + 1, sizeof(double));
+			ENTRY(0) PUSH(number, 0, 0)
+			break;
+		}
+		case OPC_NEG   :  ENTRY(1)  PUSH( -A    , -1      , 0       )  break;
+		case OPC_ADD   :  ENTRY(2)  PUSH(  A + B,  1      , 1       )  break;
+		case OPC_SUB   :  ENTRY(2)  PUSH(  A - B,  1      , -1      )  break;
+		case OPC_MULT  :  ENTRY(2)  PUSH(  A * B,  B      , A       )  break;
+		case OPC_DIV   :  ENTRY(2)  PUSH(  A / B,  1 / B  , -A/(B*B))  break;
+		case OPC_POW   : {
+			ENTRY(2)
+			double power = pow(A, B);
+			/* A constant exponent must not go through the logarithm, because
+			 * pow(x, y) is allowed for negative x and integer y. */
+			double db = tape->entries[entry->operand[1]].varying ? power * log(A) : 0;
+			double da = tape->entries[entry->operand[0]].varying ? B * pow(A, B - 1) : 0;
+			PUSH(power, da, db)
+			break;
+		}
+		case OPC_EXP   : {
+			ENTRY(1)
+			double e = exp(A);
+			PUSH(e, e, 0)
+			break;
+		}
+		case OPC_LN    :  ENTRY(1)  PUSH( log(A),  1 / A  , 0       )  break;
+		case OPC_SIN   :  ENTRY(1)  PUSH( sin(A),  cos(A) , 0       )  break;
+		case OPC_COS   :  ENTRY(1)  PUSH( cos(A), -sin(A) , 0       )  break;
+		case OPC_TAN   : {
+			ENTRY(1)
+			double c = cos(A);
+			PUSH(tan(A), 1 / (c * c), 0)
+			break;
+		}
+		case OPC_VAR_X :  ENTRY(0)  PUSH( machine->reg_x, 0, 0      )  break;
+		case OPC_PI    :  ENTRY(0)  PUSH( PI    ,  0      , 0       )  break;
+		case OPC_E     :  ENTRY(0)  PUSH( E     ,  0      , 0       )  break;
+		case OPC_VAR   : {
+			uint8_t variable = machine->code.code[index--];
+			if (variable == 0 || variable > machine->reg_count) {error = 1; goto end;}
+			ENTRY(0)
+			entry->variable = variable;
+			entry->varying  = 1;
+			PUSH(machine->reg_vars[variable - 1], 0, 0)
+			break;
+		}
+		case OPC_ADDC  :
+		case OPC_MULC  :
+		case OPC_MADDC : {
+			double c1, c2; /* Constant in front, and the term of MADDC. */
+			index -= sizeof(double);
+			memcpy(&c1, machine->code.code + index + 1, sizeof(double));
+			ENTRY(1)
+			if (opcode == OPC_ADDC) {PUSH(c1 + A, 1, 0) break;}
+			if (opcode == OPC_MULC) {PUSH(c1 * A, c1, 0) break;}
+			index -= sizeof(double);
+			memcpy(&c2, machine->code.code + index + 1, sizeof(double));
+			PUSH(c1 * A + c2, c1, 0)
+			break;
+		}
+		case OPC_POWI  : {
+			uint8_t n = machine->code.code[index--];
+			ENTRY(1)
+			/* A constant power has no derivative, n - 1 would wrap around. */
+			double dn = n == 0 ? 0.0 : n * machine_integer_power(A, n - 1);
+			PUSH(machine_integer_power(A, n), dn, 0)
+			break;
+		}
+
+		default: error = 1; goto end; /* Unknown opcode. */
+		}
+	}
+	assert(count == 1); /* Only only one entry left on the stack. */
+
+	/* The reverse sweep, seeded with the derivative of the result by itself. */
+	for (size_t i = 0; i < machine->reg_count; ++i) {gradient[i] = 0;}
+	tape->entries[tape->length - 1].adjoint = 1;
+
+	for (size_t i = tape->length; i-- > 0;) {
+		const VMTapeEntry *e = &tape->entries[i];
+		if (!e->varying || e->adjoint == 0) {continue;}
+		if (e->variable) {gradient[e->variable - 1] += e->adjoint;}
+		for (int k = 0; k < e->arity; ++k) {
+			tape->entries[e->operand[k]].adjoint += e->adjoint * e->partial[k];
+		}
+	}
+	*value = tape->entries[tape->length - 1].value;
+
+end:
+	return error;
+
+	#undef A
+	#undef B
+	#undef ENTRY
+	#undef PUSH
+}
+
+static VMTapeEntry *append_entry(VMTape *tape, uint8_t arity) {
+	assert(tape->length < tape->capacity);
+	VMTapeEntry *entry = &tape->entries[tape->length++];
+	*entry = (VMTapeEntry){
+		.value    = 0,
+		.adjoint  = 0,
+		.partial  = {0, 0},
+		.operand  = {0, 0},
+		.arity    = arity,
+		.variable = 0,
+		.varying  = 0,
+	};
+	return entry;
+}
@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "vm.h"
+#include "opcodes.h"
+
+/* Threaded code:
+ *
+ * The bytecode tape is built for compactness: it is read backwards, number
+ * literals are stored as raw unaligned bytes and every opcode has to be
+ * checked while running. Threaded code is the decoded form of the tape: an
+ * array of instructions in the order of execution, each with its number
+ * operand properly aligned. All checks are done once while decoding, so the
+ * execution loop does not have to do any of them.
+ *
+ * If the code is compiled with `VM_DIRECT_THREADING` on a GNU C compiler every
+ * instruction holds the address of the label of its handler, and every
+ * handler jumps directly to the handler of the next instruction (direct
+ * threading). This uses the GNU *labels as values* extension, wrapped in
+ * `__extension__` to keep the pedantic build happy. Otherwise the handlers are
+ * cases of a `switch` over the decoded opcodes, which is portable but goes
+ * through a single indirect branch.
+ */
+
+#if defined(VM_DIRECT_THREADING) && defined(__GNUC__)
+	#define DIRECT_THREADING 1
+#else
+	#define DIRECT_THREADING 0
+#endif
+
+/** Opcode of the instruction which ends the threaded code. */
+#define OPC_END  0x00
+
+/** Number of entries in the table of handlers. */
+#define HANDLERS  (OPC_POWI + 1)
+
+/** Arity of an opcode.
+ *
+ *  @param opcode  The opcode.
+ *
+ *  @return  Number of operands the opcode pops off the stack, -1 if the
+ *           opcode is unknown.
+ */
+static int opcode_arity(uint8_t opcode);
+
+/** Execute threaded code, or hand out the table of handlers.
+ *
+ *  @param code      The threaded code to execute.
+ *  @param x         Value of the variable X.
+ *  @param result    Pointer to store the result in.
+ *  @param handlers  If not NULL store the table of handlers, indexed by
+ *                   opcode, here and return without executing anything.
+ *
+ *  @return  Always 0, all checks have been done while decoding.
+ *
+ *  The labels of the handlers are local to this function, so the decoder has
+ *  to ask this function for their addresses.
+ */
+static int execute(const VMThreadedCode *code, double x, double *result, const void *const **handlers);
+
+
+int vm_threaded_code_decode(const VMCode code, VMThreadedCode *threaded) {
+	int    error = 0;             /* No error.                           */
+	int    index = code.length-1; /* Current index into the bytecode.    */
+	size_t count = 0;             /* Simulated number of stack elements. */
+	size_t depth = 0;             /* Maximum number of stack elements.   */
+
+	const void *const *handlers = NULL; /* Labels of the handlers. */
+	execute(NULL, 0.0, NULL, &handlers);
+
+	/* There can't be more instructions than bytes, plus one to end. */
+	*threaded = (VMThreadedCode){
+		.instructions = malloc((code.length + 1) * sizeof(VMInstruction)),
+		.length       = 0,
+		.depth        = 0,
+	};
+	if (!threaded->instructions) {error = 1; goto end;}
+	/* The handlers compute in double, float literals would be misread. */
+	if (code.precision != VM_DOUBLE) {error = 1; goto end;}
+
+	while (index >= 0) {
+		uint8_t        opcode      = code.code[index--];
+		int            arity       = opcode_arity(opcode);
+		VMInstruction *instruction = &threaded->instructions[threaded->length++];
+
+		if (arity < 0 || count < (size_t)arity) {error = 1; goto end;}
+
+		instruction->opcode  = opcode;
+		instruction->operand = 0.0;
+		instruction->addend  = 0.0;
+		if (opcode == OPC_NUM || opcode == OPC_ADDC || opcode == OPC_MULC || opcode == OPC_MADDC) {
+			if (index + 1 < (int)sizeof(double)) {error = 1; goto end;}
+			index -= sizeof(double);
+			memcpy(&instruction->operand, code.code + index + 1, sizeof(double));
+		}
+		if (opcode == OPC_MADDC) {
+			if (index + 1 < (int)sizeof(double)) {error = 1; goto end;}
+			index -= sizeof(double);
+			memcpy(&instruction->addend, code.code + index + 1, sizeof(double));
+		}
+		if (opcode == OPC_POWI) {
+			if (index < 0) {error = 1; goto end;}
+			instruction->operand = code.code[index--];
+		}
+		if (DIRECT_THREADING) {instruction->handler = handlers[opcode];}
+
+		count = count - arity + 1;
+		if (count > depth) {depth = count;}
+	}
+	if (count != 1) {error = 1; goto end;}
+
+	threaded->instructions[threaded->length] = (VMInstruction){
+		.handler = DIRECT_THREADING ? handlers[OPC_END] : NULL,
+		.opcode  = OPC_END,
+		.operand = 0.0,
+		.addend  = 0.0,
+	};
+	++threaded->length;
+	threaded->depth = depth;
+
+end:
+	if (error) {vm_threaded_code_clear(threaded);}
+	return error;
+}
+
+void vm_threaded_code_clear(VMThreadedCode *const code) {
+	free(code->instructions);
+	code->instructions = NULL;
+	code->length       = 0;
+	code->depth        = 0;
+}
+
+int machine_execute_threaded(const VMThreadedCode *code, double x, double *result) {
+	return execute(code, x, result, NULL);
+}
+
+static int opcode_arity(uint8_t opcode) {
+	switch (opcode) {
+	case OPC_NUM   : case OPC_VAR_X : case OPC_PI  : case OPC_E   :
+		return 0;
+	case OPC_NEG   : case OPC_EXP   : case OPC_LN  : case OPC_SIN :
+	case OPC_COS   : case OPC_TAN   : case OPC_ADDC: case OPC_MULC:
+	case OPC_MADDC : case OPC_POWI  :
+		return 1;
+	case OPC_ADD   : case OPC_SUB   : case OPC_MULT: case OPC_DIV :
+	case OPC_POW   :
+		return 2;
+	}
+	return -1;
+}
+
+static int execute(const VMThreadedCode *code, double x, double *result, const void *const **handlers) {
+	#if DIRECT_THREADING
+	static const void *const labels[HANDLERS] = {
+		[ OPC_END   ] = __extension__ &&L_END   ,
+		[ OPC_NUM   ] = __extension__ &&L_NUM   ,
+		[ OPC_NEG   ] = __extension__ &&L_NEG   ,
+		[ OPC_ADD   ] = __extension__ &&L_ADD   ,
+		[ OPC_SUB   ] = __extension__ &&L_SUB   ,
+		[ OPC_MULT  ] = __extension__ &&L_MULT  ,
+		[ OPC_DIV   ] = __extension__ &&L_DIV   ,
+		[ OPC_POW   ] = __extension__ &&L_POW   ,
+		[ OPC_EXP   ] = __extension__ &&L_EXP   ,
+		[ OPC_LN    ] = __extension__ &&L_LN    ,
+		[ OPC_SIN   ] = __extension__ &&L_SIN   ,
+		[ OPC_COS   ] = __extension__ &&L_COS   ,
+		[ OPC_TAN   ] = __extension__ &&L_TAN   ,
+		[ OPC_VAR_X ] = __extension__ &&L_VAR_X ,
+		[ OPC_PI    ] = __extension__ &&L_PI    ,
+		[ OPC_E     ] = __extension__ &&L_E     ,
+		[ OPC_ADDC  ] = __extension__ &&L_ADDC  ,
+		[ OPC_MULC  ] = __extension__ &&L_MULC  ,
+		[ OPC_MADDC ] = __extension__ &&L_MADDC ,
+		[ OPC_POWI  ] = __extension__ &&L_POWI  ,
+	};
+	#endif
+
+	if (handlers) {
+		#if DIRECT_THREADING
+		*handlers = labels;
+		#else
+		*handlers = NULL;
+		#endif
+		return 0;
+	}
+
+	/* Reserve at least one slot, VLAs of size 0 are undefined. */
+	double stack[code->depth > 0 ? code->depth : 1];
+	double *sp = stack;                       /**< Next free stack slot. */
+	const VMInstruction *ip = code->instructions; /**< Next instruction. */
+
+	/* Operands of the current instruction, the top of the stack first. */
+	#define A   sp[-1]
+	#define B   sp[-2]
+
+	/* Handlers of the operations, in terms of the operands. */
+	#define NULLARY(value)  *sp++ = (value);
+	#define UNARY(value)    A = (value);
+	#define BINARY(value)   B = (value); --sp;
+
+	#if DIRECT_THREADING
+		/** Jump to the handler of the next instruction. */
+		#define NEXT     __extension__ ({ goto *(ip++)->handler; })
+		/** Beginning of a handler, the instruction is `ip[-1]`. */
+		#define CASE(o)  L_ ## o :
+		#define OPERAND  ip[-1].operand
+		#define ADDEND   ip[-1].addend
+
+		NEXT;
+	#else
+		#define NEXT     continue;
+		#define CASE(o)  case OPC_ ## o :
+		#define OPERAND  ip[-1].operand
+		#define ADDEND   ip[-1].addend
+
+		for (;;) switch ((ip++)->opcode) {
+	#endif
+
+		CASE( NUM   )  NULLARY( OPERAND      )  NEXT;
+		CASE( NEG   )  UNARY(  -A            )  NEXT;
+		CASE( ADD   )  BINARY(  A + B        )  NEXT;
+		CASE( SUB   )  BINARY(  A - B        )  NEXT;
+		CASE( MULT  )  BINARY(  A * B        )  NEXT;
+		CASE( DIV   )  BINARY(  A / B        )  NEXT;
+		CASE( POW   )  BINARY(  pow(A, B)    )  NEXT;
+		CASE( EXP   )  UNARY(   exp(A)       )  NEXT;
+		CASE( LN    )  UNARY(   log(A)       )  NEXT;
+		CASE( SIN   )  UNARY(   sin(A)       )  NEXT;
+		CASE( COS   )  UNARY(   cos(A)       )  NEXT;
+		CASE( TAN   )  UNARY(   tan(A)       )  NEXT;
+		CASE( VAR_X )  NULLARY( x            )  NEXT;
+		CASE( PI    )  NULLARY( PI           )  NEXT;
+		CASE( E     )  NULLARY( E            )  NEXT;
+		CASE( ADDC  )  UNARY(   OPERAND + A  )  NEXT;
+		CASE( MULC  )  UNARY(   OPERAND * A  )  NEXT;
+		CASE( MADDC )  UNARY(   OPERAND * A + ADDEND )  NEXT;
+		CASE( POWI  )  UNARY(   machine_integer_power(A, (unsigned int)OPERAND) )  NEXT;
+		CASE( END   )  goto end;
+
+	#if !DIRECT_THREADING
+		}
+	#endif
+
+end:
+	assert(sp == stack + 1); /* Only one number left on the stack. */
+	*result = stack[0];
+	return 0;
+
+	#undef A
+	#undef B
+	#undef NULLARY
+	#undef UNARY
+	#undef BINARY
+	#undef NEXT
+	#undef CASE
+	#undef OPERAND
+	#undef ADDEND
+}